@@ -68,6 +68,13 @@ function(PROTOBUF_GENERATE_CPP_NO_DCCL SRCS HDRS)
   set(${HDRS} ${PROTO_HDRS} PARENT_SCOPE)
 endfunction()
 
+# also generates compiled message codecs (--dccl_out=compiled:...)
+function(PROTOBUF_GENERATE_CPP_COMPILED SRCS HDRS)
+  protobuf_generate_cpp_internal("Compiled" PROTO_SRCS PROTO_HDRS ${ARGN})
+  set(${SRCS} ${PROTO_SRCS} PARENT_SCOPE)
+  set(${HDRS} ${PROTO_HDRS} PARENT_SCOPE)
+endfunction()
+
 function(PROTOBUF_GENERATE_CPP_INTERNAL USE_DCCL SRCS HDRS)
   if(NOT ARGN)
     message(SEND_ERROR "Error: PROTOBUF_GENERATE_CPP() called without any proto files")
@@ -98,7 +105,9 @@ function(PROTOBUF_GENERATE_CPP_INTERNAL USE_DCCL SRCS HDRS)
     list(APPEND ${SRCS} "${FIL_PATH}/${FIL_WE}.pb.cc")
     list(APPEND ${HDRS} "${FIL_PATH}/${FIL_WE}.pb.h")
 
-    if(USE_DCCL)
+    if(USE_DCCL STREQUAL "Compiled")
+      set(DCCL_PROTOC_ARGS --dccl_out compiled:${dccl_INC_DIR} --plugin ${dccl_EXEC_DIR}/protoc-gen-dccl)
+    elseif(USE_DCCL)
       set(DCCL_PROTOC_ARGS --dccl_out ${dccl_INC_DIR} --plugin ${dccl_EXEC_DIR}/protoc-gen-dccl)
     endif()
 
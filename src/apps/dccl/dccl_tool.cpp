@@ -48,7 +48,7 @@
 #include <stdlib.h>
 
 
-enum Action { NO_ACTION, ENCODE, DECODE, ANALYZE, DISP_PROTO };
+enum Action { NO_ACTION, ENCODE, DECODE, ANALYZE, DISP_PROTO, PROFILE };
 enum Format { BINARY, TEXTFORMAT, HEX, BASE64 };
 
 namespace dccl
@@ -63,7 +63,8 @@ namespace dccl
                   format(BINARY),
                   id_codec(dccl::Codec::default_id_codec_name()),
                   verbose(false),
-                  omit_prefix(false)
+                  omit_prefix(false),
+                  profile_iterations(1000)
                 { }
     
             Action action;
@@ -75,6 +76,7 @@ namespace dccl
             std::string id_codec;
             bool verbose;
             bool omit_prefix;
+            int profile_iterations;
         };
     }
 }
@@ -84,6 +86,10 @@ void analyze(dccl::Codec& dccl, const dccl::tool::Config& cfg);
 void encode(dccl::Codec& dccl, dccl::tool::Config& cfg);
 void decode(dccl::Codec& dccl, const dccl::tool::Config& cfg);
 void disp_proto(dccl::Codec& dccl, const dccl::tool::Config& cfg);
+void profile(dccl::Codec& dccl, dccl::tool::Config& cfg);
+
+void check_encode_message(const dccl::tool::Config& cfg);
+boost::shared_ptr<google::protobuf::Message> read_message(dccl::Codec& dccl, dccl::tool::Config& cfg, const std::string& command_line_name, std::string input);
 
         
 void load_desc(dccl::Codec* dccl,  const google::protobuf::Descriptor* desc, const std::string& name);
@@ -140,7 +146,7 @@ int main(int argc, char* argv[])
                 for(int i = 0, n = file_desc->message_type_count(); i < n; ++i)
                 {
                     cfg.message.insert(file_desc->message_type(i)->full_name());
-                    if(i == 0 && cfg.action == ENCODE)
+                    if(i == 0 && (cfg.action == ENCODE || cfg.action == PROFILE))
                     {
                         std::cerr << "Encoding assuming message: " << file_desc->message_type(i)->full_name() << std::endl;
                         break;
@@ -164,6 +170,7 @@ int main(int argc, char* argv[])
             case DECODE: decode(dccl, cfg); break;
             case ANALYZE: analyze(dccl, cfg); break;
             case DISP_PROTO: disp_proto(dccl, cfg); break;
+            case PROFILE: profile(dccl, cfg); break;
             default:
                 std::cerr << "No action specified (e.g. analyze, decode, encode). Try --help." << std::endl;
                 exit(EXIT_SUCCESS);
@@ -181,76 +188,16 @@ void analyze(dccl::Codec& dccl, const dccl::tool::Config& cfg)
 
 void encode(dccl::Codec& dccl, dccl::tool::Config& cfg)
 {
-    if(cfg.message.size() > 1)
-    {
-        std::cerr << "No more than one DCCL message can be specified with -m or --message for encoding." << std::endl;
-        exit(EXIT_FAILURE);
-    }
-    else if(cfg.message.size() == 0)
-    {
-        std::cerr << "You must specify a DCCL message to encode with -m" << std::endl;
-        exit(EXIT_FAILURE);
-    }
-    
+    check_encode_message(cfg);
     std::string command_line_name = *cfg.message.begin();
-    
+
     while(!std::cin.eof())
     {
         std::string input;
         std::getline (std::cin, input);
 
-        boost::trim(input);
-        if(input.empty())
-            continue;
-
-        std::string name;
-        if(input[0] == '|')
-        {
-            std::string::size_type close_bracket_pos = input.find('|', 1);
-            if(close_bracket_pos == std::string::npos)
-            {
-                std::cerr << "Incorrectly formatted input: expected '|'" << std::endl;
-                exit(EXIT_FAILURE);
-            }
-
-            name = input.substr(1, close_bracket_pos-1);
-            if(cfg.message.find(name) == cfg.message.end())
-            {
-                const google::protobuf::Descriptor* desc = 
-                    dccl::DynamicProtobufManager::find_descriptor(name);
-                load_desc(&dccl, desc, name);
-                cfg.message.insert(name);
-            }
-            
-            
-            if(input.size() > close_bracket_pos+1)
-                input = input.substr(close_bracket_pos+1);
-            else
-                input.clear();
-        }
-        else
-        {
-            if(cfg.message.size() == 0)
-            {
-                std::cerr << "Message name not given with -m or in the input (i.e. '[Name] field1: value field2: value')." << std::endl;
-                exit(EXIT_FAILURE);
-            }
-                
-            name = command_line_name;
-        }
-        
-        const google::protobuf::Descriptor* desc = dccl::DynamicProtobufManager::find_descriptor(name);
-        if(desc == 0)
-        {
-            std::cerr << "No descriptor with name " << name << " found! Make sure you have loaded all the necessary .proto files and/or shared libraries. Also make sure you specified the fully qualified name including the package, if any (e.g. 'goby.acomms.protobuf.NetworkAck', not just 'NetworkAck')." << std::endl;
-            exit(EXIT_FAILURE);
-        }
-        
-        
-        boost::shared_ptr<google::protobuf::Message> msg = dccl::DynamicProtobufManager::new_protobuf_message(desc);
-        google::protobuf::TextFormat::ParseFromString(input, msg.get());
-
-        if(msg->IsInitialized())
+        boost::shared_ptr<google::protobuf::Message> msg = read_message(dccl, cfg, command_line_name, input);
+        if(msg && msg->IsInitialized())
         {
             std::string encoded;
             dccl.encode(&encoded, *msg);
@@ -297,6 +244,77 @@ void encode(dccl::Codec& dccl, dccl::tool::Config& cfg)
     }    
 }
 
+void check_encode_message(const dccl::tool::Config& cfg)
+{
+    if(cfg.message.size() > 1)
+    {
+        std::cerr << "No more than one DCCL message can be specified with -m or --message for encoding." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    else if(cfg.message.size() == 0)
+    {
+        std::cerr << "You must specify a DCCL message to encode with -m" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+// parses one line of input to encode: a TextFormat message, optionally preceded by |MessageName| (otherwise command_line_name). Returns null for a blank line.
+boost::shared_ptr<google::protobuf::Message> read_message(dccl::Codec& dccl, dccl::tool::Config& cfg, const std::string& command_line_name, std::string input)
+{
+    boost::trim(input);
+    if(input.empty())
+        return boost::shared_ptr<google::protobuf::Message>();
+
+    std::string name;
+    if(input[0] == '|')
+    {
+        std::string::size_type close_bracket_pos = input.find('|', 1);
+        if(close_bracket_pos == std::string::npos)
+        {
+            std::cerr << "Incorrectly formatted input: expected '|'" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        name = input.substr(1, close_bracket_pos-1);
+        if(cfg.message.find(name) == cfg.message.end())
+        {
+            const google::protobuf::Descriptor* desc = 
+                dccl::DynamicProtobufManager::find_descriptor(name);
+            load_desc(&dccl, desc, name);
+            cfg.message.insert(name);
+        }
+        
+        
+        if(input.size() > close_bracket_pos+1)
+            input = input.substr(close_bracket_pos+1);
+        else
+            input.clear();
+    }
+    else
+    {
+        if(cfg.message.size() == 0)
+        {
+            std::cerr << "Message name not given with -m or in the input (i.e. '[Name] field1: value field2: value')." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+            
+        name = command_line_name;
+    }
+    
+    const google::protobuf::Descriptor* desc = dccl::DynamicProtobufManager::find_descriptor(name);
+    if(desc == 0)
+    {
+        std::cerr << "No descriptor with name " << name << " found! Make sure you have loaded all the necessary .proto files and/or shared libraries. Also make sure you specified the fully qualified name including the package, if any (e.g. 'goby.acomms.protobuf.NetworkAck', not just 'NetworkAck')." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    
+    
+    boost::shared_ptr<google::protobuf::Message> msg = dccl::DynamicProtobufManager::new_protobuf_message(desc);
+    google::protobuf::TextFormat::ParseFromString(input, msg.get());
+
+    return msg;
+}
+
 void decode(dccl::Codec& dccl, const dccl::tool::Config& cfg)
 {
     std::string input;
@@ -375,6 +393,47 @@ void disp_proto(dccl::Codec& dccl, const dccl::tool::Config& cfg)
     }
 }
 
+void profile(dccl::Codec& dccl, dccl::tool::Config& cfg)
+{
+    check_encode_message(cfg);
+    std::string command_line_name = *cfg.message.begin();
+
+    std::vector<boost::shared_ptr<google::protobuf::Message> > msgs;
+    while(!std::cin.eof())
+    {
+        std::string input;
+        std::getline (std::cin, input);
+
+        boost::shared_ptr<google::protobuf::Message> msg = read_message(dccl, cfg, command_line_name, input);
+        if(!msg)
+            continue;
+        
+        if(msg->IsInitialized())
+            msgs.push_back(msg);
+        else
+            std::cerr << "Message is not properly initialized. All `required` fields must be set. Skipping: " << msg->ShortDebugString() << std::endl;
+    }
+
+    dccl::FieldProfiler profiler;
+    dccl.set_field_profiler(&profiler);
+    
+    std::string encoded;
+    for(int i = 0; i < cfg.profile_iterations; ++i)
+    {
+        for(std::vector<boost::shared_ptr<google::protobuf::Message> >::const_iterator it = msgs.begin(),
+                end = msgs.end(); it != end; ++it)
+        {
+            encoded.clear();
+            dccl.encode(&encoded, **it);
+            boost::shared_ptr<google::protobuf::Message> decoded((*it)->New());
+            dccl.decode(encoded, decoded.get());
+        }
+    }
+    dccl.set_field_profiler(0);
+    
+    std::cout << "Profiled " << msgs.size() << " message(s) " << cfg.profile_iterations << " time(s) each" << std::endl;
+    profiler.report(&std::cout);
+}
 
 void load_desc(dccl::Codec* dccl,  const google::protobuf::Descriptor* desc, const std::string& name)
 {
@@ -400,11 +459,13 @@ void parse_options(int argc, char* argv[], dccl::tool::Config* cfg)
     options.push_back(dccl::Option('d', "decode", no_argument, "Decode a DCCL message to STDOUT from STDIN"));
     options.push_back(dccl::Option('a', "analyze", no_argument, "Provides information on a given DCCL message definition (e.g. field sizes)"));
     options.push_back(dccl::Option('p', "display_proto", no_argument, "Display the .proto definition of this message."));
+    options.push_back(dccl::Option('P', "profile", no_argument, "Encode and decode the messages read from STDIN (as for --encode) repeatedly, and report the time and encoded bits spent on each field"));
     options.push_back(dccl::Option('h', "help", no_argument, "Gives help on the usage of 'dccl'"));
     options.push_back(dccl::Option('I', "proto_path", required_argument, "Add another search directory for .proto files"));
     options.push_back(dccl::Option('l', "dlopen", required_argument, "Open this shared library containing compiled DCCL messages."));
     options.push_back(dccl::Option('m', "message", required_argument, "Message name to encode, decode or analyze."));
     options.push_back(dccl::Option('f', "proto_file", required_argument, ".proto file to load."));
+    options.push_back(dccl::Option(0, "profile_iterations", required_argument, "Number of times --profile encodes and decodes each message (default 1000)"));
     options.push_back(dccl::Option(0, "format", required_argument, "Format for encode output or decode input: 'bin' (default) is raw binary, 'hex' is ascii-encoded hexadecimal, 'textformat' is a Google Protobuf TextFormat byte string, 'base64' is ascii-encoded base 64."));
     options.push_back(dccl::Option('v', "verbose", no_argument, "Display extra debugging information."));
     options.push_back(dccl::Option('o', "omit_prefix", no_argument, "Omit the DCCL type name prefix from the output of decode."));
@@ -445,6 +506,15 @@ void parse_options(int argc, char* argv[], dccl::tool::Config* cfg)
                         exit(EXIT_FAILURE);
                     }
                 }
+                else if(!strcmp(long_options[option_index].name, "profile_iterations"))
+                {
+                    cfg->profile_iterations = atoi(optarg);
+                    if(cfg->profile_iterations <= 0)
+                    {
+                        std::cerr << "Invalid profile_iterations '" << optarg << "'" << std::endl;
+                        exit(EXIT_FAILURE);
+                    }
+                }
                 else
                 {
                     std::cerr << "Try --help for valid options." << std::endl;
@@ -457,6 +527,7 @@ void parse_options(int argc, char* argv[], dccl::tool::Config* cfg)
             case 'd': cfg->action = DECODE; break;
             case 'a': cfg->action = ANALYZE; break;    
             case 'p': cfg->action = DISP_PROTO; break;    
+            case 'P': cfg->action = PROFILE; break;    
             case 'I': cfg->include.insert(optarg); break;
             case 'l': cfg->dlopen.push_back(optarg); break;
             case 'm': cfg->message.insert(optarg); break;
@@ -0,0 +1,531 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+//
+// For the 'dccl' tool: loading non-GPL shared libraries for the purpose of
+// using this tool does *not* violate the GPL license terms of DCCL.
+//
+
+
+// Builds arithmetic models (dccl.arithmetic, dccl.rans) for the fields of DCCL messages from a
+// corpus of logged messages
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+#include <google/protobuf/text_format.h>
+
+#include <boost/algorithm/string.hpp>
+
+#include "dccl/codec.h"
+#include "dccl/cli_option.h"
+#include "dccl/binary.h"
+#include "dccl/field_profiler.h"
+#include "dccl/arithmetic/model_trainer.h"
+
+// for realpath
+#include <limits.h>
+#include <stdlib.h>
+
+enum Format { BINARY, HEX, TEXT };
+
+namespace dccl
+{
+    /// 'dccl_arith_train' command line tool namespace
+    namespace arith_train
+    {
+        struct Config
+        {
+            Config()
+                : format(BINARY),
+                  id_codec(dccl::Codec::default_id_codec_name()),
+                  verbose(false),
+                  threads(1),
+                  max_symbols(1024)
+                { }
+
+            std::set<std::string> include;
+            std::vector<std::string> dlopen;
+            std::set<std::string> message;
+            std::set<std::string> proto_file;
+            Format format;
+            std::string id_codec;
+            bool verbose;
+            int threads;
+            int max_symbols;
+            std::string output_dir;
+        };
+
+        // one message of the corpus: either still encoded, or already decoded (or parsed)
+        struct Record
+        {
+            std::string bytes;
+            boost::shared_ptr<google::protobuf::Message> msg;
+        };
+
+        // trains on records [begin, end) with its own Codec
+        struct Worker
+        {
+            Worker() : codec(0), records(0), begin(0), end(0), errors(0) { }
+
+            dccl::Codec* codec;
+            const std::vector<Record>* records;
+            std::size_t begin;
+            std::size_t end;
+            dccl::arith::ModelTrainer trainer;
+            unsigned errors;
+        };
+    }
+}
+
+void read_corpus(std::vector<boost::shared_ptr<dccl::Codec> >& codecs, dccl::arith_train::Config& cfg, std::vector<dccl::arith_train::Record>* records);
+void* train(void* arg);
+void write_models(const dccl::arith::ModelTrainer& trainer, const dccl::FieldProfiler& profiler, const dccl::arith_train::Config& cfg);
+
+void load_desc(std::vector<boost::shared_ptr<dccl::Codec> >& codecs, const google::protobuf::Descriptor* desc, const std::string& name);
+void parse_options(int argc, char* argv[], dccl::arith_train::Config* cfg);
+
+int main(int argc, char* argv[])
+{
+    dccl::arith_train::Config cfg;
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    if(processors > 0)
+        cfg.threads = processors;
+    parse_options(argc, argv, &cfg);
+
+    if(!cfg.verbose)
+        dccl::dlog.connect(dccl::logger::WARN_PLUS, &std::cerr);
+    else
+        dccl::dlog.connect(dccl::logger::DEBUG1_PLUS, &std::cerr);
+
+    dccl::DynamicProtobufManager::enable_compilation();
+    for(std::set<std::string>::const_iterator it = cfg.include.begin(),
+            end = cfg.include.end(); it != end; ++it)
+        dccl::DynamicProtobufManager::add_include_path(*it);
+
+    // a Codec for each thread, all loaded (which may not happen concurrently with encoding and decoding) before any starts
+    std::vector<boost::shared_ptr<dccl::Codec> > codecs;
+    for(int i = 0; i < cfg.threads; ++i)
+    {
+        codecs.push_back(boost::shared_ptr<dccl::Codec>(new dccl::Codec(cfg.id_codec)));
+        for(std::vector<std::string>::const_iterator it = cfg.dlopen.begin(),
+                end = cfg.dlopen.end(); it != end; ++it)
+            codecs.back()->load_library(*it);
+    }
+
+    bool no_messages_specified = cfg.message.empty();
+    for(std::set<std::string>::const_iterator it = cfg.proto_file.begin(),
+            end = cfg.proto_file.end(); it != end; ++it)
+    {
+        const google::protobuf::FileDescriptor* file_desc =
+            dccl::DynamicProtobufManager::load_from_proto_file(*it);
+
+        if(!file_desc)
+        {
+            std::cerr << "failed to read in: " << *it << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        // if no messages explicitly specified, load them all.
+        if(no_messages_specified)
+        {
+            for(int i = 0, n = file_desc->message_type_count(); i < n; ++i)
+                cfg.message.insert(file_desc->message_type(i)->full_name());
+        }
+    }
+
+    for(std::set<std::string>::const_iterator it = cfg.message.begin(),
+            end = cfg.message.end(); it != end; ++it)
+        load_desc(codecs, dccl::DynamicProtobufManager::find_descriptor(*it), *it);
+
+    std::vector<dccl::arith_train::Record> records;
+    read_corpus(codecs, cfg, &records);
+
+    // every field of every message, so that the bits spent on each by the codecs it uses now can be compared
+    dccl::FieldProfiler profiler;
+    std::vector<dccl::arith_train::Worker> workers(cfg.threads);
+    std::vector<pthread_t> threads(cfg.threads);
+    for(int i = 0; i < cfg.threads; ++i)
+    {
+        dccl::arith_train::Worker& worker = workers[i];
+        worker.codec = codecs[i].get();
+        worker.codec->set_field_profiler(&profiler);
+        worker.records = &records;
+        worker.begin = records.size() * i / cfg.threads;
+        worker.end = records.size() * (i + 1) / cfg.threads;
+        worker.trainer = dccl::arith::ModelTrainer(cfg.max_symbols);
+    }
+    for(int i = 0; i < cfg.threads; ++i)
+        pthread_create(&threads[i], 0, train, &workers[i]);
+
+    dccl::arith::ModelTrainer trainer(cfg.max_symbols);
+    unsigned errors = 0;
+    for(int i = 0; i < cfg.threads; ++i)
+    {
+        pthread_join(threads[i], 0);
+        trainer.merge(workers[i].trainer);
+        errors += workers[i].errors;
+    }
+
+    std::cerr << "Trained on " << trainer.messages() << " message(s)";
+    if(errors)
+        std::cerr << " (" << errors << " could not be decoded or encoded, and were skipped)";
+    std::cerr << std::endl;
+
+    if(trainer.messages() == 0)
+        exit(EXIT_FAILURE);
+
+    write_models(trainer, profiler, cfg);
+}
+
+void read_corpus(std::vector<boost::shared_ptr<dccl::Codec> >& codecs, dccl::arith_train::Config& cfg, std::vector<dccl::arith_train::Record>* records)
+{
+    if(cfg.format == BINARY)
+    {
+        // the messages must be decoded to find where each ends
+        std::ifstream fin("/dev/stdin", std::ios::binary);
+        std::ostringstream ostrm;
+        ostrm << fin.rdbuf();
+        std::string input = ostrm.str();
+
+        while(!input.empty())
+        {
+            dccl::arith_train::Record record;
+            try
+            {
+                record.msg = codecs.front()->decode<boost::shared_ptr<google::protobuf::Message> >(&input);
+            }
+            catch(std::exception& e)
+            {
+                std::cerr << "Failed to decode the binary input (" << e.what() << "); ignoring the remaining " << input.size() << " byte(s)." << std::endl;
+                break;
+            }
+            records->push_back(record);
+        }
+        return;
+    }
+
+    std::string default_name = (cfg.message.size() == 1) ? *cfg.message.begin() : std::string();
+    while(!std::cin.eof())
+    {
+        std::string line;
+        std::getline(std::cin, line);
+        boost::trim(line);
+        if(line.empty())
+            continue;
+
+        dccl::arith_train::Record record;
+        if(cfg.format == HEX)
+        {
+            record.bytes = dccl::hex_decode(line);
+        }
+        else
+        {
+            // a TextFormat message, optionally preceded by |MessageName| (as for 'dccl --encode')
+            std::string name = default_name;
+            if(line[0] == '|')
+            {
+                std::string::size_type close_bracket_pos = line.find('|', 1);
+                if(close_bracket_pos == std::string::npos)
+                {
+                    std::cerr << "Incorrectly formatted input: expected '|'" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                name = line.substr(1, close_bracket_pos - 1);
+                line = line.substr(close_bracket_pos + 1);
+
+                if(cfg.message.find(name) == cfg.message.end())
+                {
+                    load_desc(codecs, dccl::DynamicProtobufManager::find_descriptor(name), name);
+                    cfg.message.insert(name);
+                }
+            }
+
+            const google::protobuf::Descriptor* desc = dccl::DynamicProtobufManager::find_descriptor(name);
+            if(!desc)
+            {
+                std::cerr << "Message name not given with -m (with exactly one message) or in the input (i.e. '|Name| field1: value field2: value')." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+
+            record.msg = dccl::DynamicProtobufManager::new_protobuf_message(desc);
+            if(!google::protobuf::TextFormat::ParseFromString(line, record.msg.get()))
+            {
+                std::cerr << "Failed to parse, skipping: " << line << std::endl;
+                continue;
+            }
+        }
+        records->push_back(record);
+    }
+}
+
+void* train(void* arg)
+{
+    dccl::arith_train::Worker* worker = static_cast<dccl::arith_train::Worker*>(arg);
+    std::string encoded;
+    for(std::size_t i = worker->begin; i < worker->end; ++i)
+    {
+        const dccl::arith_train::Record& record = (*worker->records)[i];
+        try
+        {
+            boost::shared_ptr<google::protobuf::Message> msg = record.msg;
+            if(!msg)
+                msg = worker->codec->decode<boost::shared_ptr<google::protobuf::Message> >(record.bytes);
+
+            // measures the bits spent on each field now
+            encoded.clear();
+            worker->codec->encode(&encoded, *msg);
+
+            worker->trainer.add(*msg);
+        }
+        catch(std::exception& e)
+        {
+            dccl::dlog.is(dccl::logger::DEBUG1) && dccl::dlog << "Skipping message " << i << ": " << e.what() << std::endl;
+            ++worker->errors;
+        }
+    }
+    return 0;
+}
+
+void write_models(const dccl::arith::ModelTrainer& trainer, const dccl::FieldProfiler& profiler, const dccl::arith_train::Config& cfg)
+{
+    // bits spent on each field now, and by which codec(s)
+    std::map<const google::protobuf::FieldDescriptor*, std::pair<dccl::uint64, std::string> > current;
+    std::vector<dccl::FieldProfile> profiles = profiler.profiles();
+    for(std::vector<dccl::FieldProfile>::const_iterator it = profiles.begin(), end = profiles.end(); it != end; ++it)
+    {
+        std::pair<dccl::uint64, std::string>& field_current = current[it->field];
+        field_current.first += it->encode_bits;
+        if(field_current.second.find(it->codec) == std::string::npos)
+            field_current.second += (field_current.second.empty() ? "" : ",") + it->codec;
+    }
+
+    const double messages = trainer.messages();
+    double total_current = 0, total_trained = 0;
+    std::stringstream report, skipped;
+    report << std::fixed << std::setprecision(2);
+    report << std::left << std::setw(50) << "field" << std::setw(20) << "current codec"
+           << std::right << std::setw(12) << "current" << std::setw(12) << "trained" << "  (bits/message)\n";
+
+    std::vector<const google::protobuf::FieldDescriptor*> fields = trainer.fields();
+    for(std::vector<const google::protobuf::FieldDescriptor*>::const_iterator it = fields.begin(), end = fields.end(); it != end; ++it)
+    {
+        const google::protobuf::FieldDescriptor* field = *it;
+        dccl::arith::protobuf::ArithmeticModel model;
+        if(!trainer.model(field, &model))
+        {
+            unsigned distinct = trainer.distinct_values(field);
+            skipped << "  " << field->full_name() << ": ";
+            if(distinct)
+                skipped << distinct << " distinct values (more than --max_symbols)\n";
+            else
+                skipped << "never set\n";
+            continue;
+        }
+
+        const std::pair<dccl::uint64, std::string>& field_current = current[field];
+        const double current_bits = field_current.first / messages;
+        const double trained_bits = trainer.expected_bits(field, model);
+        total_current += current_bits;
+        total_trained += trained_bits;
+        report << std::left << std::setw(50) << field->full_name() << std::setw(20) << field_current.second
+               << std::right << std::setw(12) << current_bits << std::setw(12) << trained_bits << "\n";
+
+        std::string text;
+        google::protobuf::TextFormat::PrintToString(model, &text);
+        std::stringstream header;
+        header << std::fixed << std::setprecision(2)
+               << "# " << field->full_name() << ": " << current_bits << " bits/message now, "
+               << trained_bits << " expected with this model\n";
+
+        if(cfg.output_dir.empty())
+        {
+            std::cout << header.str() << text << std::endl;
+        }
+        else
+        {
+            const std::string path = cfg.output_dir + "/" + model.name() + ".pb.txt";
+            std::ofstream fout(path.c_str());
+            if(!fout.is_open())
+            {
+                std::cerr << "Failed to open " << path << " for writing" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            fout << header.str() << text;
+        }
+    }
+
+    report << std::left << std::setw(70) << "total" << std::right << std::setw(12) << total_current << std::setw(12) << total_trained;
+    if(total_current > 0)
+        report << "  (" << 100 * (1 - total_trained / total_current) << "% smaller)";
+    report << "\n";
+
+    std::cerr << report.str();
+    if(!skipped.str().empty())
+        std::cerr << "No model for:\n" << skipped.str();
+    std::cerr << "Expected bits are the entropy of the values under the model: the arithmetic coder adds up to two bits each time a field is encoded." << std::endl;
+}
+
+void load_desc(std::vector<boost::shared_ptr<dccl::Codec> >& codecs, const google::protobuf::Descriptor* desc, const std::string& name)
+{
+    if(desc)
+    {
+        try
+        {
+            for(std::vector<boost::shared_ptr<dccl::Codec> >::iterator it = codecs.begin(),
+                    end = codecs.end(); it != end; ++it)
+                (*it)->load(desc);
+        }
+        catch(std::exception& e)
+        {
+            std::cerr << "Not a valid DCCL message: " << desc->full_name() << "\nWhy: " << e.what() << std::endl;
+        }
+    }
+    else
+    {
+        std::cerr << "No descriptor with name " << name << " found! Make sure you have loaded all the necessary .proto files and/or shared libraries. Try --help." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+void parse_options(int argc, char* argv[], dccl::arith_train::Config* cfg)
+{
+    std::vector<dccl::Option> options;
+    options.push_back(dccl::Option('h', "help", no_argument, "Gives help on the usage of 'dccl_arith_train'"));
+    options.push_back(dccl::Option('I', "proto_path", required_argument, "Add another search directory for .proto files"));
+    options.push_back(dccl::Option('l', "dlopen", required_argument, "Open this shared library containing compiled DCCL messages and/or codecs."));
+    options.push_back(dccl::Option('m', "message", required_argument, "Message name to train on (default: all the messages in the .proto files). With 'text', the message that lines without a |Name| prefix are."));
+    options.push_back(dccl::Option('f', "proto_file", required_argument, ".proto file to load."));
+    options.push_back(dccl::Option(0, "format", required_argument, "Format of the corpus read from STDIN: 'bin' (default) is raw binary encoded messages (as written by 'dccl --encode'), 'hex' is one ascii-encoded hexadecimal message per line, 'text' is one Google Protobuf TextFormat message per line (as read by 'dccl --encode')."));
+    options.push_back(dccl::Option('j', "threads", required_argument, "Number of threads to decode and count the messages with (default: number of processors)"));
+    options.push_back(dccl::Option(0, "max_symbols", required_argument, "Most distinct values a field may take for a model to be built for it (default 1024)"));
+    options.push_back(dccl::Option('o', "output_dir", required_argument, "Write each model to <output_dir>/<field name>.pb.txt rather than STDOUT"));
+    options.push_back(dccl::Option('v', "verbose", no_argument, "Display extra debugging information."));
+    options.push_back(dccl::Option('i', "id_codec", required_argument, "(Advanced) name for a nonstandard DCCL ID codec to use"));
+
+    std::vector<option> long_options;
+    std::string opt_string;
+    dccl::Option::convert_vector(options, &long_options, &opt_string);
+
+    while (1) {
+        int option_index = 0;
+
+        int c = getopt_long(argc, argv, opt_string.c_str(),
+                            &long_options[0], &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 0:
+                // If this option set a flag, do nothing else now.
+                if (long_options[option_index].flag != 0)
+                    break;
+
+                if(!strcmp(long_options[option_index].name, "format"))
+                {
+                    if(!strcmp(optarg, "bin"))
+                        cfg->format = BINARY;
+                    else if(!strcmp(optarg, "hex"))
+                        cfg->format = HEX;
+                    else if(!strcmp(optarg, "text"))
+                        cfg->format = TEXT;
+                    else
+                    {
+                        std::cerr << "Invalid format '" << optarg << "'" << std::endl;
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                else if(!strcmp(long_options[option_index].name, "max_symbols"))
+                {
+                    cfg->max_symbols = atoi(optarg);
+                    if(cfg->max_symbols <= 0)
+                    {
+                        std::cerr << "Invalid max_symbols '" << optarg << "'" << std::endl;
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                else
+                {
+                    std::cerr << "Try --help for valid options." << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+
+                break;
+
+            case 'I': cfg->include.insert(optarg); break;
+            case 'l': cfg->dlopen.push_back(optarg); break;
+            case 'm': cfg->message.insert(optarg); break;
+            case 'f':
+            {
+                char* proto_file_canonical_path = realpath(optarg, 0);
+                if(proto_file_canonical_path)
+                {
+                    cfg->proto_file.insert(proto_file_canonical_path);
+                    free(proto_file_canonical_path);
+                }
+                else
+                {
+                    std::cerr << "Invalid proto file path: '" << optarg << "'" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
+            case 'j':
+                cfg->threads = atoi(optarg);
+                if(cfg->threads <= 0)
+                {
+                    std::cerr << "Invalid threads '" << optarg << "'" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'o': cfg->output_dir = optarg; break;
+            case 'i': cfg->id_codec = optarg; break;
+            case 'v': cfg->verbose = true; break;
+
+            case 'h':
+                std::cout << "Usage of 'dccl_arith_train', which builds arithmetic models for the fields of DCCL messages from a corpus read from STDIN: " << std::endl;
+                for(int i = 0, n = options.size(); i < n; ++i)
+                    std::cout << "  " << options[i].usage() << std::endl;
+                exit(EXIT_SUCCESS);
+                break;
+
+            case '?':
+                std::cerr << "Try --help for valid options." << std::endl;
+                exit(EXIT_FAILURE);
+            default: exit(EXIT_FAILURE);
+        }
+    }
+
+    /* Print any remaining command line arguments (not options). */
+    if (optind < argc)
+    {
+        std::cerr << "Unknown arguments: \n";
+        while (optind < argc)
+            std::cerr << argv[optind++];
+        std::cerr << std::endl;
+        std::cerr << "Try --help for valid options." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
@@ -0,0 +1,331 @@
+// Copyright 2014-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     Stephanie Petillo (http://gobysoft.org/index.wt/people/stephanie)
+//                     GobySoft, LLC
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef GenCompiledCodecPlugin20261018H
+#define GenCompiledCodecPlugin20261018H
+
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <google/protobuf/descriptor.h>
+
+#include "option_extensions.pb.h"
+
+///////////////////////////////////////////////////////////////////////////////////
+// Generation of message codecs compiled ahead of time
+// (children of dccl::v3::CompiledMessageCodec)
+///////////////////////////////////////////////////////////////////////////////////
+
+namespace dccl
+{
+  namespace compiled
+  {
+    // Fully qualified C++ name of a generated message or enum class (e.g. ::foo::bar::Outer_Inner)
+    template<typename Descriptor>
+    inline std::string cpp_class_name(const Descriptor* desc)
+    {
+      const std::string& package = desc->file()->package();
+      std::string name = package.empty() ? desc->full_name() : desc->full_name().substr(package.size() + 1);
+      boost::replace_all(name, ".", "_");
+      std::string ns = package;
+      boost::replace_all(ns, ".", "::");
+      return ns.empty() ? "::" + name : "::" + ns + "::" + name;
+    }
+
+    // Name of the generated accessors for a field (or empty if the generator would have mangled it)
+    inline std::string cpp_accessor_name(const google::protobuf::FieldDescriptor* field)
+    {
+      static const char* keywords[] = {
+        "and", "asm", "auto", "bool", "break", "case", "catch", "char", "class", "const",
+        "continue", "default", "delete", "do", "double", "else", "enum", "explicit", "extern",
+        "false", "float", "for", "friend", "goto", "if", "inline", "int", "long", "mutable",
+        "namespace", "new", "not", "operator", "or", "private", "protected", "public", "register",
+        "return", "short", "signed", "sizeof", "static", "struct", "switch", "template", "this",
+        "throw", "true", "try", "typedef", "typeid", "typename", "union", "unsigned", "using",
+        "virtual", "void", "volatile", "while", "xor" };
+      const std::set<std::string> keyword_set(keywords, keywords + sizeof(keywords)/sizeof(keywords[0]));
+
+      if(keyword_set.count(field->lowercase_name()))
+        return std::string();
+      return field->lowercase_name();
+    }
+
+    // Wire type of DefaultNumericFieldCodec for a numeric field (or empty if not numeric)
+    inline std::string numeric_wire_type(const google::protobuf::FieldDescriptor* field)
+    {
+      switch(field->cpp_type())
+      {
+        case google::protobuf::FieldDescriptor::CPPTYPE_INT32: return "dccl::int32";
+        case google::protobuf::FieldDescriptor::CPPTYPE_INT64: return "dccl::int64";
+        case google::protobuf::FieldDescriptor::CPPTYPE_UINT32: return "dccl::uint32";
+        case google::protobuf::FieldDescriptor::CPPTYPE_UINT64: return "dccl::uint64";
+        case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE: return "double";
+        case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT: return "float";
+        default: return std::string();
+      }
+    }
+
+    // Fields that are compiled: singular numeric, bool and enum fields of proto2 messages using the default DCCL3 codecs. All others use their codec at runtime.
+    inline bool is_compiled(const google::protobuf::FieldDescriptor* field)
+    {
+      const dccl::DCCLFieldOptions& options = field->options().GetExtension(dccl::field);
+      if(field->is_repeated() || options.omit() || options.has_codec() ||
+         field->file()->syntax() != google::protobuf::FileDescriptor::SYNTAX_PROTO2 ||
+         cpp_accessor_name(field).empty())
+        return false;
+
+      switch(field->cpp_type())
+      {
+        case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+          return true;
+        case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+          return field->enum_type()->value_count() > 0;
+        case google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE:
+        case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
+          return false;
+        default:
+          // missing bounds fail validation when the message is loaded
+          return options.has_min() && options.has_max();
+      }
+    }
+
+    inline std::string double_literal(double d)
+    {
+      // lexical_cast writes enough digits to recover exactly the same double
+      return boost::lexical_cast<std::string>(d);
+    }
+
+    // Bounds given to the enumeration's DefaultNumericFieldCodec (see dccl::v3::DefaultEnumCodec::min() and max())
+    inline void enum_bounds(const google::protobuf::FieldDescriptor* field, int* min, int* max)
+    {
+      const google::protobuf::EnumDescriptor* e = field->enum_type();
+      if(field->options().GetExtension(dccl::field).packed_enum())
+      {
+        *min = 0;
+        *max = e->value_count() - 1;
+      }
+      else
+      {
+        *min = *max = e->value(0)->number();
+        for(int i = 1, n = e->value_count(); i < n; ++i)
+        {
+          *min = std::min(*min, e->value(i)->number());
+          *max = std::max(*max, e->value(i)->number());
+        }
+      }
+    }
+
+    // Conversion between the enumeration and the wire value (the index for packed enumerations, otherwise the number)
+    inline void construct_enum_conversion(const google::protobuf::FieldDescriptor* field, std::ostream& out)
+    {
+      const google::protobuf::EnumDescriptor* e = field->enum_type();
+      const std::string enum_class = cpp_class_name(e);
+      const std::string name = cpp_accessor_name(field);
+
+      out << "    static dccl::int32 " << name << "_to_wire(" << enum_class << " value)\n"
+          << "    {\n";
+      if(field->options().GetExtension(dccl::field).packed_enum())
+      {
+        out << "        switch(value)\n"
+            << "        {\n";
+        // aliases share the index of the first value with that number (as FindValueByNumber() does)
+        std::set<int> numbers;
+        for(int i = 0, n = e->value_count(); i < n; ++i)
+        {
+          if(numbers.insert(e->value(i)->number()).second)
+            out << "            case " << e->value(i)->number() << ": return " << i << ";\n";
+        }
+        out << "        }\n"
+            << "        return 0;\n";
+      }
+      else
+      {
+        out << "        return value;\n";
+      }
+      out << "    }\n\n";
+
+      out << "    static bool " << name << "_from_wire(dccl::int32 wire_value, " << enum_class << "* value)\n"
+          << "    {\n";
+      if(field->options().GetExtension(dccl::field).packed_enum())
+      {
+        out << "        switch(wire_value)\n"
+            << "        {\n";
+        for(int i = 0, n = e->value_count(); i < n; ++i)
+          out << "            case " << i << ": *value = static_cast< " << enum_class << ">(" << e->value(i)->number() << "); return true;\n";
+        out << "        }\n"
+            << "        return false;\n";
+      }
+      else
+      {
+        out << "        if(!" << enum_class << "_IsValid(wire_value))\n"
+            << "            return false;\n"
+            << "        *value = static_cast< " << enum_class << ">(wire_value);\n"
+            << "        return true;\n";
+      }
+      out << "    }\n\n";
+    }
+
+    /// \brief Writes a child of dccl::v3::CompiledMessageCodec for desc (and the declaration that adds it to the FieldCodecManager) to out, to be inserted into the namespace of the generated .pb.cc
+    ///
+    /// \return false (and writes nothing) if no fields of desc can be compiled
+    inline bool construct_compiled_codec(const google::protobuf::Descriptor* desc, std::ostream& out)
+    {
+      // custom message codecs don't use the layout of DefaultMessageCodec; map entries are never DCCL messages
+      if(desc->options().GetExtension(dccl::msg).has_codec() || desc->options().map_entry())
+        return false;
+
+      std::vector<const google::protobuf::FieldDescriptor*> fields;
+      for(int i = 0, n = desc->field_count(); i < n; ++i)
+      {
+        if(is_compiled(desc->field(i)))
+          fields.push_back(desc->field(i));
+      }
+      if(fields.empty())
+        return false;
+
+      const std::string msg_class = cpp_class_name(desc);
+      std::string codec_class = desc->full_name();
+      boost::replace_all(codec_class, ".", "_");
+      codec_class += "_DCCLCompiledCodec";
+
+      std::stringstream constructor, field_compiled, encode, decode, bits, conversions;
+      for(int k = 0, n = fields.size(); k < n; ++k)
+      {
+        const google::protobuf::FieldDescriptor* field = fields[k];
+        const dccl::DCCLFieldOptions& options = field->options().GetExtension(dccl::field);
+        const std::string name = cpp_accessor_name(field);
+        const std::string params = "params_[" + boost::lexical_cast<std::string>(k) + "]";
+        const std::string required = field->is_required() ? "true" : "false";
+        const int number = field->number();
+
+        switch(field->cpp_type())
+        {
+          case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+            field_compiled << "            case " << number << ": return is_codec<dccl::v3::DefaultBoolCodec>(codec);\n";
+            encode << "            case " << number << ": encode_bool(writer, msg.has_" << name << "(), msg." << name << "(), " << required << "); break;\n";
+            decode << "            case " << number << ":\n"
+                   << "            {\n"
+                   << "                bool value;\n"
+                   << "                if(decode_bool(reader, " << required << ", &value))\n"
+                   << "                    msg->set_" << name << "(value);\n"
+                   << "                break;\n"
+                   << "            }\n";
+            bits << "            case " << number << ": return bool_bits(" << required << ");\n";
+            break;
+
+          case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+          {
+            int min = 0, max = 0;
+            enum_bounds(field, &min, &max);
+            constructor << "        " << params << " = numeric_params(" << min << ", " << max << ", " << options.precision() << ");\n";
+            field_compiled << "            case " << number << ": return is_codec<dccl::v3::DefaultEnumCodec>(codec);\n";
+            encode << "            case " << number << ": encode_numeric<dccl::int32>(writer, msg.has_" << name << "(), " << name << "_to_wire(msg." << name << "()), " << params << ", " << required << ", field); break;\n";
+            decode << "            case " << number << ":\n"
+                   << "            {\n"
+                   << "                dccl::int32 wire_value;\n"
+                   << "                " << cpp_class_name(field->enum_type()) << " value;\n"
+                   << "                if(decode_numeric(reader, " << params << ", " << required << ", &wire_value) && " << name << "_from_wire(wire_value, &value))\n"
+                   << "                    msg->set_" << name << "(value);\n"
+                   << "                break;\n"
+                   << "            }\n";
+            bits << "            case " << number << ": return numeric_bits(" << params << ", " << required << ");\n";
+            construct_enum_conversion(field, conversions);
+            break;
+          }
+
+          default:
+          {
+            const std::string wire_type = numeric_wire_type(field);
+            constructor << "        " << params << " = numeric_params(" << double_literal(options.min()) << ", " << double_literal(options.max()) << ", " << options.precision() << ");\n";
+            field_compiled << "            case " << number << ": return is_codec<dccl::v3::DefaultNumericFieldCodec<" << wire_type << "> >(codec);\n";
+            encode << "            case " << number << ": encode_numeric<" << wire_type << ">(writer, msg.has_" << name << "(), msg." << name << "(), " << params << ", " << required << ", field); break;\n";
+            decode << "            case " << number << ":\n"
+                   << "            {\n"
+                   << "                " << wire_type << " value;\n"
+                   << "                if(decode_numeric(reader, " << params << ", " << required << ", &value))\n"
+                   << "                    msg->set_" << name << "(value);\n"
+                   << "                break;\n"
+                   << "            }\n";
+            bits << "            case " << number << ": return numeric_bits(" << params << ", " << required << ");\n";
+            break;
+          }
+        }
+      }
+
+      out << "namespace\n"
+          << "{\n"
+          << "// DCCL codec for " << desc->full_name() << " compiled by protoc-gen-dccl\n"
+          << "class " << codec_class << " : public dccl::v3::CompiledMessageCodec< " << msg_class << ">\n"
+          << "{\n"
+          << "  public:\n"
+          << "    " << codec_class << "()\n"
+          << "    {\n"
+          << constructor.str()
+          << "    }\n\n"
+          << "  private:\n"
+          << "    bool field_compiled(const google::protobuf::FieldDescriptor* field, const dccl::FieldCodecBase& codec)\n"
+          << "    {\n"
+          << "        switch(field->number())\n"
+          << "        {\n"
+          << field_compiled.str()
+          << "            default: return false;\n"
+          << "        }\n"
+          << "    }\n\n"
+          << "    void encode_field(dccl::BitWriter* writer, const " << msg_class << "& msg, const google::protobuf::FieldDescriptor* field)\n"
+          << "    {\n"
+          << "        switch(field->number())\n"
+          << "        {\n"
+          << encode.str()
+          << "        }\n"
+          << "    }\n\n"
+          << "    void decode_field(dccl::BitReader* reader, " << msg_class << "* msg, const google::protobuf::FieldDescriptor* field)\n"
+          << "    {\n"
+          << "        switch(field->number())\n"
+          << "        {\n"
+          << decode.str()
+          << "        }\n"
+          << "    }\n\n"
+          << "    unsigned field_bits(const " << msg_class << "& msg, const google::protobuf::FieldDescriptor* field)\n"
+          << "    {\n"
+          << "        switch(field->number())\n"
+          << "        {\n"
+          << bits.str()
+          << "        }\n"
+          << "        return 0;\n"
+          << "    }\n\n"
+          << conversions.str()
+          << "    dccl::FieldCodecParams params_[" << fields.size() << "];\n"
+          << "};\n\n"
+          << "dccl::v3::CompiledMessageCodecRegistrar<" << codec_class << "> " << codec_class << "_registrar;\n"
+          << "}\n\n";
+
+      return true;
+    }
+  }
+}
+
+#endif
@@ -30,10 +30,12 @@
 #include <google/protobuf/io/zero_copy_stream.h>
 #include "option_extensions.pb.h"
 #include "gen_units_class_plugin.h"
+#include "gen_compiled_codec_plugin.h"
 
 std::set<std::string> systems_to_include_;
 std::set<std::string> base_units_to_include_;
 std::string filename_h_;
+std::string filename_cc_;
 
 
 class DCCLGenerator : public google::protobuf::compiler::CodeGenerator {
@@ -54,6 +56,8 @@ class DCCLGenerator : public google::protobuf::compiler::CodeGenerator {
     void generate_field(const google::protobuf::FieldDescriptor* field,
                         google::protobuf::io::Printer* printer,
                         boost::shared_ptr<std::string> message_unit_system) const;
+    bool generate_compiled_codec(const google::protobuf::Descriptor* desc,
+                                 std::ostream& out) const;
     bool check_field_type(const google::protobuf::FieldDescriptor* field) const;
     
 };
@@ -87,7 +91,18 @@ bool DCCLGenerator::Generate(const google::protobuf::FileDescriptor* file,
     {
         const std::string& filename = file->name();
         filename_h_ = filename.substr(0, filename.find(".proto")) + ".pb.h";
-//        std::string filename_cc = filename.substr(0, filename.find(".proto")) + ".pb.cc";
+        filename_cc_ = filename.substr(0, filename.find(".proto")) + ".pb.cc";
+
+        // --dccl_out=compiled:<dir> also generates compiled message codecs (see dccl::v3::CompiledMessageCodec)
+        bool compiled = false;
+        std::vector<std::pair<std::string, std::string> > options;
+        google::protobuf::compiler::ParseGeneratorParameter(parameter, &options);
+        for(int i = 0, n = options.size(); i < n; ++i)
+        {
+            // other parameters are ignored, as they were before `compiled` existed
+            if(options[i].first == "compiled")
+                compiled = true;
+        }
         
         for(int message_i = 0, message_n = file->message_type_count(); message_i < message_n; ++message_i)
         {
@@ -120,6 +135,26 @@ bool DCCLGenerator::Generate(const google::protobuf::FileDescriptor* file,
             include_base_unit_headers(*it, includes_ss);
         }
         include_printer.Print(includes_ss.str().c_str());
+
+        if(compiled)
+        {
+            std::stringstream codecs_ss;
+            for(int message_i = 0, message_n = file->message_type_count(); message_i < message_n; ++message_i)
+                generate_compiled_codec(file->message_type(message_i), codecs_ss);
+
+            if(!codecs_ss.str().empty())
+            {
+                boost::shared_ptr<google::protobuf::io::ZeroCopyOutputStream> cc_include_output(
+                    generator_context->OpenForInsert(filename_cc_, "includes"));
+                google::protobuf::io::Printer cc_include_printer(cc_include_output.get(), '$');
+                cc_include_printer.Print("#include \"dccl/codecs3/field_codec_compiled_message.h\"\n");
+
+                boost::shared_ptr<google::protobuf::io::ZeroCopyOutputStream> cc_output(
+                    generator_context->OpenForInsert(filename_cc_, "namespace_scope"));
+                google::protobuf::io::Printer cc_printer(cc_output.get(), '$');
+                cc_printer.PrintRaw(codecs_ss.str());
+            }
+        }
         
         return true;
     }
@@ -268,6 +303,22 @@ void DCCLGenerator::generate_field(const google::protobuf::FieldDescriptor* fiel
     }
 }
 
+bool DCCLGenerator::generate_compiled_codec(const google::protobuf::Descriptor* desc, std::ostream& out) const
+{
+    try
+    {
+        bool generated = dccl::compiled::construct_compiled_codec(desc, out);
+
+        for(int nested_type_i = 0, nested_type_n = desc->nested_type_count(); nested_type_i < nested_type_n; ++nested_type_i)
+            generated = generate_compiled_codec(desc->nested_type(nested_type_i), out) || generated;
+
+        return generated;
+    }
+    catch(std::exception& e)
+    {
+        throw(std::runtime_error(std::string("Message: \n" + desc->full_name() + "\n" + e.what())));
+    }
+}
 
 int main(int argc, char* argv[])
 {
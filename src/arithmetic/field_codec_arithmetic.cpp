@@ -20,19 +20,22 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
 #include "field_codec_arithmetic.h"
+#include "field_codec_rans.h"
 #include "dccl/field_codec_manager.h"
+#include "dccl/codec.h"
 
 using dccl::dlog;
 using namespace dccl::logger;
 
-std::map<std::string, dccl::arith::Model> dccl::arith::ModelManager::arithmetic_models_;
+dccl::arith::ModelContext dccl::arith::ModelManager::defaults_;
+dccl::arith::ModelManager::GenerationMap dccl::arith::ModelManager::generations_;
+boost::mutex dccl::arith::ModelManager::generations_mutex_;
 const dccl::arith::Model::symbol_type dccl::arith::Model::OUT_OF_RANGE_SYMBOL;
 const dccl::arith::Model::symbol_type dccl::arith::Model::EOF_SYMBOL;
 const dccl::arith::Model::symbol_type dccl::arith::Model::MIN_SYMBOL;
 const int dccl::arith::Model::CODE_VALUE_BITS;
 const int dccl::arith::Model::FREQUENCY_BITS;
 const dccl::arith::Model::freq_type dccl::arith::Model::MAX_FREQUENCY;
-std::map<std::string, std::map<std::string, dccl::Bitset> > dccl::arith::Model::last_bits_map;
 
 // shared library load
 extern "C"
@@ -65,6 +68,15 @@ extern "C"
         FieldCodecManager::add<ArithmeticFieldCodec<bool> >("dccl.arithmetic");
         FieldCodecManager::add<ArithmeticFieldCodec<const google::protobuf::EnumValueDescriptor*> >("dccl.arithmetic");
 
+        FieldCodecManager::add<RansFieldCodec<int32> >("dccl.rans");
+        FieldCodecManager::add<RansFieldCodec<int64> >("dccl.rans");
+        FieldCodecManager::add<RansFieldCodec<uint32> >("dccl.rans");
+        FieldCodecManager::add<RansFieldCodec<uint64> >("dccl.rans");
+        FieldCodecManager::add<RansFieldCodec<double> >("dccl.rans");
+        FieldCodecManager::add<RansFieldCodec<float> >("dccl.rans");
+        FieldCodecManager::add<RansFieldCodec<bool> >("dccl.rans");
+        FieldCodecManager::add<RansFieldCodec<const google::protobuf::EnumValueDescriptor*> >("dccl.rans");
+
     }
     void dccl3_unload(dccl::Codec* dccl)
     {
@@ -93,6 +105,15 @@ extern "C"
         FieldCodecManager::remove<ArithmeticFieldCodec<float> >("dccl.arithmetic");
         FieldCodecManager::remove<ArithmeticFieldCodec<bool> >("dccl.arithmetic");
         FieldCodecManager::remove<ArithmeticFieldCodec<const google::protobuf::EnumValueDescriptor*> >("dccl.arithmetic");
+
+        FieldCodecManager::remove<RansFieldCodec<int32> >("dccl.rans");
+        FieldCodecManager::remove<RansFieldCodec<int64> >("dccl.rans");
+        FieldCodecManager::remove<RansFieldCodec<uint32> >("dccl.rans");
+        FieldCodecManager::remove<RansFieldCodec<uint64> >("dccl.rans");
+        FieldCodecManager::remove<RansFieldCodec<double> >("dccl.rans");
+        FieldCodecManager::remove<RansFieldCodec<float> >("dccl.rans");
+        FieldCodecManager::remove<RansFieldCodec<bool> >("dccl.rans");
+        FieldCodecManager::remove<RansFieldCodec<const google::protobuf::EnumValueDescriptor*> >("dccl.rans");
         
     }
 }
@@ -111,6 +132,10 @@ dccl::arith::Model::symbol_type dccl::arith::Model::value_to_symbol(value_type v
         
     google::protobuf::RepeatedField<double>::const_iterator lower_it = 
         (upper_it == user_model_.value_bound().begin()) ? upper_it : upper_it - 1;
+
+    // a value equal to a bound is that bound's symbol (comparing squares below would not tell -x from x)
+    if(*lower_it == value && upper_it != user_model_.value_bound().end())
+        return lower_it - user_model_.value_bound().begin();
         
     double lower_diff = std::abs((*lower_it)*(*lower_it) - value*value);
     double upper_diff = std::abs((*upper_it)*(*upper_it) - value*value);
@@ -144,33 +169,18 @@ dccl::arith::Model::value_type dccl::arith::Model::symbol_to_value(symbol_type s
 
 std::pair<dccl::arith::Model::freq_type, dccl::arith::Model::freq_type> dccl::arith::Model::symbol_to_cumulative_freq(symbol_type symbol, ModelState state) const
 {
-    const boost::bimap<symbol_type, freq_type>& c_freqs = (state == ENCODER) ?
-        encoder_cumulative_freqs_ :
-        decoder_cumulative_freqs_;
+    const CumulativeFrequencies& c_freqs = cumulative_freqs(state);
 
-    boost::bimap<symbol_type, freq_type>::left_map::const_iterator c_freq_it =
-        c_freqs.left.find(symbol);
     std::pair<freq_type, freq_type> c_freq_range;
-    c_freq_range.second = c_freq_it->second;
-    if(c_freq_it == c_freqs.left.begin())
-    {
-        c_freq_range.first  = 0;
-    }
-    else
-    {
-        c_freq_it--;
-        c_freq_range.first = c_freq_it->second;
-    }
+    c_freq_range.second = c_freqs.cumulative(index(symbol));
+    c_freq_range.first = c_freq_range.second - c_freqs.frequency(index(symbol));
     return c_freq_range;
                           
 }
 
 std::pair<dccl::arith::Model::symbol_type, dccl::arith::Model::symbol_type> dccl::arith::Model::cumulative_freq_to_symbol(std::pair<freq_type, freq_type> c_freq_pair,  ModelState state) const
 {
-
-    const boost::bimap<symbol_type, freq_type>& c_freqs = (state == ENCODER) ?
-        encoder_cumulative_freqs_ :
-        decoder_cumulative_freqs_;
+    const CumulativeFrequencies& c_freqs = cumulative_freqs(state);
     
     std::pair<symbol_type, symbol_type> symbol_pair;
     
@@ -181,17 +191,15 @@ std::pair<dccl::arith::Model::symbol_type, dccl::arith::Model::symbol_type> dccl
     // symbol: 2   freq: 10   c_freq: 35 [25 ... 35)
     // searching for c_freq of 30 should return symbol 2     
     // searching for c_freq of 10 should return symbol 1
-    symbol_pair.first = c_freqs.right.upper_bound(c_freq_pair.first)->second;
-    
+    std::size_t first = c_freqs.upper_bound(c_freq_pair.first);
+    symbol_pair.first = symbol(first);
     
-    if(symbol_pair.first == c_freqs.left.rbegin()->first)
+    if(symbol_pair.first == max_symbol())
         symbol_pair.second = symbol_pair.first; // last symbol can't be ambiguous on the low end
-    else if(c_freqs.left.find(symbol_pair.first)->second > c_freq_pair.second)
+    else if(c_freqs.cumulative(first) > c_freq_pair.second)
         symbol_pair.second = symbol_pair.first; // unambiguously this symbol
     else
         symbol_pair.second = symbol_pair.first + 1;
-
-
     
     return symbol_pair;
 }
@@ -202,7 +210,7 @@ void dccl::arith::Model::update_model(symbol_type symbol, ModelState state)
     if(!user_model_.is_adaptive())
         return;
 
-    boost::bimap<symbol_type, freq_type>& c_freqs = (state == ENCODER) ?
+    CumulativeFrequencies& c_freqs = (state == ENCODER) ?
         encoder_cumulative_freqs_ :
         decoder_cumulative_freqs_;
 
@@ -210,35 +218,81 @@ void dccl::arith::Model::update_model(symbol_type symbol, ModelState state)
     {
         dlog << "Model was: " << std::endl;
         for(symbol_type i = MIN_SYMBOL, n = max_symbol(); i <= n; ++i)
-        {
-            boost::bimap<symbol_type, freq_type>::left_iterator it =
-                c_freqs.left.find(i);
-            if(it != c_freqs.left.end())
-                dlog << "Symbol: " << it->first << ", c_freq: " << it->second << std::endl;
-        }
+            dlog << "Symbol: " << i << ", c_freq: " << c_freqs.cumulative(index(i)) << std::endl;
     }
     
-                
-    for(symbol_type i = max_symbol(), n = symbol; i >= n; --i)
-    {
-        boost::bimap<symbol_type, freq_type>::left_iterator it =
-            c_freqs.left.find(i);
-        if(it != c_freqs.left.end())
-            c_freqs.left.replace_data(it, it->second + 1);
-    }
+    // increments the cumulative frequency of this symbol and all those after it
+    c_freqs.add(index(symbol), 1);
 
     if(dlog.is(DEBUG3))
     {
         dlog << "Model is now: " << std::endl;
         for(symbol_type i = MIN_SYMBOL, n = max_symbol(); i <= n; ++i)
-        {
-            boost::bimap<symbol_type, freq_type>::left_iterator it =
-                c_freqs.left.find(i);
-            if(it != c_freqs.left.end())
-                dlog << "Symbol: " << it->first << ", c_freq: " << it->second << std::endl;
-        }
+            dlog << "Symbol: " << i << ", c_freq: " << c_freqs.cumulative(index(i)) << std::endl;
     }
     
     dlog.is(DEBUG3) && dlog << "total freq: " << total_freq(state) << std::endl;
                 
 }
+
+void dccl::arith::ModelContext::set_model(const protobuf::ArithmeticModel& model)
+{
+    Model new_model(model);
+    ModelManager::create_and_validate_model(&new_model);
+    if(models_.count(model.name()))
+        models_.erase(model.name());
+    models_.insert(std::make_pair(model.name(), new_model));
+    ModelManager::generation(model.name())->bump();
+}
+
+dccl::arith::Model& dccl::arith::ModelContext::find(const std::string& name)
+{
+    if(internal::DependencyScope::active())
+        internal::DependencyScope::record(ModelManager::generation(name));
+
+    std::map<std::string, Model>::iterator it = models_.find(name);
+    if(it != models_.end())
+        return it->second;
+
+    // first use by this Codec: start from the shared model (and its initial frequencies)
+    if(this != &ModelManager::defaults_)
+    {
+        Model& defaults = ModelManager::defaults_.find(name);
+        Model new_model(defaults.user_model());
+        ModelManager::create_and_validate_model(&new_model);
+        return models_.insert(std::make_pair(name, new_model)).first->second;
+    }
+    
+    throw(Exception("Cannot find model called: " + name));
+}
+
+void dccl::arith::ModelContext::reset()
+{
+    for(std::map<std::string, Model>::iterator it = models_.begin(), end = models_.end(); it != end; ++it)
+    {
+        Model new_model(it->second.user_model());
+        ModelManager::create_and_validate_model(&new_model);
+        it->second = new_model;
+    }
+    last_bits_.clear();
+}
+
+dccl::internal::Generation* dccl::arith::ModelManager::generation(const std::string& name)
+{
+    boost::mutex::scoped_lock lock(generations_mutex_);
+    boost::shared_ptr<internal::Generation>& generation = generations_[name];
+    if(!generation)
+        generation.reset(new internal::Generation);
+    return generation.get();
+}
+
+dccl::arith::ModelContext& dccl::arith::ModelManager::context(dccl::Codec& codec)
+{
+    if(!codec.codec_context())
+        codec.set_codec_context(boost::shared_ptr<CodecContext>(new ModelContext));
+
+    ModelContext* context = dynamic_cast<ModelContext*>(codec.codec_context().get());
+    if(!context)
+        throw(Exception("Codec already has a CodecContext that is not a dccl::arith::ModelContext"));
+    return *context;
+}
@@ -28,10 +28,14 @@
 #include <limits>
 #include <algorithm>
 
-#include <boost/bimap.hpp>
+#include <vector>
+
 #include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "dccl/field_codec_typed.h"
+#include "dccl/internal/generation.h"
 
 #include "dccl/arithmetic/protobuf/arithmetic_extensions.pb.h"
 #include "dccl/arithmetic/protobuf/arithmetic.pb.h"
@@ -53,6 +57,89 @@ namespace dccl
     /// DCCL Arithmetic Encoder Library namespace 
     namespace arith
     {
+        /// \brief Cumulative frequencies of the symbols 0 ... size()-1, stored as a Fenwick (binary indexed) tree so that updating a frequency, finding a cumulative frequency and finding the symbol for a cumulative frequency are all O(log size())
+        class CumulativeFrequencies
+        {
+          public:
+            typedef uint32 freq_type;
+
+            CumulativeFrequencies() : total_(0), mask_(0) { }
+
+            /// \brief Reset to the frequencies [begin, end)
+            template<typename InputIterator>
+                void assign(InputIterator begin, InputIterator end)
+            {
+                freqs_.assign(begin, end);
+                tree_.assign(freqs_.size() + 1, 0);
+                total_ = 0;
+                for(std::size_t i = 1, n = tree_.size(); i < n; ++i)
+                {
+                    tree_[i] += freqs_[i-1];
+                    total_ += freqs_[i-1];
+                    std::size_t parent = i + (i & -i);
+                    if(parent < n)
+                        tree_[parent] += tree_[i];
+                }
+
+                mask_ = 1;
+                while(mask_ * 2 <= freqs_.size())
+                    mask_ *= 2;
+            }
+
+            std::size_t size() const { return freqs_.size(); }
+
+            /// \brief Frequency of \a symbol
+            freq_type frequency(std::size_t symbol) const { return freqs_[symbol]; }
+
+            /// \brief Sum of the frequencies of the symbols 0 ... \a symbol (inclusive)
+            freq_type cumulative(std::size_t symbol) const
+            {
+                freq_type sum = 0;
+                for(std::size_t i = symbol + 1; i > 0; i -= (i & -i))
+                    sum += tree_[i];
+                return sum;
+            }
+
+            /// \brief Sum of all the frequencies
+            freq_type total() const { return total_; }
+
+            /// \brief Add \a delta to the frequency of \a symbol
+            void add(std::size_t symbol, freq_type delta)
+            {
+                freqs_[symbol] += delta;
+                total_ += delta;
+                for(std::size_t i = symbol + 1, n = tree_.size(); i < n; i += (i & -i))
+                    tree_[i] += delta;
+            }
+
+            /// \brief First symbol whose cumulative() is greater than \a c_freq (or size() if there is none)
+            std::size_t upper_bound(freq_type c_freq) const
+            {
+                // descend the tree, keeping the largest prefix whose sum is <= c_freq
+                std::size_t position = 0;
+                for(std::size_t step = mask_; step > 0; step >>= 1)
+                {
+                    std::size_t next = position + step;
+                    if(next < tree_.size() && tree_[next] <= c_freq)
+                    {
+                        position = next;
+                        c_freq -= tree_[next];
+                    }
+                }
+                return position;
+            }
+
+          private:
+            std::vector<freq_type> freqs_;
+            // tree_[i] is the sum of freqs_[i - (i & -i)] ... freqs_[i-1]
+            std::vector<freq_type> tree_;
+            freq_type total_;
+            // largest power of two <= size()
+            std::size_t mask_;
+        };
+
+        class RansTable;
+
         class Model
         {
           public:
@@ -69,11 +156,6 @@ namespace dccl
             
             static const freq_type MAX_FREQUENCY = (1 << FREQUENCY_BITS) - 1;
 
-            
-            // maps message name -> map of field name -> last size (bits)
-            static std::map<std::string, std::map<std::string, Bitset> > last_bits_map;
-
-            
           Model(const protobuf::ArithmeticModel& user)
               : user_model_(user)
             { }
@@ -93,14 +175,7 @@ namespace dccl
             symbol_type max_symbol() const { return user_model_.frequency_size() - 1; }
             
             freq_type total_freq(ModelState state) const
-            {
-                
-                const boost::bimap<symbol_type, freq_type>& c_freqs = (state == ENCODER) ?
-                    encoder_cumulative_freqs_ :
-                    decoder_cumulative_freqs_;
-
-                return c_freqs.left.at(max_symbol());
-            }
+            { return cumulative_freqs(state).total(); }
 
             void update_model(symbol_type symbol, ModelState state);
             
@@ -108,23 +183,73 @@ namespace dccl
             std::pair<freq_type, freq_type> symbol_to_cumulative_freq(symbol_type symbol, ModelState state) const;
             std::pair<symbol_type, symbol_type> cumulative_freq_to_symbol(std::pair<freq_type, freq_type> c_freq_pair,  ModelState state) const;
 
+            /// \brief Frequency tables for RansFieldCodec, built from user_model() the first time they are needed
+            const RansTable& rans_table();
+
             friend class ModelManager;
+          private:
+            const CumulativeFrequencies& cumulative_freqs(ModelState state) const
+            { return (state == ENCODER) ? encoder_cumulative_freqs_ : decoder_cumulative_freqs_; }
+
+            // index of symbol in the CumulativeFrequencies
+            static std::size_t index(symbol_type symbol) { return symbol - MIN_SYMBOL; }
+            static symbol_type symbol(std::size_t index) { return static_cast<symbol_type>(index) + MIN_SYMBOL; }
+            
           private:
             protobuf::ArithmeticModel user_model_;
-            boost::bimap<symbol_type, freq_type> encoder_cumulative_freqs_;
-            boost::bimap<symbol_type, freq_type> decoder_cumulative_freqs_;
+            CumulativeFrequencies encoder_cumulative_freqs_;
+            CumulativeFrequencies decoder_cumulative_freqs_;
+            boost::shared_ptr<const RansTable> rans_table_;
+        };
+
+        /// \brief Arithmetic models, and the state of the adaptive ones, used by one Codec (see ModelManager::set_model(dccl::Codec&, const protobuf::ArithmeticModel&)).
+        ///
+        /// A model not set in the context is copied from those set with ModelManager::set_model(const protobuf::ArithmeticModel&) the first time the Codec uses it, so that each context adapts its own copy. A context must not be used by more than one thread at a time.
+        class ModelContext : public CodecContext
+        {
+          public:
+            /// \brief Set (or replace) the model called model.name() for this context only
+            void set_model(const protobuf::ArithmeticModel& model);
+
+            /// \brief The model called \a name
+            /// \throw Exception if there is no such model in this context or ModelManager
+            Model& find(const std::string& name);
+
+            /// \brief Start every adaptive model over from its initial frequencies
+            void reset();
+
+            /// \brief Bits last encoded for \a field, used to check the decoder when (dccl.field).arithmetic.debug_assert is set
+            Bitset& last_bits(const google::protobuf::FieldDescriptor* field)
+            { return last_bits_[field]; }
+
+          private:
+            std::map<std::string, Model> models_;
+            std::map<const google::protobuf::FieldDescriptor*, Bitset> last_bits_;
         };
 
+        /// \brief Arithmetic models shared by all the Codecs without a ModelContext of their own, and the initial models of those that have one
         class ModelManager
         {
           public:
+            /// \brief Set (or replace) the model called model.name()
+            ///
+            /// The state of this model, if adaptive, is shared by every Codec without a ModelContext; give each a context (e.g. with context()) for them to adapt independently. The sizes of messages already loaded with the model it replaces are computed again (and cached again by the next Codec::load()).
             static void set_model(const protobuf::ArithmeticModel& model)
+            { defaults_.set_model(model); }
+
+            /// \brief Set (or replace) the model called model.name() for \a codec only
+            static void set_model(dccl::Codec& codec, const protobuf::ArithmeticModel& model)
+            { context(codec).set_model(model); }
+
+            /// \brief The ModelContext of \a codec, attaching a new one (see Codec::set_codec_context()) if it has none
+            /// \throw Exception if \a codec has a CodecContext of another type
+            static ModelContext& context(dccl::Codec& codec);
+
+            /// \brief The ModelContext of the Codec using the arithmetic codec, or the shared one if it has none
+            static ModelContext& current_context()
             {
-                Model new_model(model);
-                create_and_validate_model(&new_model);
-                if(arithmetic_models_.count(model.name()))
-                    arithmetic_models_.erase(model.name());
-                arithmetic_models_.insert(std::make_pair(model.name(), new_model));
+                ModelContext* context = dynamic_cast<ModelContext*>(FieldCodecBase::codec_context());
+                return context ? *context : defaults_;
             }
 
             static void create_and_validate_model(Model* model)
@@ -136,6 +261,7 @@ namespace dccl
                                     "Missing fields: " + model->user_model_.InitializationErrorString()));
                 }
 
+                std::vector<Model::freq_type> freqs;
                 Model::freq_type cumulative_freq = 0;
                 for(Model::symbol_type symbol = Model::MIN_SYMBOL, n = model->user_model_.frequency_size(); symbol < n; ++symbol)
                 {
@@ -154,9 +280,9 @@ namespace dccl
                                         "All frequencies must be nonzero."));
                     }                      
                     cumulative_freq += freq;
-                    model->encoder_cumulative_freqs_.left.insert(std::make_pair(symbol, cumulative_freq));
-                    
+                    freqs.push_back(freq);
                 }
+                model->encoder_cumulative_freqs_.assign(freqs.begin(), freqs.end());
 
                 // must have separate models for adaptive encoding.
                 model->decoder_cumulative_freqs_ = model->encoder_cumulative_freqs_;
@@ -190,17 +316,20 @@ namespace dccl
             }
             
 
+            /// \brief The model called \a name in current_context()
             static Model& find(const std::string& name)
-            {
-                std::map<std::string, Model>::iterator it = arithmetic_models_.find(name);
-                if(it == arithmetic_models_.end())
-                    throw(Exception("Cannot find model called: " + name));
-                else
-                    return it->second;
-            }
+            { return current_context().find(name); }
 
           private:
-            static std::map<std::string, Model> arithmetic_models_;
+            friend class ModelContext;
+            static ModelContext defaults_;
+
+            // changes whenever a model called `name` is set (in any context); recorded by
+            // ModelContext::find() so that the sizes computed from a model are redone when it is replaced
+            static internal::Generation* generation(const std::string& name);
+            typedef std::map<std::string, boost::shared_ptr<internal::Generation> > GenerationMap;
+            static GenerationMap generations_;
+            static boost::mutex generations_mutex_;
         };
         
         
@@ -374,7 +503,7 @@ namespace dccl
                   if(FieldCodecBase::dccl_field_options().GetExtension(arithmetic).debug_assert())
                   {
                       // bit of a hack so I can get at the exact bit field sizes
-                      Model::last_bits_map[FieldCodecBase::this_descriptor()->full_name()][FieldCodecBase::this_field()->name()] = bits;
+                      ModelManager::current_context().last_bits(FieldCodecBase::this_field()) = bits;
                   }
 
                   
@@ -484,7 +613,7 @@ namespace dccl
                   if(FieldCodecBase::dccl_field_options().GetExtension(arithmetic).debug_assert())
                   {
                       // must consume same bits as encoded makes
-                      Bitset in = Model::last_bits_map[FieldCodecBase::this_descriptor()->full_name()][FieldCodecBase::this_field()->name()];
+                      const Bitset& in = ModelManager::current_context().last_bits(FieldCodecBase::this_field());
                       
                       dlog.is(DEBUG3) && dlog << "(ArithmeticFieldCodec) bits used is (" << bits->size() << "):     " << *bits << std::endl;
                       dlog.is(DEBUG3) && dlog << "(ArithmeticFieldCodec) bits original is (" << in.size() << "): " << in << std::endl;
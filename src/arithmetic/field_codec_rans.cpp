@@ -0,0 +1,196 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include <algorithm>
+#include <functional>
+
+#include "field_codec_rans.h"
+
+const unsigned dccl::arith::RansTable::MAX_STATE_BITS;
+
+namespace
+{
+    unsigned floor_log2(dccl::uint64 v)
+    {
+        unsigned r = 0;
+        while(v >>= 1)
+            ++r;
+        return r;
+    }
+}
+
+const dccl::arith::RansTable& dccl::arith::Model::rans_table()
+{
+    if(!rans_table_)
+        rans_table_.reset(new RansTable(user_model_));
+    return *rans_table_;
+}
+
+dccl::arith::RansTable::RansTable(const protobuf::ArithmeticModel& model)
+    : state_bits_(0),
+      max_symbol_bits_(0),
+      fill_symbol_(0)
+{
+    // indexed by symbol - Model::MIN_SYMBOL
+    std::vector<uint64> freqs;
+    freqs.push_back(model.eof_frequency());
+    freqs.push_back(model.out_of_range_frequency());
+    freqs.insert(freqs.end(), model.frequency().begin(), model.frequency().end());
+
+    uint64 total = 0;
+    unsigned nonzero = 0;
+    for(std::vector<uint64>::const_iterator it = freqs.begin(), end = freqs.end(); it != end; ++it)
+    {
+        total += *it;
+        if(*it)
+            ++nonzero;
+    }
+
+    if(nonzero == 0)
+        throw(Exception("Model \"" + model.name() + "\" has no symbols with a nonzero frequency"));
+    if(nonzero > (1u << MAX_STATE_BITS))
+        throw(Exception("Model \"" + model.name() + "\" has too many symbols for the rANS codec (at most 2^" +
+                        boost::lexical_cast<std::string>(MAX_STATE_BITS) + " may have a nonzero frequency)"));
+
+    // use the model's total unchanged where it is a power of two, otherwise the next one up, but
+    // with at least one slot per symbol
+    state_bits_ = std::max<unsigned>(1, std::max<unsigned>(ceil_log2(nonzero),
+                                                           std::min<unsigned>(ceil_log2(total), MAX_STATE_BITS)));
+    const uint32 M = 1u << state_bits_;
+
+    // scale the frequencies to sum to M, rounding down and keeping every nonzero frequency at least
+    // one, then hand out what is left over by largest remainder
+    std::vector<uint32> scaled(freqs.size(), 0);
+    std::vector<std::pair<uint64, std::size_t> > remainders;
+    uint64 scaled_total = 0;
+    for(std::size_t i = 0, n = freqs.size(); i < n; ++i)
+    {
+        if(!freqs[i])
+            continue;
+        scaled[i] = std::max<uint64>(1, freqs[i] * M / total);
+        scaled_total += scaled[i];
+        remainders.push_back(std::make_pair(freqs[i] * M % total, i));
+    }
+
+    if(scaled_total < M)
+    {
+        // each symbol rounded down by less than one, so there are fewer left over than symbols
+        std::sort(remainders.begin(), remainders.end(), std::greater<std::pair<uint64, std::size_t> >());
+        for(std::size_t i = 0, n = M - scaled_total; i < n; ++i)
+            ++scaled[remainders[i].second];
+    }
+    else
+    {
+        // too many rare symbols were rounded up to one: take the excess from the most frequent
+        while(scaled_total > M)
+        {
+            std::vector<uint32>::iterator largest = std::max_element(scaled.begin(), scaled.end());
+            uint32 excess = std::min<uint64>(scaled_total - M, *largest - 1);
+            *largest -= excess;
+            scaled_total -= excess;
+        }
+    }
+
+    if(model.frequency_size() > 0)
+        fill_symbol_ = std::max_element(model.frequency().begin(), model.frequency().end()) - model.frequency().begin();
+
+    encode_.resize(freqs.size());
+    decode_.resize(M);
+    uint32 cum = 0;
+    for(std::size_t i = 0, n = freqs.size(); i < n; ++i)
+    {
+        const uint32 freq = scaled[i];
+        const Model::symbol_type symbol = static_cast<Model::symbol_type>(i) + Model::MIN_SYMBOL;
+
+        EncodeEntry& entry = encode_[i];
+        entry.freq = freq;
+        entry.cum = cum;
+        entry.delta = 0;
+        if(!freq)
+            continue;
+
+        // renormalize by max_bits, or one fewer if the state is less than freq << max_bits
+        const unsigned max_bits = state_bits_ - floor_log2(freq);
+        entry.delta = (max_bits << (state_bits_ + 1)) - (freq << max_bits);
+        if(symbol != Model::EOF_SYMBOL)
+            max_symbol_bits_ = std::max(max_symbol_bits_, max_bits);
+
+        for(uint32 base = freq; base < 2*freq; ++base)
+        {
+            DecodeEntry& slot = decode_[cum + base - freq];
+            slot.eof = (symbol == Model::EOF_SYMBOL);
+            slot.value = (symbol == Model::EOF_SYMBOL) ? 0 :
+                (symbol == Model::OUT_OF_RANGE_SYMBOL) ? std::numeric_limits<Model::value_type>::quiet_NaN() :
+                model.value_bound(symbol);
+            slot.base = base;
+            slot.bits = state_bits_ - floor_log2(base);
+        }
+        cum += freq;
+    }
+}
+
+void dccl::arith::RansTable::encode(const Model& model, const std::vector<Model::value_type>& values, unsigned max_repeat, Encoding* encoding) const
+{
+    std::vector<Model::symbol_type>& symbols = encoding->symbols;
+    symbols.clear();
+    for(unsigned i = 0; i < max_repeat; ++i)
+    {
+        Model::symbol_type symbol = (i < values.size()) ? model.value_to_symbol(values[i]) : Model::EOF_SYMBOL;
+
+        // out of range without a frequency ends the field; EOF without one is replaced by the most probable symbol
+        if(symbol == Model::OUT_OF_RANGE_SYMBOL && !frequency(symbol))
+            symbol = Model::EOF_SYMBOL;
+        if(symbol == Model::EOF_SYMBOL && !frequency(symbol))
+            symbol = fill_symbol_;
+
+        symbols.push_back(symbol);
+        if(symbol == Model::EOF_SYMBOL)
+            break;
+    }
+
+    // rANS is last in, first out: encode the symbols in reverse so they decode in order
+    const uint32 M = 1u << state_bits_;
+    uint32 x = M;
+    encoding->chunks.clear();
+    encoding->size = state_bits_;
+    for(std::size_t i = symbols.size(); i-- > 0; )
+    {
+        const EncodeEntry& entry = encode_[symbols[i] - Model::MIN_SYMBOL];
+        const unsigned bits = (x + entry.delta) >> (state_bits_ + 1);
+
+        // the decoder stops after the last symbol, so the initial state need not be written
+        if(i + 1 != symbols.size())
+        {
+            encoding->chunks.push_back(std::make_pair(x & ((1u << bits) - 1), bits));
+            encoding->size += bits;
+        }
+        x = M + entry.cum + (x >> bits) - entry.freq;
+    }
+    encoding->state = x;
+}
+
+void dccl::arith::RansTable::write(const Encoding& encoding, BitWriter* writer) const
+{
+    writer->write(encoding.state - (1u << state_bits_), state_bits_);
+    for(std::vector<std::pair<uint32, unsigned> >::const_reverse_iterator it = encoding.chunks.rbegin(),
+            end = encoding.chunks.rend(); it != end; ++it)
+        writer->write(it->first, it->second);
+}
@@ -0,0 +1,335 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLFIELDCODECRANS20261018H
+#define DCCLFIELDCODECRANS20261018H
+
+#include <vector>
+#include <string>
+#include <utility>
+
+#include "dccl/bitstream.h"
+#include "dccl/arithmetic/field_codec_arithmetic.h"
+
+namespace dccl
+{
+    namespace arith
+    {
+        /// \brief Tables used by RansFieldCodec, built from the frequencies of a static Model scaled to sum to M = 2^state_bits().
+        ///
+        /// The coder state is kept in [M, 2M) and renormalized a bit at a time (rather than a byte at a time), so each step is a table lookup, a shift and an add: the quotient that a byte-wise rANS coder computes by a division (or a multiplication by the reciprocal of the frequency) is always exactly one.
+        class RansTable
+        {
+          public:
+            /// \brief Largest state_bits(). A model may not have more than 2^MAX_STATE_BITS symbols with a nonzero frequency (including EOF and out of range).
+            static const unsigned MAX_STATE_BITS = 15;
+
+            /// \brief Output of encode()
+            struct Encoding
+            {
+                Encoding() : state(0), size(0) { }
+
+                // symbols in the order they are decoded
+                std::vector<Model::symbol_type> symbols;
+                // final coder state
+                uint32 state;
+                // bits (value, number of bits) in the order they were produced, which is the reverse of the order they are written
+                std::vector<std::pair<uint32, unsigned> > chunks;
+                // total bits, including the state
+                unsigned size;
+            };
+
+            /// \throw Exception if the model has too many symbols
+            explicit RansTable(const protobuf::ArithmeticModel& model);
+
+            /// \brief Number of bits used to store the final coder state, which every field starts with
+            unsigned state_bits() const { return state_bits_; }
+
+            /// \brief Most bits taken by any symbol other than EOF
+            unsigned max_symbol_bits() const { return max_symbol_bits_; }
+
+            /// \brief Scaled frequency of \a symbol (zero if it cannot be encoded)
+            uint32 frequency(Model::symbol_type symbol) const
+            { return encode_[symbol - Model::MIN_SYMBOL].freq; }
+
+            /// \brief Encode up to \a max_repeat \a values, following the same rules as ArithmeticFieldCodec for values that are out of range and for fields shorter than max_repeat
+            void encode(const Model& model, const std::vector<Model::value_type>& values, unsigned max_repeat, Encoding* encoding) const;
+
+            /// \brief Write an Encoding: the final state followed by the chunks in reverse
+            void write(const Encoding& encoding, BitWriter* writer) const;
+
+            /// \brief Decode up to \a max_repeat values from \a source (a BitReader or internal::BitsetSource)
+            template<typename BitSource>
+                void decode(BitSource* source, unsigned max_repeat, std::vector<Model::value_type>* values) const
+            {
+                const uint32 M = 1u << state_bits_;
+                uint32 slot = static_cast<uint32>(source->read(state_bits_));
+                for(unsigned i = 0; i < max_repeat; ++i)
+                {
+                    const DecodeEntry& entry = decode_[slot];
+                    if(entry.eof)
+                        break;
+                    values->push_back(entry.value);
+
+                    // the encoder does not renormalize after the last symbol
+                    if(i + 1 == max_repeat)
+                        break;
+                    slot = ((entry.base << entry.bits) | static_cast<uint32>(source->read(entry.bits))) - M;
+                }
+            }
+
+          private:
+            struct EncodeEntry
+            {
+                uint32 freq;
+                uint32 cum;
+                // bits to renormalize by for state x are (x + delta) >> (state_bits_ + 1)
+                uint32 delta;
+            };
+
+            struct DecodeEntry
+            {
+                Model::value_type value;
+                // state before the symbol was encoded, shifted right by bits
+                uint32 base;
+                unsigned bits;
+                bool eof;
+            };
+
+          private:
+            unsigned state_bits_;
+            unsigned max_symbol_bits_;
+            Model::symbol_type fill_symbol_;
+            // indexed by symbol - Model::MIN_SYMBOL
+            std::vector<EncodeEntry> encode_;
+            // indexed by state - M
+            std::vector<DecodeEntry> decode_;
+        };
+
+        /// \brief Entropy codes a field with the same (dccl.field).arithmetic.model as ArithmeticFieldCodec, using a table-driven rANS (range asymmetric numeral systems) coder in place of the bit-at-a-time arithmetic coder.
+        ///
+        /// Only static (not adaptive) models are supported. Every field costs RansTable::state_bits() bits on top of close to the entropy of its values under the model, so this codec suits long repeated fields best; a single value is usually smaller with ArithmeticFieldCodec.
+        template<typename FieldType = Model::value_type>
+            class RansFieldCodecBase : public RepeatedTypedFieldCodec<Model::value_type, FieldType>
+        {
+          public:
+            using RepeatedTypedFieldCodec<Model::value_type, FieldType>::encode;
+            using RepeatedTypedFieldCodec<Model::value_type, FieldType>::decode;
+            using RepeatedTypedFieldCodec<Model::value_type, FieldType>::try_decode;
+
+            Bitset encode_repeated(const std::vector<Model::value_type>& wire_values)
+            {
+                Model& model = current_model();
+                const RansTable& table = model.rans_table();
+                RansTable::Encoding encoding;
+                table.encode(model, wire_values, max_repeat(), &encoding);
+
+                std::string bytes((encoding.size + 7) / 8, 0);
+                BitWriter writer(&bytes[0], &bytes[0] + bytes.size());
+                table.write(encoding, &writer);
+
+                Bitset bits;
+                bits.from_byte_string(bytes);
+                bits.resize(encoding.size);
+                return bits;
+            }
+
+            std::vector<Model::value_type> decode_repeated(Bitset* bits)
+            {
+                std::vector<Model::value_type> values;
+                internal::BitsetSource source(bits);
+                current_model().rans_table().decode(&source, max_repeat(), &values);
+                return values;
+            }
+
+            unsigned size_repeated(const std::vector<Model::value_type>& wire_values)
+            {
+                Model& model = current_model();
+                RansTable::Encoding encoding;
+                model.rans_table().encode(model, wire_values, max_repeat(), &encoding);
+                return encoding.size;
+            }
+
+            unsigned max_size_repeated()
+            {
+                // EOF is always the last symbol, so it never adds to the size
+                const RansTable& table = current_model().rans_table();
+                return table.state_bits() + (max_repeat() - 1) * table.max_symbol_bits();
+            }
+
+            unsigned min_size_repeated()
+            { return current_model().rans_table().state_bits(); }
+
+            void encode(BitWriter* writer)
+            { encode(writer, std::vector<Model::value_type>()); }
+
+            void encode(BitWriter* writer, const Model::value_type& wire_value)
+            { encode(writer, std::vector<Model::value_type>(1, wire_value)); }
+
+            Model::value_type decode(BitReader* reader)
+            {
+                Model::value_type wire_value;
+                if(!try_decode(reader, &wire_value))
+                    throw NullValueException();
+                return wire_value;
+            }
+
+            bool try_decode(BitReader* reader, Model::value_type* wire_value)
+            {
+                std::vector<Model::value_type> values;
+                decode(reader, &values);
+                if(values.empty())
+                    return false;
+                *wire_value = values.front();
+                return true;
+            }
+
+            void validate()
+            {
+                FieldCodecBase::require(FieldCodecBase::dccl_field_options().HasExtension(arithmetic),
+                                        "missing (dccl.field).arithmetic");
+
+                std::string model_name = FieldCodecBase::dccl_field_options().GetExtension(arithmetic).model();
+                Model* model = 0;
+                try
+                {
+                    model = &ModelManager::find(model_name);
+                }
+                catch(Exception& e)
+                {
+                    FieldCodecBase::require(false, "no such (dccl.field).arithmetic.model called \"" + model_name + "\" loaded.");
+                }
+
+                FieldCodecBase::require(!model->user_model().is_adaptive(),
+                                        "(dccl.field).arithmetic.model \"" + model_name + "\" is adaptive, which is not supported by the rANS codec");
+
+                // build the tables now, rather than on first use
+                try
+                {
+                    model->rans_table();
+                }
+                catch(Exception& e)
+                {
+                    FieldCodecBase::require(false, e.what());
+                }
+            }
+
+          private:
+            // the BitWriter / BitReader overloads write and read the bits directly, without the intermediate Bitset
+            // (unless a subclass may have changed the encoding, see TypedFieldCodec::direct_io())
+            void any_encode_repeated(BitWriter* writer, const std::vector<boost::any>& wire_values)
+            {
+                std::vector<Model::value_type> in;
+                in.reserve(wire_values.size());
+                try
+                {
+                    for(std::vector<boost::any>::const_iterator it = wire_values.begin(), end = wire_values.end(); it != end; ++it)
+                        in.push_back(boost::any_cast<Model::value_type>(*it));
+                }
+                catch(boost::bad_any_cast&)
+                { throw(type_error("encode_repeated", typeid(Model::value_type), wire_values.at(0).type())); }
+
+                if(this->direct_io())
+                    encode(writer, in);
+                else
+                    writer->write(this->encode_repeated(in));
+            }
+
+            void any_decode_repeated(BitReader* reader, std::vector<boost::any>* wire_values)
+            {
+                std::vector<Model::value_type> values;
+                if(this->direct_io())
+                {
+                    decode(reader, &values);
+                }
+                else
+                {
+                    internal::BitReaderBitset bits(reader, this->max_size_repeated(), this->min_size_repeated());
+                    values = this->decode_repeated(bits.bits());
+                }
+                wire_values->assign(values.begin(), values.end());
+            }
+
+            void encode(BitWriter* writer, const std::vector<Model::value_type>& wire_values)
+            {
+                Model& model = current_model();
+                const RansTable& table = model.rans_table();
+                RansTable::Encoding encoding;
+                table.encode(model, wire_values, max_repeat(), &encoding);
+                table.write(encoding, writer);
+            }
+
+            void decode(BitReader* reader, std::vector<Model::value_type>* values)
+            {
+                current_model().rans_table().decode(reader, max_repeat(), values);
+            }
+
+            dccl::int32 max_repeat()
+            {
+                return FieldCodecBase::this_field()->is_repeated() ? FieldCodecBase::dccl_field_options().max_repeat() : 1;
+            }
+
+            Model& current_model()
+            {
+                return ModelManager::find(FieldCodecBase::dccl_field_options().GetExtension(arithmetic).model());
+            }
+        };
+
+        template<typename FieldType>
+            class RansFieldCodec : public RansFieldCodecBase<FieldType>
+        {
+          public:
+            RansFieldCodec()
+            { this->set_direct_io_type(typeid(RansFieldCodec)); }
+
+          private:
+            Model::value_type pre_encode(const FieldType& field_value)
+            { return static_cast<Model::value_type>(field_value); }
+
+            FieldType post_decode(const Model::value_type& wire_value)
+            { return static_cast<FieldType>(wire_value); }
+        };
+
+        template <>
+            class RansFieldCodec<const google::protobuf::EnumValueDescriptor*> : public RansFieldCodecBase<const google::protobuf::EnumValueDescriptor*>
+        {
+          public:
+            RansFieldCodec()
+            { set_direct_io_type(typeid(RansFieldCodec)); }
+
+            Model::value_type pre_encode(const google::protobuf::EnumValueDescriptor* const& field_value)
+            { return field_value->number(); }
+
+            const google::protobuf::EnumValueDescriptor* post_decode(const Model::value_type& wire_value)
+            {
+                const google::protobuf::EnumDescriptor* e = FieldCodecBase::this_field()->enum_type();
+                const google::protobuf::EnumValueDescriptor* return_value = e->FindValueByNumber((int)wire_value);
+
+                if(return_value)
+                    return return_value;
+                else
+                    throw NullValueException();
+            }
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,230 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "dccl/option_extensions.pb.h"
+
+#include "model_trainer.h"
+#include "field_codec_arithmetic.h"
+
+namespace
+{
+    bool field_name_less(const google::protobuf::FieldDescriptor* a, const google::protobuf::FieldDescriptor* b)
+    { return a->full_name() < b->full_name(); }
+
+    // value of (repeated) field as used by the arithmetic codecs
+    double field_value(const google::protobuf::Message& msg, const google::protobuf::FieldDescriptor* field, int index)
+    {
+        using google::protobuf::FieldDescriptor;
+        const google::protobuf::Reflection* refl = msg.GetReflection();
+        const bool repeated = field->is_repeated();
+        switch(field->cpp_type())
+        {
+            case FieldDescriptor::CPPTYPE_INT32:
+                return repeated ? refl->GetRepeatedInt32(msg, field, index) : refl->GetInt32(msg, field);
+            case FieldDescriptor::CPPTYPE_INT64:
+                return repeated ? refl->GetRepeatedInt64(msg, field, index) : refl->GetInt64(msg, field);
+            case FieldDescriptor::CPPTYPE_UINT32:
+                return repeated ? refl->GetRepeatedUInt32(msg, field, index) : refl->GetUInt32(msg, field);
+            case FieldDescriptor::CPPTYPE_UINT64:
+                return repeated ? refl->GetRepeatedUInt64(msg, field, index) : refl->GetUInt64(msg, field);
+            case FieldDescriptor::CPPTYPE_DOUBLE:
+                return repeated ? refl->GetRepeatedDouble(msg, field, index) : refl->GetDouble(msg, field);
+            case FieldDescriptor::CPPTYPE_FLOAT:
+                return repeated ? refl->GetRepeatedFloat(msg, field, index) : refl->GetFloat(msg, field);
+            case FieldDescriptor::CPPTYPE_BOOL:
+                return repeated ? refl->GetRepeatedBool(msg, field, index) : refl->GetBool(msg, field);
+            case FieldDescriptor::CPPTYPE_ENUM:
+                return (repeated ? refl->GetRepeatedEnum(msg, field, index) : refl->GetEnum(msg, field))->number();
+            default:
+                return 0;
+        }
+    }
+}
+
+dccl::arith::ModelTrainer::ModelTrainer(unsigned max_symbols)
+    : max_symbols_(max_symbols),
+      messages_(0)
+{ }
+
+void dccl::arith::ModelTrainer::add(const google::protobuf::Message& msg)
+{
+    ++messages_;
+    add_fields(msg);
+}
+
+void dccl::arith::ModelTrainer::add_fields(const google::protobuf::Message& msg)
+{
+    const google::protobuf::Descriptor* desc = msg.GetDescriptor();
+    for(int i = 0, n = desc->field_count(); i < n; ++i)
+        add_field(msg, desc->field(i));
+}
+
+void dccl::arith::ModelTrainer::add_field(const google::protobuf::Message& msg, const google::protobuf::FieldDescriptor* field)
+{
+    using google::protobuf::FieldDescriptor;
+
+    const DCCLFieldOptions& options = field->options().GetExtension(dccl::field);
+    if(options.omit())
+        return;
+
+    const google::protobuf::Reflection* refl = msg.GetReflection();
+    switch(field->cpp_type())
+    {
+        case FieldDescriptor::CPPTYPE_MESSAGE:
+            if(field->is_repeated())
+            {
+                for(int i = 0, n = refl->FieldSize(msg, field); i < n; ++i)
+                    add_fields(refl->GetRepeatedMessage(msg, field, i));
+            }
+            else if(refl->HasField(msg, field))
+            {
+                add_fields(refl->GetMessage(msg, field));
+            }
+            return;
+
+        case FieldDescriptor::CPPTYPE_STRING:
+            return;
+
+        default:
+            break;
+    }
+
+    Histogram& histogram = histograms_[field];
+    if(field->is_repeated())
+    {
+        const int size = refl->FieldSize(msg, field);
+        const int max_repeat = options.max_repeat();
+        for(int i = 0, n = std::min(size, max_repeat); i < n; ++i)
+            ++histogram.values[field_value(msg, field, i)];
+        if(size < max_repeat)
+            ++histogram.eof;
+    }
+    else if(refl->HasField(msg, field))
+    {
+        ++histogram.values[field_value(msg, field, 0)];
+    }
+    else
+    {
+        ++histogram.eof;
+    }
+}
+
+void dccl::arith::ModelTrainer::merge(const ModelTrainer& other)
+{
+    messages_ += other.messages_;
+    for(std::map<const google::protobuf::FieldDescriptor*, Histogram>::const_iterator it = other.histograms_.begin(),
+            end = other.histograms_.end(); it != end; ++it)
+    {
+        Histogram& histogram = histograms_[it->first];
+        histogram.eof += it->second.eof;
+        for(std::map<double, uint64>::const_iterator value_it = it->second.values.begin(),
+                value_end = it->second.values.end(); value_it != value_end; ++value_it)
+            histogram.values[value_it->first] += value_it->second;
+    }
+}
+
+std::vector<const google::protobuf::FieldDescriptor*> dccl::arith::ModelTrainer::fields() const
+{
+    std::vector<const google::protobuf::FieldDescriptor*> fields;
+    for(std::map<const google::protobuf::FieldDescriptor*, Histogram>::const_iterator it = histograms_.begin(),
+            end = histograms_.end(); it != end; ++it)
+        fields.push_back(it->first);
+    std::sort(fields.begin(), fields.end(), field_name_less);
+    return fields;
+}
+
+unsigned dccl::arith::ModelTrainer::distinct_values(const google::protobuf::FieldDescriptor* field) const
+{
+    std::map<const google::protobuf::FieldDescriptor*, Histogram>::const_iterator it = histograms_.find(field);
+    return (it == histograms_.end()) ? 0 : it->second.values.size();
+}
+
+bool dccl::arith::ModelTrainer::model(const google::protobuf::FieldDescriptor* field, protobuf::ArithmeticModel* model) const
+{
+    std::map<const google::protobuf::FieldDescriptor*, Histogram>::const_iterator it = histograms_.find(field);
+    if(it == histograms_.end() || it->second.values.empty() || it->second.values.size() > max_symbols_)
+        return false;
+    const Histogram& histogram = it->second;
+
+    const uint64 eof = histogram.eof + (field->is_required() ? 0 : 1);
+    uint64 total = eof;
+    for(std::map<double, uint64>::const_iterator value_it = histogram.values.begin(),
+            value_end = histogram.values.end(); value_it != value_end; ++value_it)
+        total += value_it->second;
+
+    // the frequencies of a model must sum to less than Model::MAX_FREQUENCY, so scale down the
+    // counts of a large corpus (leaving room for those rounded up to one)
+    const uint64 divisor = total / (Model::MAX_FREQUENCY / 2) + 1;
+
+    model->Clear();
+    model->set_name(field->full_name());
+    model->set_eof_frequency(eof ? std::max<uint64>(1, eof / divisor) : 0);
+    model->set_out_of_range_frequency(0);
+    for(std::map<double, uint64>::const_iterator value_it = histogram.values.begin(),
+            value_end = histogram.values.end(); value_it != value_end; ++value_it)
+    {
+        model->add_value_bound(value_it->first);
+        model->add_frequency(std::max<uint64>(1, value_it->second / divisor));
+    }
+
+    // the last bound is not the value of a symbol, but must be above the largest one
+    const double largest = histogram.values.rbegin()->first;
+    double top = largest + 1;
+    if(!(top > largest))
+        top = std::nextafter(largest, std::numeric_limits<double>::infinity());
+    model->add_value_bound(top);
+
+    return true;
+}
+
+double dccl::arith::ModelTrainer::expected_bits(const google::protobuf::FieldDescriptor* field, const protobuf::ArithmeticModel& model) const
+{
+    std::map<const google::protobuf::FieldDescriptor*, Histogram>::const_iterator it = histograms_.find(field);
+    if(it == histograms_.end() || messages_ == 0)
+        return 0;
+    const Histogram& histogram = it->second;
+
+    double total = model.eof_frequency() + model.out_of_range_frequency();
+    for(int i = 0, n = model.frequency_size(); i < n; ++i)
+        total += model.frequency(i);
+
+    double bits = 0;
+    if(histogram.eof && model.eof_frequency())
+        bits += histogram.eof * std::log2(total / model.eof_frequency());
+
+    const Model symbols(model);
+    for(std::map<double, uint64>::const_iterator value_it = histogram.values.begin(),
+            value_end = histogram.values.end(); value_it != value_end; ++value_it)
+    {
+        Model::symbol_type symbol = symbols.value_to_symbol(value_it->first);
+        if(symbol >= model.frequency_size())
+            continue;
+        double freq = (symbol == Model::OUT_OF_RANGE_SYMBOL) ? model.out_of_range_frequency() : model.frequency(symbol);
+        // values without a frequency can't be encoded
+        if(freq)
+            bits += value_it->second * std::log2(total / freq);
+    }
+    return bits / messages_;
+}
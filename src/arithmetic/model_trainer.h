@@ -0,0 +1,91 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLARITHMODELTRAINER20261018H
+#define DCCLARITHMODELTRAINER20261018H
+
+#include <map>
+#include <vector>
+
+#include <google/protobuf/message.h>
+
+#include "dccl/common.h"
+#include "dccl/arithmetic/protobuf/arithmetic.pb.h"
+
+namespace dccl
+{
+    namespace arith
+    {
+        /// \brief Builds an ArithmeticModel for each field from the values it takes in a corpus of messages.
+        ///
+        /// Every field the arithmetic codecs can encode (numeric, enumeration and bool fields, including those of embedded messages, but not those omitted with (dccl.field).omit) is counted. A trainer must not be used by more than one thread at a time, but several (e.g. one per thread) can be combined with merge().
+        class ModelTrainer
+        {
+          public:
+            /// \param max_symbols Most distinct values a field may take for a model to be built for it
+            explicit ModelTrainer(unsigned max_symbols = 1024);
+
+            /// \brief Count the values of the fields of \a msg
+            void add(const google::protobuf::Message& msg);
+
+            /// \brief Add the counts of \a other to this trainer
+            void merge(const ModelTrainer& other);
+
+            /// \brief Number of messages added (including through merge())
+            uint64 messages() const { return messages_; }
+
+            /// \brief The fields counted so far, ordered by name
+            std::vector<const google::protobuf::FieldDescriptor*> fields() const;
+
+            /// \brief Number of distinct values seen for \a field
+            unsigned distinct_values(const google::protobuf::FieldDescriptor* field) const;
+
+            /// \brief Build a model (named field->full_name()) from the values seen for \a field.
+            ///
+            /// Every value seen is a value_bound with a frequency of the number of times it was seen. The EOF frequency is the number of times the field had fewer than max_repeat values (was not set, for an optional field), plus one unless the field is required, so that this is always possible. Values not seen are out of range, and end the field (out_of_range_frequency is 0).
+            /// \return false (leaving \a model unchanged) if \a field was never set or took more than max_symbols distinct values
+            bool model(const google::protobuf::FieldDescriptor* field, protobuf::ArithmeticModel* model) const;
+
+            /// \brief Expected bits per message spent on \a field if it were coded with \a model: the entropy of the values seen under the model (the arithmetic coder adds up to two bits to this each time the field is encoded)
+            double expected_bits(const google::protobuf::FieldDescriptor* field, const protobuf::ArithmeticModel& model) const;
+
+          private:
+            struct Histogram
+            {
+                Histogram() : eof(0) { }
+
+                std::map<double, uint64> values;
+                // number of times the field ended before max_repeat
+                uint64 eof;
+            };
+
+            void add_fields(const google::protobuf::Message& msg);
+            void add_field(const google::protobuf::Message& msg, const google::protobuf::FieldDescriptor* field);
+
+          private:
+            unsigned max_symbols_;
+            uint64 messages_;
+            std::map<const google::protobuf::FieldDescriptor*, Histogram> histograms_;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,585 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// Performance suite for encode, decode (including into pooled or arena allocated messages, and rejecting truncated messages), size, id, dispatch, load and sharing a loaded Schema.
+//
+// usage: dccl_bench [Google Benchmark options]
+// e.g. dccl_bench --benchmark_format=json > results.json
+// or   dccl_bench --benchmark_out=results.json --benchmark_out_format=json
+//
+// Each benchmark reports time per operation, "allocs/op" (calls to operator new per operation),
+// the encoded message size ("bytes") and bytes_per_second, and (where applicable)
+// is run with encryption off (crypto:0) and on (crypto:1).
+
+#include <cstdlib>
+#include <new>
+
+#include <benchmark/benchmark.h>
+
+#include "dccl/codec.h"
+#include "bench.pb.h"
+
+#ifdef DCCL_BENCH_ARITHMETIC
+#include "dccl/arithmetic/field_codec_arithmetic.h"
+#include "bench_arithmetic.pb.h"
+#endif
+
+#ifdef DCCL_BENCH_NATIVE_PROTOBUF
+#include "dccl/native_protobuf/dccl_native_protobuf.h"
+#include "bench_native_protobuf.pb.h"
+
+// ensure we link in dccl_native_protobuf.so
+dccl::native_protobuf::EnumFieldCodec native_protobuf_dummy;
+#endif
+
+#ifdef DCCL_BENCH_CCL
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "dccl/ccl/ccl_compatibility.h"
+#endif
+
+namespace
+{
+    std::size_t allocations = 0;
+}
+
+void* operator new(std::size_t size)
+{
+    ++allocations;
+    void* p = std::malloc(size ? size : 1);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) throw()
+{
+    std::free(p);
+}
+
+namespace dccl
+{
+    namespace bench
+    {
+        // counts allocations made between construction and report()
+        class AllocationCounter
+        {
+          public:
+            AllocationCounter() : start_(allocations) { }
+
+            void report(benchmark::State& state, std::size_t bytes_per_op)
+            {
+                state.counters["allocs/op"] = benchmark::Counter(allocations - start_, benchmark::Counter::kAvgIterations);
+                if(bytes_per_op)
+                {
+                    state.counters["bytes"] = bytes_per_op;
+                    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * bytes_per_op);
+                }
+            }
+
+          private:
+            std::size_t start_;
+        };
+
+        // A Shape provides the message type, a Codec configured for it, and a representative message
+        struct AllFieldsV3Shape
+        {
+            typedef AllFieldsV3 Msg;
+            static dccl::Codec* new_codec() { return new dccl::Codec; }
+
+            template<typename M>
+            static void fill_all(M* msg)
+            {
+                msg->set_time(1286827000000000ull);
+                msg->set_source(7);
+                msg->set_heading(271.3);
+                msg->set_speed(1.52);
+                msg->set_count(-23456);
+                msg->set_battery(88);
+                msg->set_pitch(-12);
+                msg->set_payload_on(true);
+                msg->set_state(STATE_SURVEY);
+                msg->set_label("glider-7");
+                msg->set_key(std::string("\x01\x02\x03\x04", 4));
+                msg->mutable_position()->set_lat(42.358456);
+                msg->mutable_position()->set_lon(-71.087589);
+                msg->mutable_position()->set_depth(112.5);
+            }
+
+            static void fill(Msg* msg, dccl::Codec&) { fill_all(msg); }
+        };
+
+        struct AllFieldsV2Shape
+        {
+            typedef AllFieldsV2 Msg;
+            static dccl::Codec* new_codec() { return new dccl::Codec; }
+            static void fill(Msg* msg, dccl::Codec&) { AllFieldsV3Shape::fill_all(msg); }
+        };
+
+        // only the required (header) fields set, so every optional field decodes as absent
+        struct SparseV2Shape
+        {
+            typedef AllFieldsV2 Msg;
+            static dccl::Codec* new_codec() { return new dccl::Codec; }
+            static void fill(Msg* msg, dccl::Codec&)
+            {
+                msg->set_time(1286827000000000ull);
+                msg->set_source(7);
+            }
+        };
+
+        struct RepeatedShape
+        {
+            typedef Repeated Msg;
+            static dccl::Codec* new_codec() { return new dccl::Codec; }
+            static void fill(Msg* msg, dccl::Codec&)
+            {
+                for(int i = 0; i < 20; ++i)
+                    msg->add_temperature(i % 60 - 20);
+                for(int i = 0; i < 10; ++i)
+                {
+                    Position* pos = msg->add_track();
+                    pos->set_lat(42.35 + i * 0.001);
+                    pos->set_lon(-71.08 - i * 0.001);
+                    if(i % 2)
+                        pos->set_depth(i * 10);
+                }
+                for(int i = 0; i < 8; ++i)
+                    msg->add_history(static_cast<State>(1 + i % 4));
+            }
+        };
+
+        struct VarBytesShape
+        {
+            typedef VarBytes Msg;
+            static dccl::Codec* new_codec() { return new dccl::Codec; }
+            static void fill(Msg* msg, dccl::Codec&)
+            {
+                std::string data(60, 0);
+                for(std::string::size_type i = 0; i < data.size(); ++i)
+                    data[i] = static_cast<char>(i * 7);
+                msg->set_data(data);
+                msg->set_extra("extra");
+            }
+        };
+
+#ifdef DCCL_BENCH_ARITHMETIC
+        struct ArithmeticShape
+        {
+            typedef Arithmetic Msg;
+            static dccl::Codec* new_codec()
+            {
+                dccl::Codec* codec = new dccl::Codec;
+                codec->load_library(DCCL_ARITHMETIC_NAME);
+
+                dccl::arith::protobuf::ArithmeticModel model;
+                model.set_name("bench");
+                model.set_eof_frequency(1);
+                model.set_out_of_range_frequency(0);
+                for(int i = 0; i < 16; ++i)
+                {
+                    model.add_value_bound(i);
+                    model.add_frequency(16 - i);
+                }
+                model.add_value_bound(16);
+                dccl::arith::ModelManager::set_model(model);
+                return codec;
+            }
+            static void fill(Msg* msg, dccl::Codec&)
+            {
+                for(int i = 0; i < 24; ++i)
+                    msg->add_value((i * i) % 16);
+            }
+        };
+
+        // same model and values as ArithmeticShape
+        struct RansShape
+        {
+            typedef Rans Msg;
+            static dccl::Codec* new_codec() { return ArithmeticShape::new_codec(); }
+            static void fill(Msg* msg, dccl::Codec&)
+            {
+                for(int i = 0; i < 24; ++i)
+                    msg->add_value((i * i) % 16);
+            }
+        };
+
+        // the model adapts with every value, so the encoder and decoder must stay in step (see BM_EncodeDecode)
+        struct ArithmeticAdaptiveShape
+        {
+            typedef ArithmeticAdaptive Msg;
+            static dccl::Codec* new_codec()
+            {
+                dccl::Codec* codec = new dccl::Codec;
+                codec->load_library(DCCL_ARITHMETIC_NAME);
+
+                dccl::arith::protobuf::ArithmeticModel model;
+                model.set_name("bench_adaptive");
+                model.set_eof_frequency(1);
+                model.set_out_of_range_frequency(0);
+                model.set_is_adaptive(true);
+                for(int i = 0; i < 400; ++i)
+                {
+                    model.add_value_bound(i);
+                    model.add_frequency(1);
+                }
+                model.add_value_bound(400);
+                dccl::arith::ModelManager::set_model(model);
+                return codec;
+            }
+            static void fill(Msg* msg, dccl::Codec&)
+            {
+                for(int i = 0; i < 24; ++i)
+                    msg->add_value((i * 37) % 400);
+            }
+        };
+#endif
+
+#ifdef DCCL_BENCH_NATIVE_PROTOBUF
+        // same values as AllFieldsV3Shape (and RepeatedShape's temperature), with Protobuf encoding
+        struct NativeProtobufShape
+        {
+            typedef NativeProtobuf Msg;
+            static dccl::Codec* new_codec()
+            {
+                dccl::Codec* codec = new dccl::Codec;
+                codec->load_library(DCCL_NATIVE_PROTOBUF_NAME);
+                return codec;
+            }
+            static void fill(Msg* msg, dccl::Codec&)
+            {
+                msg->set_time(1286827000000000ull);
+                msg->set_source(7);
+                msg->set_heading(271.3);
+                msg->set_speed(1.52);
+                msg->set_count(-23456);
+                msg->set_battery(88);
+                msg->set_pitch(-12);
+                msg->set_payload_on(true);
+                msg->set_state(STATE_SURVEY);
+                for(int i = 0; i < 20; ++i)
+                    msg->add_temperature(i % 60 - 20);
+            }
+        };
+#endif
+
+#ifdef DCCL_BENCH_CCL
+        struct CCLShape
+        {
+            typedef dccl::legacyccl::protobuf::CCLMDATState Msg;
+            static dccl::Codec* new_codec() { return new dccl::Codec("dccl.ccl.id", DCCL_CCL_COMPAT_NAME); }
+            static void fill(Msg* msg, dccl::Codec& codec)
+            {
+                // reference message from the dccl_ccl test
+                codec.decode(dccl::hex_decode("0e86fa11ad20c9011b4432bf47d10000002401042f0e7d87fa111620c95a200a"), msg);
+            }
+        };
+#endif
+
+        // one loaded Codec per Shape, with and without encryption
+        template<typename Shape>
+        dccl::Codec& codec(bool crypto)
+        {
+            static dccl::Codec* codecs[2] = { 0, 0 };
+            dccl::Codec*& codec = codecs[crypto ? 1 : 0];
+            if(!codec)
+            {
+                codec = Shape::new_codec();
+                if(crypto)
+                    codec->set_crypto_passphrase("dccl_bench");
+                codec->template load<typename Shape::Msg>();
+            }
+            return *codec;
+        }
+
+        template<typename Shape>
+        void BM_Encode(benchmark::State& state)
+        {
+            dccl::Codec& c = codec<Shape>(state.range(0));
+            typename Shape::Msg msg;
+            Shape::fill(&msg, c);
+
+            std::string bytes;
+            AllocationCounter allocs;
+            while(state.KeepRunning())
+            {
+                bytes.clear();
+                c.encode(&bytes, msg);
+            }
+            allocs.report(state, bytes.size());
+        }
+
+        template<typename Shape>
+        void BM_Decode(benchmark::State& state)
+        {
+            dccl::Codec& c = codec<Shape>(state.range(0));
+            typename Shape::Msg msg_in, msg_out;
+            Shape::fill(&msg_in, c);
+
+            std::string bytes;
+            c.encode(&bytes, msg_in);
+
+            AllocationCounter allocs;
+            while(state.KeepRunning())
+                c.decode(bytes, &msg_out);
+            allocs.report(state, bytes.size());
+        }
+
+        // the cost of keeping runtime statistics (Codec::set_stats_enabled()), compare with BM_Encode and BM_Decode
+        template<typename Shape>
+        void BM_EncodeDecodeStats(benchmark::State& state)
+        {
+            dccl::Codec& c = codec<Shape>(false);
+            typename Shape::Msg msg_in, msg_out;
+            Shape::fill(&msg_in, c);
+
+            c.set_stats_enabled(true);
+            std::string bytes;
+            AllocationCounter allocs;
+            while(state.KeepRunning())
+            {
+                bytes.clear();
+                c.encode(&bytes, msg_in);
+                c.decode(bytes, &msg_out);
+            }
+            allocs.report(state, bytes.size());
+            c.set_stats_enabled(false);
+        }
+
+        template<typename Shape>
+        void BM_EncodeDecode(benchmark::State& state)
+        {
+            dccl::Codec& c = codec<Shape>(false);
+            typename Shape::Msg msg_in, msg_out;
+            Shape::fill(&msg_in, c);
+
+            std::string bytes;
+            AllocationCounter allocs;
+            while(state.KeepRunning())
+            {
+                bytes.clear();
+                c.encode(&bytes, msg_in);
+                c.decode(bytes, &msg_out);
+            }
+            allocs.report(state, bytes.size());
+        }
+
+        // decoding frames of any loaded type into new messages: from the heap (as decode<boost::shared_ptr<google::protobuf::Message> >()),
+        // recycled through a MessagePool, or allocated on an Arena that is reset every 64 messages
+        template<typename Shape>
+        void BM_DecodeNew(benchmark::State& state)
+        {
+            dccl::Codec& c = codec<Shape>(false);
+            typename Shape::Msg msg_in;
+            Shape::fill(&msg_in, c);
+
+            std::string bytes;
+            c.encode(&bytes, msg_in);
+
+            AllocationCounter allocs;
+            while(state.KeepRunning())
+                benchmark::DoNotOptimize(c.decode<boost::shared_ptr<google::protobuf::Message> >(bytes));
+            allocs.report(state, bytes.size());
+        }
+
+        template<typename Shape>
+        void BM_DecodePool(benchmark::State& state)
+        {
+            dccl::Codec& c = codec<Shape>(false);
+            typename Shape::Msg msg_in;
+            Shape::fill(&msg_in, c);
+
+            std::string bytes;
+            c.encode(&bytes, msg_in);
+
+            dccl::MessagePool pool;
+            AllocationCounter allocs;
+            while(state.KeepRunning())
+                pool.release(c.decode(bytes, &pool));
+            allocs.report(state, bytes.size());
+        }
+
+#if DCCL_HAS_PROTOBUF_ARENA
+        template<typename Shape>
+        void BM_DecodeArena(benchmark::State& state)
+        {
+            dccl::Codec& c = codec<Shape>(false);
+            typename Shape::Msg msg_in;
+            Shape::fill(&msg_in, c);
+
+            std::string bytes;
+            c.encode(&bytes, msg_in);
+
+            google::protobuf::Arena arena;
+            int n = 0;
+            AllocationCounter allocs;
+            while(state.KeepRunning())
+            {
+                benchmark::DoNotOptimize(c.decode(bytes, &arena));
+                if(++n % 64 == 0)
+                    arena.Reset();
+            }
+            allocs.report(state, bytes.size());
+        }
+#endif
+
+        // rejecting a corrupted (here, truncated to half its length) message with try_decode()
+        template<typename Shape>
+        void BM_TryDecodeTruncated(benchmark::State& state)
+        {
+            dccl::Codec& c = codec<Shape>(false);
+            typename Shape::Msg msg_in, msg_out;
+            Shape::fill(&msg_in, c);
+
+            std::string bytes;
+            c.encode(&bytes, msg_in);
+            bytes.resize(bytes.size() / 2);
+
+            dccl::Status status;
+            AllocationCounter allocs;
+            while(state.KeepRunning())
+                benchmark::DoNotOptimize(c.try_decode(bytes, &msg_out, &status));
+            allocs.report(state, bytes.size());
+        }
+
+        template<typename Shape>
+        void BM_Size(benchmark::State& state)
+        {
+            dccl::Codec& c = codec<Shape>(false);
+            typename Shape::Msg msg;
+            Shape::fill(&msg, c);
+
+            unsigned size = 0;
+            AllocationCounter allocs;
+            while(state.KeepRunning())
+                benchmark::DoNotOptimize(size = c.size(msg));
+            allocs.report(state, size);
+        }
+
+        template<typename Shape>
+        void BM_Id(benchmark::State& state)
+        {
+            dccl::Codec& c = codec<Shape>(false);
+            typename Shape::Msg msg;
+            Shape::fill(&msg, c);
+
+            std::string bytes;
+            c.encode(&bytes, msg);
+
+            AllocationCounter allocs;
+            while(state.KeepRunning())
+                benchmark::DoNotOptimize(c.id(bytes));
+            allocs.report(state, bytes.size());
+        }
+
+        void count_frame(unsigned dccl_id, const char* begin, const char* end)
+        { benchmark::DoNotOptimize(end - begin); }
+
+        // routing a frame to the handler for its id, without decoding it
+        template<typename Shape>
+        void BM_Dispatch(benchmark::State& state)
+        {
+            dccl::Codec& c = codec<Shape>(false);
+            typename Shape::Msg msg;
+            Shape::fill(&msg, c);
+
+            std::string bytes;
+            c.encode(&bytes, msg);
+            c.add_frame_handler(c.id(bytes), &count_frame);
+
+            AllocationCounter allocs;
+            while(state.KeepRunning())
+                benchmark::DoNotOptimize(c.dispatch(bytes));
+            allocs.report(state, bytes.size());
+        }
+
+        template<typename Shape>
+        void BM_Load(benchmark::State& state)
+        {
+            dccl::Codec& c = codec<Shape>(false);
+
+            // loading a type that is already loaded does nothing, so unload it first
+            AllocationCounter allocs;
+            while(state.KeepRunning())
+            {
+                c.template unload<typename Shape::Msg>();
+                c.template load<typename Shape::Msg>();
+            }
+            allocs.report(state, 0);
+        }
+
+        // a Codec for another link (e.g. with its own passphrase) sharing the loaded messages
+        template<typename Shape>
+        void BM_ShareSchema(benchmark::State& state)
+        {
+            dccl::Codec& c = codec<Shape>(false);
+
+            AllocationCounter allocs;
+            while(state.KeepRunning())
+            {
+                dccl::Codec link(c.schema());
+                link.template load<typename Shape::Msg>();
+            }
+            allocs.report(state, 0);
+        }
+    }
+}
+
+using namespace dccl::bench;
+
+#if DCCL_HAS_PROTOBUF_ARENA
+#define DCCL_BENCH_ARENA(Shape) BENCHMARK_TEMPLATE(BM_DecodeArena, Shape);
+#else
+#define DCCL_BENCH_ARENA(Shape)
+#endif
+
+#define DCCL_BENCH_SHAPE(Shape)                                             \
+    BENCHMARK_TEMPLATE(BM_Encode, Shape)->ArgName("crypto")->Arg(0)->Arg(1); \
+    BENCHMARK_TEMPLATE(BM_Decode, Shape)->ArgName("crypto")->Arg(0)->Arg(1); \
+    BENCHMARK_TEMPLATE(BM_EncodeDecodeStats, Shape);                        \
+    BENCHMARK_TEMPLATE(BM_DecodeNew, Shape);                                \
+    BENCHMARK_TEMPLATE(BM_DecodePool, Shape);                               \
+    DCCL_BENCH_ARENA(Shape)                                                 \
+    BENCHMARK_TEMPLATE(BM_TryDecodeTruncated, Shape);                       \
+    BENCHMARK_TEMPLATE(BM_Size, Shape);                                     \
+    BENCHMARK_TEMPLATE(BM_Id, Shape);                                       \
+    BENCHMARK_TEMPLATE(BM_Dispatch, Shape);                                 \
+    BENCHMARK_TEMPLATE(BM_Load, Shape);                                     \
+    BENCHMARK_TEMPLATE(BM_ShareSchema, Shape)
+
+DCCL_BENCH_SHAPE(AllFieldsV3Shape);
+DCCL_BENCH_SHAPE(AllFieldsV2Shape);
+DCCL_BENCH_SHAPE(SparseV2Shape);
+DCCL_BENCH_SHAPE(RepeatedShape);
+DCCL_BENCH_SHAPE(VarBytesShape);
+#ifdef DCCL_BENCH_ARITHMETIC
+DCCL_BENCH_SHAPE(ArithmeticShape);
+BENCHMARK_TEMPLATE(BM_EncodeDecode, ArithmeticShape);
+DCCL_BENCH_SHAPE(RansShape);
+BENCHMARK_TEMPLATE(BM_EncodeDecode, ArithmeticAdaptiveShape);
+#endif
+#ifdef DCCL_BENCH_NATIVE_PROTOBUF
+DCCL_BENCH_SHAPE(NativeProtobufShape);
+#endif
+#ifdef DCCL_BENCH_CCL
+DCCL_BENCH_SHAPE(CCLShape);
+#endif
+
+BENCHMARK_MAIN();
@@ -40,14 +40,12 @@ dccl::Bitset dccl::Bitset::relinquish_bits(size_type num_bits,
     Bitset out;
     if(!final_child)
     {
-        for(size_type i = 0; i < num_bits; ++i)
-        {
-            if(this->empty())
-                throw(dccl::Exception("Cannot relinquish_bits - no more bits to give up! Check that all field codecs are always producing (encode) and consuming (decode) the exact same number of bits."));
-            
-            out.push_back(this->front());
-            this->pop_front();
-        }
+        if(this->size() < num_bits)
+            throw(dccl::TruncatedException("Cannot relinquish_bits - no more bits to give up! Check that all field codecs are always producing (encode) and consuming (decode) the exact same number of bits."));
+
+        out.resize(num_bits);
+        out.copy_from(*this, 0, num_bits);
+        erase_front(num_bits);
     }
     return out;
 }
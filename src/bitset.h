@@ -22,27 +22,107 @@
 #ifndef DCCLBITSET20120424H
 #define DCCLBITSET20120424H
 
-#include <deque>
+#include <vector>
+#include <iterator>
 #include <algorithm>
 #include <limits>
 #include <string>
 #include <cstring>
+#include <cstddef>
+#include <stdexcept>
+#include <ostream>
+
+#include <boost/cstdint.hpp>
 
 #include "exception.h"
 
 namespace dccl
 {
-    /// \brief A variable size container of bits (subclassed from std::deque<bool>) with an optional hierarchy. Similar to set::bitset but can be resized at runtime and has the ability to have parent Bitsets that can give bits to their children.
+    /// \brief A variable size container of bits (packed into contiguous 64-bit words) with an optional hierarchy. Similar to set::bitset but can be resized at runtime and has the ability to have parent Bitsets that can give bits to their children.
     /// 
-    /// This is the class used within DCCL hold the encoded message as it is created. The front() of the deque represents the least significant bit (lsb) and the back() is the most significant bit (msb). DCCL messages are encoded and decoded starting with the  lsb and ending at the msb. The hierarchy is used to represent parent bit pools from which the child can pull more bits from to decode. The top level Bitset represents the entire encoded message, whereas the children are the message fields. 
-    class Bitset : public std::deque<bool>
+    /// This is the class used within DCCL hold the encoded message as it is created. Index 0 (front()) represents the least significant bit (lsb) and index size()-1 (back()) is the most significant bit (msb). DCCL messages are encoded and decoded starting with the  lsb and ending at the msb. The hierarchy is used to represent parent bit pools from which the child can pull more bits from to decode. The top level Bitset represents the entire encoded message, whereas the children are the message fields.
+    ///
+    /// The bits are stored in a std::vector of 64-bit words, starting at a small offset into the first word so that both ends of the container can grow and shrink cheaply. The commonly used subset of the std::deque<bool> interface (which this class used to derive from) is provided for compatibility.
+    class Bitset
     {
       public:
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef bool value_type;
+        typedef bool const_reference;
+
+        /// \brief Proxy to a single (modifiable) bit in the Bitset
+        class reference
+        {
+          public:
+            operator bool() const { return bitset_->test(n_); }
+            bool operator~() const { return !bitset_->test(n_); }
+            reference& operator=(bool val) { bitset_->set(n_, val); return *this; }
+            reference& operator=(const reference& rhs) { return *this = static_cast<bool>(rhs); }
+            reference& flip() { bitset_->flip(n_); return *this; }
+            
+          private:
+            friend class Bitset;
+            reference(Bitset* bitset, size_type n) : bitset_(bitset), n_(n) { }
+            Bitset* bitset_;
+            size_type n_;
+        };
+
+        /// \brief Random access iterator over the bits of a Bitset (from lsb to msb)
+        template<typename BitsetType, typename Reference>
+            class iterator_base
+        {
+          public:
+            typedef std::random_access_iterator_tag iterator_category;
+            typedef bool value_type;
+            typedef Bitset::difference_type difference_type;
+            typedef void pointer;
+            typedef Reference reference;
+
+            iterator_base() : bitset_(0), n_(0) { }
+            iterator_base(BitsetType* bitset, size_type n) : bitset_(bitset), n_(n) { }
+            // allow iterator -> const_iterator conversion
+            template<typename OtherBitsetType, typename OtherReference>
+                iterator_base(const iterator_base<OtherBitsetType, OtherReference>& other) : bitset_(other.bitset_), n_(other.n_) { }
+            
+            Reference operator*() const { return (*bitset_)[n_]; }
+            Reference operator[](difference_type d) const { return (*bitset_)[n_ + d]; }
+
+            iterator_base& operator++() { ++n_; return *this; }
+            iterator_base& operator--() { --n_; return *this; }
+            iterator_base operator++(int) { iterator_base copy(*this); ++n_; return copy; }
+            iterator_base operator--(int) { iterator_base copy(*this); --n_; return copy; }
+            iterator_base& operator+=(difference_type d) { n_ += d; return *this; }
+            iterator_base& operator-=(difference_type d) { n_ -= d; return *this; }
+            iterator_base operator+(difference_type d) const { return iterator_base(bitset_, n_ + d); }
+            iterator_base operator-(difference_type d) const { return iterator_base(bitset_, n_ - d); }
+            difference_type operator-(const iterator_base& rhs) const { return static_cast<difference_type>(n_) - static_cast<difference_type>(rhs.n_); }
+
+            bool operator==(const iterator_base& rhs) const { return n_ == rhs.n_ && bitset_ == rhs.bitset_; }
+            bool operator!=(const iterator_base& rhs) const { return !(*this == rhs); }
+            bool operator<(const iterator_base& rhs) const { return n_ < rhs.n_; }
+            bool operator>(const iterator_base& rhs) const { return n_ > rhs.n_; }
+            bool operator<=(const iterator_base& rhs) const { return n_ <= rhs.n_; }
+            bool operator>=(const iterator_base& rhs) const { return n_ >= rhs.n_; }
+            
+          private:
+            template<typename OtherBitsetType, typename OtherReference> friend class iterator_base;
+            BitsetType* bitset_;
+            size_type n_;
+        };
+
+        typedef iterator_base<Bitset, reference> iterator;
+        typedef iterator_base<const Bitset, bool> const_iterator;
+        typedef std::reverse_iterator<iterator> reverse_iterator;
+        typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+        
         /// \brief Construct an empty Bitset.
         ///
         /// \param parent Pointer to a bitset that should be consider this Bitset's parent for calls to get_more_bits()
         explicit Bitset(Bitset* parent = 0)
-            : parent_(parent)
+            : offset_(0),
+            size_(0),
+            parent_(parent)
         { }
 
         /// \brief Construct a Bitset of a certain initial size and value.
@@ -51,7 +131,8 @@ namespace dccl
         /// \param value Initial value of the bits in this Bitset
         /// \param parent Pointer to a bitset that should be consider this Bitset's parent for calls to get_more_bits()
         explicit Bitset(size_type num_bits, unsigned long value = 0, Bitset* parent = 0)
-            : std::deque<bool>(num_bits, false),
+            : offset_(0),
+            size_(0),
             parent_(parent)
             { from(value, num_bits); }
         
@@ -76,8 +157,11 @@ namespace dccl
             if(rhs.size() != size())
                 throw(dccl::Exception("Bitset operator&= requires this->size() == rhs.size()"));
                 
-            for (size_type i = 0; i != this->size(); ++i)
-                (*this)[i] = (*this)[i] & rhs[i];
+            for(size_type i = 0; i < size_; i += WORD_BITS)
+            {
+                size_type n = std::min<size_type>(WORD_BITS, size_ - i);
+                set_word(i, get_word(i, n) & rhs.get_word(i, n), n);
+            }
             return *this;
         }
 
@@ -92,8 +176,11 @@ namespace dccl
             if(rhs.size() != size())
                 throw(dccl::Exception("Bitset operator|= requires this->size() == rhs.size()"));
 
-            for (size_type i = 0; i != this->size(); ++i)
-                (*this)[i] = (*this)[i] | rhs[i];
+            for(size_type i = 0; i < size_; i += WORD_BITS)
+            {
+                size_type n = std::min<size_type>(WORD_BITS, size_ - i);
+                set_word(i, get_word(i, n) | rhs.get_word(i, n), n);
+            }
             return *this;
         }
             
@@ -108,8 +195,11 @@ namespace dccl
             if(rhs.size() != size())
                 throw(dccl::Exception("Bitset operator^= requires this->size() == rhs.size()"));
 
-            for (size_type i = 0; i != this->size(); ++i)
-                (*this)[i] = (*this)[i] ^ rhs[i];
+            for(size_type i = 0; i < size_; i += WORD_BITS)
+            {
+                size_type n = std::min<size_type>(WORD_BITS, size_ - i);
+                set_word(i, get_word(i, n) ^ rhs.get_word(i, n), n);
+            }
             return *this;
         }
             
@@ -124,11 +214,12 @@ namespace dccl
         /// \return  A reference to the resulting Bitset
         Bitset& operator<<=(size_type n)
         {
-            for(size_type i = 0; i < n; ++i)
-            {
-                push_front(false);
-                pop_back();
-            }
+            if(n >= size_)
+                return reset();
+            
+            size_type old_size = size_;
+            grow_front(n);
+            resize(old_size);
             return *this;
         }
                
@@ -140,11 +231,12 @@ namespace dccl
         /// \return  A reference to the resulting Bitset
         Bitset& operator>>=(size_type n)
         {
-            for(size_type i = 0; i < n; ++i)
-            {
-                push_back(false);
-                pop_front();
-            }
+            if(n >= size_)
+                return reset();
+            
+            size_type old_size = size_;
+            erase_front(n);
+            resize(old_size);
             return *this;
         }
             
@@ -175,7 +267,12 @@ namespace dccl
         /// \return A reference to the resulting Bitset
         Bitset& set(size_type n, bool val = true)
         {
-            (*this)[n] = val;
+            size_type pos = offset_ + n;
+            Word mask = static_cast<Word>(1) << (pos % WORD_BITS);
+            if(val)
+                words_[pos / WORD_BITS] |= mask;
+            else
+                words_[pos / WORD_BITS] &= ~mask;
             return *this;
         }
             
@@ -184,8 +281,11 @@ namespace dccl
         /// \return A reference to the resulting Bitset
         Bitset& set()
         {
-            for(iterator it = begin(), n = end(); it != n; ++it)
-                *it = true;
+            for(size_type i = 0; i < size_; i += WORD_BITS)
+            {
+                size_type n = std::min<size_type>(WORD_BITS, size_ - i);
+                set_word(i, ~static_cast<Word>(0), n);
+            }
             return *this;
         }
             
@@ -201,8 +301,7 @@ namespace dccl
         /// \return A reference to the resulting Bitset
         Bitset& reset()
         {
-            for(iterator it = begin(), n = end(); it != n; ++it)
-                *it = false;
+            std::fill(words_.begin(), words_.end(), 0);
             return *this;
         }
 
@@ -211,15 +310,22 @@ namespace dccl
         /// \param n bit to flip
         /// \return A reference to the resulting Bitset
         Bitset& flip(size_type n)
-        { return set(n, !(*this)[n]); }
+        {
+            size_type pos = offset_ + n;
+            words_[pos / WORD_BITS] ^= static_cast<Word>(1) << (pos % WORD_BITS);
+            return *this;
+        }
             
         /// \brief Flip (toggle) all bits
         ///
         /// \return A reference to the resulting Bitset
         Bitset& flip()
         {
-            for(size_type i = 0, n = size(); i < n; ++i)
-                flip(i);
+            for(size_type i = 0; i < size_; i += WORD_BITS)
+            {
+                size_type n = std::min<size_type>(WORD_BITS, size_ - i);
+                set_word(i, ~get_word(i, n), n);
+            }
             return *this;
         }
             
@@ -228,15 +334,108 @@ namespace dccl
         /// \param n bit to test
         /// \return value of the bit
         bool test(size_type n) const
-        { return (*this)[n]; }
+        {
+            size_type pos = offset_ + n;
+            return (words_[pos / WORD_BITS] >> (pos % WORD_BITS)) & 1;
+        }
             
         /* bool any() const; */
         /* bool none() const; */
         /* Bitset operator~() const; */
         /* size_type count() const; */
 
+        /// \brief Number of bits in the Bitset
+        size_type size() const { return size_; }
+
+        /// \brief Is the Bitset empty (size() == 0)?
+        bool empty() const { return size_ == 0; }
+
+        /// \brief Change the size of the Bitset, discarding bits from (or adding bits set to \a value to) the most significant end
+        void resize(size_type num_bits, bool value = false)
+        {
+            size_type old_size = size_;
+            if(num_bits == 0)
+            {
+                clear();
+            }
+            else if(num_bits < old_size)
+            {
+                clear_bits(num_bits, old_size - num_bits);
+                size_ = num_bits;
+                words_.resize(words_needed(offset_ + size_));
+            }
+            else if(num_bits > old_size)
+            {
+                words_.resize(words_needed(offset_ + num_bits), 0);
+                size_ = num_bits;
+                if(value)
+                {
+                    for(size_type i = old_size; i < num_bits; i += WORD_BITS)
+                    {
+                        size_type n = std::min<size_type>(WORD_BITS, num_bits - i);
+                        set_word(i, ~static_cast<Word>(0), n);
+                    }
+                }
+            }
+        }
         
+        /// \brief Remove all bits
+        void clear()
+        {
+            words_.clear();
+            offset_ = 0;
+            size_ = 0;
+        }
 
+        /// \brief Add a bit to the big (most significant) end
+        void push_back(bool value)
+        {
+            resize(size_ + 1);
+            if(value) set(size_ - 1);
+        }
+        
+        /// \brief Add a bit to the little (least significant) end
+        void push_front(bool value)
+        {
+            grow_front(1);
+            if(value) set(0);
+        }
+
+        /// \brief Remove the most significant bit
+        void pop_back()
+        { resize(size_ - 1); }
+
+        /// \brief Remove the least significant bit
+        void pop_front()
+        { erase_front(1); }
+
+        /// \brief Value of the least significant bit
+        reference front() { return reference(this, 0); }
+        const_reference front() const { return test(0); }
+        /// \brief Value of the most significant bit
+        reference back() { return reference(this, size_ - 1); }
+        const_reference back() const { return test(size_ - 1); }
+
+        reference operator[](size_type n) { return reference(this, n); }
+        const_reference operator[](size_type n) const { return test(n); }
+
+        iterator begin() { return iterator(this, 0); }
+        iterator end() { return iterator(this, size_); }
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, size_); }
+        reverse_iterator rbegin() { return reverse_iterator(end()); }
+        reverse_iterator rend() { return reverse_iterator(begin()); }
+        const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+        const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+        /// \brief Swap the contents (but not the parent) of this Bitset with another
+        void swap(Bitset& other)
+        {
+            words_.swap(other.words_);
+            std::swap(offset_, other.offset_);
+            std::swap(size_, other.size_);
+        }
+        
         /// \brief Sets value of the Bitset to the contents of an integer
         ///
         /// \param value Value to give the Bitset.
@@ -245,11 +444,13 @@ namespace dccl
             void from(IntType value, size_type num_bits = std::numeric_limits<IntType>::digits)
         {
             this->resize(num_bits);
-            for(int i = 0, n = std::min<size_type>(std::numeric_limits<IntType>::digits, size());
-                i < n; ++i)
+            this->reset();
+            size_type n = std::min<size_type>(std::numeric_limits<IntType>::digits, size());
+            for(size_type i = 0; i < n; i += WORD_BITS)
             {
-                if(value & (static_cast<IntType>(1) << i))
-                    (*this)[i] = true;
+                size_type num = std::min<size_type>(WORD_BITS, n - i);
+                // i > 0 only if IntType is wider than Word
+                set_word(i, static_cast<Word>(i ? (value >> i) : value), num);
             }
         }
 
@@ -270,10 +471,10 @@ namespace dccl
                 throw(Exception("Type IntType cannot represent current bitset (this->size() > std::numeric_limits<IntType>::digits)"));
 
             IntType out = 0;
-            for(int i = 0, n = size(); i < n; ++i)
+            for(size_type i = 0; i < size_; i += WORD_BITS)
             {
-                if((*this)[i])
-                    out |= (static_cast<IntType>(1) << i);
+                size_type n = std::min<size_type>(WORD_BITS, size_ - i);
+                out |= (static_cast<IntType>(get_word(i, n)) << i);
             }
                 
             return out;
@@ -286,17 +487,18 @@ namespace dccl
             return to<unsigned long>();
         }
 
+        /// \brief Returns \a num_bits (at most 64) bits starting at bit \a n as an integer, bit n being the lsb. Bits [n, n + num_bits) must be within size().
+        boost::uint64_t get_bits(size_type n, size_type num_bits) const
+        {
+            return get_word(n, num_bits);
+        }
+
         /// \brief Returns the value of the Bitset as a printable string, where each bit is represented by '1' or '0'. The msb is written into the zero index of the string, so it is printed msb to lsb (as is standard for writing numbers).
         std::string to_string() const
         {
             std::string s(size(), 0);
-            int i = 0;
-            for(Bitset::const_reverse_iterator it = rbegin(),
-                    n = rend(); it != n; ++it)
-            {
-                s[i] = (*it) ? '1' : '0';
-                ++i;
-            }
+            for(size_type i = 0, n = size(); i < n; ++i)
+                s[n - i - 1] = test(i) ? '1' : '0';
             return s;
         }
 
@@ -307,14 +509,12 @@ namespace dccl
         /// \brief Returns the value of the Bitset to a byte string, where each character represents 8 bits of the Bitset. The string is used as a byte container, and is not intended to be printed.
         ///
         /// \return A string containing the value of the Bitset, with the least signficant byte in string[0] and the most significant byte in string[size()-1]
-        std::string to_byte_string()
+        std::string to_byte_string() const
         {
             // number of bytes needed is ceil(size() / 8)
             std::string s(this->size()/8 + (this->size()%8 ? 1 : 0), 0);
-                
-            for(size_type i = 0, n = this->size(); i < n; ++i)
-                s[i/8] |= static_cast<char>((*this)[i] << (i%8));
-                
+            if(!s.empty())
+                write_bytes(&s[0]);
             return s;
         }
 
@@ -323,7 +523,7 @@ namespace dccl
         /// \param max_len Maximum length of buf
         /// \return number of bytes written to buf
         /// \throw std::length_error if max_len < encoded length.
-        size_t to_byte_string(char* buf, size_t max_len)
+        size_t to_byte_string(char* buf, size_t max_len) const
         {
             // number of bytes needed is ceil(size() / 8)
             size_t len = this->size()/8 + (this->size()%8 ? 1 : 0);
@@ -333,12 +533,7 @@ namespace dccl
                 throw std::length_error("max_len must be >= len");
             }
 
-            // initialize buffer to all zeroes
-            std::fill_n(buf, len, 0);
-
-            for(size_type i = 0, n = this->size(); i < n; ++i)
-                buf[i/8] |= static_cast<char>((*this)[i] << (i%8));
-
+            write_bytes(buf);
             return len;
         }
 
@@ -357,44 +552,143 @@ namespace dccl
         template<typename CharIterator>
         void from_byte_stream(CharIterator begin, CharIterator end)
         {
-            this->resize(std::distance(begin, end) * 8);
-            int i = 0;
-            for(CharIterator it = begin; it != end; ++it)
-            {
-                for(size_type j = 0; j < 8; ++j)
-                    (*this)[i*8+j] = (*it) & (1 << j);
-                ++i;
-            }
+            size_type num_bytes = std::distance(begin, end);
+            words_.assign(words_needed(num_bytes * 8), 0);
+            offset_ = 0;
+            size_ = num_bytes * 8;
+
+            size_type i = 0;
+            for(CharIterator it = begin; it != end; ++it, ++i)
+                words_[i / WORD_BYTES] |= static_cast<Word>(static_cast<unsigned char>(*it)) << ((i % WORD_BYTES) * 8);
         }
 
         /// \brief Adds the bitset to the little end
         Bitset& prepend(const Bitset& bits)
         {
-            for(const_reverse_iterator it = bits.rbegin(),
-                    n = bits.rend(); it != n; ++it)
-                push_front(*it);
-
+            if(&bits == this)
+                return prepend(Bitset(bits));
+            
+            size_type num_bits = bits.size();
+            grow_front(num_bits);
+            copy_from(bits, 0, num_bits);
             return *this;
         }
 
         /// \brief Adds the bitset to the big end
         Bitset& append(const Bitset& bits)
         {
-            for(const_iterator it = bits.begin(),
-                    n = bits.end(); it != n; ++it)
-                push_back(*it);                
-
+            if(&bits == this)
+                return append(Bitset(bits));
+            
+            size_type old_size = size_;
+            resize(size_ + bits.size());
+            copy_from(bits, old_size, bits.size());
             return *this;
         }
             
-            
-      private:            
+      private:
+        typedef boost::uint64_t Word;
+        enum { WORD_BITS = 64, WORD_BYTES = WORD_BITS / 8 };
+        
         Bitset relinquish_bits(size_type num_bits, bool final_child);
-            
-      private:            
-        Bitset* parent_;
 
-            
+        static size_type words_needed(size_type num_bits)
+        { return (num_bits + WORD_BITS - 1) / WORD_BITS; }
+
+        static Word low_mask(size_type num_bits)
+        { return (num_bits >= WORD_BITS) ? ~static_cast<Word>(0) : ((static_cast<Word>(1) << num_bits) - 1); }
+        
+        /// \brief Read num_bits (<= 64) bits starting at bit n into the low bits of a Word
+        Word get_word(size_type n, size_type num_bits) const
+        {
+            if(num_bits == 0) return 0;
+            size_type pos = offset_ + n;
+            size_type word = pos / WORD_BITS, shift = pos % WORD_BITS;
+            Word out = words_[word] >> shift;
+            if(shift && shift + num_bits > WORD_BITS)
+                out |= words_[word + 1] << (WORD_BITS - shift);
+            return out & low_mask(num_bits);
+        }
+        
+        /// \brief Write the low num_bits (<= 64) bits of value into the bits starting at n
+        void set_word(size_type n, Word value, size_type num_bits)
+        {
+            if(num_bits == 0) return;
+            Word mask = low_mask(num_bits);
+            value &= mask;
+            size_type pos = offset_ + n;
+            size_type word = pos / WORD_BITS, shift = pos % WORD_BITS;
+            words_[word] = (words_[word] & ~(mask << shift)) | (value << shift);
+            if(shift && shift + num_bits > WORD_BITS)
+            {
+                size_type rshift = WORD_BITS - shift;
+                words_[word + 1] = (words_[word + 1] & ~(mask >> rshift)) | (value >> rshift);
+            }
+        }
+
+        /// \brief Set num_bits starting at bit n to false
+        void clear_bits(size_type n, size_type num_bits)
+        {
+            for(size_type i = 0; i < num_bits; i += WORD_BITS)
+                set_word(n + i, 0, std::min<size_type>(WORD_BITS, num_bits - i));
+        }
+
+        /// \brief Copy num_bits from the low end of bits into this Bitset starting at bit n
+        void copy_from(const Bitset& bits, size_type n, size_type num_bits)
+        {
+            for(size_type i = 0; i < num_bits; i += WORD_BITS)
+            {
+                size_type num = std::min<size_type>(WORD_BITS, num_bits - i);
+                set_word(n + i, bits.get_word(i, num), num);
+            }
+        }
+        
+        /// \brief Write the bits as little-endian bytes into buf (which must hold ceil(size()/8) bytes)
+        void write_bytes(char* buf) const
+        {
+            size_type num_bytes = size_/8 + (size_%8 ? 1 : 0);
+            for(size_type i = 0; i < num_bytes; i += WORD_BYTES)
+            {
+                Word w = get_word(i*8, std::min<size_type>(WORD_BITS, size_ - i*8));
+                for(size_type j = i, n = std::min<size_type>(i + WORD_BYTES, num_bytes); j < n; ++j, w >>= 8)
+                    buf[j] = static_cast<char>(w & 0xFF);
+            }
+        }
+
+        /// \brief Add num_bits false bits to the little end
+        void grow_front(size_type num_bits)
+        {
+            if(num_bits > offset_)
+            {
+                size_type new_words = words_needed(num_bits - offset_);
+                words_.insert(words_.begin(), new_words, 0);
+                offset_ += new_words * WORD_BITS;
+            }
+            offset_ -= num_bits;
+            size_ += num_bits;
+        }
+
+        /// \brief Remove num_bits (<= size()) bits from the little end
+        void erase_front(size_type num_bits)
+        {
+            clear_bits(0, num_bits);
+            offset_ += num_bits;
+            size_ -= num_bits;
+            size_type empty_words = offset_ / WORD_BITS;
+            if(empty_words)
+            {
+                words_.erase(words_.begin(), words_.begin() + empty_words);
+                offset_ %= WORD_BITS;
+            }
+        }
+        
+      private:
+        // bits [offset_, offset_ + size_) of words_ are in use, all other bits are false
+        std::vector<Word> words_;
+        size_type offset_;
+        size_type size_;
+        
+        Bitset* parent_;
     };
     
     inline bool operator==(const Bitset& a, const Bitset& b)
@@ -0,0 +1,363 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLBITSTREAM20261018H
+#define DCCLBITSTREAM20261018H
+
+#include <string>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+#include <boost/cstdint.hpp>
+
+#include "bitset.h"
+#include "exception.h"
+
+namespace dccl
+{
+    /// \brief Cursor that writes bits directly into a caller-owned byte buffer.
+    ///
+    /// Bits are written in the same order as Bitset::to_byte_string(): the first bit written is the least significant bit of byte 0, the ninth bit written is the least significant bit of byte 1, and so on. The buffer does not need to be zeroed beforehand; each byte is fully overwritten when the cursor first enters it.
+    class BitWriter
+    {
+      public:
+        /// \brief Construct a writer over the byte range [begin, end)
+        BitWriter(char* begin, char* end)
+            : begin_(reinterpret_cast<unsigned char*>(begin)),
+            capacity_(end - begin),
+            position_(0)
+        { }
+
+        /// \brief Write the \a num_bits least significant bits of \a value. If num_bits is greater than 64, the extra most significant bits are written as zeros.
+        /// \throw std::length_error if the buffer is too small.
+        void write(boost::uint64_t value, std::size_t num_bits)
+        {
+            reserve(num_bits);
+            while(num_bits)
+            {
+                const std::size_t offset = position_ & 7;
+                const std::size_t n = std::min<std::size_t>(8 - offset, num_bits);
+                const unsigned char chunk = static_cast<unsigned char>((value & ((1u << n) - 1)) << offset);
+
+                unsigned char& byte = begin_[position_ >> 3];
+                byte = offset ? (byte | chunk) : chunk;
+
+                value >>= n;
+                position_ += n;
+                num_bits -= n;
+            }
+        }
+
+        /// \brief Write a single bit
+        void write_bit(bool value) { write(value ? 1 : 0, 1); }
+
+        /// \brief Write all the bits of \a bits (lsb first)
+        void write(const Bitset& bits)
+        {
+            reserve(bits.size());
+            for(std::size_t i = 0, n = bits.size(); i < n; i += 64)
+            {
+                const std::size_t num_bits = std::min<std::size_t>(64, n - i);
+                write(bits.get_bits(i, num_bits), num_bits);
+            }
+        }
+
+        /// \brief Write \a num_bytes whole bytes (the cursor does not need to be byte aligned)
+        void write_bytes(const char* data, std::size_t num_bytes)
+        { write_bits(data, num_bytes * 8); }
+
+        /// \brief Write the first \a num_bits bits of a byte array (least significant bit of data[0] first)
+        void write_bits(const char* data, std::size_t num_bits)
+        {
+            reserve(num_bits);
+            const unsigned char* in = reinterpret_cast<const unsigned char*>(data);
+            if((position_ & 7) == 0)
+            {
+                // byte aligned: copy whole bytes, then write the remainder
+                const std::size_t whole_bytes = num_bits >> 3;
+                if(whole_bytes)
+                    std::memcpy(begin_ + (position_ >> 3), in, whole_bytes);
+                position_ += whole_bytes * 8;
+                if(num_bits & 7)
+                    write(in[whole_bytes], num_bits & 7);
+            }
+            else
+            {
+                for(std::size_t i = 0; num_bits; ++i)
+                {
+                    const std::size_t n = std::min<std::size_t>(8, num_bits);
+                    write(in[i], n);
+                    num_bits -= n;
+                }
+            }
+        }
+
+        /// \brief Advance the cursor to the next byte boundary, writing zeros
+        void pad_to_byte()
+        {
+            if(position_ & 7)
+                write(0, 8 - (position_ & 7));
+        }
+
+        /// \brief Number of bits written so far
+        std::size_t size() const { return position_; }
+
+        /// \brief Number of bytes (partially) used so far
+        std::size_t byte_size() const { return (position_ + 7) >> 3; }
+
+        /// \brief Total number of bits that fit in the buffer
+        std::size_t capacity() const { return capacity_ * 8; }
+
+      private:
+        void reserve(std::size_t num_bits) const
+        {
+            if(position_ + num_bits > capacity_ * 8)
+                throw std::length_error("BitWriter: output buffer too small");
+        }
+
+      private:
+        unsigned char* begin_;
+        std::size_t capacity_;
+        std::size_t position_;
+    };
+
+    /// \brief Cursor that reads bits directly from a caller-owned byte buffer, in the same order that BitWriter writes them.
+    ///
+    /// By default, reading more bits than remain throws TruncatedException. If constructed with throw_on_overrun = false, such a read instead returns zeros, moves the cursor to the end and sets overrun(), so that a truncated message can be rejected without the cost of an exception.
+    class BitReader
+    {
+      public:
+        /// \brief Construct a reader over the byte range [begin, end)
+        BitReader(const char* begin, const char* end, bool throw_on_overrun = true)
+            : begin_(reinterpret_cast<const unsigned char*>(begin)),
+            size_((end - begin) * 8),
+            position_(0),
+            throw_on_overrun_(throw_on_overrun),
+            overrun_(false),
+            overrun_position_(0)
+        { }
+
+        /// \brief Read \a num_bits and return them as an integer (first bit read is the lsb). If num_bits is greater than 64, the extra most significant bits are consumed and discarded.
+        /// \throw TruncatedException if there are fewer than num_bits remaining.
+        boost::uint64_t read(std::size_t num_bits)
+        {
+            if(!require(num_bits))
+                return 0;
+            boost::uint64_t value = unchecked_peek(num_bits);
+            position_ += num_bits;
+            return value;
+        }
+
+        /// \brief Read a single bit
+        bool read_bit() { return read(1); }
+
+        /// \brief Same as read() but does not advance the cursor (or set overrun())
+        boost::uint64_t peek(std::size_t num_bits) const
+        {
+            return available(num_bits) ? unchecked_peek(num_bits) : 0;
+        }
+
+        /// \brief Read \a num_bits into \a bits (replacing its contents; bits read first are the least significant)
+        void read(Bitset* bits, std::size_t num_bits)
+        {
+            if(!require(num_bits))
+            {
+                *bits = Bitset(num_bits);
+                return;
+            }
+            peek(bits, num_bits);
+            position_ += num_bits;
+        }
+
+        /// \brief Same as read(Bitset*, std::size_t) but does not advance the cursor (or set overrun())
+        void peek(Bitset* bits, std::size_t num_bits) const
+        {
+            if(!available(num_bits))
+            {
+                *bits = Bitset(num_bits);
+                return;
+            }
+
+            const std::size_t first = position_ >> 3;
+            const std::size_t last = (position_ + num_bits + 7) >> 3;
+            bits->from_byte_stream(begin_ + first, begin_ + last);
+            *bits >>= (position_ & 7);
+            bits->resize(num_bits);
+        }
+
+        /// \brief Read \a num_bytes whole bytes (the cursor does not need to be byte aligned)
+        std::string read_bytes(std::size_t num_bytes)
+        {
+            if(!require(num_bytes * 8))
+                return std::string(num_bytes, 0);
+
+            std::string bytes(num_bytes, 0);
+            if((position_ & 7) == 0)
+            {
+                if(num_bytes)
+                    std::memcpy(&bytes[0], begin_ + (position_ >> 3), num_bytes);
+                position_ += num_bytes * 8;
+            }
+            else
+            {
+                for(std::size_t i = 0; i < num_bytes; ++i)
+                    bytes[i] = static_cast<char>(read(8));
+            }
+            return bytes;
+        }
+
+        /// \brief Advance the cursor by \a num_bits
+        void skip(std::size_t num_bits)
+        {
+            if(require(num_bits))
+                position_ += num_bits;
+        }
+
+        /// \brief Number of bits consumed so far
+        std::size_t position() const { return position_; }
+
+        /// \brief Number of bits left to read
+        std::size_t remaining() const { return size_ - position_; }
+
+        /// \brief True if a read needed more bits than remained (only if constructed with throw_on_overrun = false)
+        bool overrun() const { return overrun_; }
+
+        /// \brief Position() at the start of the first read that overran
+        std::size_t overrun_position() const { return overrun_position_; }
+
+      private:
+        boost::uint64_t unchecked_peek(std::size_t num_bits) const
+        {
+            boost::uint64_t value = 0;
+            std::size_t pos = position_;
+            std::size_t shift = 0;
+            const std::size_t value_bits = std::min<std::size_t>(num_bits, 64);
+            while(shift < value_bits)
+            {
+                const std::size_t offset = pos & 7;
+                const std::size_t n = std::min<std::size_t>(8 - offset, value_bits - shift);
+                const boost::uint64_t chunk = (begin_[pos >> 3] >> offset) & ((1u << n) - 1);
+                value |= chunk << shift;
+                shift += n;
+                pos += n;
+            }
+            return value;
+        }
+
+        bool available(std::size_t num_bits) const
+        {
+            if(num_bits <= remaining())
+                return true;
+            if(throw_on_overrun_)
+                throw(dccl::TruncatedException("Cannot read more bits than remain in the buffer"));
+            return false;
+        }
+
+        // true if num_bits can be read; otherwise throws, or marks the overrun and moves to the end
+        bool require(std::size_t num_bits)
+        {
+            if(available(num_bits))
+                return true;
+            if(!overrun_)
+            {
+                overrun_ = true;
+                overrun_position_ = position_;
+            }
+            position_ = size_;
+            return false;
+        }
+
+      private:
+        const unsigned char* begin_;
+        std::size_t size_;
+        std::size_t position_;
+        bool throw_on_overrun_;
+        bool overrun_;
+        std::size_t overrun_position_;
+    };
+
+    namespace internal
+    {
+        /// \brief Presents the front of a BitReader as a Bitset hierarchy, so that codecs that only implement the Bitset interface can be used from the BitReader path.
+        ///
+        /// Up to \a max_bits are made available to bits() through get_more_bits(); on destruction the reader is advanced by the number of bits that were actually consumed.
+        class BitReaderBitset
+        {
+          public:
+            BitReaderBitset(BitReader* reader, std::size_t max_bits, std::size_t min_bits)
+                : reader_(reader),
+                pool_(),
+                bits_(&pool_)
+            {
+                reader_->peek(&pool_, std::min(max_bits, reader_->remaining()));
+                available_ = pool_.size();
+                bits_.get_more_bits(min_bits);
+            }
+
+            ~BitReaderBitset()
+            {
+                reader_->skip(available_ - pool_.size());
+            }
+
+            Bitset* bits() { return &bits_; }
+
+          private:
+            BitReaderBitset(const BitReaderBitset&);
+            BitReaderBitset& operator=(const BitReaderBitset&);
+
+            BitReader* reader_;
+            Bitset pool_;
+            Bitset bits_;
+            std::size_t available_;
+        };
+
+        /// \brief Reads bits from the front of a Bitset like a BitReader, pulling more from its parent (see Bitset::get_more_bits()) as needed. The reverse of BitReaderBitset: codecs can implement decoding once for either kind of source.
+        class BitsetSource
+        {
+          public:
+            explicit BitsetSource(Bitset* bits) : bits_(bits), position_(0) { }
+
+            boost::uint64_t read(std::size_t num_bits)
+            {
+                if(position_ + num_bits > bits_->size())
+                    bits_->get_more_bits(position_ + num_bits - bits_->size());
+
+                // as in BitReader::read(), bits past the first 64 are consumed and discarded
+                boost::uint64_t value = bits_->get_bits(position_, std::min<std::size_t>(num_bits, 64));
+                position_ += num_bits;
+                return value;
+            }
+
+            std::size_t position() const { return position_; }
+
+            // get_more_bits() throws rather than overrunning
+            bool overrun() const { return false; }
+
+          private:
+            Bitset* bits_;
+            std::size_t position_;
+        };
+    }
+}
+
+#endif
@@ -43,7 +43,10 @@
 #include "dccl/codecs3/field_codec_default.h"
 #include "dccl/codecs3/field_codec_var_bytes.h"
 #include "dccl/codecs3/field_codec_presence.h"
+#include "dccl/codecs3/field_codec_compiled_message.h"
 #include "dccl/field_codec_id.h"
+#include "dccl/internal/stats_recorder.h"
+#include "dccl/internal/field_profile.h"
 
 #include "dccl/option_extensions.pb.h"
 
@@ -58,6 +61,51 @@ using google::protobuf::FieldDescriptor;
 using google::protobuf::Descriptor;
 using google::protobuf::Reflection;
 
+#if DCCL_HAS_CRYPTOPP
+namespace dccl
+{
+    namespace internal
+    {
+        /// \brief AES-CTR over a caller's buffer with a key schedule that is computed once per passphrase.
+        ///
+        /// Produces the same output as CryptoPP::CTR_Mode<AES> keyed with the SHA256 hash of the passphrase and the (first block of the) SHA256 hash of the nonce as the IV, but without constructing a cipher or filter pipeline per message. apply() does not modify the object, so it is safe to call from multiple threads.
+        class AESCounterCipher
+        {
+          public:
+            AESCounterCipher(const std::string& key)
+                : aes_(reinterpret_cast<const unsigned char*>(key.data()), key.size())
+            { }
+
+            void apply(char* data, std::size_t len, const char* nonce, std::size_t nonce_len) const
+            {
+                using namespace CryptoPP;
+
+                byte digest[SHA256::DIGESTSIZE];
+                SHA256().CalculateDigest(digest, reinterpret_cast<const byte*>(nonce), nonce_len);
+
+                byte counter[AES::BLOCKSIZE];
+                std::memcpy(counter, digest, AES::BLOCKSIZE);
+
+                byte keystream[AES::BLOCKSIZE];
+                byte* out = reinterpret_cast<byte*>(data);
+                for(std::size_t offset = 0; offset < len; offset += AES::BLOCKSIZE)
+                {
+                    aes_.ProcessBlock(counter, keystream);
+                    const std::size_t n = std::min<std::size_t>(AES::BLOCKSIZE, len - offset);
+                    for(std::size_t i = 0; i < n; ++i)
+                        out[offset + i] ^= keystream[i];
+                    // big-endian increment of the whole block, as CTR_Mode does
+                    IncrementCounterByOne(counter, AES::BLOCKSIZE);
+                }
+            }
+
+          private:
+            CryptoPP::AES::Encryption aes_;
+        };
+    }
+}
+#endif // HAS_CRYPTOPP
+
 const unsigned full_width = 60;
 
 
@@ -66,7 +114,9 @@ const unsigned full_width = 60;
 //
 
 dccl::Codec::Codec(const std::string& dccl_id_codec, const std::string& library_path)
-    : strict_(false), id_codec_(dccl_id_codec)
+    : strict_(false),
+      schema_(new Schema(dccl_id_codec, dccl_id_codec == default_id_codec_name())),
+      profiler_(0)
 {
     set_default_codecs();
     FieldCodecManager::add<DefaultIdentifierCodec>(default_id_codec_name());
@@ -77,6 +127,26 @@ dccl::Codec::Codec(const std::string& dccl_id_codec, const std::string& library_
     id_codec();
 }
 
+dccl::Codec::Codec(boost::shared_ptr<const Schema> schema)
+    : strict_(false),
+      schema_(schema),
+      profiler_(0)
+{
+    if(!schema_)
+        throw(Exception("Codec constructed with a null Schema"));
+
+    set_default_codecs();
+    FieldCodecManager::add<DefaultIdentifierCodec>(default_id_codec_name());
+    id_codec();
+}
+
+dccl::Schema& dccl::Codec::mutable_schema()
+{
+    if(!schema_.unique())
+        schema_.reset(new Schema(*schema_));
+    return const_cast<Schema&>(*schema_);
+}
+
 dccl::Codec::~Codec()
 {
     for(std::vector<void *>::iterator it = dl_handles_.begin(),
@@ -160,12 +230,14 @@ void dccl::Codec::set_default_codecs()
         FieldCodecManager::add<v2::StaticCodec<uint32> >("_static");
         FieldCodecManager::add<v2::StaticCodec<uint64> >("_static");
 
+        // message codecs compiled by protoc-gen-dccl take precedence over the defaults loaded above
+        internal::CompiledCodecRegistry::load();
 
         defaults_loaded = true;
     }
 }
 
-void dccl::Codec::encode_internal(const google::protobuf::Message& msg, bool header_only, Bitset& head_bits, Bitset& body_bits, int user_id)
+bool dccl::Codec::encode_internal(const google::protobuf::Message& msg, bool header_only, BitWriter* writer, std::size_t* head_byte_size, int user_id, Status* status, internal::StatsSample* sample, const EncodeTarget* target)
 {
     const Descriptor* desc = msg.GetDescriptor();
 
@@ -173,32 +245,55 @@ void dccl::Codec::encode_internal(const google::protobuf::Message& msg, bool hea
 
     try
     {
-        unsigned dccl_id = (user_id < 0) ? id(desc) : user_id;
-        size_t head_byte_size = 0;
+        unsigned dccl_id = target ? target->dccl_id : ((user_id < 0) ? id(desc) : user_id);
+        if(status)
+            status->dccl_id_ = dccl_id;
+        if(sample)
+            sample->set_id(dccl_id);
 
         if(!msg.IsInitialized() && !header_only)
+        {
+            if(status)
+                return status->fail(STATUS_NOT_INITIALIZED, 0);
+            if(sample)
+                sample->failure = STATUS_NOT_INITIALIZED;
             throw(Exception("Message is not properly initialized. All `required` fields must be set."));
+        }
 
-        if(!id2desc_.count(dccl_id))
+        if(!loaded_descriptor(dccl_id))
+        {
+            if(status)
+                return status->fail(STATUS_UNKNOWN_ID, 0);
+            if(sample)
+                sample->failure = STATUS_UNKNOWN_ID;
             throw(Exception("Message id " + boost::lexical_cast<std::string>(dccl_id) + " has not been loaded. Call load() before encoding this type."));
+        }
 
 
-
-        boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
-        boost::shared_ptr<internal::FromProtoCppTypeBase> helper = internal::TypeHelper::find(desc);
+        boost::shared_ptr<FieldCodecBase> found_codec;
+        FieldCodecBase* codec = target ? target->codec.get() : (found_codec = FieldCodecManager::find(desc)).get();
 
         if(codec)
         {
+            // state for this call only, so that encoding is reentrant and thread-safe
+            internal::TraversalScope traversal;
+            internal::TraversalContext::current()->codec_context = codec_context_.get();
+            if(status)
+                internal::TraversalContext::current()->error_field = &status->field_path_;
+            internal::FieldProfileSampler profile(profiler_, false);
+
             //fixed header
-            id_codec()->field_encode(&head_bits, dccl_id, 0);
+            id_codec()->field_encode(writer, dccl_id, 0);
 
             internal::MessageStack msg_stack;
             msg_stack.push(msg.GetDescriptor());
-            codec->base_encode(&head_bits, msg, HEAD, strict_);
+            codec->base_encode(writer, msg, HEAD, strict_);
 
             // given header of not even byte size (e.g. 01011), make even byte size (e.g. 00001011)
-            head_byte_size = ceil_bits2bytes(head_bits.size());
-            head_bits.resize(head_byte_size * BITS_IN_BYTE);
+            if(sample)
+                sample->padding_bits = writer->byte_size() * BITS_IN_BYTE - writer->size();
+            writer->pad_to_byte();
+            *head_byte_size = writer->byte_size();
 
             if(header_only)
             {
@@ -206,22 +301,45 @@ void dccl::Codec::encode_internal(const google::protobuf::Message& msg, bool hea
             }
             else
             {
-                codec->base_encode(&body_bits, msg, BODY, strict_);
+                codec->base_encode(writer, msg, BODY, strict_);
             }
         }
         else
         {
+            if(status)
+                return status->fail(STATUS_NO_CODEC, 0);
+            if(sample)
+                sample->failure = STATUS_NO_CODEC;
             throw(Exception("Failed to find (dccl.msg).codec `" + desc->options().GetExtension(dccl::msg).codec() + "`"));
         }
 
     }
     catch(dccl::OutOfRangeException& e)
     {
+        if(status)
+        {
+            if(status->field_path_.empty() && e.field())
+                status->field_path_.push_back(e.field());
+            return status->fail(STATUS_OUT_OF_RANGE, writer->size());
+        }
         dlog.is(DEBUG1, ENCODE) && dlog << "Message " << desc->full_name() << " failed to encode because a field was out of bounds and strict == true: " << e.what() << std::endl;
         throw;
     }
+    catch(std::length_error& e)
+    {
+        if(status)
+            return status->fail(STATUS_BUFFER_TOO_SMALL, writer->size());
+        dlog.is(DEBUG1, ENCODE) && dlog << "Message " << desc->full_name() << " failed to encode because the output buffer is too small: " << e.what() << std::endl;
+        throw;
+    }
     catch(std::exception& e)
     {
+        if(status)
+        {
+            status->detail_ = e.what();
+            return status->fail(STATUS_CODEC_ERROR, writer->size());
+        }
+
         std::stringstream ss;
 
         ss << "Message " << desc->full_name() << " failed to encode. Reason: " << e.what();
@@ -229,46 +347,69 @@ void dccl::Codec::encode_internal(const google::protobuf::Message& msg, bool hea
         dlog.is(DEBUG1, ENCODE) && dlog << ss.str() << std::endl;
         throw(Exception(ss.str()));
     }
+    return true;
 }
 
-size_t dccl::Codec::encode(char* bytes, size_t max_len, const google::protobuf::Message& msg, bool header_only /* = false */, int user_id /* = -1 */)
+bool dccl::Codec::encode_bytes(char* bytes, size_t max_len, const google::protobuf::Message& msg, bool header_only, int user_id, size_t* len, Status* status, const EncodeTarget* target /* = 0 */)
 {
-    const Descriptor* desc = msg.GetDescriptor();
-    Bitset head_bits;
-    Bitset body_bits;
-    encode_internal(msg, header_only, head_bits, body_bits, user_id);
+    if(!stats_)
+        return encode_frame(bytes, max_len, msg, header_only, user_id, len, status, 0, target);
 
-    size_t head_byte_size = ceil_bits2bytes(head_bits.size());
-    if (max_len < head_byte_size)
+    internal::StatsSample sample(internal::StatsSample::ENCODE);
+    try
     {
-        throw std::length_error("max_len must be >= head_byte_size");
+        bool ok = encode_frame(bytes, max_len, msg, header_only, user_id, len, status, &sample, target);
+        stats_->record(sample, ok ? STATUS_OK : status->code());
+        return ok;
     }
-    head_bits.to_byte_string(bytes, head_byte_size);
+    catch(std::exception& e)
+    {
+        stats_->record(sample, sample.failure != STATUS_OK ? sample.failure : internal::StatsRecorder::failure_code(e));
+        throw;
+    }
+}
 
-    dlog.is(DEBUG2, ENCODE) && dlog << "Head bytes (bits): " << head_byte_size << "(" << head_bits.size() << ")" << std::endl;
-    dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Head (bin): " << head_bits << std::endl;
+bool dccl::Codec::encode_frame(char* bytes, size_t max_len, const google::protobuf::Message& msg, bool header_only, int user_id, size_t* len, Status* status, internal::StatsSample* sample, const EncodeTarget* target)
+{
+    const Descriptor* desc = msg.GetDescriptor();
+
+    // fields are encoded directly into `bytes`, with no intermediate Bitset
+    BitWriter writer(bytes, bytes + max_len);
+    size_t head_byte_size = 0;
+    if(!encode_internal(msg, header_only, &writer, &head_byte_size, user_id, status, sample, target))
+        return false;
+
+    dlog.is(DEBUG2, ENCODE) && dlog << "Head bytes: " << head_byte_size << std::endl;
     dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Head (hex): " << hex_encode(bytes, bytes+head_byte_size) << std::endl;
 
     size_t body_byte_size = 0;
     if (!header_only)
     {
-        body_byte_size = ceil_bits2bytes(body_bits.size());
-        if (max_len < (head_byte_size + body_byte_size))
-        {
-            throw std::length_error("max_len must be >= (head_byte_size + body_byte_size)");
-        }
-        body_bits.to_byte_string(bytes+head_byte_size, max_len-head_byte_size);
+        body_byte_size = writer.byte_size() - head_byte_size;
+        if(sample)
+            sample->padding_bits += writer.byte_size() * BITS_IN_BYTE - writer.size();
 
-        dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Body (bin): " << body_bits << std::endl;
         dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Body (hex): " << hex_encode(bytes+head_byte_size, bytes+head_byte_size+body_byte_size) << std::endl;
-        dlog.is(DEBUG2, ENCODE) && dlog << "Body bytes (bits): " <<  body_byte_size << "(" << body_bits.size() << ")" <<  std::endl;
+        dlog.is(DEBUG2, ENCODE) && dlog << "Body bytes (bits): " <<  body_byte_size << "(" << writer.size() - head_byte_size*BITS_IN_BYTE << ")" <<  std::endl;
 
-        unsigned dccl_id = (user_id < 0) ? id(desc) : user_id;
-        if(!crypto_key_.empty() && !skip_crypto_ids_.count(dccl_id)) {
-            std::string head_bytes(bytes, bytes+head_byte_size);
-            std::string body_bytes(bytes+head_byte_size, bytes+head_byte_size+body_byte_size);
-            encrypt(&body_bytes, head_bytes);
-            std::memcpy(bytes+head_byte_size, body_bytes.data(), body_bytes.size());
+        bool encrypt_body = false;
+        if(target)
+        {
+            encrypt_body = target->encrypt;
+        }
+        else
+        {
+            unsigned dccl_id = (user_id < 0) ? id(desc) : user_id;
+            encrypt_body = !crypto_key_.empty() && !skip_crypto_ids_.count(dccl_id);
+        }
+
+        if(encrypt_body)
+        {
+            if(sample)
+                sample->start_crypto();
+            encrypt(bytes+head_byte_size, body_byte_size, bytes, head_byte_size);
+            if(sample)
+                sample->stop_crypto();
         }
 
         dlog.is(logger::DEBUG3, logger::ENCODE) && dlog << "Encrypted Body (hex): " << hex_encode(bytes+head_byte_size, bytes+head_byte_size+body_byte_size) << std::endl;
@@ -276,67 +417,542 @@ size_t dccl::Codec::encode(char* bytes, size_t max_len, const google::protobuf::
 
     dlog.is(DEBUG1, ENCODE) && dlog << "Successfully encoded message of type: " << desc->full_name() << std::endl;
 
-    return head_byte_size + body_byte_size;
+    *len = head_byte_size + body_byte_size;
+    if(sample)
+        sample->bytes = *len;
+    return true;
+}
+
+size_t dccl::Codec::encode(char* bytes, size_t max_len, const google::protobuf::Message& msg, bool header_only /* = false */, int user_id /* = -1 */)
+{
+    size_t len = 0;
+    encode_bytes(bytes, max_len, msg, header_only, user_id, &len, 0);
+    return len;
 }
 
 
 void dccl::Codec::encode(std::string* bytes, const google::protobuf::Message& msg, bool header_only /* = false */, int user_id /* = -1 */)
 {
-    const Descriptor* desc = msg.GetDescriptor();
-    Bitset head_bits;
-    Bitset body_bits;
-    encode_internal(msg, header_only, head_bits, body_bits, user_id);
+    // (dccl.msg).max_bytes is checked by load() to be an upper bound on the encoded size,
+    // so we can encode straight into the end of `bytes`
+    const std::string::size_type start = bytes->size();
+    const std::string::size_type max_len = msg.GetDescriptor()->options().GetExtension(dccl::msg).max_bytes();
 
-    std::string head_bytes = head_bits.to_byte_string();
+    bytes->resize(start + max_len);
+    try
+    {
+        size_t len = encode(max_len ? &(*bytes)[start] : 0, max_len, msg, header_only, user_id);
+        bytes->resize(start + len);
+    }
+    catch(...)
+    {
+        bytes->resize(start);
+        throw;
+    }
+}
 
-    dlog.is(DEBUG2, ENCODE) && dlog << "Head bytes (bits): " << head_bytes.size() << "(" << head_bits.size() << ")" << std::endl;
-    dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Head (bin): " << head_bits << std::endl;
-    dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Head (hex): " << hex_encode(head_bytes) << std::endl;
+dccl::StatusCode dccl::Codec::try_encode(char* bytes, size_t max_len, const google::protobuf::Message& msg, size_t* len, Status* status /* = 0 */, bool header_only /* = false */, int user_id /* = -1 */)
+{
+    Status local_status;
+    if(!status)
+        status = &local_status;
+    status->reset();
 
-    std::string body_bytes;
-    if (!header_only)
-    {
-        body_bytes = body_bits.to_byte_string();
+    encode_bytes(bytes, max_len, msg, header_only, user_id, len, status);
+    return status->code();
+}
 
-        dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Body (bin): " << body_bits << std::endl;
-        dlog.is(DEBUG3, ENCODE) && dlog << "Unencrypted Body (hex): " << hex_encode(body_bytes) << std::endl;
-        dlog.is(DEBUG2, ENCODE) && dlog << "Body bytes (bits): " <<  body_bytes.size() << "(" << body_bits.size() << ")" <<  std::endl;
+dccl::StatusCode dccl::Codec::try_encode(std::string* bytes, const google::protobuf::Message& msg, Status* status /* = 0 */, bool header_only /* = false */, int user_id /* = -1 */)
+{
+    const std::string::size_type start = bytes->size();
+    const std::string::size_type max_len = msg.GetDescriptor()->options().GetExtension(dccl::msg).max_bytes();
+
+    bytes->resize(start + max_len);
+    size_t len = 0;
+    StatusCode code = try_encode(max_len ? &(*bytes)[start] : 0, max_len, msg, &len, status, header_only, user_id);
+    bytes->resize(code == STATUS_OK ? start + len : start);
+    return code;
+}
 
-        unsigned dccl_id = (user_id < 0) ? id(desc) : user_id;
-        if(!crypto_key_.empty() && !skip_crypto_ids_.count(dccl_id))
-            encrypt(&body_bytes, head_bytes);
+unsigned dccl::Codec::id(const std::string& bytes) const
+{
+    return id(bytes.data(), bytes.data() + bytes.size());
+}
+
+unsigned dccl::Codec::id(const char* begin, const char* end) const
+{
+    unsigned dccl_id = 0;
+    if(!peek_id(begin, end, &dccl_id))
+        throw(Exception("Bytes passed (hex: " + hex_encode(begin, end) + ") is too small to be a valid DCCL message"));
+    return dccl_id;
+}
 
-        dlog.is(logger::DEBUG3, logger::ENCODE) && dlog << "Encrypted Body (hex): " << hex_encode(body_bytes) << std::endl;
+unsigned dccl::Codec::id(const google::protobuf::Descriptor* desc) const
+{
+    dccl::uint32 hardcoded_id = desc->options().GetExtension(dccl::msg).id();
+
+    // the default id codec decodes every id it can encode unchanged
+    if(schema_->default_id_codec_ && hardcoded_id <= DefaultIdentifierCodec::max_id())
+        return hardcoded_id;
+
+    // pass the hard coded id, that is, (dccl.msg).id,
+    // through encode/decode to allow a custom ID codec (if in use)
+    // to always take effect.
+    Bitset id_bits;
+    id_codec()->field_encode(&id_bits, hardcoded_id, 0);
+    std::string id_bytes(id_bits.to_byte_string());
+    return id(id_bytes);
+}
+
+bool dccl::Codec::peek_id(const char* begin, const char* end, unsigned* dccl_id) const
+{
+    if(schema_->default_id_codec_)
+    {
+        uint32 peeked_id = 0;
+        if(!DefaultIdentifierCodec::peek(begin, end, &peeked_id))
+            return false;
+        *dccl_id = peeked_id;
+        return true;
     }
 
-    dlog.is(DEBUG1, ENCODE) && dlog << "Successfully encoded message of type: " << desc->full_name() << std::endl;
-    *bytes += head_bytes + body_bytes;
+    unsigned id_min_size = 0, id_max_size = 0;
+    id_bit_bounds(&id_min_size, &id_max_size);
+
+    if(end - begin < static_cast<std::ptrdiff_t>(id_min_size / BITS_IN_BYTE))
+        return false;
+
+    // read no further than the largest possible id, nor past the end of the buffer
+    const char* id_end = std::min(end, begin + ceil_bits2bytes(id_max_size));
+    BitReader reader(begin, id_end);
+
+    boost::any return_value;
+    id_codec()->field_decode(&reader, &return_value, 0);
+
+    *dccl_id = boost::any_cast<uint32>(return_value);
+    return true;
 }
 
-unsigned dccl::Codec::id(const std::string& bytes) const
+const google::protobuf::Descriptor* dccl::Codec::loaded_descriptor(const char* begin, const char* end) const
+{
+    const unsigned this_id = id(begin, end);
+    const google::protobuf::Descriptor* desc = loaded_descriptor(this_id);
+    if(!desc)
+        throw(Exception("Message id " + boost::lexical_cast<std::string>(this_id) + " has not been loaded. Call load() before decoding this type."));
+    return desc;
+}
+
+bool dccl::Codec::dispatch(const char* begin, const char* end) const
 {
-    return id(bytes.begin(), bytes.end());
+    const unsigned dccl_id = id(begin, end);
+    const FrameHandler& handler = handlers_.get(dccl_id);
+    if(!handler)
+        return false;
+
+    handler(dccl_id, begin, end);
+    return true;
 }
 
 
 void dccl::Codec::decode(std::string* bytes, google::protobuf::Message* msg)
 {
-    decode(*bytes, msg);
-    unsigned last_size = size(*msg);
-    bytes->erase(0, last_size);
+    std::string scratch;
+    std::size_t consumed = decode_internal(bytes->data(), bytes->data() + bytes->size(), msg, false, &scratch);
+    bytes->erase(0, consumed);
+}
+
+void dccl::Codec::decode(const char* data, std::size_t len, google::protobuf::Message* msg, std::size_t* consumed, bool header_only /* = false */)
+{
+    std::string scratch;
+    std::size_t used = decode_internal(data, data + len, msg, header_only, &scratch);
+    if(consumed)
+        *consumed = used;
 }
 
 void dccl::Codec::decode(const std::string& bytes, google::protobuf::Message* msg, bool header_only /* = false */)
 {
-    decode(bytes.begin(), bytes.end(), msg, header_only);
+    std::string scratch;
+    decode_internal(bytes.data(), bytes.data() + bytes.size(), msg, header_only, &scratch);
+}
+
+dccl::StatusCode dccl::Codec::try_decode(const std::string& bytes, google::protobuf::Message* msg, Status* status /* = 0 */, bool header_only /* = false */)
+{
+    return try_decode(bytes.data(), bytes.size(), msg, 0, status, header_only);
+}
+
+dccl::StatusCode dccl::Codec::try_decode(const char* data, std::size_t len, google::protobuf::Message* msg, std::size_t* consumed, Status* status /* = 0 */, bool header_only /* = false */)
+{
+    Status local_status;
+    if(!status)
+        status = &local_status;
+    status->reset();
+
+    std::string scratch;
+    std::size_t used = decode_internal(data, data + len, msg, header_only, &scratch, status);
+    if(status->ok() && consumed)
+        *consumed = used;
+    return status->code();
+}
+
+std::size_t dccl::Codec::decode_internal(const char* begin, const char* end, google::protobuf::Message* msg, bool header_only, std::string* scratch, Status* status /* = 0 */)
+{
+    if(!stats_)
+        return decode_frame(begin, end, msg, header_only, scratch, status, 0);
+
+    internal::StatsSample sample(internal::StatsSample::DECODE);
+    try
+    {
+        std::size_t consumed = decode_frame(begin, end, msg, header_only, scratch, status, &sample);
+        stats_->record(sample, status ? status->code() : STATUS_OK);
+        return consumed;
+    }
+    catch(std::exception& e)
+    {
+        stats_->record(sample, sample.failure != STATUS_OK ? sample.failure : internal::StatsRecorder::failure_code(e));
+        throw;
+    }
+}
+
+std::size_t dccl::Codec::decode_frame(const char* begin, const char* end, google::protobuf::Message* msg, bool header_only, std::string* scratch, Status* status, internal::StatsSample* sample)
+{
+    // the reader currently in use and its offset (in bits) from the start of the message, so that the position of a failure is known
+    BitReader reader(begin, begin);
+    std::size_t reader_offset = 0;
+
+    try
+    {
+        unsigned this_id = 0;
+        if(!peek_id(begin, end, &this_id))
+        {
+            if(status)
+            {
+                status->fail(STATUS_TOO_SHORT, 0);
+                return 0;
+            }
+            if(sample)
+                sample->failure = STATUS_TOO_SHORT;
+            throw(Exception("Bytes passed (hex: " + hex_encode(begin, end) + ") is too small to be a valid DCCL message"));
+        }
+        if(status)
+            status->dccl_id_ = this_id;
+        if(sample)
+            sample->set_id(this_id);
+
+        dlog.is(DEBUG1, DECODE) && dlog  << "Began decoding message of id: " << this_id << std::endl;
+
+        if(!loaded_descriptor(this_id))
+        {
+            if(status)
+            {
+                status->fail(STATUS_UNKNOWN_ID, 0);
+                return 0;
+            }
+            if(sample)
+                sample->failure = STATUS_UNKNOWN_ID;
+            throw(Exception("Message id " + boost::lexical_cast<std::string>(this_id) + " has not been loaded. Call load() before decoding this type."));
+        }
+
+        const Descriptor* desc = msg->GetDescriptor();
+
+        dlog.is(DEBUG1, DECODE) && dlog  << "Type name: " << desc->full_name() << std::endl;
+
+        boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
+
+        if(!codec)
+        {
+            if(status)
+            {
+                status->fail(STATUS_NO_CODEC, 0);
+                return 0;
+            }
+            if(sample)
+                sample->failure = STATUS_NO_CODEC;
+            throw(Exception("Failed to find (dccl.msg).codec `" + desc->options().GetExtension(dccl::msg).codec() + "`"));
+        }
+
+        MessageBitSizes sizes;
+        message_bit_sizes(desc, &sizes);
+        unsigned id_size = id_bits(this_id);
+        unsigned head_size_bits = sizes.head_max + id_size;
+        unsigned body_size_bits = sizes.body_max;
+
+        unsigned head_size_bytes = ceil_bits2bytes(head_size_bits);
+        unsigned body_size_bytes = ceil_bits2bytes(body_size_bits);
+
+        dlog.is(DEBUG2, DECODE) && dlog  << "Head bytes (bits): " << head_size_bytes << "(" << head_size_bits
+                                         << "), max body bytes (bits): " << body_size_bytes << "(" << body_size_bits << ")" <<  std::endl;
+
+        if(end - begin < static_cast<std::ptrdiff_t>(head_size_bytes))
+        {
+            if(status)
+            {
+                status->fail(STATUS_TOO_SHORT, (end - begin) * BITS_IN_BYTE);
+                return 0;
+            }
+            if(sample)
+                sample->failure = STATUS_TOO_SHORT;
+            throw(Exception("Bytes passed are too small to contain the message header"));
+        }
+
+        const char* head_bytes_end = begin + head_size_bytes;
+        dlog.is(DEBUG3, DECODE) && dlog  << "Unencrypted Head (hex): " << hex_encode(begin, head_bytes_end) << std::endl;
+
+        // in try_decode() mode, running out of bits is reported through reader.overrun() rather than thrown
+        reader = BitReader(begin, head_bytes_end, status == 0);
+
+        // skip over ID bits
+        reader.skip(id_size);
+
+        // state for this call only, so that decoding is reentrant and thread-safe
+        internal::TraversalScope traversal;
+        internal::TraversalContext::current()->codec_context = codec_context_.get();
+        if(status)
+            internal::TraversalContext::current()->error_field = &status->field_path_;
+        internal::FieldProfileSampler profile(profiler_, true);
+        internal::MessageStack msg_stack;
+        msg_stack.push(desc);
+
+        codec->base_decode(&reader, msg, HEAD);
+        if(reader.overrun())
+        {
+            status->fail(STATUS_TRUNCATED, reader_offset + reader.overrun_position());
+            return 0;
+        }
+        dlog.is(DEBUG2, DECODE) && dlog  << "after header decode, message is: " << *msg << std::endl;
+
+        std::size_t consumed = head_size_bytes;
+        if(header_only)
+        {
+            dlog.is(DEBUG2, DECODE) && dlog  << "as requested, skipping decrypting and decoding body." << std::endl;
+        }
+        else
+        {
+            // a body shorter than the smallest possible is certain to run out of bits
+            if(status && (end - head_bytes_end) * BITS_IN_BYTE < static_cast<std::ptrdiff_t>(sizes.body_min))
+            {
+                status->fail(STATUS_TRUNCATED, (end - begin) * BITS_IN_BYTE);
+                return 0;
+            }
+
+            // the body can be no longer than body_size_bytes; anything after that belongs to the next frame
+            const char* frame_end = head_bytes_end + std::min<std::ptrdiff_t>(end - head_bytes_end, body_size_bytes);
+
+            dlog.is(DEBUG3, DECODE) && dlog  << "Encrypted Body (hex): " << hex_encode(head_bytes_end, frame_end) << std::endl;
+
+            const char* body_begin = head_bytes_end;
+            const char* body_end = frame_end;
+            if(!crypto_key_.empty() && !skip_crypto_ids_.count(this_id))
+            {
+                scratch->assign(head_bytes_end, frame_end);
+                if(sample)
+                    sample->start_crypto();
+                if(!scratch->empty())
+                    decrypt(&(*scratch)[0], scratch->size(), begin, head_size_bytes);
+                if(sample)
+                    sample->stop_crypto();
+                body_begin = scratch->data();
+                body_end = scratch->data() + scratch->size();
+            }
+
+            dlog.is(DEBUG3, DECODE) && dlog  << "Unencrypted Body (hex): " << hex_encode(body_begin, body_end) << std::endl;
+
+            reader = BitReader(body_begin, body_end, status == 0);
+            reader_offset = head_size_bytes * BITS_IN_BYTE;
+            codec->base_decode(&reader, msg, BODY);
+            if(reader.overrun())
+            {
+                status->fail(STATUS_TRUNCATED, reader_offset + reader.overrun_position());
+                return 0;
+            }
+            dlog.is(DEBUG2, DECODE) && dlog  << "after header & body decode, message is: " << *msg << std::endl;
+
+            consumed = (frame_end - begin) - reader.remaining()/BITS_IN_BYTE;
+        }
+
+        dlog.is(DEBUG1, DECODE) && dlog  << "Successfully decoded message of type: " << desc->full_name() << std::endl;
+        if(sample)
+            sample->bytes = consumed;
+        return consumed;
+    }
+    catch(std::exception& e)
+    {
+        if(status)
+        {
+            if(reader.overrun())
+            {
+                // a codec failed on the zeros read past the end
+                status->fail(STATUS_TRUNCATED, reader_offset + reader.overrun_position());
+                return 0;
+            }
+            if(dynamic_cast<TruncatedException*>(&e))
+            {
+                status->fail(STATUS_TRUNCATED, reader_offset + reader.position());
+                return 0;
+            }
+
+            status->detail_ = e.what();
+            status->fail(STATUS_CODEC_ERROR, reader_offset + reader.position());
+            return 0;
+        }
+
+        if(sample && sample->failure == STATUS_OK)
+            sample->failure = internal::StatsRecorder::failure_code(e);
+
+        std::stringstream ss;
+
+        ss << "Message " << hex_encode(begin, end) <<  " failed to decode. Reason: " << e.what() << std::endl;
+
+        dlog.is(DEBUG1, DECODE) && dlog << ss.str() << std::endl;
+        throw(Exception(ss.str()));
+    }
+}
+
+void dccl::Codec::set_stats_enabled(bool enabled)
+{
+    if(!enabled)
+    {
+        stats_.reset();
+        return;
+    }
+    if(stats_)
+        return;
+
+    stats_.reset(new internal::StatsRecorder);
+    for(std::map<int32, const google::protobuf::Descriptor*>::const_iterator it = schema_->id2desc_.begin(), end = schema_->id2desc_.end(); it != end; ++it)
+        stats_->add(it->first, it->second);
+}
+
+dccl::CodecStats dccl::Codec::stats() const
+{
+    CodecStats stats;
+    if(stats_)
+        stats_->snapshot(&stats);
+    return stats;
+}
+
+void dccl::Codec::reset_stats()
+{
+    if(stats_)
+        stats_->reset();
+}
+
+void dccl::Codec::encode_batch(std::vector<std::string>* frames, const std::vector<const google::protobuf::Message*>& msgs, bool header_only /* = false */, int user_id /* = -1 */)
+{
+    // the id, message codec and encryption are resolved once for each run of messages of the same type
+    EncodeTarget target;
+    const Descriptor* target_desc = 0;
+    std::size_t max_len = 0;
+
+    frames->reserve(frames->size() + msgs.size());
+    for(std::vector<const google::protobuf::Message*>::const_iterator it = msgs.begin(), end = msgs.end(); it != end; ++it)
+    {
+        const google::protobuf::Message& msg = **it;
+        const Descriptor* desc = msg.GetDescriptor();
+
+        if(desc != target_desc)
+        {
+            target.dccl_id = (user_id < 0) ? id(desc) : user_id;
+            target.codec = FieldCodecManager::find(desc);
+            target.encrypt = !crypto_key_.empty() && !skip_crypto_ids_.count(target.dccl_id);
+            max_len = desc->options().GetExtension(dccl::msg).max_bytes();
+            target_desc = desc;
+        }
+
+        // encoded straight into the new frame, as by encode(std::string*, ...)
+        frames->push_back(std::string());
+        std::string& frame = frames->back();
+        frame.resize(max_len);
+        size_t len = 0;
+        try
+        {
+            encode_bytes(max_len ? &frame[0] : 0, max_len, msg, header_only, target.dccl_id, &len, 0, &target);
+        }
+        catch(...)
+        {
+            frames->pop_back();
+            throw;
+        }
+        frame.resize(len);
+    }
+}
+
+void dccl::Codec::decode_batch(const std::vector<std::string>& frames, const std::vector<google::protobuf::Message*>& msgs, bool header_only /* = false */)
+{
+    if(frames.size() != msgs.size())
+        throw(Exception("decode_batch: number of frames (" + boost::lexical_cast<std::string>(frames.size()) + ") does not match the number of messages (" + boost::lexical_cast<std::string>(msgs.size()) + ")"));
+
+    std::string scratch;
+    for(std::vector<std::string>::size_type i = 0, n = frames.size(); i < n; ++i)
+        decode_internal(frames[i].data(), frames[i].data() + frames[i].size(), msgs[i], header_only, &scratch);
+}
+
+google::protobuf::Message* dccl::Codec::decode(const std::string& bytes, MessagePool* pool, bool header_only /* = false */)
+{
+    google::protobuf::Message* msg = pool->acquire(loaded_descriptor(bytes.data(), bytes.data() + bytes.size()));
+    try
+    {
+        decode(bytes, msg, header_only);
+    }
+    catch(...)
+    {
+        pool->release(msg);
+        throw;
+    }
+    return msg;
+}
+
+#if DCCL_HAS_PROTOBUF_ARENA
+google::protobuf::Message* dccl::Codec::decode(const std::string& bytes, google::protobuf::Arena* arena, bool header_only /* = false */)
+{
+    google::protobuf::Message* msg = DynamicProtobufManager::new_protobuf_message(loaded_descriptor(bytes.data(), bytes.data() + bytes.size()), arena);
+    try
+    {
+        decode(bytes, msg, header_only);
+    }
+    catch(...)
+    {
+        if(!arena)
+            delete msg;
+        throw;
+    }
+    return msg;
+}
+
+void dccl::Codec::decode_batch(const std::vector<std::string>& frames, std::vector<google::protobuf::Message*>* msgs, google::protobuf::Arena* arena, bool header_only /* = false */)
+{
+    msgs->reserve(msgs->size() + frames.size());
+    std::string scratch;
+    for(std::vector<std::string>::const_iterator it = frames.begin(), end = frames.end(); it != end; ++it)
+    {
+        const char* begin = it->data();
+        google::protobuf::Message* msg = DynamicProtobufManager::new_protobuf_message(loaded_descriptor(begin, begin + it->size()), arena);
+        msgs->push_back(msg);
+        decode_internal(begin, begin + it->size(), msg, header_only, &scratch);
+    }
 }
+#endif
 
 // makes sure we can actual encode / decode a message of this descriptor given the loaded FieldCodecs
 // checks all bounds on the message
 void dccl::Codec::load(const google::protobuf::Descriptor* desc, int user_id /* = -1 */)
 {
+    // already validated with the current codecs (e.g. in a shared Schema): nothing to do
+    std::map<const google::protobuf::Descriptor*, Schema::LoadedSizes>::const_iterator loaded_it = schema_->desc2size_.find(desc);
+    if(loaded_it != schema_->desc2size_.end() && loaded_it->second.dependencies.current() &&
+       schema_->id_dependencies_.current() &&
+       (user_id >= 0 || desc->options().GetExtension(dccl::msg).has_id()) &&
+       loaded_descriptor((user_id < 0) ? id(desc) : user_id) == desc)
+    {
+        if(stats_)
+            stats_->add((user_id < 0) ? id(desc) : user_id, desc);
+        return;
+    }
+
+    Schema& schema = mutable_schema();
     try
     {
+        internal::TraversalScope traversal;
+        internal::TraversalContext::current()->codec_context = codec_context_.get();
+
         if(user_id <0 && !desc->options().GetExtension(dccl::msg).has_id())
             throw(Exception("Missing message option `(dccl.msg).id`. Specify a unique id (e.g. 3) in the body of your .proto message using \"option (dccl.msg).id = 3\""));
         if(!desc->options().GetExtension(dccl::msg).has_max_bytes())
@@ -348,15 +964,13 @@ void dccl::Codec::load(const google::protobuf::Descriptor* desc, int user_id /*
         boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
 
         unsigned dccl_id = (user_id < 0) ? id(desc) : user_id;
-        unsigned head_size_bits, body_size_bits;
-        codec->base_max_size(&head_size_bits, desc, HEAD);
-        codec->base_max_size(&body_size_bits, desc, BODY);
+        Schema::LoadedSizes sizes;
+        compute_message_bit_sizes(desc, &sizes.bits, &sizes.dependencies);
 
-        unsigned id_bits = 0;
-        id_codec()->field_size(&id_bits, dccl_id, 0);
-        head_size_bits += id_bits;
+        unsigned id_size = 0;
+        id_codec()->field_size(&id_size, dccl_id, 0);
 
-        const unsigned byte_size = ceil_bits2bytes(head_size_bits) + ceil_bits2bytes(body_size_bits);
+        const unsigned byte_size = ceil_bits2bytes(sizes.bits.head_max + id_size) + ceil_bits2bytes(sizes.bits.body_max);
 
         if(byte_size > desc->options().GetExtension(dccl::msg).max_bytes())
             throw(Exception("Actual maximum size of message exceeds allowed maximum (dccl.max_bytes). Tighten bounds, remove fields, improve codecs, or increase the allowed dccl.max_bytes"));
@@ -364,10 +978,20 @@ void dccl::Codec::load(const google::protobuf::Descriptor* desc, int user_id /*
         codec->base_validate(desc, HEAD);
         codec->base_validate(desc, BODY);
 
-        if(id2desc_.count(dccl_id) && desc != id2desc_.find(dccl_id)->second)
-            throw(Exception("`dccl id` " + boost::lexical_cast<std::string>(dccl_id) + " is already in use by Message " + id2desc_.find(dccl_id)->second->full_name() + ": " + boost::lexical_cast<std::string>(id2desc_.find(dccl_id)->second)));
+        if(schema.id2desc_.count(dccl_id) && desc != schema.id2desc_.find(dccl_id)->second)
+            throw(Exception("`dccl id` " + boost::lexical_cast<std::string>(dccl_id) + " is already in use by Message " + schema.id2desc_.find(dccl_id)->second->full_name() + ": " + boost::lexical_cast<std::string>(schema.id2desc_.find(dccl_id)->second)));
         else
-            id2desc_.insert(std::make_pair(dccl_id, desc));
+        {
+            schema.id2desc_.insert(std::make_pair(dccl_id, desc));
+            schema.id2desc_table_.set(dccl_id, desc);
+        }
+
+        refresh_size_tables(&schema);
+        schema.desc2size_[desc] = sizes;
+        schema.id2bits_[dccl_id] = id_size;
+
+        if(stats_)
+            stats_->add(dccl_id, desc);
 
         dlog.is(DEBUG1) && dlog << "Successfully validated message of type: " << desc->full_name() << std::endl;
 
@@ -392,19 +1016,23 @@ void dccl::Codec::load(const google::protobuf::Descriptor* desc, int user_id /*
 
 void dccl::Codec::unload(const google::protobuf::Descriptor* desc)
 {
+    Schema& schema = mutable_schema();
     unsigned int erased = 0;
-    for (std::map<int32, const google::protobuf::Descriptor*>::iterator it = id2desc_.begin(); it != id2desc_.end();)
+    for (std::map<int32, const google::protobuf::Descriptor*>::iterator it = schema.id2desc_.begin(); it != schema.id2desc_.end();)
     {
         if (it->second == desc)
         {
             erased++;
-            id2desc_.erase(it++);
+            schema.id2bits_.erase(it->first);
+            schema.id2desc_table_.erase(it->first);
+            schema.id2desc_.erase(it++);
         }
         else
         {
             it++;
         }
     }
+    schema.desc2size_.erase(desc);
     if (erased == 0)
     {
         dlog.is(DEBUG1) && dlog << "Message " << desc->full_name() << ": is not loaded. Ignoring unload request." << std::endl;
@@ -414,9 +1042,12 @@ void dccl::Codec::unload(const google::protobuf::Descriptor* desc)
 
 void dccl::Codec::unload(size_t dccl_id)
 {
-    if(id2desc_.count(dccl_id))
+    Schema& schema = mutable_schema();
+    if(schema.id2desc_.count(dccl_id))
     {
-        id2desc_.erase(dccl_id);
+        schema.id2desc_.erase(dccl_id);
+        schema.id2desc_table_.erase(dccl_id);
+        schema.id2bits_.erase(dccl_id);
     }
     else
     {
@@ -432,6 +1063,8 @@ unsigned dccl::Codec::size(const google::protobuf::Message& msg, int user_id /*
 
     boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
 
+    internal::TraversalScope traversal;
+    internal::TraversalContext::current()->codec_context = codec_context_.get();
     unsigned dccl_id = (user_id < 0) ? id(desc) : user_id;
     unsigned head_size_bits;
     codec->base_size(&head_size_bits, msg, HEAD);
@@ -451,42 +1084,121 @@ unsigned dccl::Codec::size(const google::protobuf::Message& msg, int user_id /*
 
 unsigned dccl::Codec::max_size(const google::protobuf::Descriptor* desc) const
 {
-    boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
+    MessageBitSizes sizes;
+    message_bit_sizes(desc, &sizes);
 
-    unsigned head_size_bits;
-    codec->base_max_size(&head_size_bits, desc, HEAD);
+    unsigned id_min = 0, id_max = 0;
+    id_bit_bounds(&id_min, &id_max);
 
-    unsigned id_bits = 0;
-    id_codec()->field_max_size(&id_bits, 0);
-    head_size_bits += id_bits;
+    const unsigned head_size_bytes = ceil_bits2bytes(sizes.head_max + id_max);
+    const unsigned body_size_bytes = ceil_bits2bytes(sizes.body_max);
+    return head_size_bytes + body_size_bytes;
+}
 
-    unsigned body_size_bits;
-    codec->base_max_size(&body_size_bits, desc, BODY);
+unsigned dccl::Codec::min_size(const google::protobuf::Descriptor* desc) const
+{
+    MessageBitSizes sizes;
+    message_bit_sizes(desc, &sizes);
 
-    const unsigned head_size_bytes = ceil_bits2bytes(head_size_bits);
-    const unsigned body_size_bytes = ceil_bits2bytes(body_size_bits);
+    unsigned id_min = 0, id_max = 0;
+    id_bit_bounds(&id_min, &id_max);
+
+    const unsigned head_size_bytes = ceil_bits2bytes(sizes.head_min + id_min);
+    const unsigned body_size_bytes = ceil_bits2bytes(sizes.body_min);
     return head_size_bytes + body_size_bytes;
 }
 
-unsigned dccl::Codec::min_size(const google::protobuf::Descriptor* desc) const
+void dccl::Codec::compute_message_bit_sizes(const google::protobuf::Descriptor* desc, MessageBitSizes* sizes, internal::Dependencies* dependencies) const
 {
+    internal::DependencyScope dependency_scope(dependencies);
     boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
+    if(!codec)
+        throw(Exception("Failed to find (dccl.msg).codec `" + desc->options().GetExtension(dccl::msg).codec() + "`"));
+
+    internal::TraversalScope traversal;
+    internal::TraversalContext::current()->codec_context = codec_context_.get();
+    codec->base_max_size(&sizes->head_max, desc, HEAD);
+    codec->base_max_size(&sizes->body_max, desc, BODY);
+    codec->base_min_size(&sizes->head_min, desc, HEAD);
+    codec->base_min_size(&sizes->body_min, desc, BODY);
+}
 
-    unsigned head_size_bits;
-    codec->base_min_size(&head_size_bits, desc, HEAD);
+void dccl::Codec::message_bit_sizes(const google::protobuf::Descriptor* desc, MessageBitSizes* sizes) const
+{
+    std::map<const google::protobuf::Descriptor*, Schema::LoadedSizes>::const_iterator it = schema_->desc2size_.find(desc);
+    if(it != schema_->desc2size_.end() && it->second.dependencies.current())
+    {
+        *sizes = it->second.bits;
+        return;
+    }
 
-    unsigned id_bits = 0;
-    id_codec()->field_min_size(&id_bits, 0);
-    head_size_bits += id_bits;
+    internal::Dependencies dependencies;
+    compute_message_bit_sizes(desc, sizes, &dependencies);
+}
 
-    unsigned body_size_bits;
-    codec->base_min_size(&body_size_bits, desc, BODY);
+unsigned dccl::Codec::id_bits(unsigned dccl_id) const
+{
+    if(schema_->default_id_codec_ && schema_->id_dependencies_.current())
+    {
+        std::map<int32, unsigned>::const_iterator it = schema_->id2bits_.find(dccl_id);
+        if(it != schema_->id2bits_.end())
+            return it->second;
+    }
 
-    const unsigned head_size_bytes = ceil_bits2bytes(head_size_bits);
-    const unsigned body_size_bytes = ceil_bits2bytes(body_size_bits);
-    return head_size_bytes + body_size_bytes;
+    unsigned bits = 0;
+    id_codec()->field_size(&bits, dccl_id, 0);
+    return bits;
 }
 
+void dccl::Codec::id_bit_bounds(unsigned* min_bits, unsigned* max_bits) const
+{
+    if(schema_->default_id_codec_ && schema_->id_dependencies_.current())
+    {
+        *min_bits = schema_->id_min_bits_;
+        *max_bits = schema_->id_max_bits_;
+    }
+    else
+    {
+        id_codec()->field_min_size(min_bits, 0);
+        id_codec()->field_max_size(max_bits, 0);
+    }
+}
+
+void dccl::Codec::refresh_size_tables(Schema* schema) const
+{
+    // only the sizes computed from a codec that has since been added or removed
+    for(std::map<const google::protobuf::Descriptor*, Schema::LoadedSizes>::iterator it = schema->desc2size_.begin(), end = schema->desc2size_.end(); it != end; ++it)
+    {
+        if(!it->second.dependencies.current())
+        {
+            Schema::LoadedSizes sizes;
+            compute_message_bit_sizes(it->first, &sizes.bits, &sizes.dependencies);
+            it->second = sizes;
+        }
+    }
+
+    if(schema->id_dependencies_.current())
+        return;
+
+    internal::Dependencies id_dependencies;
+    {
+        internal::DependencyScope dependency_scope(&id_dependencies);
+        schema->id2bits_.clear();
+        for(std::map<int32, const google::protobuf::Descriptor*>::const_iterator it = schema->id2desc_.begin(), end = schema->id2desc_.end(); it != end; ++it)
+        {
+            unsigned bits = 0;
+            id_codec()->field_size(&bits, static_cast<uint32>(it->first), 0);
+            schema->id2bits_[it->first] = bits;
+        }
+
+        // field_min_size() and field_max_size() add to the value passed
+        schema->id_min_bits_ = 0;
+        schema->id_max_bits_ = 0;
+        id_codec()->field_min_size(&schema->id_min_bits_, 0);
+        id_codec()->field_max_size(&schema->id_max_bits_, 0);
+    }
+    schema->id_dependencies_ = id_dependencies;
+}
 
 
 void dccl::Codec::info(const google::protobuf::Descriptor* desc, std::ostream* param_os /*= 0 */, int user_id /* = -1 */) const
@@ -498,14 +1210,16 @@ void dccl::Codec::info(const google::protobuf::Descriptor* desc, std::ostream* p
         try
         {
             boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
+            internal::TraversalScope traversal;
+            internal::TraversalContext::current()->codec_context = codec_context_.get();
 
-            unsigned config_head_bit_size, body_bit_size;
-            codec->base_max_size(&config_head_bit_size, desc, HEAD);
-            codec->base_max_size(&body_bit_size, desc, BODY);
+            MessageBitSizes sizes;
+            message_bit_sizes(desc, &sizes);
+            const unsigned config_head_bit_size = sizes.head_max;
+            const unsigned body_bit_size = sizes.body_max;
 
             unsigned dccl_id = (user_id < 0) ? id(desc) : user_id;
-            unsigned id_bit_size = 0;
-            id_codec()->field_size(&id_bit_size, dccl_id, 0);
+            unsigned id_bit_size = id_bits(dccl_id);
 
             const unsigned bit_size = id_bit_size + config_head_bit_size + body_bit_size;
 
@@ -564,45 +1278,18 @@ void dccl::Codec::info(const google::protobuf::Descriptor* desc, std::ostream* p
 }
 
 
-void dccl::Codec::encrypt(std::string* s, const std::string& nonce /* message head */)
+void dccl::Codec::encrypt(char* data, std::size_t len, const char* nonce /* message head */, std::size_t nonce_len) const
 {
 #if DCCL_HAS_CRYPTOPP
-    using namespace CryptoPP;
-
-    std::string iv;
-    SHA256 hash;
-    StringSource unused(nonce, true, new HashFilter(hash, new StringSink(iv)));
-
-    CTR_Mode<AES>::Encryption encryptor;
-    encryptor.SetKeyWithIV((byte*)crypto_key_.c_str(), crypto_key_.size(), (byte*)iv.c_str());
-
-    std::string cipher;
-    StreamTransformationFilter in(encryptor, new StringSink(cipher));
-    in.Put((byte*)s->c_str(), s->size());
-    in.MessageEnd();
-    *s = cipher;
+    if(cipher_)
+        cipher_->apply(data, len, nonce, nonce_len);
 #endif
 }
 
-void dccl::Codec::decrypt(std::string* s, const std::string& nonce)
+void dccl::Codec::decrypt(char* data, std::size_t len, const char* nonce, std::size_t nonce_len) const
 {
-#if DCCL_HAS_CRYPTOPP
-    using namespace CryptoPP;
-
-    std::string iv;
-    SHA256 hash;
-    StringSource unused(nonce, true, new HashFilter(hash, new StringSink(iv)));
-
-    CTR_Mode<AES>::Decryption decryptor;
-    decryptor.SetKeyWithIV((byte*)crypto_key_.c_str(), crypto_key_.size(), (byte*)iv.c_str());
-
-    std::string recovered;
-
-    StreamTransformationFilter out(decryptor, new StringSink(recovered));
-    out.Put((byte*)s->c_str(), s->size());
-    out.MessageEnd();
-    *s = recovered;
-#endif
+    // CTR mode is symmetric
+    encrypt(data, len, nonce, nonce_len);
 }
 
 void dccl::Codec::load_library(const std::string& library_path)
@@ -642,6 +1329,7 @@ void dccl::Codec::set_crypto_passphrase(const std::string& passphrase, const std
 {
     if(!crypto_key_.empty())
         crypto_key_.clear();
+    cipher_.reset();
     skip_crypto_ids_.clear();
 
 #if DCCL_HAS_CRYPTOPP
@@ -649,6 +1337,7 @@ void dccl::Codec::set_crypto_passphrase(const std::string& passphrase, const std
 
     SHA256 hash;
     StringSource unused(passphrase, true, new HashFilter(hash, new StringSink(crypto_key_)));
+    cipher_.reset(new internal::AESCounterCipher(crypto_key_));
 
     dlog.is(DEBUG1) && dlog << "Cryptography enabled with given passphrase" << std::endl;
 #else
@@ -668,10 +1357,10 @@ void dccl::Codec::info_all(std::ostream* param_os /*= 0 */) const
         std::string codec_guard = std::string((full_width-codec_str.size())/2, '|');
         *os << codec_guard << " " << codec_str << " " << codec_guard << std::endl;
 
-        *os << id2desc_.size() << " messages loaded.\n";
+        *os << schema_->id2desc_.size() << " messages loaded.\n";
         *os << "Field sizes are in bits unless otherwise noted." << std::endl;
 
-        for(std::map<int32, const google::protobuf::Descriptor*>::const_iterator it = id2desc_.begin(), n = id2desc_.end(); it != n; ++it)
+        for(std::map<int32, const google::protobuf::Descriptor*>::const_iterator it = schema_->id2desc_.begin(), n = schema_->id2desc_.end(); it != n; ++it)
             info(it->second, os, it->first);
 
 //        *os << std::string(codec_str.size() + 2 + 2*codec_guard.size(), '|') << std::endl;
@@ -27,22 +27,30 @@
 #include <map>
 #include <ostream>
 #include <stdexcept>
+#include <iterator>
 #include <vector>
 
 #include <google/protobuf/descriptor.h>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/type_traits.hpp>
 
 #include "binary.h"
 #include "dynamic_protobuf_manager.h"
+#include "message_pool.h"
 #include "logger.h"
 #include "exception.h"
+#include "status.h"
+#include "stats.h"
+#include "field_profiler.h"
 #include "field_codec.h"
 #include "field_codec_fixed.h"
 
 #include "codecs2/field_codec_default_message.h"
 #include "codecs3/field_codec_default_message.h"
 #include "field_codec_manager.h"
+#include "schema.h"
 
 #define DCCL_HAS_CRYPTOPP @DCCL_HAS_CRYPTOPP@
  
@@ -50,8 +58,37 @@
 namespace dccl
 {
     class FieldCodec;
+    namespace internal
+    {
+        class AESCounterCipher;
+        class StatsRecorder;
+        struct StatsSample;
+
+        // true if CharIterator is known to point into a contiguous array of char
+        template<typename CharIterator>
+            struct IsContiguousCharIterator
+            : boost::integral_constant<bool,
+            boost::is_same<CharIterator, const char*>::value ||
+            boost::is_same<CharIterator, char*>::value ||
+            boost::is_same<CharIterator, std::string::const_iterator>::value ||
+            boost::is_same<CharIterator, std::string::iterator>::value ||
+            boost::is_same<CharIterator, std::vector<char>::const_iterator>::value ||
+            boost::is_same<CharIterator, std::vector<char>::iterator>::value>
+        { };
+
+        // pointer to the (dereferenceable) char at begin, or 0 if CharIterator is not contiguous
+        template<typename CharIterator>
+            const char* contiguous_data(CharIterator begin, boost::true_type)
+        { return &*begin; }
+
+        template<typename CharIterator>
+            const char* contiguous_data(CharIterator begin, boost::false_type)
+        { return 0; }
+    }
   
     /// \brief The Dynamic CCL enCODer/DECoder. This is the main class you will use to load, encode and decode DCCL messages. Many users will not need any other DCCL classes than this one.
+    ///
+    /// Once constructed and loaded, Codec instances may be used to encode and decode from different threads concurrently. Field codecs may also be added to or removed from the FieldCodecManager (directly or through load_library()) while other threads encode and decode: those threads are never blocked, and keep using the codecs they had already resolved. Constructing a Codec and loading messages modify shared state and must not happen concurrently with other DCCL calls.
     /// \ingroup dccl_api
     class Codec
     {
@@ -64,6 +101,12 @@ namespace dccl
         Codec(const std::string& dccl_id_codec = default_id_codec_name(),
               const std::string& library_path = "");
 
+        /// \brief Instantiate a Codec that shares the messages already loaded (and validated) into another Codec's Schema (see schema()).
+        ///
+        /// The new Codec uses the same identifier codec as \a schema, and starts with no crypto passphrase, strict mode off and no frame handlers.
+        /// \param schema Schema returned by schema() from another Codec
+        explicit Codec(boost::shared_ptr<const Schema> schema);
+
         /// \brief Destructor
         virtual ~Codec();
 
@@ -199,20 +242,23 @@ namespace dccl
         template<typename CharIterator>
         unsigned id(CharIterator begin, CharIterator end) const;
 
+        /// \brief Get the DCCL ID of an unknown encoded DCCL message held in a contiguous buffer, reading the ID in place.
+        ///
+        /// With the DefaultIdentifierCodec, the ID is read directly from the first one or two bytes.
+        unsigned id(const char* begin, const char* end) const;
+
         /// \brief Provides the DCCL ID given a DCCL type.
-        unsigned id(const google::protobuf::Descriptor* desc) const {
-            Bitset id_bits;
-            dccl::uint32 hardcoded_id = desc->options().GetExtension(dccl::msg).id();
-            // pass the hard coded id, that is, (dccl.msg).id,
-            // through encode/decode to allow a custom ID codec (if in use)
-            // to always take effect.
-            id_codec()->field_encode(&id_bits, hardcoded_id, 0);
-            std::string id_bytes(id_bits.to_byte_string());
-            return id(id_bytes);
-        }      
+        unsigned id(const google::protobuf::Descriptor* desc) const;
 
         /// \brief Provides a map of all loaded DCCL IDs to the equivalent Protobuf descriptor
-        const std::map<int32, const google::protobuf::Descriptor*>& loaded() const { return id2desc_; }
+        const std::map<int32, const google::protobuf::Descriptor*>& loaded() const { return schema_->loaded(); }
+
+        /// \brief Descriptor of the message loaded with a given DCCL ID (in constant time), or 0 if none is loaded
+        const google::protobuf::Descriptor* loaded_descriptor(unsigned dccl_id) const
+        { return schema_->loaded_descriptor(dccl_id); }
+
+        /// \brief The loaded messages, which can be shared with other Codec instances (see Codec(boost::shared_ptr<const Schema>))
+        boost::shared_ptr<const Schema> schema() const { return schema_; }
         
         //@}
             
@@ -255,6 +301,17 @@ namespace dccl
         template <typename CharIterator>
             CharIterator decode(CharIterator begin, CharIterator end, google::protobuf::Message* msg, bool header_only = false);
 
+        /// \brief Decode a DCCL message directly from a contiguous buffer.
+        ///
+        /// No copy of the encoded message is made (other than into a scratch buffer for decryption, if applicable), so this is the preferred form for decoding a series of concatenated messages: advance data by *consumed and decode again.
+        /// \param data Pointer to the first byte of the encoded message
+        /// \param len Number of bytes available starting at data (may extend past the end of this message)
+        /// \param msg Pointer to any Google Protobuf Message generated by protoc (i.e. subclass of google::protobuf::Message). The decoded message will be written here.
+        /// \param consumed If not null, set to the number of bytes used by this message
+        /// \param header_only If true, only decode the header (do not try to decrypt (if applicable) and decode the message body)
+        /// \throw Exception if message cannot be decoded.
+        void decode(const char* data, std::size_t len, google::protobuf::Message* msg, std::size_t* consumed, bool header_only = false);
+
         /// \brief Decode a DCCL message when the type is known at compile time.
         ///
         /// \param bytes encoded message to decode (must already have been validated)
@@ -289,6 +346,111 @@ namespace dccl
         template<typename GoogleProtobufMessagePointer>
             GoogleProtobufMessagePointer decode(std::string* bytes);
 
+        /// \brief An alterative form for decoding messages for message types <i>not</i> known at compile-time ("dynamic"), into a message recycled from \a pool.
+        ///
+        /// \param bytes the byte string returned by encode
+        /// \param pool Pool to take the message from. Return the message to it with MessagePool::release() when finished, so that it can be reused.
+        /// \param header_only If true, only decode the header (do not try to decrypt (if applicable) and decode the message body)
+        /// \throw Exception if message cannot be decoded (the message is returned to the pool)
+        /// \return the decoded message
+        google::protobuf::Message* decode(const std::string& bytes, MessagePool* pool, bool header_only = false);
+
+#if DCCL_HAS_PROTOBUF_ARENA
+        /// \brief An alterative form for decoding messages for message types <i>not</i> known at compile-time ("dynamic"), allocating the message and all its submessages on \a arena.
+        ///
+        /// Many decoded messages can then be freed at once by resetting (or destroying) the arena, rather than one at a time.
+        /// \param bytes the byte string returned by encode
+        /// \param arena Arena to allocate the decoded message on (if 0, the message is allocated on the heap and must be deleted by the caller)
+        /// \param header_only If true, only decode the header (do not try to decrypt (if applicable) and decode the message body)
+        /// \throw Exception if message cannot be decoded
+        /// \return the decoded message, owned by arena
+        google::protobuf::Message* decode(const std::string& bytes, google::protobuf::Arena* arena, bool header_only = false);
+#endif
+
+        /// \brief Encodes a DCCL message, reporting failure through the return value rather than an exception.
+        ///
+        /// Otherwise the same as encode(std::string*, const google::protobuf::Message&, bool, int). No description of the failure is formatted (or logged) unless Status::str() is called.
+        /// \param bytes Pointer to byte string to which the encoded message is appended (unchanged on failure)
+        /// \param msg Message to encode (must already have been validated)
+        /// \param status If not null, set to the outcome, including the field and bit offset of a failure
+        /// \param header_only If true, only encode the header (do not encode or encrypt the message body)
+        /// \param user_id Custom user specified dccl id (see encode())
+        /// \return STATUS_OK on success, otherwise the reason for failure
+        StatusCode try_encode(std::string* bytes, const google::protobuf::Message& msg, Status* status = 0, bool header_only = false, int user_id = -1);
+
+        /// \brief Encodes a DCCL message into a caller-owned buffer, reporting failure through the return value rather than an exception.
+        ///
+        /// \param bytes Output buffer to store encoded msg
+        /// \param max_len Maximum size of output buffer
+        /// \param msg Message to encode (must already have been validated)
+        /// \param len Set to the size of the encoded message on success
+        /// \param status If not null, set to the outcome, including the field and bit offset of a failure
+        /// \param header_only If true, only encode the header (do not encode or encrypt the message body)
+        /// \param user_id Custom user specified dccl id (see encode())
+        /// \return STATUS_OK on success, otherwise the reason for failure
+        StatusCode try_encode(char* bytes, size_t max_len, const google::protobuf::Message& msg, size_t* len, Status* status = 0, bool header_only = false, int user_id = -1);
+
+        /// \brief Decodes a DCCL message, reporting failure through the return value rather than an exception.
+        ///
+        /// Intended for links that deliver corrupted or truncated messages: the common failures (too few bytes, unknown DCCL id) are detected without throwing, and no description of the failure is formatted (or logged) unless Status::str() is called. On failure \a msg may have been partially filled.
+        /// \param bytes encoded message to decode
+        /// \param msg Pointer to any Google Protobuf Message generated by protoc (i.e. subclass of google::protobuf::Message). The decoded message will be written here.
+        /// \param status If not null, set to the outcome, including the field and bit offset of a failure
+        /// \param header_only If true, only decode the header (do not try to decrypt (if applicable) and decode the message body)
+        /// \return STATUS_OK on success, otherwise the reason for failure
+        StatusCode try_decode(const std::string& bytes, google::protobuf::Message* msg, Status* status = 0, bool header_only = false);
+
+        /// \brief Decodes a DCCL message directly from a contiguous buffer, reporting failure through the return value rather than an exception.
+        ///
+        /// \param data Pointer to the first byte of the encoded message
+        /// \param len Number of bytes available starting at data (may extend past the end of this message)
+        /// \param msg Pointer to any Google Protobuf Message generated by protoc (i.e. subclass of google::protobuf::Message). The decoded message will be written here.
+        /// \param consumed If not null, set to the number of bytes used by this message on success
+        /// \param status If not null, set to the outcome, including the field and bit offset of a failure
+        /// \param header_only If true, only decode the header (do not try to decrypt (if applicable) and decode the message body)
+        /// \return STATUS_OK on success, otherwise the reason for failure
+        StatusCode try_decode(const char* data, std::size_t len, google::protobuf::Message* msg, std::size_t* consumed, Status* status = 0, bool header_only = false);
+
+        /// \brief Encodes a batch of DCCL messages, appending one encoded message to \a frames for each entry of \a msgs (in order)
+        ///
+        /// This is equivalent to calling encode() for each message, but the DCCL id, message codec and encryption settings are looked up once for each run of messages of the same type, and each message is encoded directly into its entry of \a frames.
+        /// \param frames Pointer to vector to which the encoded messages are appended
+        /// \param msgs Messages to encode (all must already have been validated)
+        /// \param header_only If true, only encode the header (do not encode or encrypt the message bodies)
+        /// \param user_id Custom user_speicified dccl id applied to every message in the batch. If <0, then the first
+        /// dccl id with the message descriptor corresponding to that of each msg will be used
+        /// \throw Exception if any message cannot be encoded. Messages before the failing one will already have been appended to frames.
+        void encode_batch(std::vector<std::string>* frames, const std::vector<const google::protobuf::Message*>& msgs, bool header_only = false, int user_id = -1);
+
+        /// \brief Decodes a batch of DCCL messages whose types are known in advance
+        ///
+        /// \param frames Encoded messages, one per entry (e.g. as produced by encode_batch())
+        /// \param msgs Messages to decode into: frames[i] is decoded into msgs[i]. Must be the same length as frames.
+        /// \param header_only If true, only decode the header (do not try to decrypt (if applicable) and decode the message body)
+        /// \throw Exception if any message cannot be decoded
+        void decode_batch(const std::vector<std::string>& frames, const std::vector<google::protobuf::Message*>& msgs, bool header_only = false);
+
+        /// \brief An alterative form of decode_batch() for message types <i>not</i> known at compile-time ("dynamic"). Each frame may be of any loaded type.
+        ///
+        /// \tparam GoogleProtobufMessagePointer anything that acts like a pointer (has operator*) to a google::protobuf::Message (smart pointers like boost::shared_ptr included)
+        /// \param frames Encoded messages, one per entry
+        /// \param msgs Pointer to vector to which the decoded messages are appended (in the same order as frames). As with decode(const std::string&, bool), you are responsible for deleting these messages, so we recommend using a smart pointer.
+        /// \param header_only If true, only decode the header (do not try to decrypt (if applicable) and decode the message body)
+        /// \throw Exception if any message cannot be decoded
+        template<typename GoogleProtobufMessagePointer>
+            void decode_batch(const std::vector<std::string>& frames, std::vector<GoogleProtobufMessagePointer>* msgs, bool header_only = false);
+
+#if DCCL_HAS_PROTOBUF_ARENA
+        /// \brief An alterative form of decode_batch() for message types <i>not</i> known at compile-time ("dynamic"), allocating the decoded messages (and all their submessages) on \a arena.
+        ///
+        /// \param frames Encoded messages, one per entry
+        /// \param msgs Pointer to vector to which the decoded messages (owned by arena) are appended (in the same order as frames). Each message is appended before it is decoded, so if one fails to decode it is the last entry.
+        /// \param arena Arena to allocate the decoded messages on (if 0, the messages are allocated on the heap and must be deleted by the caller)
+        /// \param header_only If true, only decode the header (do not try to decrypt (if applicable) and decode the message body)
+        /// \throw Exception if any message cannot be decoded
+        void decode_batch(const std::vector<std::string>& frames, std::vector<google::protobuf::Message*>* msgs, google::protobuf::Arena* arena, bool header_only = false);
+#endif
+
         /// \brief Provides the encoded size (in bytes) of msg. This is useful if you need to know the size of a message before encoding it (encoding it is generally much more expensive than calling this method)
         ///
         /// \param msg Google Protobuf message with DCCL extensions for which the encoded size is requested
@@ -322,6 +484,68 @@ namespace dccl
         
         //@}
 
+        /// \name Frame dispatch.
+        ///
+        /// Routes encoded messages to handlers by DCCL ID alone (e.g. to fan incoming frames out to other processes), without decoding them.
+        //@{
+
+        /// \brief Handler for encoded messages of one DCCL ID, called with that ID and the bytes of the message [begin, end)
+        typedef boost::function<void (unsigned dccl_id, const char* begin, const char* end)> FrameHandler;
+
+        /// \brief Call \a handler for each encoded message with this DCCL ID passed to dispatch(), replacing any handler added before. The message type does not need to be loaded.
+        void add_frame_handler(unsigned dccl_id, const FrameHandler& handler)
+        { handlers_.set(dccl_id, handler); }
+
+        /// \brief Stop calling the handler added for this DCCL ID
+        void remove_frame_handler(unsigned dccl_id)
+        { handlers_.erase(dccl_id); }
+
+        /// \brief Pass an encoded message to the handler added for its DCCL ID
+        ///
+        /// \return true if a handler was called, false if none was added for this ID
+        /// \throw Exception if [begin, end) is too short to contain a DCCL ID
+        bool dispatch(const char* begin, const char* end) const;
+
+        /// \brief Pass an encoded message to the handler added for its DCCL ID
+        bool dispatch(const std::string& bytes) const
+        { return dispatch(bytes.data(), bytes.data() + bytes.size()); }
+
+        //@}
+
+        /// \name Runtime statistics.
+        ///
+        /// Optional counters and latency histograms for every encode and decode call, kept per DCCL ID (see CodecStats).
+        //@{
+
+        /// \brief Start (or stop) keeping statistics. They are off by default, and cost two clock reads and a few uncontended atomic increments per call when on.
+        ///
+        /// Like load(), this must not be called concurrently with encoding or decoding. Turning statistics off discards the counters.
+        void set_stats_enabled(bool enabled);
+
+        bool stats_enabled() const { return stats_.get() != 0; }
+
+        /// \brief Snapshot of the counters (empty if statistics are off). May be called while other threads encode and decode.
+        CodecStats stats() const;
+
+        /// \brief Set all the counters to zero
+        void reset_stats();
+
+        /// \brief Time the fields of the messages sampled by \a profiler as they are encoded and decoded, or stop if null. The profiler is not owned, and must outlive its use.
+        ///
+        /// Like load(), this must not be called concurrently with encoding or decoding. Several Codecs (used from several threads) may share one profiler.
+        void set_field_profiler(FieldProfiler* profiler) { profiler_ = profiler; }
+
+        FieldProfiler* field_profiler() const { return profiler_; }
+
+        //@}
+
+        /// \brief Attach state that field codec libraries keep for this Codec alone, such as dccl::arith::ModelContext (so that adaptive arithmetic models are not shared with other Codecs), or detach it if null.
+        ///
+        /// The field codecs see it (FieldCodecBase::codec_context()) whenever this Codec loads, encodes, decodes, sizes or describes a message. Like load(), this must not be called concurrently with encoding or decoding.
+        void set_codec_context(boost::shared_ptr<CodecContext> context) { codec_context_ = context; }
+
+        const boost::shared_ptr<CodecContext>& codec_context() const { return codec_context_; }
+
         
         static std::string default_id_codec_name()
         { return "dccl.default.id"; }        
@@ -345,32 +569,89 @@ namespace dccl
         Codec(const Codec&);
         Codec& operator= (const Codec&);
 
-        void encode_internal(const google::protobuf::Message& msg, bool header_only, Bitset& header_bits, Bitset& body_bits, int user_id);
+        // what encoding a message type needs from the Codec, resolved once for a run of messages by encode_batch()
+        struct EncodeTarget
+        {
+            unsigned dccl_id;
+            boost::shared_ptr<FieldCodecBase> codec;
+            bool encrypt;
+        };
+
+        // if status is null, throws on failure; otherwise returns false and fills in *status.
+        // If sample is not null, what the call did is added to it for stats_.
+        // If target is not null, it is used instead of looking up the id, codec and encryption of msg's type
+        bool encode_internal(const google::protobuf::Message& msg, bool header_only, BitWriter* writer, std::size_t* head_byte_size, int user_id, Status* status, internal::StatsSample* sample, const EncodeTarget* target);
+        bool encode_frame(char* bytes, size_t max_len, const google::protobuf::Message& msg, bool header_only, int user_id, size_t* len, Status* status, internal::StatsSample* sample, const EncodeTarget* target);
+        // encode_frame(), recorded in stats_ if enabled
+        bool encode_bytes(char* bytes, size_t max_len, const google::protobuf::Message& msg, bool header_only, int user_id, size_t* len, Status* status, const EncodeTarget* target = 0);
+
+        typedef Schema::MessageBitSizes MessageBitSizes;
+
+        // schema_, copied first if it is shared with another Codec (or held elsewhere), so that it can be changed
+        Schema& mutable_schema();
+
+        // looks up the sizes recorded by load(), or computes them if desc was not loaded or codecs it uses have changed since
+        void message_bit_sizes(const google::protobuf::Descriptor* desc, MessageBitSizes* sizes) const;
+        // computes the sizes, recording what they were computed from into *dependencies
+        void compute_message_bit_sizes(const google::protobuf::Descriptor* desc, MessageBitSizes* sizes, internal::Dependencies* dependencies) const;
+
+        // size of the encoded DCCL id, and the bounds on that size for any id
+        unsigned id_bits(unsigned dccl_id) const;
+        void id_bit_bounds(unsigned* min_bits, unsigned* max_bits) const;
+
+        // reads the DCCL id from the start of [begin, end); returns false if there are too few bytes
+        bool peek_id(const char* begin, const char* end, unsigned* dccl_id) const;
+
+        // descriptor of the loaded type of the message in [begin, end); throws if it is not loaded
+        const google::protobuf::Descriptor* loaded_descriptor(const char* begin, const char* end) const;
 
-        void encrypt(std::string* s, const std::string& nonce);
-        void decrypt(std::string* s, const std::string& nonce);
+        // recomputes the size tables of loaded messages whose codecs have been added or removed since they were computed
+        void refresh_size_tables(Schema* schema) const;
+
+        // decodes a single message from [begin, end), using *scratch for the decrypted body (so that it can be reused between calls). Returns the number of bytes consumed.
+        // If status is null, throws on failure; otherwise returns 0 and fills in *status
+        std::size_t decode_internal(const char* begin, const char* end, google::protobuf::Message* msg, bool header_only, std::string* scratch, Status* status = 0);
+        // decode_internal() without recording stats_ (if sample is not null, what the call did is added to it)
+        std::size_t decode_frame(const char* begin, const char* end, google::protobuf::Message* msg, bool header_only, std::string* scratch, Status* status, internal::StatsSample* sample);
+
+        // encrypt / decrypt [data, data+len) in place, using the SHA256 hash of the message head as the IV
+        void encrypt(char* data, std::size_t len, const char* nonce, std::size_t nonce_len) const;
+        void decrypt(char* data, std::size_t len, const char* nonce, std::size_t nonce_len) const;
 
         void set_default_codecs();
 
         boost::shared_ptr<FieldCodecBase> id_codec() const
         {
             return FieldCodecManager::find(google::protobuf::FieldDescriptor::TYPE_UINT32,
-                                           id_codec_);
+                                           schema_->id_codec_);
         }
         
       private:
         // SHA256 hash of the crypto passphrase
         std::string crypto_key_;
 
+        // AES key schedule for crypto_key_, computed once by set_crypto_passphrase()
+        boost::shared_ptr<const internal::AESCounterCipher> cipher_;
+
         // strict mode setting
         bool strict_;
         
 	// set of DCCL IDs *not* to encrypt        
 	std::set<unsigned> skip_crypto_ids_;
 
-        // maps `dccl.id`s onto Message Descriptors
-        std::map<int32, const google::protobuf::Descriptor*> id2desc_;
-        std::string id_codec_;
+        // loaded messages, possibly shared with other Codecs (and then not modified)
+        boost::shared_ptr<const Schema> schema_;
+
+        internal::IdTable<FrameHandler> handlers_;
+
+        // null unless set_stats_enabled(true)
+        boost::shared_ptr<internal::StatsRecorder> stats_;
+
+        // not owned, null unless set_field_profiler()
+        FieldProfiler* profiler_;
+
+        // null unless set_codec_context()
+        boost::shared_ptr<CodecContext> codec_context_;
 
         std::vector<void *> dl_handles_;
         
@@ -388,12 +669,13 @@ GoogleProtobufMessagePointer dccl::Codec::decode(const std::string& bytes, bool
 {
     unsigned this_id = id(bytes);
 
-    if(!id2desc_.count(this_id))
+    const google::protobuf::Descriptor* desc = loaded_descriptor(this_id);
+    if(!desc)
         throw(Exception("Message id " + boost::lexical_cast<std::string>(this_id) + " has not been loaded. Call load() before decoding this type."));
                     
     // ownership of this object goes to the caller of decode()
     GoogleProtobufMessagePointer msg =
-        dccl::DynamicProtobufManager::new_protobuf_message<GoogleProtobufMessagePointer>(id2desc_.find(this_id)->second);
+        dccl::DynamicProtobufManager::new_protobuf_message<GoogleProtobufMessagePointer>(desc);
     decode(bytes, &(*msg), header_only);
     return msg;
 }
@@ -403,11 +685,12 @@ GoogleProtobufMessagePointer dccl::Codec::decode(std::string* bytes)
 {
     unsigned this_id = id(*bytes);
 
-    if(!id2desc_.count(this_id))
+    const google::protobuf::Descriptor* desc = loaded_descriptor(this_id);
+    if(!desc)
         throw(Exception("Message id " + boost::lexical_cast<std::string>(this_id) + " has not been loaded. Call load() before decoding this type."));
                     
     GoogleProtobufMessagePointer msg =
-        dccl::DynamicProtobufManager::new_protobuf_message<GoogleProtobufMessagePointer>(id2desc_.find(this_id)->second);
+        dccl::DynamicProtobufManager::new_protobuf_message<GoogleProtobufMessagePointer>(desc);
     std::string::iterator new_begin = decode(bytes->begin(), bytes->end(), &(*msg));
     bytes->erase(bytes->begin(), new_begin);
     return msg;
@@ -417,127 +700,47 @@ template<typename CharIterator>
 unsigned dccl::Codec::id(CharIterator begin, CharIterator end) const
 {
     unsigned id_min_size = 0, id_max_size = 0;
-    id_codec()->field_min_size(&id_min_size, 0);
-    id_codec()->field_max_size(&id_max_size, 0);
-
-    if(std::distance(begin, end) < (id_min_size / BITS_IN_BYTE))
-        throw(Exception("Bytes passed (hex: " + hex_encode(begin, end) + ") is too small to be a valid DCCL message"));
+    id_bit_bounds(&id_min_size, &id_max_size);
 
-    Bitset fixed_header_bits;
-    fixed_header_bits.from_byte_stream(begin, begin+(size_t)std::ceil(double(id_max_size) / BITS_IN_BYTE));
+    // copy no more than the largest possible id into a contiguous buffer
+    std::string id_bytes;
+    for(std::size_t i = 0, n = ceil_bits2bytes(id_max_size); i < n && begin != end; ++i, ++begin)
+        id_bytes.push_back(*begin);
 
-    Bitset these_bits(&fixed_header_bits);
-    these_bits.get_more_bits(id_min_size);
-
-    boost::any return_value;
-    id_codec()->field_decode(&these_bits, &return_value, 0);
-
-    return boost::any_cast<uint32>(return_value);
+    return id(id_bytes);
 }
 
 template <typename CharIterator>
 CharIterator dccl::Codec::decode(CharIterator begin, CharIterator end, google::protobuf::Message* msg, bool header_only /*= false*/)
 {
-    try
-    {
-        unsigned this_id = id(begin, end);
-        
-        dlog.is(logger::DEBUG1, logger::DECODE) && dlog  << "Began decoding message of id: " << this_id << std::endl;
-        
-        if(!id2desc_.count(this_id))
-            throw(Exception("Message id " + boost::lexical_cast<std::string>(this_id) + " has not been loaded. Call load() before decoding this type."));
-
-        const google::protobuf::Descriptor* desc = msg->GetDescriptor();
-
-        dlog.is(logger::DEBUG1, logger::DECODE) && dlog  << "Type name: " << desc->full_name() << std::endl;
-
-        boost::shared_ptr<FieldCodecBase> codec = FieldCodecManager::find(desc);
-        boost::shared_ptr<internal::FromProtoCppTypeBase> helper = internal::TypeHelper::find(desc);
-
-        CharIterator actual_end = end;
-        if(codec)
-        {
-            unsigned head_size_bits;
-            unsigned body_size_bits;
-            codec->base_max_size(&head_size_bits, desc, HEAD);
-            codec->base_max_size(&body_size_bits, desc, BODY);
-            unsigned id_size = 0;
-            id_codec()->field_size(&id_size, this_id, 0);
-            head_size_bits += id_size;
-
-            unsigned head_size_bytes = ceil_bits2bytes(head_size_bits);
-            unsigned body_size_bytes = ceil_bits2bytes(body_size_bits);
-
-            dlog.is(logger::DEBUG2, logger::DECODE) && dlog  << "Head bytes (bits): " << head_size_bytes << "(" << head_size_bits
-                                    << "), max body bytes (bits): " << body_size_bytes << "(" << body_size_bits << ")" <<  std::endl;
-
-            CharIterator head_bytes_end = begin + head_size_bytes;
-            dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Head (hex): " << hex_encode(begin, head_bytes_end) << std::endl;
-
-            Bitset head_bits;
-            head_bits.from_byte_stream(begin, head_bytes_end);
-            dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Head (bin): " << head_bits << std::endl;
-
-            // shift off ID bits
-            head_bits >>= id_size;
+    std::string scratch;
 
-            dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Head after ID bits removal (bin): " << head_bits << std::endl;
+    // decode straight from the caller's buffer if it is contiguous
+    const std::size_t len = std::distance(begin, end);
+    const char* data = len ? internal::contiguous_data(begin, typename internal::IsContiguousCharIterator<CharIterator>::type()) : "";
+    if(data)
+        return begin + decode_internal(data, data + len, msg, header_only, &scratch);
 
-            internal::MessageStack msg_stack;
-            msg_stack.push(msg->GetDescriptor());
-
-            codec->base_decode(&head_bits, msg, HEAD);
-            dlog.is(logger::DEBUG2, logger::DECODE) && dlog  << "after header decode, message is: " << *msg << std::endl;
-
-
-            if(header_only)
-            {
-                dlog.is(logger::DEBUG2, logger::DECODE) && dlog  << "as requested, skipping decrypting and decoding body." << std::endl;
-                actual_end = head_bytes_end;
-            }
-            else
-            {
-                dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Encrypted Body (hex): " << hex_encode(head_bytes_end, end) << std::endl;
-
-                Bitset body_bits;
-                if(!crypto_key_.empty() && !skip_crypto_ids_.count(this_id))
-                {
-                    std::string head_bytes(begin, head_bytes_end);
-                    std::string body_bytes(head_bytes_end, end);
-                    decrypt(&body_bytes, head_bytes);
-                    dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Body (hex): " << hex_encode(body_bytes) << std::endl;
-                    body_bits.from_byte_stream(body_bytes.begin(), body_bytes.end());
-                }
-                else
-                {
-                    dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Body (hex): " << hex_encode(head_bytes_end, end) << std::endl;
-                    body_bits.from_byte_stream(head_bytes_end, end);
-                }
-
-                dlog.is(logger::DEBUG3, logger::DECODE) && dlog  << "Unencrypted Body (bin): " << body_bits << std::endl;
-
-                codec->base_decode(&body_bits, msg, BODY);
-                dlog.is(logger::DEBUG2, logger::DECODE) && dlog  << "after header & body decode, message is: " << *msg << std::endl;
-
-                actual_end = end - body_bits.size()/BITS_IN_BYTE;
-            }
-        }
-        else
-        {
-            throw(Exception("Failed to find (dccl.msg).codec `" + desc->options().GetExtension(dccl::msg).codec() + "`"));
-        }
+    const std::string bytes(begin, end);
+    return begin + decode_internal(bytes.data(), bytes.data() + bytes.size(), msg, header_only, &scratch);
+}
 
-        dlog.is(logger::DEBUG1, logger::DECODE) && dlog  << "Successfully decoded message of type: " << desc->full_name() << std::endl;
-        return actual_end;
-    }
-    catch(std::exception& e)
+template<typename GoogleProtobufMessagePointer>
+void dccl::Codec::decode_batch(const std::vector<std::string>& frames, std::vector<GoogleProtobufMessagePointer>* msgs, bool header_only /* = false */)
+{
+    msgs->reserve(msgs->size() + frames.size());
+    std::string scratch;
+    for(std::vector<std::string>::const_iterator it = frames.begin(), end = frames.end(); it != end; ++it)
     {
-        std::stringstream ss;
-
-        ss << "Message " << hex_encode(begin, end) <<  " failed to decode. Reason: " << e.what() << std::endl;
+        unsigned this_id = id(*it);
+        const google::protobuf::Descriptor* desc = loaded_descriptor(this_id);
+        if(!desc)
+            throw(Exception("Message id " + boost::lexical_cast<std::string>(this_id) + " has not been loaded. Call load() before decoding this type."));
 
-        dlog.is(logger::DEBUG1, logger::DECODE) && dlog << ss.str() << std::endl;
-        throw(Exception(ss.str()));
+        GoogleProtobufMessagePointer msg =
+            dccl::DynamicProtobufManager::new_protobuf_message<GoogleProtobufMessagePointer>(desc);
+        decode_internal(it->data(), it->data() + it->size(), &(*msg), header_only, &scratch);
+        msgs->push_back(msg);
     }
 }
 
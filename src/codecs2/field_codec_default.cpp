@@ -42,21 +42,58 @@ dccl::Bitset dccl::v2::DefaultBoolCodec::encode(const bool& wire_value)
     return Bitset(size(), use_required() ? wire_value : wire_value + 1);
 }
 
+void dccl::v2::DefaultBoolCodec::encode(BitWriter* writer)
+{
+    writer->write(0, size());
+}
+
+void dccl::v2::DefaultBoolCodec::encode(BitWriter* writer, const bool& wire_value)
+{
+    writer->write(use_required() ? wire_value : wire_value + 1, size());
+}
+
 bool dccl::v2::DefaultBoolCodec::decode(Bitset* bits)
 {
-    unsigned long t = bits->to_ulong();
+    bool wire_value;
+    if(!try_decode(bits, &wire_value))
+        throw NullValueException();
+    return wire_value;
+}
+
+bool dccl::v2::DefaultBoolCodec::decode(BitReader* reader)
+{
+    bool wire_value;
+    if(!try_decode(reader, &wire_value))
+        throw NullValueException();
+    return wire_value;
+}
+
+bool dccl::v2::DefaultBoolCodec::try_decode(Bitset* bits, bool* wire_value)
+{
+    return decode_value(bits->to_ulong(), wire_value);
+}
+
+bool dccl::v2::DefaultBoolCodec::try_decode(BitReader* reader, bool* wire_value)
+{
+    return decode_value(reader->read(size()), wire_value);
+}
+
+bool dccl::v2::DefaultBoolCodec::decode_value(unsigned long t, bool* wire_value)
+{
     if(use_required())
     {
-        return t;
+        *wire_value = t;
+        return true;
     }
     else if(t)
     {
         --t;
-        return t;
+        *wire_value = t;
+        return true;
     }
     else
     {
-        throw NullValueException();
+        return false;
     }
 }
 
@@ -86,13 +123,13 @@ dccl::Bitset dccl::v2::DefaultStringCodec::encode()
 dccl::Bitset dccl::v2::DefaultStringCodec::encode(const std::string& wire_value)
 {
     std::string s = wire_value;
-    if(s.size() > dccl_field_options().max_length())
+    if(s.size() > field_params().max_length)
     {
         if(this->strict())
             throw(dccl::OutOfRangeException(std::string("String too long for field: ") + FieldCodecBase::this_field()->DebugString(), this->this_field()));
         
         dccl::dlog.is(DEBUG2) && dccl::dlog << "String " << s <<  " exceeds `dccl.max_length`, truncating" << std::endl;
-        s.resize(dccl_field_options().max_length()); 
+        s.resize(field_params().max_length); 
     }
         
             
@@ -116,7 +153,59 @@ dccl::Bitset dccl::v2::DefaultStringCodec::encode(const std::string& wire_value)
     return length_bits;
 }
 
+void dccl::v2::DefaultStringCodec::encode(BitWriter* writer)
+{
+    writer->write(0, min_size());
+}
+
+void dccl::v2::DefaultStringCodec::encode(BitWriter* writer, const std::string& wire_value)
+{
+    std::string::size_type length = wire_value.size();
+    if(length > field_params().max_length)
+    {
+        if(this->strict())
+            throw(dccl::OutOfRangeException(std::string("String too long for field: ") + FieldCodecBase::this_field()->DebugString(), this->this_field()));
+
+        dccl::dlog.is(DEBUG2) && dccl::dlog << "String " << wire_value <<  " exceeds `dccl.max_length`, truncating" << std::endl;
+        length = field_params().max_length;
+    }
+
+    writer->write(length, min_size());
+    writer->write_bytes(wire_value.data(), length);
+}
+
+std::string dccl::v2::DefaultStringCodec::decode(BitReader* reader)
+{
+    std::string wire_value;
+    if(!try_decode(reader, &wire_value))
+        throw NullValueException();
+    return wire_value;
+}
+
 std::string dccl::v2::DefaultStringCodec::decode(Bitset* bits)
+{
+    std::string wire_value;
+    if(!try_decode(bits, &wire_value))
+        throw NullValueException();
+    return wire_value;
+}
+
+bool dccl::v2::DefaultStringCodec::try_decode(BitReader* reader, std::string* wire_value)
+{
+    unsigned value_length = reader->read(min_size());
+
+    if(value_length)
+    {
+        *wire_value = reader->read_bytes(value_length);
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+bool dccl::v2::DefaultStringCodec::try_decode(Bitset* bits, std::string* wire_value)
 {
     unsigned value_length = bits->to_ulong();
     
@@ -138,11 +227,12 @@ std::string dccl::v2::DefaultStringCodec::decode(Bitset* bits)
         string_body_bits >>= header_length;
         string_body_bits.resize(bits->size() - header_length);
     
-        return string_body_bits.to_byte_string();
+        *wire_value = string_body_bits.to_byte_string();
+        return true;
     }
     else
     {
-        throw NullValueException();
+        return false;
     }
     
 }
@@ -161,7 +251,7 @@ unsigned dccl::v2::DefaultStringCodec::size(const std::string& wire_value)
 unsigned dccl::v2::DefaultStringCodec::max_size()
 {
     // string length + actual string
-    return min_size() + dccl_field_options().max_length() * BITS_IN_BYTE;
+    return min_size() + field_params().max_length * BITS_IN_BYTE;
 }
 
 unsigned dccl::v2::DefaultStringCodec::min_size()
@@ -205,6 +295,43 @@ dccl::Bitset dccl::v2::DefaultBytesCodec::encode(const std::string& wire_value)
     return bits;
 }
 
+void dccl::v2::DefaultBytesCodec::encode(BitWriter* writer)
+{
+    writer->write(0, min_size());
+}
+
+void dccl::v2::DefaultBytesCodec::encode(BitWriter* writer, const std::string& wire_value)
+{
+    const std::string::size_type max_length = field_params().max_length;
+    if(wire_value.size() > max_length && this->strict())
+        throw(dccl::OutOfRangeException(std::string("Bytes too long for field: ") + FieldCodecBase::this_field()->DebugString(), this->this_field()));
+
+    if(!use_required())
+        writer->write_bit(true); // presence bit
+
+    // truncate or zero pad to max_length
+    const std::string::size_type length = std::min(wire_value.size(), max_length);
+    writer->write_bytes(wire_value.data(), length);
+    writer->write(0, (max_length - length) * BITS_IN_BYTE);
+}
+
+std::string dccl::v2::DefaultBytesCodec::decode(BitReader* reader)
+{
+    std::string wire_value;
+    if(!try_decode(reader, &wire_value))
+        throw NullValueException();
+    return wire_value;
+}
+
+bool dccl::v2::DefaultBytesCodec::try_decode(BitReader* reader, std::string* wire_value)
+{
+    if(!use_required() && !reader->read_bit()) // presence bit
+        return false;
+
+    *wire_value = reader->read_bytes(field_params().max_length);
+    return true;
+}
+
 unsigned dccl::v2::DefaultBytesCodec::size()
 {
     return min_size();    
@@ -218,6 +345,14 @@ unsigned dccl::v2::DefaultBytesCodec::size(const std::string& wire_value)
 
 
 std::string dccl::v2::DefaultBytesCodec::decode(Bitset* bits)
+{
+    std::string wire_value;
+    if(!try_decode(bits, &wire_value))
+        throw NullValueException();
+    return wire_value;
+}
+
+bool dccl::v2::DefaultBytesCodec::try_decode(Bitset* bits, std::string* wire_value)
 {
     if(!use_required())
     {
@@ -230,22 +365,24 @@ std::string dccl::v2::DefaultBytesCodec::decode(Bitset* bits)
             bytes_body_bits >>= min_size();
             bytes_body_bits.resize(bits->size() - min_size());
         
-            return bytes_body_bits.to_byte_string();
+            *wire_value = bytes_body_bits.to_byte_string();
+            return true;
         }
         else
         {
-            throw NullValueException();
+            return false;
         }
     }
     else
     {
-        return bits->to_byte_string();
+        *wire_value = bits->to_byte_string();
+        return true;
     }
 }
 
 unsigned dccl::v2::DefaultBytesCodec::max_size()
 {
-    return dccl_field_options().max_length() * BITS_IN_BYTE +
+    return field_params().max_length * BITS_IN_BYTE +
         (use_required() ? 0 : 1); // presence bit?
 }
 
@@ -54,6 +54,8 @@ namespace dccl
             class DefaultNumericFieldCodec : public TypedFixedFieldCodec<WireType, FieldType>
             {
             public:
+              DefaultNumericFieldCodec()
+              { this->set_direct_io_type(typeid(DefaultNumericFieldCodec)); }
 
               virtual double max()
               { return FieldCodecBase::dccl_field_options().max(); }
@@ -95,43 +97,24 @@ namespace dccl
               {
                   return Bitset(size());
               }
+
+              void encode(BitWriter* writer)
+              {
+                  writer->write(0, size());
+              }
           
           
               virtual Bitset encode(const WireType& value)
               {
-                  // round first, before checking bounds
-                  WireType wire_value = dccl::round(value, precision());
-
-                  // check bounds
-                  if(wire_value < min() || wire_value > max())
-                  {
-                      // strict mode
-                      if(this->strict())
-                          throw(dccl::OutOfRangeException(std::string("Value exceeds min/max bounds for field: ") + FieldCodecBase::this_field()->DebugString(), this->this_field()));
-                      // non-strict (default): if out-of-bounds, send as zeros
-                      else
-                          return Bitset(size());
-                  }
-          
-                  wire_value -= dccl::round((WireType)min(), precision());
-
-                  if (precision() < 0) {
-                      wire_value /= (WireType)std::pow(10.0, -precision());
-                  } else if (precision() > 0) {
-                      wire_value *= (WireType)std::pow(10.0, precision());
-                  }
-
-                  dccl::uint64 uint_value = boost::numeric_cast<dccl::uint64>(dccl::round(wire_value, 0));
-
-                  // "presence" value (0)
-                  if(!FieldCodecBase::use_required())
-                      uint_value += 1;
-	  
-
                   Bitset encoded;
-                  encoded.from(uint_value, size());
+                  encoded.from(encode_value(value), size());
                   return encoded;
               }
+
+              virtual void encode(BitWriter* writer, const WireType& value)
+              {
+                  writer->write(encode_value(value), size());
+              }
           
               virtual WireType decode(Bitset* bits)
               {
@@ -139,39 +122,144 @@ namespace dccl
                   // dccl::uint64 t = bits->to<dccl::uint64>();
                   // But GCC3.3 requires an explicit template modifier on the method.
                   // See, e.g., http://gcc.gnu.org/bugzilla/show_bug.cgi?id=10959
-                  dccl::uint64 uint_value = (bits->template to<dccl::uint64>)();
+                  return decode_value((bits->template to<dccl::uint64>)());
+              }
+
+              virtual WireType decode(BitReader* reader)
+              {
+                  return decode_value(reader->read(size()));
+              }
+
+              virtual bool try_decode(Bitset* bits, WireType* value)
+              {
+                  return from_wire((bits->template to<dccl::uint64>)(), FieldCodecBase::field_params(), FieldCodecBase::use_required(), value);
+              }
+
+              virtual bool try_decode(BitReader* reader, WireType* value)
+              {
+                  return from_wire(reader->read(size()), FieldCodecBase::field_params(), FieldCodecBase::use_required(), value);
+              }
+
+              // bring size(const WireType&) into scope so callers can access it
+              using TypedFixedFieldCodec<WireType, FieldType>::size;
+
+              unsigned size()
+              {
+                  const FieldCodecParams params = FieldCodecBase::field_params();
+                  return FieldCodecBase::use_required() ? params.bits_required : params.bits_optional;
+              }
+
+            protected:
+              virtual void resolve_params(FieldCodecParams* params)
+              {
+                  FieldCodecBase::resolve_params(params);
+                  params->min = min();
+                  params->max = max();
+                  params->precision = precision();
+                  resolve_numeric_params(params);
+              }
+
+            public:
+              /// \brief Fills in the scale factors and encoded sizes of \a params from its min, max and precision
+              static void resolve_numeric_params(FieldCodecParams* params)
+              {
+                  params->scale = std::pow(10.0, params->precision);
+                  params->inverse_scale = std::pow(10.0, -params->precision);
+
+                  // if not required field, leave one value for unspecified (always encoded as 0)
+                  const double num_values = (params->max - params->min) * params->scale + 1;
+                  params->bits_required = dccl::ceil_log2(num_values);
+                  params->bits_optional = dccl::ceil_log2(num_values + 1);
+              }
 
-                  if(!FieldCodecBase::use_required())
+              /// \brief Converts \a value to the unsigned integer placed on the wire for the bounds in \a params
+              ///
+              /// \return false (and leaves uint_value unchanged) if the value is out of bounds
+              static bool to_wire(const WireType& value, const FieldCodecParams& params, bool required, dccl::uint64* uint_value)
+              {
+                  // round first, before checking bounds
+                  WireType wire_value = round_value(value, params);
+
+                  // check bounds
+                  if(wire_value < params.min || wire_value > params.max)
+                      return false;
+
+                  wire_value -= round_value((WireType)params.min, params);
+
+                  if (params.precision < 0) {
+                      wire_value /= (WireType)params.inverse_scale;
+                  } else if (params.precision > 0) {
+                      wire_value *= (WireType)params.scale;
+                  }
+
+                  *uint_value = boost::numeric_cast<dccl::uint64>(dccl::round(wire_value, 0));
+
+                  // "presence" value (0)
+                  if(!required)
+                      *uint_value += 1;
+
+                  return true;
+              }
+
+              /// \brief Converts the unsigned integer read from the wire back to the value, the inverse of to_wire()
+              ///
+              /// \return false if \a uint_value is the "not present" value of an optional field
+              static bool from_wire(dccl::uint64 uint_value, const FieldCodecParams& params, bool required, WireType* value)
+              {
+                  if(!required)
                   {
-                      if(!uint_value) throw NullValueException();
+                      if(!uint_value) return false;
                       --uint_value;
                   }
-	  
+
                   WireType wire_value = (WireType)uint_value;
 
-                  if (precision() < 0) {
-                      wire_value *= (WireType)std::pow(10.0, -precision());
-                  } else if (precision() > 0) {
-                      wire_value /= (WireType)std::pow(10.0, precision());
+                  if (params.precision < 0) {
+                      wire_value *= (WireType)params.inverse_scale;
+                  } else if (params.precision > 0) {
+                      wire_value /= (WireType)params.scale;
                   }
 
                   // round values again to properly handle cases where double precision
                   // leads to slightly off values (e.g. 2.099999999 instead of 2.1)
-                  wire_value = dccl::round(wire_value + dccl::round((WireType)min(), precision()),
-                                           precision());
-
-                  return wire_value;
+                  *value = round_value(wire_value + round_value((WireType)params.min, params), params);
+                  return true;
               }
 
-              // bring size(const WireType&) into scope so callers can access it
-              using TypedFixedFieldCodec<WireType, FieldType>::size;
+            private:
+              // same as dccl::round(value, precision), using the precomputed scale factors
+              static WireType round_value(WireType value, const FieldCodecParams& params)
+              { return round_value(value, params, boost::is_floating_point<WireType>()); }
 
-              unsigned size()
+              static WireType round_value(WireType value, const FieldCodecParams& params, boost::true_type)
+              { return dccl::round(value * (WireType)params.scale) / (WireType)params.scale; }
+
+              static WireType round_value(WireType value, const FieldCodecParams& params, boost::false_type)
+              { return params.precision >= 0 ? value : dccl::round(value, (int)params.precision); }
+
+              // converts the value to the unsigned integer placed on the wire
+              dccl::uint64 encode_value(const WireType& value)
               {
-                  // if not required field, leave one value for unspecified (always encoded as 0)
-                  unsigned NULL_VALUE = FieldCodecBase::use_required() ? 0 : 1;
-              
-                  return dccl::ceil_log2((max()-min())*std::pow(10.0, precision())+1 + NULL_VALUE);
+                  dccl::uint64 uint_value = 0;
+                  if(!to_wire(value, FieldCodecBase::field_params(), FieldCodecBase::use_required(), &uint_value))
+                  {
+                      // strict mode
+                      if(this->strict())
+                          throw(dccl::OutOfRangeException(std::string("Value exceeds min/max bounds for field: ") + FieldCodecBase::this_field()->DebugString(), this->this_field()));
+                      // non-strict (default): if out-of-bounds, send as zeros
+                      else
+                          return 0;
+                  }
+                  return uint_value;
+              }
+
+              // converts the unsigned integer read from the wire back to the value
+              WireType decode_value(dccl::uint64 uint_value)
+              {
+                  WireType value;
+                  if(!from_wire(uint_value, FieldCodecBase::field_params(), FieldCodecBase::use_required(), &value))
+                      throw NullValueException();
+                  return value;
               }
             
             };
@@ -181,10 +269,20 @@ namespace dccl
         /// [presence bit (0 bits if required, 1 bit if optional)][value (1 bit)]
         class DefaultBoolCodec : public TypedFixedFieldCodec<bool>
         {
+          public:
+            DefaultBoolCodec()
+            { set_direct_io_type(typeid(DefaultBoolCodec)); }
+
           private:
             Bitset encode(const bool& wire_value);
             Bitset encode();
             bool decode(Bitset* bits);
+            void encode(BitWriter* writer, const bool& wire_value);
+            void encode(BitWriter* writer);
+            bool decode(BitReader* reader);
+            bool try_decode(Bitset* bits, bool* wire_value);
+            bool try_decode(BitReader* reader, bool* wire_value);
+            bool decode_value(unsigned long t, bool* wire_value);
             unsigned size();
             void validate();
         };
@@ -194,10 +292,19 @@ namespace dccl
         /// [length of following string (1 byte)][string (0-255 bytes)]
         class DefaultStringCodec : public TypedFieldCodec<std::string>
         {
+          public:
+            DefaultStringCodec()
+            { set_direct_io_type(typeid(DefaultStringCodec)); }
+
           private:
             Bitset encode();
             Bitset encode(const std::string& wire_value);
             std::string decode(Bitset* bits);
+            void encode(BitWriter* writer);
+            void encode(BitWriter* writer, const std::string& wire_value);
+            std::string decode(BitReader* reader);
+            bool try_decode(Bitset* bits, std::string* wire_value);
+            bool try_decode(BitReader* reader, std::string* wire_value);
             unsigned size();
             unsigned size(const std::string& wire_value);
             unsigned max_size();
@@ -212,10 +319,19 @@ namespace dccl
         /// \brief Provides an fixed length byte string encoder.        
         class DefaultBytesCodec : public TypedFieldCodec<std::string>
         {
+          public:
+            DefaultBytesCodec()
+            { set_direct_io_type(typeid(DefaultBytesCodec)); }
+
           private:
             Bitset encode();
             Bitset encode(const std::string& wire_value);
             std::string decode(Bitset* bits);
+            void encode(BitWriter* writer);
+            void encode(BitWriter* writer, const std::string& wire_value);
+            std::string decode(BitReader* reader);
+            bool try_decode(Bitset* bits, std::string* wire_value);
+            bool try_decode(BitReader* reader, std::string* wire_value);
             unsigned size();
             unsigned size(const std::string& wire_value);
             unsigned max_size();
@@ -228,6 +344,9 @@ namespace dccl
             : public DefaultNumericFieldCodec<int32, const google::protobuf::EnumValueDescriptor*>
         {
           public:
+            DefaultEnumCodec()
+            { set_direct_io_type(typeid(DefaultEnumCodec)); }
+
             int32 pre_encode(const google::protobuf::EnumValueDescriptor* const& field_value);
             const google::protobuf::EnumValueDescriptor* post_decode(const int32& wire_value);
 
@@ -308,26 +427,46 @@ namespace dccl
             class TimeCodec : public TimeCodecBase<TimeType, 0>
         { BOOST_STATIC_ASSERT(sizeof(TimeCodec) == 0); };
     
-        template<> class TimeCodec<uint64> : public TimeCodecBase<uint64, 1000000> { };
-        template<> class TimeCodec<int64> : public TimeCodecBase<int64, 1000000> { };
-        template<> class TimeCodec<double> : public TimeCodecBase<double, 1> { };
+        template<> class TimeCodec<uint64> : public TimeCodecBase<uint64, 1000000>
+        { public: TimeCodec() { set_direct_io_type(typeid(TimeCodec)); } };
+        template<> class TimeCodec<int64> : public TimeCodecBase<int64, 1000000>
+        { public: TimeCodec() { set_direct_io_type(typeid(TimeCodec)); } };
+        template<> class TimeCodec<double> : public TimeCodecBase<double, 1>
+        { public: TimeCodec() { set_direct_io_type(typeid(TimeCodec)); } };
     
     
         /// \brief Placeholder codec that takes no space on the wire (0 bits).
         template<typename T>
             class StaticCodec : public TypedFixedFieldCodec<T>
         {
+          public:
+            StaticCodec()
+            { this->set_direct_io_type(typeid(StaticCodec)); }
+
+          private:
             Bitset encode(const T&)
             { return Bitset(size()); }
 
             Bitset encode()
             { return Bitset(size()); }
 
+            void encode(BitWriter*, const T&)
+            { }
+
+            void encode(BitWriter*)
+            { }
+
             T decode(Bitset* bits)
             {
                 return boost::lexical_cast<T>(
                     FieldCodecBase::dccl_field_options().static_value());
             }
+
+            T decode(BitReader* reader)
+            {
+                return boost::lexical_cast<T>(
+                    FieldCodecBase::dccl_field_options().static_value());
+            }
             
             unsigned size()
             { return 0; }
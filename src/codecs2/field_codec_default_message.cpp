@@ -31,9 +31,22 @@ using dccl::dlog;
 void dccl::v2::DefaultMessageCodec::any_encode(Bitset* bits, const boost::any& wire_value)
 {
     if(wire_value.empty())
+    {
         *bits = Bitset(min_size());
+    }
+    else
+    {
+        *bits = Bitset();
+        traverse_const_message<Encoder>(wire_value, bits);
+    }
+}
+
+void dccl::v2::DefaultMessageCodec::any_encode(BitWriter* writer, const boost::any& wire_value)
+{
+    if(wire_value.empty())
+        writer->write(0, min_size());
     else
-        *bits = traverse_const_message<Encoder, Bitset>(wire_value);
+        traverse_const_message<Encoder>(wire_value, writer);
 }
   
 
@@ -41,13 +54,30 @@ void dccl::v2::DefaultMessageCodec::any_encode(Bitset* bits, const boost::any& w
 unsigned dccl::v2::DefaultMessageCodec::any_size(const boost::any& wire_value)
 {
     if(wire_value.empty())
+    {
         return min_size();
+    }
     else
-        return traverse_const_message<Size, unsigned>(wire_value);
+    {
+        unsigned size = 0;
+        traverse_const_message<Size>(wire_value, &size);
+        return size;
+    }
 }
 
 
 void dccl::v2::DefaultMessageCodec::any_decode(Bitset* bits, boost::any* wire_value)
+{
+    decode_message(bits, wire_value);
+}
+
+void dccl::v2::DefaultMessageCodec::any_decode(BitReader* reader, boost::any* wire_value)
+{
+    decode_message(reader, wire_value);
+}
+
+template<typename BitSource>
+void dccl::v2::DefaultMessageCodec::decode_message(BitSource* bits, boost::any* wire_value)
 {
     try
     {
@@ -57,18 +87,21 @@ void dccl::v2::DefaultMessageCodec::any_decode(Bitset* bits, boost::any* wire_va
         const google::protobuf::Descriptor* desc = msg->GetDescriptor();
         const google::protobuf::Reflection* refl = msg->GetReflection();
         
-        for(int i = 0, n = desc->field_count(); i < n; ++i)
+        internal::MessagePlan scratch;
+        const internal::MessagePlan& plan = current_plan(desc, &scratch);
+        internal::PlannedFieldScope planned_scope;
+        // stops early if a non-throwing BitReader runs out of bits (see Codec::try_decode())
+        int i = 0;
+        for(const int n = plan.fields.size(); i < n && !overrun(bits); ++i)
         {
-        
-            const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
+            const google::protobuf::FieldDescriptor* field_desc = plan.fields[i].field;
+            const boost::shared_ptr<FieldCodecBase>& codec = plan.fields[i].codec;
+            const boost::shared_ptr<internal::FromProtoCppTypeBase>& helper = plan.fields[i].helper;
 
-            if(!check_field(field_desc))
-                continue;
+            internal::set_planned_field(plan.fields[i]);
 
-            
-            boost::shared_ptr<FieldCodecBase> codec = find(field_desc);            
-            boost::shared_ptr<internal::FromProtoCppTypeBase> helper =
-                internal::TypeHelper::find(field_desc);
+            if(plan.fields[i].typed && decode_typed(codec, bits, msg, field_desc))
+                continue;
 
             if(field_desc->is_repeated())
             {   
@@ -112,6 +145,9 @@ void dccl::v2::DefaultMessageCodec::any_decode(Bitset* bits, boost::any* wire_va
             } 
         }
 
+        if(i && overrun(bits) && internal::TraversalContext::current())
+            internal::TraversalContext::current()->record_error_field(plan.fields[i-1].field);
+
         std::vector< const google::protobuf::FieldDescriptor* > set_fields;
         refl->ListFields(*msg, &set_fields);
         if(set_fields.empty() && this_field()) *wire_value = boost::any();
@@ -144,6 +180,75 @@ void dccl::v2::DefaultMessageCodec::validate()
 {
     bool b = false;
     traverse_descriptor<Validate>(&b);
+
+    // validate() is called by Codec::load() for every message in both parts,
+    // so resolve the codecs for encoding and decoding now
+    const google::protobuf::Descriptor* desc = FieldCodecBase::this_descriptor();
+    internal::MessagePlan plan;
+    compile_plan(desc, &plan, true);
+    plans_.insert(desc, plan);
+}
+
+const dccl::internal::MessagePlan& dccl::v2::DefaultMessageCodec::current_plan(const google::protobuf::Descriptor* desc, internal::MessagePlan* scratch)
+{
+    // handed the plan by the parent message codec's own plan (see compile_plan)
+    const internal::PlannedField* planned = internal::planned_field(this, this_field());
+    if(planned && planned->nested && planned->field->message_type() == desc && planned->nested->dependencies.current())
+    {
+        internal::DependencyScope::record(planned->nested->dependencies);
+        return *planned->nested;
+    }
+
+    if(const internal::MessagePlan* plan = plans_.find(desc))
+    {
+        // whatever is computed from this message (e.g. the sizes of its parent) depends on the same codecs
+        internal::DependencyScope::record(plan->dependencies);
+        return *plan;
+    }
+
+    compile_plan(desc, scratch, false);
+    return *scratch;
+}
+
+void dccl::v2::DefaultMessageCodec::compile_plan(const google::protobuf::Descriptor* desc, internal::MessagePlan* plan, bool cached)
+{
+    internal::DependencyScope dependencies(&plan->dependencies);
+    plan->fields.clear();
+    for(int i = 0, n = desc->field_count(); i < n; ++i)
+    {
+        const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
+
+        if(!check_field(field_desc))
+            continue;
+
+        internal::PlannedField planned;
+        planned.field = field_desc;
+        planned.codec = find(field_desc);
+        planned.helper = internal::TypeHelper::find(field_desc);
+        planned.typed = field_desc->cpp_type() != google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE &&
+            planned.codec->field_supports_typed(field_desc);
+        planned.compiled = false;
+        planned.params = planned.codec->field_resolved_params(field_desc);
+        planned.sized = false;
+        planned.min_bits = 0;
+        planned.max_bits = 0;
+        planned.nested = 0;
+        if(cached)
+        {
+            planned.codec->field_min_size(&planned.min_bits, field_desc);
+            planned.codec->field_max_size(&planned.max_bits, field_desc);
+            planned.sized = true;
+
+            DefaultMessageCodec* message_codec = dynamic_cast<DefaultMessageCodec*>(planned.codec.get());
+            if(message_codec && field_desc->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+            {
+                // validated (and so cached) before this plan, under the key the field's traversal will use
+                internal::MessageStack msg_handler(field_desc);
+                planned.nested = message_codec->plans_.find(field_desc->message_type());
+            }
+        }
+        plan->fields.push_back(planned);
+    }
 }
 
 std::string dccl::v2::DefaultMessageCodec::info()
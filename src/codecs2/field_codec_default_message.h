@@ -24,6 +24,7 @@
 
 #include "dccl/field_codec.h"
 #include "dccl/field_codec_manager.h"
+#include "dccl/internal/message_plan.h"
 
 #include "dccl/option_extensions.pb.h"
 
@@ -38,6 +39,8 @@ namespace dccl
             
             void any_encode(Bitset* bits, const boost::any& wire_value);
             void any_decode(Bitset* bits, boost::any* wire_value); 
+            void any_encode(BitWriter* writer, const boost::any& wire_value);
+            void any_decode(BitReader* reader, boost::any* wire_value);
             unsigned max_size();
             unsigned min_size();
             unsigned any_size(const boost::any& wire_value);
@@ -53,9 +56,16 @@ namespace dccl
             std::string info();
             bool check_field(const google::protobuf::FieldDescriptor* field);
 
+            // fields (and their codecs) of desc to encode or decode in the current traversal:
+            // the plan compiled by validate() if available, otherwise compiled into scratch
+            const internal::MessagePlan& current_plan(const google::protobuf::Descriptor* desc,
+                                                      internal::MessagePlan* scratch);
+            // if cached (the plan is kept by validate()), also resolves the sizes and embedded message plans of the fields
+            void compile_plan(const google::protobuf::Descriptor* desc, internal::MessagePlan* plan, bool cached);
+
             struct Size
             {
-                static void repeated(boost::shared_ptr<FieldCodecBase> codec,
+                static void repeated(const boost::shared_ptr<FieldCodecBase>& codec,
                                      unsigned* return_value,
                                      const std::vector<boost::any>& field_values,
                                      const google::protobuf::FieldDescriptor* field_desc)
@@ -63,33 +73,63 @@ namespace dccl
                         codec->field_size_repeated(return_value, field_values, field_desc);
                     }
                 
-                static void single(boost::shared_ptr<FieldCodecBase> codec,
+                static void single(const boost::shared_ptr<FieldCodecBase>& codec,
                                    unsigned* return_value,
                                    const boost::any& field_value,
                                    const google::protobuf::FieldDescriptor* field_desc)
                     {
                         codec->field_size(return_value, field_value, field_desc);
                     }
+
+
+                static bool typed(const boost::shared_ptr<FieldCodecBase>& codec,
+                                  unsigned* return_value,
+                                  const google::protobuf::Message& msg,
+                                  const google::protobuf::FieldDescriptor* field_desc)
+                    {
+                        codec->field_size_typed(return_value, msg, field_desc);
+                        return true;
+                    }
                 
             };
             
+            // BitSink is Bitset or BitWriter
             struct Encoder
             {
-                static void repeated(boost::shared_ptr<FieldCodecBase> codec,
-                                     Bitset* return_value,
+                template<typename BitSink>
+                static void repeated(const boost::shared_ptr<FieldCodecBase>& codec,
+                                     BitSink* return_value,
                                      const std::vector<boost::any>& field_values,
                                      const google::protobuf::FieldDescriptor* field_desc)
                     {
                         codec->field_encode_repeated(return_value, field_values, field_desc);
                     }
                 
-                static void single(boost::shared_ptr<FieldCodecBase> codec,
-                                   Bitset* return_value,
+                template<typename BitSink>
+                static void single(const boost::shared_ptr<FieldCodecBase>& codec,
+                                   BitSink* return_value,
                                    const boost::any& field_value,
                                    const google::protobuf::FieldDescriptor* field_desc)
                     {
                         codec->field_encode(return_value, field_value, field_desc);
                     }
+
+
+                // the typed path writes directly to a BitWriter only
+                static bool typed(const boost::shared_ptr<FieldCodecBase>& codec,
+                                  BitWriter* return_value,
+                                  const google::protobuf::Message& msg,
+                                  const google::protobuf::FieldDescriptor* field_desc)
+                    {
+                        codec->field_encode_typed(return_value, msg, field_desc);
+                        return true;
+                    }
+
+                static bool typed(const boost::shared_ptr<FieldCodecBase>& codec,
+                                  Bitset* return_value,
+                                  const google::protobuf::Message& msg,
+                                  const google::protobuf::FieldDescriptor* field_desc)
+                    { return false; }
             };
 
             struct MaxSize
@@ -151,26 +191,50 @@ namespace dccl
             }
             
 
+            // BitSource is Bitset or BitReader
+            template<typename BitSource>
+                void decode_message(BitSource* bits, boost::any* wire_value);
+
+            static bool overrun(const BitReader* reader) { return reader->overrun(); }
+            static bool overrun(const Bitset* bits) { return false; }
+
+            // decodes directly into msg if bits is a BitReader, otherwise returns false
+            static bool decode_typed(const boost::shared_ptr<FieldCodecBase>& codec,
+                                     BitReader* reader,
+                                     google::protobuf::Message* msg,
+                                     const google::protobuf::FieldDescriptor* field_desc)
+            {
+                codec->field_decode_typed(reader, msg, field_desc);
+                return true;
+            }
+
+            static bool decode_typed(const boost::shared_ptr<FieldCodecBase>& codec,
+                                     Bitset* bits,
+                                     google::protobuf::Message* msg,
+                                     const google::protobuf::FieldDescriptor* field_desc)
+            { return false; }
+
             template<typename Action, typename ReturnType>
-                ReturnType traverse_const_message(const boost::any& wire_value)
+                void traverse_const_message(const boost::any& wire_value, ReturnType* return_value)
             {
                 try
                 {
-                    ReturnType return_value = ReturnType();
-       
                     const google::protobuf::Message* msg = boost::any_cast<const google::protobuf::Message*>(wire_value);
                     const google::protobuf::Descriptor* desc = msg->GetDescriptor();
                     const google::protobuf::Reflection* refl = msg->GetReflection();
-                    for(int i = 0, n = desc->field_count(); i < n; ++i)
-                    {       
-                        const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
+                    internal::MessagePlan scratch;
+                    const internal::MessagePlan& plan = current_plan(desc, &scratch);
+                    internal::PlannedFieldScope planned_scope;
+                    for(int i = 0, n = plan.fields.size(); i < n; ++i)
+                    {
+                        const google::protobuf::FieldDescriptor* field_desc = plan.fields[i].field;
+                        const boost::shared_ptr<FieldCodecBase>& codec = plan.fields[i].codec;
+                        const boost::shared_ptr<internal::FromProtoCppTypeBase>& helper = plan.fields[i].helper;
+
+                        internal::set_planned_field(plan.fields[i]);
 
-                        if(!check_field(field_desc))
+                        if(plan.fields[i].typed && Action::typed(codec, return_value, *msg, field_desc))
                             continue;
-           
-                        boost::shared_ptr<FieldCodecBase> codec = find(field_desc);
-                        boost::shared_ptr<internal::FromProtoCppTypeBase> helper =
-                            internal::TypeHelper::find(field_desc);
             
             
                         if(field_desc->is_repeated())
@@ -179,14 +243,13 @@ namespace dccl
                             for(int j = 0, m = refl->FieldSize(*msg, field_desc); j < m; ++j)
                                 field_values.push_back(helper->get_repeated_value(field_desc, *msg, j));
                    
-                            Action::repeated(codec, &return_value, field_values, field_desc);
+                            Action::repeated(codec, return_value, field_values, field_desc);
                         }
                         else
                         {
-                            Action::single(codec, &return_value, helper->get_value(field_desc, *msg), field_desc);
+                            Action::single(codec, return_value, helper->get_value(field_desc, *msg), field_desc);
                         }
                     }
-                    return return_value;
                 }
                 catch(boost::bad_any_cast& e)
                 {
@@ -194,6 +257,8 @@ namespace dccl
                 }
                 
             }
+
+            internal::MessagePlanCache plans_;
         };
 
     }
@@ -0,0 +1,55 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include "dccl/codecs3/field_codec_compiled_message.h"
+
+//
+// CompiledCodecRegistry
+//
+
+void dccl::internal::CompiledCodecRegistry::add(AddFunction add_codec)
+{
+    if(loaded())
+        add_codec();
+    else
+        pending().push_back(add_codec);
+}
+
+void dccl::internal::CompiledCodecRegistry::load()
+{
+    loaded() = true;
+    for(std::vector<AddFunction>::const_iterator it = pending().begin(), end = pending().end(); it != end; ++it)
+        (*it)();
+    pending().clear();
+}
+
+// function local statics, as compiled codecs are usually added during static initialization
+std::vector<dccl::internal::CompiledCodecRegistry::AddFunction>& dccl::internal::CompiledCodecRegistry::pending()
+{
+    static std::vector<AddFunction> pending_codecs;
+    return pending_codecs;
+}
+
+bool& dccl::internal::CompiledCodecRegistry::loaded()
+{
+    static bool defaults_loaded = false;
+    return defaults_loaded;
+}
@@ -0,0 +1,199 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLFIELDCODECCOMPILEDMESSAGE20261018H
+#define DCCLFIELDCODECCOMPILEDMESSAGE20261018H
+
+#include <typeinfo>
+#include <vector>
+
+#include "dccl/codec.h"
+#include "dccl/codecs3/field_codec_default.h"
+#include "dccl/codecs3/field_codec_default_message.h"
+
+namespace dccl
+{
+    namespace internal
+    {
+        /// \brief Holds the compiled message codecs created (usually during static initialization) before the default codecs are loaded into the FieldCodecManager.
+        class CompiledCodecRegistry
+        {
+          public:
+            typedef void (*AddFunction)();
+
+            /// \brief Calls \a add_codec now if the default codecs are loaded, otherwise once they are
+            static void add(AddFunction add_codec);
+
+            /// \brief Called by Codec once the default codecs are loaded
+            static void load();
+
+          private:
+            static std::vector<AddFunction>& pending();
+            static bool& loaded();
+        };
+    }
+
+    namespace v3
+    {
+        /// \brief Base class for message codecs compiled ahead of time for the message type ProtobufMessage (as generated by protoc-gen-dccl with the `compiled` parameter).
+        ///
+        /// The compiled codec is used in place of DefaultMessageCodec for ProtobufMessage (see CompiledMessageCodecRegistrar). Fields that the child class compiles are encoded, decoded and sized through the generated accessors and a layout resolved from the (dccl.field) options when the codec is constructed, without Reflection, boost::any or codec lookups. Every other field (repeated, string, embedded message, custom codec, etc.) falls back to its codec, exactly as DefaultMessageCodec does, so the two produce the same bits.
+        ///
+        /// A compiled field is only used if the codec that DefaultMessageCodec would otherwise use for it is the one the layout was compiled for (see is_codec()), and only for messages whose C++ type is ProtobufMessage (not, e.g. a google::protobuf::DynamicMessage of the same type).
+        template<typename ProtobufMessage>
+        class CompiledMessageCodec : public DefaultMessageCodec
+        {
+          public:
+            typedef ProtobufMessage message_type;
+
+          protected:
+            /// \name Implemented by the compiled codec
+            //@{
+            /// \brief Whether \a field is compiled, given the \a codec that would otherwise be used for it
+            virtual bool field_compiled(const google::protobuf::FieldDescriptor* field, const FieldCodecBase& codec) = 0;
+            /// \brief Encode the compiled \a field of \a msg
+            virtual void encode_field(BitWriter* writer, const ProtobufMessage& msg, const google::protobuf::FieldDescriptor* field) = 0;
+            /// \brief Decode the compiled \a field into \a msg
+            virtual void decode_field(BitReader* reader, ProtobufMessage* msg, const google::protobuf::FieldDescriptor* field) = 0;
+            /// \brief Encoded size (in bits) of the compiled \a field of \a msg
+            virtual unsigned field_bits(const ProtobufMessage& msg, const google::protobuf::FieldDescriptor* field) = 0;
+            //@}
+
+            /// \name Helpers for the compiled codec
+            //@{
+            /// \brief True if \a codec is exactly of type FieldCodec (not a child of it, as that may change the layout)
+            template<typename FieldCodec>
+                static bool is_codec(const FieldCodecBase& codec)
+            { return typeid(codec) == typeid(FieldCodec); }
+
+            /// \brief Layout of a field using DefaultNumericFieldCodec (or DefaultEnumCodec) with these bounds
+            static FieldCodecParams numeric_params(double min, double max, double precision)
+            {
+                FieldCodecParams params = FieldCodecParams();
+                params.min = min;
+                params.max = max;
+                params.precision = precision;
+                v2::DefaultNumericFieldCodec<double>::resolve_numeric_params(&params);
+                return params;
+            }
+
+            static unsigned numeric_bits(const FieldCodecParams& params, bool required)
+            { return required ? params.bits_required : params.bits_optional; }
+
+            /// \brief Same encoding as DefaultNumericFieldCodec<WireType> (and DefaultEnumCodec, given the enumeration index or value)
+            template<typename WireType>
+                static void encode_numeric(BitWriter* writer, bool has_value, const WireType& value,
+                                           const FieldCodecParams& params, bool required,
+                                           const google::protobuf::FieldDescriptor* field)
+            {
+                dccl::uint64 uint_value = 0;
+                if(has_value && !DefaultNumericFieldCodec<WireType>::to_wire(value, params, required, &uint_value) && strict())
+                    throw(dccl::OutOfRangeException(std::string("Value exceeds min/max bounds for field: ") + field->DebugString(), field));
+                writer->write(uint_value, numeric_bits(params, required));
+            }
+
+            /// \brief Inverse of encode_numeric()
+            ///
+            /// \return false if the field was not present
+            template<typename WireType>
+                static bool decode_numeric(BitReader* reader, const FieldCodecParams& params, bool required, WireType* value)
+            {
+                return DefaultNumericFieldCodec<WireType>::from_wire(reader->read(numeric_bits(params, required)),
+                                                                     params, required, value);
+            }
+
+            static unsigned bool_bits(bool required)
+            { return required ? 1 : 2; }
+
+            /// \brief Same encoding as DefaultBoolCodec
+            static void encode_bool(BitWriter* writer, bool has_value, bool value, bool required)
+            {
+                const unsigned wire_value = has_value ? (required ? value : value + 1) : 0;
+                writer->write(wire_value, bool_bits(required));
+            }
+
+            /// \brief Inverse of encode_bool()
+            ///
+            /// \return false if the field was not present
+            static bool decode_bool(BitReader* reader, bool required, bool* value)
+            {
+                dccl::uint64 wire_value = reader->read(bool_bits(required));
+                if(!required)
+                {
+                    if(!wire_value)
+                        return false;
+                    --wire_value;
+                }
+                *value = wire_value;
+                return true;
+            }
+            //@}
+
+          private:
+            bool compiled(const google::protobuf::FieldDescriptor* field, const FieldCodecBase& codec)
+            {
+                return field->containing_type() == ProtobufMessage::descriptor() && field_compiled(field, codec);
+            }
+
+            bool compiled_encode(BitWriter* writer, const google::protobuf::Message& msg, const google::protobuf::FieldDescriptor* field)
+            {
+                if(typeid(msg) != typeid(ProtobufMessage))
+                    return false;
+                encode_field(writer, static_cast<const ProtobufMessage&>(msg), field);
+                return true;
+            }
+
+            bool compiled_decode(BitReader* reader, google::protobuf::Message* msg, const google::protobuf::FieldDescriptor* field)
+            {
+                if(typeid(*msg) != typeid(ProtobufMessage))
+                    return false;
+                decode_field(reader, static_cast<ProtobufMessage*>(msg), field);
+                return true;
+            }
+
+            bool compiled_size(unsigned* bit_size, const google::protobuf::Message& msg, const google::protobuf::FieldDescriptor* field)
+            {
+                if(typeid(msg) != typeid(ProtobufMessage))
+                    return false;
+                *bit_size += field_bits(static_cast<const ProtobufMessage&>(msg), field);
+                return true;
+            }
+        };
+
+        /// \brief Adds the compiled message codec CompiledCodec (a child of CompiledMessageCodec) for its message type once the default codecs are loaded. Generated code declares one of these at namespace scope for each compiled message.
+        template<typename CompiledCodec>
+        class CompiledMessageCodecRegistrar
+        {
+          public:
+            CompiledMessageCodecRegistrar()
+            { internal::CompiledCodecRegistry::add(&add_codec); }
+
+          private:
+            static void add_codec()
+            {
+                FieldCodecManager::add<CompiledCodec>(Codec::default_codec_name(3),
+                                                      CompiledCodec::message_type::descriptor());
+            }
+        };
+    }
+}
+
+#endif
@@ -35,13 +35,13 @@ dccl::Bitset dccl::v3::DefaultStringCodec::encode()
 dccl::Bitset dccl::v3::DefaultStringCodec::encode(const std::string& wire_value)
 {
     std::string s = wire_value;
-    if(s.size() > dccl_field_options().max_length())
+    if(s.size() > field_params().max_length)
     {
         if(this->strict())
             throw(dccl::OutOfRangeException(std::string("String too long for field: ") + FieldCodecBase::this_field()->DebugString(), this->this_field()));
                 
         dccl::dlog.is(DEBUG2) && dccl::dlog << "String " << s <<  " exceeds `dccl.max_length`, truncating" << std::endl;
-        s.resize(dccl_field_options().max_length()); 
+        s.resize(field_params().max_length); 
     }
         
             
@@ -65,7 +65,59 @@ dccl::Bitset dccl::v3::DefaultStringCodec::encode(const std::string& wire_value)
     return length_bits;
 }
 
+void dccl::v3::DefaultStringCodec::encode(BitWriter* writer)
+{
+    writer->write(0, min_size());
+}
+
+void dccl::v3::DefaultStringCodec::encode(BitWriter* writer, const std::string& wire_value)
+{
+    std::string::size_type length = wire_value.size();
+    if(length > field_params().max_length)
+    {
+        if(this->strict())
+            throw(dccl::OutOfRangeException(std::string("String too long for field: ") + FieldCodecBase::this_field()->DebugString(), this->this_field()));
+
+        dccl::dlog.is(DEBUG2) && dccl::dlog << "String " << wire_value <<  " exceeds `dccl.max_length`, truncating" << std::endl;
+        length = field_params().max_length;
+    }
+
+    writer->write(length, min_size());
+    writer->write_bytes(wire_value.data(), length);
+}
+
+std::string dccl::v3::DefaultStringCodec::decode(BitReader* reader)
+{
+    std::string wire_value;
+    if(!try_decode(reader, &wire_value))
+        throw NullValueException();
+    return wire_value;
+}
+
 std::string dccl::v3::DefaultStringCodec::decode(Bitset* bits)
+{
+    std::string wire_value;
+    if(!try_decode(bits, &wire_value))
+        throw NullValueException();
+    return wire_value;
+}
+
+bool dccl::v3::DefaultStringCodec::try_decode(BitReader* reader, std::string* wire_value)
+{
+    unsigned value_length = reader->read(min_size());
+
+    if(value_length)
+    {
+        *wire_value = reader->read_bytes(value_length);
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+bool dccl::v3::DefaultStringCodec::try_decode(Bitset* bits, std::string* wire_value)
 {
     unsigned value_length = bits->to_ulong();
     
@@ -87,11 +139,12 @@ std::string dccl::v3::DefaultStringCodec::decode(Bitset* bits)
         string_body_bits >>= header_length;
         string_body_bits.resize(bits->size() - header_length);
     
-        return string_body_bits.to_byte_string();
+        *wire_value = string_body_bits.to_byte_string();
+        return true;
     }
     else
     {
-        throw NullValueException();
+        return false;
     }
     
 }
@@ -110,12 +163,12 @@ unsigned dccl::v3::DefaultStringCodec::size(const std::string& wire_value)
 unsigned dccl::v3::DefaultStringCodec::max_size()
 {
     // string length + actual string
-    return min_size() + dccl_field_options().max_length() * BITS_IN_BYTE;
+    return min_size() + field_params().max_length * BITS_IN_BYTE;
 }
 
 unsigned dccl::v3::DefaultStringCodec::min_size()
 {
-    return dccl::ceil_log2(dccl_field_options().max_length()+1);
+    return dccl::ceil_log2(field_params().max_length+1);
 }
 
 
@@ -33,7 +33,12 @@ namespace dccl
     {
 	// all these are the same as version 2
         template<typename WireType, typename FieldType = WireType>
-            class DefaultNumericFieldCodec : public v2::DefaultNumericFieldCodec<WireType, FieldType> { };
+            class DefaultNumericFieldCodec : public v2::DefaultNumericFieldCodec<WireType, FieldType>
+        {
+          public:
+            DefaultNumericFieldCodec()
+            { this->set_direct_io_type(typeid(DefaultNumericFieldCodec)); }
+        };
 
         typedef v2::DefaultBoolCodec DefaultBoolCodec;
         typedef v2::DefaultBytesCodec DefaultBytesCodec;
@@ -49,6 +54,9 @@ namespace dccl
             : public DefaultNumericFieldCodec<int32, const google::protobuf::EnumValueDescriptor*>
         {
           public:
+            DefaultEnumCodec()
+            { set_direct_io_type(typeid(DefaultEnumCodec)); }
+
             int32 pre_encode(const google::protobuf::EnumValueDescriptor* const& field_value);
             const google::protobuf::EnumValueDescriptor* post_decode(const int32& wire_value);
             void validate() { }
@@ -63,13 +71,20 @@ namespace dccl
             class TimeCodec : public v2::TimeCodecBase<TimeType, 0>
         { BOOST_STATIC_ASSERT(sizeof(TimeCodec) == 0); };
 
-        template<> class TimeCodec<uint64> : public v2::TimeCodecBase<uint64, 1000000> { };
-        template<> class TimeCodec<int64> : public v2::TimeCodecBase<int64, 1000000> { };
-        template<> class TimeCodec<double> : public v2::TimeCodecBase<double, 1> { };
+        template<> class TimeCodec<uint64> : public v2::TimeCodecBase<uint64, 1000000>
+        { public: TimeCodec() { set_direct_io_type(typeid(TimeCodec)); } };
+        template<> class TimeCodec<int64> : public v2::TimeCodecBase<int64, 1000000>
+        { public: TimeCodec() { set_direct_io_type(typeid(TimeCodec)); } };
+        template<> class TimeCodec<double> : public v2::TimeCodecBase<double, 1>
+        { public: TimeCodec() { set_direct_io_type(typeid(TimeCodec)); } };
     
         template<typename T>
             class StaticCodec : public v2::StaticCodec<T>
-        { };
+        {
+          public:
+            StaticCodec()
+            { this->set_direct_io_type(typeid(StaticCodec)); }
+        };
 
 
         /// \brief Provides an variable length ASCII string encoder.
@@ -77,10 +92,19 @@ namespace dccl
         /// [length of following string size: ceil(log2(max_length))][string]
         class DefaultStringCodec : public TypedFieldCodec<std::string>
         {
+        public:
+            DefaultStringCodec()
+            { set_direct_io_type(typeid(DefaultStringCodec)); }
+
         private:
             Bitset encode();
             Bitset encode(const std::string& wire_value);
             std::string decode(Bitset* bits);
+            void encode(BitWriter* writer);
+            void encode(BitWriter* writer, const std::string& wire_value);
+            std::string decode(BitReader* reader);
+            bool try_decode(Bitset* bits, std::string* wire_value);
+            bool try_decode(BitReader* reader, std::string* wire_value);
             unsigned size();
             unsigned size(const std::string& wire_value);
             unsigned max_size();
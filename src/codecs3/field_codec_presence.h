@@ -66,6 +66,7 @@ namespace dccl
         public:
             PresenceBitCodec() {
                 _inner_codec.set_force_use_required(true);
+                this->set_direct_io_type(typeid(PresenceBitCodec));
             }
 
             // required when wire_type != field_type
@@ -80,10 +81,11 @@ namespace dccl
                 return _inner_codec.post_decode(wire_value);
             }
 
-            /// Calls _inner_codec.validate()
+            /// Validates the field with _inner_codec (which also resolves the inner codec's parameters for this field)
             virtual void validate()
             {
-                _inner_codec.validate();
+                bool b;
+                _inner_codec.field_validate(&b, this->this_field());
             }
 
             /// Encodes an empty field as a single 0 bit
@@ -103,8 +105,60 @@ namespace dccl
                 return encoded;
             }
 
+            /// Encodes an empty field as a single 0 bit
+            virtual void encode(BitWriter* writer)
+            {
+                writer->write_bit(false); // presence bit == false
+            }
+
+            /// Encodes a non-empty field, writing a 1 bit first for optional fields
+            virtual void encode(BitWriter* writer, const wire_type& value)
+            {
+                if (!this->use_required()) {
+                    writer->write_bit(true);
+                }
+                _inner_codec.dispatch_encode(writer, value);
+            }
+
+            /// Decodes a field, first evaluating the presence bit if necessary
+            virtual wire_type decode(BitReader* reader)
+            {
+                wire_type value;
+                if (!try_decode(reader, &value))
+                {
+                    throw NullValueException();
+                }
+                return value;
+            }
+
             /// Decodes a field, first evaluating the presence bit if necessary
             virtual wire_type decode(Bitset* bits)
+            {
+                wire_type value;
+                if (!try_decode(bits, &value))
+                {
+                    throw NullValueException();
+                }
+                return value;
+            }
+
+            /// Decodes a field, returning false if the presence bit is not set
+            virtual bool try_decode(BitReader* reader, wire_type* value)
+            {
+                if (!this->use_required() && !reader->read_bit())
+                {
+                    return false;
+                }
+
+                if (!_inner_codec.dispatch_try_decode(reader, value))
+                {
+                    throw NullValueException();
+                }
+                return true;
+            }
+
+            /// Decodes a field, returning false if the presence bit is not set
+            virtual bool try_decode(Bitset* bits, wire_type* value)
             {
                 if (!this->use_required())
                 {
@@ -112,14 +166,15 @@ namespace dccl
                     bool present = bits->front();
                     if (!present)
                     {
-                        throw NullValueException();
+                        return false;
                     }
                     // the single bit was the presence bit; consume it and get the rest
                     bits->pop_front();
                     bits->get_more_bits(_inner_codec.size());
                 }
 
-                return _inner_codec.decode(bits);
+                *value = _inner_codec.decode(bits);
+                return true;
             }
 
             /// Size of an empty field (1 bit)
@@ -14,13 +14,13 @@ dccl::Bitset dccl::v3::VarBytesCodec::encode()
 dccl::Bitset dccl::v3::VarBytesCodec::encode(const std::string& wire_value)
 {
     std::string s = wire_value;
-    if(s.size() > dccl_field_options().max_length())
+    if(s.size() > field_params().max_length)
     {
         if(this->strict())
             throw(dccl::OutOfRangeException(std::string("Bytes too long for field: ") + FieldCodecBase::this_field()->DebugString(), this->this_field()));
         
         dccl::dlog.is(DEBUG2) && dccl::dlog << "Bytes " << s <<  " exceeds `dccl.max_length`, truncating" << std::endl;
-        s.resize(dccl_field_options().max_length()); 
+        s.resize(field_params().max_length); 
     }
             
     dccl::Bitset value_bits;
@@ -49,12 +49,20 @@ dccl::Bitset dccl::v3::VarBytesCodec::encode(const std::string& wire_value)
 }
 
 std::string dccl::v3::VarBytesCodec::decode(dccl::Bitset* bits)
+{
+    std::string wire_value;
+    if(!try_decode(bits, &wire_value))
+        throw dccl::NullValueException();
+    return wire_value;
+}
+
+bool dccl::v3::VarBytesCodec::try_decode(dccl::Bitset* bits, std::string* wire_value)
 {
     if(!use_required())
     {
         if(bits->to_ulong() == 0)
         {
-            throw dccl::NullValueException();
+            return false;
         }
         else
         {
@@ -82,7 +90,53 @@ std::string dccl::v3::VarBytesCodec::decode(dccl::Bitset* bits)
     dccl::dlog.is(DEBUG2) && dccl::dlog << "string_body_bits " << string_body_bits << std::endl;    
 
     
-    return string_body_bits.to_byte_string();
+    *wire_value = string_body_bits.to_byte_string();
+    return true;
+}
+
+void dccl::v3::VarBytesCodec::encode(dccl::BitWriter* writer)
+{
+    writer->write(0, min_size());
+}
+
+void dccl::v3::VarBytesCodec::encode(dccl::BitWriter* writer, const std::string& wire_value)
+{
+    std::string::size_type length = wire_value.size();
+    if(length > field_params().max_length)
+    {
+        if(this->strict())
+            throw(dccl::OutOfRangeException(std::string("Bytes too long for field: ") + FieldCodecBase::this_field()->DebugString(), this->this_field()));
+
+        dccl::dlog.is(DEBUG2) && dccl::dlog << "Bytes " << wire_value <<  " exceeds `dccl.max_length`, truncating" << std::endl;
+        length = field_params().max_length;
+    }
+
+    if(!use_required())
+        writer->write_bit(true); // presence bit
+
+    writer->write(length, prefix_size());
+    writer->write_bytes(wire_value.data(), length);
+}
+
+std::string dccl::v3::VarBytesCodec::decode(dccl::BitReader* reader)
+{
+    std::string wire_value;
+    if(!try_decode(reader, &wire_value))
+        throw dccl::NullValueException();
+    return wire_value;
+}
+
+bool dccl::v3::VarBytesCodec::try_decode(dccl::BitReader* reader, std::string* wire_value)
+{
+    if(!use_required() && !reader->read_bit()) // presence bit
+        return false;
+
+    unsigned value_length = reader->read(prefix_size());
+
+    dccl::dlog.is(DEBUG2) && dccl::dlog << "Length of string is = " << value_length << std::endl;
+
+    *wire_value = reader->read_bytes(value_length);
+    return true;
 }
 
 unsigned dccl::v3::VarBytesCodec::size()
@@ -98,7 +152,7 @@ unsigned dccl::v3::VarBytesCodec::size(const std::string& wire_value)
 
 unsigned dccl::v3::VarBytesCodec::max_size()
 {
-    return presence_size() + prefix_size() + dccl_field_options().max_length() * dccl::BITS_IN_BYTE;
+    return presence_size() + prefix_size() + field_params().max_length * dccl::BITS_IN_BYTE;
 }
 
 unsigned dccl::v3::VarBytesCodec::min_size()
@@ -35,10 +35,19 @@ namespace dccl
         // if repeated: [M bits - prefix with the number of repeated values][same as "required" for value with index 0][same as "required" for index = 1]...[same as required for last index]
         class VarBytesCodec : public dccl::TypedFieldCodec<std::string>
         {
+        public:
+            VarBytesCodec()
+            { set_direct_io_type(typeid(VarBytesCodec)); }
+
         private:
             dccl::Bitset encode();
             dccl::Bitset encode(const std::string& wire_value);
             std::string decode(dccl::Bitset* bits);
+            void encode(dccl::BitWriter* writer);
+            void encode(dccl::BitWriter* writer, const std::string& wire_value);
+            std::string decode(dccl::BitReader* reader);
+            bool try_decode(dccl::Bitset* bits, std::string* wire_value);
+            bool try_decode(dccl::BitReader* reader, std::string* wire_value);
             unsigned size();
             unsigned size(const std::string& wire_value);
             unsigned max_size();
@@ -47,7 +56,7 @@ namespace dccl
         
         private:
             unsigned prefix_size()
-            { return dccl::ceil_log2(dccl_field_options().max_length()+1); }
+            { return dccl::ceil_log2(field_params().max_length+1); }
             unsigned presence_size()
             { return use_required() ? 0 : 1; }
         
@@ -36,6 +36,15 @@
 #include "dccl/bitset.h"
 
 
+/// Storage class specifier for per-thread variables (plain old data types only, for compatibility with pre-C++11 compilers)
+#if __cplusplus >= 201103L
+#define DCCL_THREAD_LOCAL thread_local
+#elif defined(_MSC_VER)
+#define DCCL_THREAD_LOCAL __declspec(thread)
+#else
+#define DCCL_THREAD_LOCAL __thread
+#endif
+
 namespace dccl
 {
     inline unsigned floor_bits2bytes(unsigned bits)
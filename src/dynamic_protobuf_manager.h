@@ -33,6 +33,15 @@
 #include <google/protobuf/dynamic_message.h>
 #include <google/protobuf/descriptor_database.h>
 #include <google/protobuf/compiler/importer.h>
+#include <google/protobuf/stubs/common.h>
+
+// google::protobuf::Arena was introduced in Protobuf 3.0
+#if GOOGLE_PROTOBUF_VERSION >= 3000000
+#include <google/protobuf/arena.h>
+#define DCCL_HAS_PROTOBUF_ARENA 1
+#else
+#define DCCL_HAS_PROTOBUF_ARENA 0
+#endif
 
 #include <boost/shared_ptr.hpp>
 
@@ -100,6 +109,16 @@ namespace dccl
             const google::protobuf::Descriptor* desc)
         { return new_protobuf_message<boost::shared_ptr<google::protobuf::Message> >(desc); }
             
+#if DCCL_HAS_PROTOBUF_ARENA
+        /// \brief Create a new (empty) Google Protobuf message of a given type by Descriptor on an Arena
+        ///
+        /// \param desc The Google Protobuf Descriptor of the message to create.
+        /// \param arena Arena to allocate the message on. The message is owned by the arena and must not be deleted. If arena is 0, the message is allocated on the heap and owned by the caller.
+        static google::protobuf::Message* new_protobuf_message(
+            const google::protobuf::Descriptor* desc, google::protobuf::Arena* arena)
+        { return msg_factory().GetPrototype(desc)->New(arena); }
+#endif
+
         /// \brief Create a new (empty) Google Protobuf message of a given type by name.
         ///
         /// \param protobuf_type_name The full name (including package) of the Google Protobuf message to create (e.g. "package.MyMessage").
@@ -45,6 +45,15 @@ namespace dccl
         { }    
     };
 
+    /// \brief Exception used to signal that decoding needed more bits than remain in the encoded message (i.e. the message is truncated or corrupt).
+    class TruncatedException : public Exception
+    {
+      public:
+      TruncatedException(const std::string& s)
+          : Exception(s)
+        { }
+    };
+
     class OutOfRangeException : public std::out_of_range
     {
       public:
@@ -24,14 +24,8 @@
 #include "field_codec.h"
 #include "exception.h"
 #include "dccl/codec.h"
-
-dccl::MessagePart dccl::FieldCodecBase::part_ =
-    dccl::UNKNOWN;
-
-bool dccl::FieldCodecBase::strict_ = false;
-
-const google::protobuf::Message* dccl::FieldCodecBase::root_message_ = 0;
-const google::protobuf::Descriptor* dccl::FieldCodecBase::root_descriptor_ = 0;
+#include "dccl/internal/field_profile.h"
+#include "dccl/internal/message_plan.h"
 
 using dccl::dlog;
 using namespace dccl::logger;
@@ -56,6 +50,18 @@ void dccl::FieldCodecBase::base_encode(Bitset* bits,
 
 }
 
+void dccl::FieldCodecBase::base_encode(BitWriter* writer,
+                                       const google::protobuf::Message& field_value,
+                                       MessagePart part,
+                                       bool strict)
+{
+    BaseRAII scoped_globals(part, &field_value, strict);
+
+    field_encode(writer,
+                 internal::TypeHelper::find(field_value.GetDescriptor())->get_value(field_value),
+                 0);
+}
+
 void dccl::FieldCodecBase::field_encode(Bitset* bits,
                                         const boost::any& field_value,
                                         const google::protobuf::FieldDescriptor* field)
@@ -70,7 +76,7 @@ void dccl::FieldCodecBase::field_encode(Bitset* bits,
     
     Bitset new_bits;
     any_encode(&new_bits, wire_value);
-    disp_size(field, new_bits, msg_handler.field_.size());
+    disp_size(field, new_bits.size(), msg_handler.field_count());
     bits->append(new_bits);
 }
 
@@ -85,10 +91,59 @@ void dccl::FieldCodecBase::field_encode_repeated(Bitset* bits,
     
     Bitset new_bits;
     any_encode_repeated(&new_bits, wire_values);
-    disp_size(field, new_bits, msg_handler.field_.size(), wire_values.size());
+    disp_size(field, new_bits.size(), msg_handler.field_count(), wire_values.size());
     bits->append(new_bits);
 }
 
+void dccl::FieldCodecBase::field_encode(BitWriter* writer,
+                                        const boost::any& field_value,
+                                        const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+    internal::FieldProfileScope profile(this, field, writer);
+
+    if(field)
+        dlog.is(DEBUG2, ENCODE) && dlog << "Starting encode for field: " << field->DebugString() << std::flush;
+
+    boost::any wire_value;
+    field_pre_encode(&wire_value, field_value);
+
+    std::size_t start = writer->size();
+    any_encode(writer, wire_value);
+    disp_size(field, writer->size() - start, msg_handler.field_count());
+}
+
+void dccl::FieldCodecBase::field_encode_repeated(BitWriter* writer,
+                                                 const std::vector<boost::any>& field_values,
+                                                 const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+    internal::FieldProfileScope profile(this, field, writer);
+
+    std::vector<boost::any> wire_values;
+    field_pre_encode_repeated(&wire_values, field_values);
+
+    std::size_t start = writer->size();
+    any_encode_repeated(writer, wire_values);
+    disp_size(field, writer->size() - start, msg_handler.field_count(), wire_values.size());
+}
+
+
+void dccl::FieldCodecBase::field_encode_typed(BitWriter* writer,
+                                              const google::protobuf::Message& parent,
+                                              const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+    internal::FieldProfileScope profile(this, field, writer);
+
+    dlog.is(DEBUG2, ENCODE) && dlog << "Starting encode for field: " << field->DebugString() << std::flush;
+
+    std::size_t start = writer->size();
+    typed_encode(writer, parent);
+    disp_size(field, writer->size() - start, msg_handler.field_count(),
+              field->is_repeated() ? parent.GetReflection()->FieldSize(parent, field) : -1);
+}
+
             
 void dccl::FieldCodecBase::base_size(unsigned* bit_size,
                                      const google::protobuf::Message& msg,
@@ -126,6 +181,15 @@ void dccl::FieldCodecBase::field_size_repeated(unsigned* bit_size,
     *bit_size += any_size_repeated(wire_values);
 }
 
+void dccl::FieldCodecBase::field_size_typed(unsigned* bit_size,
+                                            const google::protobuf::Message& parent,
+                                            const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    *bit_size += typed_size(parent);
+}
+
 
 
 
@@ -139,6 +203,15 @@ void dccl::FieldCodecBase::base_decode(Bitset* bits,
 }
 
 
+void dccl::FieldCodecBase::base_decode(BitReader* reader,
+                                       google::protobuf::Message* field_value,
+                                       MessagePart part)
+{
+    BaseRAII scoped_globals(part, field_value);
+    boost::any value(field_value);
+    field_decode(reader, &value, 0);
+}
+
 void dccl::FieldCodecBase::field_decode(Bitset* bits,
                                         boost::any* field_value,
                                         const google::protobuf::FieldDescriptor* field)
@@ -202,6 +275,72 @@ void dccl::FieldCodecBase::field_decode_repeated(Bitset* bits,
 }
 
 
+void dccl::FieldCodecBase::field_decode(BitReader* reader,
+                                        boost::any* field_value,
+                                        const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    if(!field_value)
+        throw(Exception("Decode called with NULL boost::any"));
+    else if(!reader)
+        throw(Exception("Decode called with NULL BitReader"));
+
+    internal::FieldProfileScope profile(this, field, reader);
+
+    if(field)
+        dlog.is(DEBUG2, DECODE) && dlog << "Starting decode for field: " << field->DebugString() << std::flush;
+
+    if(root_message())
+        dlog.is(DEBUG3, DECODE) && dlog <<  "Message thus far is: " << root_message()->DebugString() << std::flush;
+
+    boost::any wire_value = *field_value;
+
+    any_decode(reader, &wire_value);
+
+    field_post_decode(wire_value, field_value);
+}
+
+void dccl::FieldCodecBase::field_decode_repeated(BitReader* reader,
+                                                 std::vector<boost::any>* field_values,
+                                                 const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    if(!field_values)
+        throw(Exception("Decode called with NULL field_values"));
+    else if(!reader)
+        throw(Exception("Decode called with NULL BitReader"));
+
+    internal::FieldProfileScope profile(this, field, reader);
+
+    if(field)
+        dlog.is(DEBUG2, DECODE) && dlog  << "Starting repeated decode for field: " << field->DebugString();
+
+    std::vector<boost::any> wire_values = *field_values;
+    any_decode_repeated(reader, &wire_values);
+
+    field_values->clear();
+    field_post_decode_repeated(wire_values, field_values);
+}
+
+void dccl::FieldCodecBase::field_decode_typed(BitReader* reader,
+                                              google::protobuf::Message* parent,
+                                              const google::protobuf::FieldDescriptor* field)
+{
+    internal::MessageStack msg_handler(field);
+
+    if(!reader)
+        throw(Exception("Decode called with NULL BitReader"));
+
+    internal::FieldProfileScope profile(this, field, reader);
+
+    dlog.is(DEBUG2, DECODE) && dlog << "Starting decode for field: " << field->DebugString() << std::flush;
+
+    typed_decode(reader, parent);
+}
+
+
 void dccl::FieldCodecBase::base_max_size(unsigned* bit_size,
                                          const google::protobuf::Descriptor* desc,
                                          MessagePart part)
@@ -221,6 +360,13 @@ void dccl::FieldCodecBase::base_max_size(unsigned* bit_size,
 void dccl::FieldCodecBase::field_max_size(unsigned* bit_size,
                                           const google::protobuf::FieldDescriptor* field)
 {
+    const internal::PlannedField* planned = internal::planned_field(this, field);
+    if(planned && planned->sized)
+    {
+        *bit_size += planned->max_bits;
+        return;
+    }
+
     internal::MessageStack msg_handler(field);
     
     if(this_field())
@@ -252,6 +398,13 @@ void dccl::FieldCodecBase::field_min_size(unsigned* bit_size,
                                           const google::protobuf::FieldDescriptor* field)
     
 {
+    const internal::PlannedField* planned = internal::planned_field(this, field);
+    if(planned && planned->sized)
+    {
+        *bit_size += planned->min_bits;
+        return;
+    }
+
     internal::MessageStack msg_handler(field);
     
     if(this_field())
@@ -286,6 +439,51 @@ void dccl::FieldCodecBase::field_validate(bool* b,
         throw(Exception("Variable size codec used in header - header fields must be encoded with fixed size codec."));
     
     validate();
+
+    if(field)
+    {
+        FieldCodecParams params;
+        resolve_params(&params);
+        params_[field] = params;
+    }
+}
+
+dccl::FieldCodecParams dccl::FieldCodecBase::field_params()
+{
+    const google::protobuf::FieldDescriptor* field = this_field();
+
+    // set by the message codec from its MessagePlan before handing the field to this codec
+    const internal::PlannedField* planned = internal::planned_field(this, field);
+    if(planned && planned->params)
+        return *planned->params;
+
+    if(const FieldCodecParams* params = field_resolved_params(field))
+        return *params;
+
+    FieldCodecParams params;
+    resolve_params(&params);
+    return params;
+}
+
+const dccl::FieldCodecParams* dccl::FieldCodecBase::field_resolved_params(const google::protobuf::FieldDescriptor* field) const
+{
+    std::map<const google::protobuf::FieldDescriptor*, FieldCodecParams>::const_iterator it = params_.find(field);
+    return (it != params_.end()) ? &it->second : 0;
+}
+
+void dccl::FieldCodecBase::resolve_params(FieldCodecParams* params)
+{
+    const dccl::DCCLFieldOptions& options = dccl_field_options();
+    params->min = options.min();
+    params->max = options.max();
+    params->precision = options.precision();
+    params->scale = std::pow(10.0, params->precision);
+    params->inverse_scale = std::pow(10.0, -params->precision);
+    params->bits_required = 0;
+    params->bits_optional = 0;
+    params->max_length = options.max_length();
+    params->max_repeat = options.max_repeat();
+    params->in_head = options.in_head();
 }
             
 void dccl::FieldCodecBase::base_info(std::ostream* os, const google::protobuf::Descriptor* desc, MessagePart part)
@@ -346,7 +544,7 @@ void dccl::FieldCodecBase::field_info(std::ostream* os,
     int width = this_field() ? full_width-name.size() : full_width-name.size()+spaces;
     ss << indent << name <<
         std::setfill('.') << std::setw(std::max(1, width)) << range.str()
-       << " {" << (this_field() ? FieldCodecManager::find(this_field(), has_codec_group(), codec_group())->name() : FieldCodecManager::find(root_descriptor_)->name()) << "}";
+       << " {" << (this_field() ? FieldCodecManager::find(this_field(), has_codec_group(), codec_group())->name() : FieldCodecManager::find(root_descriptor())->name()) << "}";
 
     
     
@@ -386,7 +584,8 @@ void dccl::FieldCodecBase::any_encode_repeated(dccl::Bitset* bits, const std::ve
 {
     // out_bits = [field_values[2]][field_values[1]][field_values[0]]
 
-    unsigned wire_vector_size = dccl_field_options().max_repeat();
+    const unsigned max_repeat = field_params().max_repeat;
+    unsigned wire_vector_size = max_repeat;
 
     if(wire_values.size() > wire_vector_size)
         throw(dccl::OutOfRangeException(std::string("Repeated size exceeds max_repeat for field: ") + FieldCodecBase::this_field()->DebugString(), this->this_field()));
@@ -394,8 +593,8 @@ void dccl::FieldCodecBase::any_encode_repeated(dccl::Bitset* bits, const std::ve
     // for DCCL3 and beyond, add a prefix numeric field giving the vector size (rather than always going to max_repeat)
     if(codec_version() > 2)
     {
-        wire_vector_size = std::min((int)dccl_field_options().max_repeat(), (int)wire_values.size());    
-        Bitset size_bits(repeated_vector_field_size(dccl_field_options().max_repeat()), wire_values.size());
+        wire_vector_size = std::min((int)max_repeat, (int)wire_values.size());    
+        Bitset size_bits(repeated_vector_field_size(max_repeat), wire_values.size());
         bits->append(size_bits);
     }    
 
@@ -416,11 +615,12 @@ void dccl::FieldCodecBase::any_encode_repeated(dccl::Bitset* bits, const std::ve
 void dccl::FieldCodecBase::any_decode_repeated(Bitset* repeated_bits, std::vector<boost::any>* wire_values)
 {
 
-    unsigned wire_vector_size = dccl_field_options().max_repeat();    
+    const unsigned max_repeat = field_params().max_repeat;
+    unsigned wire_vector_size = max_repeat;
     if(codec_version() > 2)
     {
         Bitset size_bits(repeated_bits);        
-        size_bits.get_more_bits(repeated_vector_field_size(dccl_field_options().max_repeat()));
+        size_bits.get_more_bits(repeated_vector_field_size(max_repeat));
 
         wire_vector_size = size_bits.to_ulong();
     }
@@ -435,15 +635,65 @@ void dccl::FieldCodecBase::any_decode_repeated(Bitset* repeated_bits, std::vecto
     }
 }
 
+void dccl::FieldCodecBase::any_encode(BitWriter* writer, const boost::any& wire_value)
+{
+    Bitset bits;
+    any_encode(&bits, wire_value);
+    writer->write(bits);
+}
+
+void dccl::FieldCodecBase::any_decode(BitReader* reader, boost::any* wire_value)
+{
+    internal::BitReaderBitset bits(reader, max_size(), min_size());
+    any_decode(bits.bits(), wire_value);
+}
+
+void dccl::FieldCodecBase::any_encode_repeated(BitWriter* writer, const std::vector<boost::any>& wire_values)
+{
+    const unsigned max_repeat = field_params().max_repeat;
+    unsigned wire_vector_size = max_repeat;
+
+    if(wire_values.size() > wire_vector_size)
+        throw(dccl::OutOfRangeException(std::string("Repeated size exceeds max_repeat for field: ") + FieldCodecBase::this_field()->DebugString(), this->this_field()));
+
+    if(codec_version() > 2)
+    {
+        wire_vector_size = std::min((int)max_repeat, (int)wire_values.size());
+        writer->write(wire_values.size(), repeated_vector_field_size(max_repeat));
+    }
+
+    for(unsigned i = 0, n = wire_vector_size; i < n; ++i)
+    {
+        if(i < wire_values.size())
+            any_encode(writer, wire_values[i]);
+        else
+            any_encode(writer, boost::any());
+    }
+}
+
+void dccl::FieldCodecBase::any_decode_repeated(BitReader* reader, std::vector<boost::any>* wire_values)
+{
+    const unsigned max_repeat = field_params().max_repeat;
+    unsigned wire_vector_size = max_repeat;
+    if(codec_version() > 2)
+        wire_vector_size = reader->read(repeated_vector_field_size(max_repeat));
+
+    wire_values->resize(wire_vector_size);
+
+    for(unsigned i = 0, n = wire_vector_size; i < n; ++i)
+        any_decode(reader, &(*wire_values)[i]);
+}
+
 unsigned dccl::FieldCodecBase::any_size_repeated(const std::vector<boost::any>& wire_values)
 {
     unsigned out = 0;
-    unsigned wire_vector_size = dccl_field_options().max_repeat();
+    const unsigned max_repeat = field_params().max_repeat;
+    unsigned wire_vector_size = max_repeat;
 
     if(codec_version() > 2)
     {
-        wire_vector_size = std::min((int)dccl_field_options().max_repeat(), (int)wire_values.size());    
-        out += repeated_vector_field_size(dccl_field_options().max_repeat());
+        wire_vector_size = std::min((int)max_repeat, (int)wire_values.size());    
+        out += repeated_vector_field_size(max_repeat);
     }    
 
     for(unsigned i = 0, n = wire_vector_size; i < n; ++i)
@@ -456,6 +706,21 @@ unsigned dccl::FieldCodecBase::any_size_repeated(const std::vector<boost::any>&
     return out;
 }
 
+void dccl::FieldCodecBase::typed_encode(BitWriter* writer, const google::protobuf::Message& parent)
+{
+    throw(Exception("Codec " + name() + " does not support typed encoding"));
+}
+
+void dccl::FieldCodecBase::typed_decode(BitReader* reader, google::protobuf::Message* parent)
+{
+    throw(Exception("Codec " + name() + " does not support typed decoding"));
+}
+
+unsigned dccl::FieldCodecBase::typed_size(const google::protobuf::Message& parent)
+{
+    throw(Exception("Codec " + name() + " does not support typed size"));
+}
+
 unsigned dccl::FieldCodecBase::max_size_repeated()
 {    
     if(!dccl_field_options().has_max_repeat())
@@ -504,19 +769,19 @@ void dccl::FieldCodecBase::any_post_decode_repeated(
 // FieldCodecBase private
 //
 
-void dccl::FieldCodecBase::disp_size(const google::protobuf::FieldDescriptor* field, const Bitset& new_bits, int depth, int vector_size /* = -1 */)
+void dccl::FieldCodecBase::disp_size(const google::protobuf::FieldDescriptor* field, unsigned bit_size, int depth, int vector_size /* = -1 */)
 {
-    if(!root_descriptor_)
+    if(!root_descriptor())
         return;
 
     if(dlog.is(INFO, SIZE))
     {   
-        std::string name = ((field) ? field->name() : root_descriptor_->full_name());
+        std::string name = ((field) ? field->name() : root_descriptor()->full_name());
         if(vector_size >= 0)
             name +=  "[" + boost::lexical_cast<std::string>(vector_size) +  "]";
 
         
-        dlog << std::string(depth, '|') << name << std::setfill('.') << std::setw(40-name.size()-depth) << new_bits.size() << std::endl;
+        dlog << std::string(depth, '|') << name << std::setfill('.') << std::setw(40-name.size()-depth) << bit_size << std::endl;
         
         if(!field)
             dlog << std::endl;
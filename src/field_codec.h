@@ -38,11 +38,40 @@
 #include "internal/type_helper.h"
 #include "internal/field_codec_message_stack.h"
 #include "dccl/binary.h"
+#include "dccl/bitstream.h"
 
 namespace dccl
 {
     class Codec;
 
+    /// \brief Base class for state that a field codec library keeps for one Codec instance rather than for the whole process (e.g. dccl::arith::ModelContext). See Codec::set_codec_context().
+    class CodecContext
+    {
+      public:
+        virtual ~CodecContext() { }
+    };
+
+    /// \brief Values for one field derived from its (dccl.field) options, resolved once when the message is loaded (see FieldCodecBase::field_params()).
+    struct FieldCodecParams
+    {
+        /// minimum, maximum and precision of numeric fields (as returned by the codec, which may differ from the options)
+        double min;
+        double max;
+        double precision;
+        /// 10^precision and 10^-precision
+        double scale;
+        double inverse_scale;
+        /// encoded size of fixed size numeric fields when using the required and optional encodings (0 if not applicable)
+        unsigned bits_required;
+        unsigned bits_optional;
+        /// (dccl.field).max_length
+        unsigned max_length;
+        /// (dccl.field).max_repeat
+        unsigned max_repeat;
+        /// (dccl.field).in_head
+        bool in_head;
+    };
+
     /// \brief Provides a base class for defining DCCL field encoders / decoders. Most users who wish to define custom encoders/decoders will use the RepeatedTypedFieldCodec, TypedFieldCodec or its children (e.g. TypedFixedFieldCodec) instead of directly inheriting from this class.
     class FieldCodecBase
     {
@@ -73,7 +102,10 @@ namespace dccl
         ///
         /// \return FieldDescriptor for the current field or 0 if this codec is encoding the base message.
         const google::protobuf::FieldDescriptor* this_field() const 
-        { return !internal::MessageStack::field_.empty() ? internal::MessageStack::field_.back() : 0; }
+        {
+            internal::TraversalContext* context = internal::TraversalContext::current();
+            return (context && !context->field.empty()) ? context->field.back() : 0;
+        }
             
         /// \brief Returns the Descriptor (message schema meta-data) for the immediate parent Message
         ///
@@ -89,18 +121,24 @@ namespace dccl
         /// returns Descriptor for Foo if this_field() == FieldDescriptor for bar
         /// returns Descriptor for FooBar if this_field() == FieldDescriptor for baz
         static const google::protobuf::Descriptor* this_descriptor()
-        { return !internal::MessageStack::desc_.empty() ? internal::MessageStack::desc_.back() : 0; }
+        {
+            internal::TraversalContext* context = internal::TraversalContext::current();
+            return (context && !context->desc.empty()) ? context->desc.back() : 0;
+        }
 
         // currently encoded or (partially) decoded root message
         static const google::protobuf::Message* root_message()
-        { return root_message_; }
+        {
+            internal::TraversalContext* context = internal::TraversalContext::current();
+            return context ? context->root_message : 0;
+        }
 
         static bool has_codec_group()
         {
-            if(root_descriptor_)
+            if(const google::protobuf::Descriptor* desc = root_descriptor())
             {
-                return root_descriptor_->options().GetExtension(dccl::msg).has_codec_group() ||
-                    root_descriptor_->options().GetExtension(dccl::msg).has_codec_version();
+                return desc->options().GetExtension(dccl::msg).has_codec_group() ||
+                    desc->options().GetExtension(dccl::msg).has_codec_version();
             }
             else
                 return false;
@@ -109,15 +147,30 @@ namespace dccl
         static std::string codec_group(const google::protobuf::Descriptor* desc);
 
         static std::string codec_group()
-        { return codec_group(root_descriptor_); }
+        { return codec_group(root_descriptor()); }
 
         static int codec_version()
-        { return root_descriptor_->options().GetExtension(dccl::msg).codec_version(); }
+        { return root_descriptor()->options().GetExtension(dccl::msg).codec_version(); }
             
         /// \brief the part of the message currently being encoded (head or body).
-        static MessagePart part() { return part_; }
+        static MessagePart part()
+        {
+            internal::TraversalContext* context = internal::TraversalContext::current();
+            return context ? context->part : UNKNOWN;
+        }
+
+        static bool strict()
+        {
+            internal::TraversalContext* context = internal::TraversalContext::current();
+            return context ? context->strict : false;
+        }
 
-        static bool strict() { return strict_; }
+        /// \brief The CodecContext of the Codec that is loading, encoding, decoding (etc.) the current message, or 0 if it has none
+        static CodecContext* codec_context()
+        {
+            internal::TraversalContext* context = internal::TraversalContext::current();
+            return context ? context->codec_context : 0;
+        }
         
         /// \brief Force the codec to always use the "required" field encoding, regardless of the FieldDescriptor setting. Useful when wrapping this codec in another that handles optional and repeated fields
         void set_force_use_required(bool force_required = true)
@@ -149,6 +202,16 @@ namespace dccl
                          MessagePart part,
                          bool strict);
 
+        /// \brief Encode this part (body or head) of the base message directly into a BitWriter
+        ///
+        /// \param writer BitWriter to write the encoded bits to (starting at its current position).
+        /// \param msg DCCL Message to encode
+        /// \param part Part of the message to encode
+        void base_encode(BitWriter* writer,
+                         const google::protobuf::Message& msg,
+                         MessagePart part,
+                         bool strict);
+
         /// \brief Calculate the size (in bits) of a part of the base message when it is encoded
         ///
         /// \param bit_size Pointer to unsigned integer to store the result.
@@ -165,6 +228,15 @@ namespace dccl
                          google::protobuf::Message* msg,
                          MessagePart part);
 
+        /// \brief Decode part of a message directly from a BitReader
+        ///
+        /// \param reader BitReader to decode from. The reader is advanced past the bits that were used.
+        /// \param msg DCCL Message to <i>merge</i> the decoded result into.
+        /// \param part part of the Message to decode
+        void base_decode(BitReader* reader,
+                         google::protobuf::Message* msg,
+                         MessagePart part);
+
         /// \brief Calculate the maximum size of a message given its Descriptor alone (no data)
         ///
         /// \param bit_size Pointer to unsigned integer to store calculated maximum size in bits.
@@ -240,6 +312,24 @@ namespace dccl
                                    const std::vector<boost::any>& field_values,
                                    const google::protobuf::FieldDescriptor* field);
 
+        /// \brief Encode a non-repeated field directly into a BitWriter.
+        ///
+        /// \param writer BitWriter to write the encoded bits to
+        /// \param field_value Value to encode (FieldType)
+        /// \param field Protobuf descriptor to the field to encode. Set to 0 for base message.
+        void field_encode(BitWriter* writer,
+                          const boost::any& field_value,
+                          const google::protobuf::FieldDescriptor* field);
+
+        /// \brief Encode a repeated field directly into a BitWriter.
+        ///
+        /// \param writer BitWriter to write the encoded bits to
+        /// \param field_values Values to encode (FieldType)
+        /// \param field Protobuf descriptor to the field. Set to 0 for base message.
+        void field_encode_repeated(BitWriter* writer,
+                                   const std::vector<boost::any>& field_values,
+                                   const google::protobuf::FieldDescriptor* field);
+
         /// \brief Calculate the size of a field
         ///
         /// \param bit_size Location to <i>add</i> calculated bit size to. Be sure to zero `bit_size` if you want only the size of this field.
@@ -275,6 +365,58 @@ namespace dccl
                                    std::vector<boost::any>* field_values,
                                    const google::protobuf::FieldDescriptor* field);
 
+        /// \brief Decode a non-repeated field directly from a BitReader
+        ///
+        /// \param reader BitReader to decode from. The reader is advanced past the bits that were used.
+        /// \param field_value Location to store decoded value (FieldType)
+        /// \param field Protobuf descriptor to the field. Set to 0 for base message.
+        void field_decode(BitReader* reader,
+                          boost::any* field_value,
+                          const google::protobuf::FieldDescriptor* field);
+
+        /// \brief Decode a repeated field directly from a BitReader
+        ///
+        /// \param reader BitReader to decode from. The reader is advanced past the bits that were used.
+        /// \param field_values Location to store decoded values (FieldType)
+        /// \param field Protobuf descriptor to the field. Set to 0 for base message.
+        void field_decode_repeated(BitReader* reader,
+                                   std::vector<boost::any>* field_values,
+                                   const google::protobuf::FieldDescriptor* field);
+
+        /// \brief Whether field_encode_typed(), field_decode_typed() and field_size_typed() can be used for this field (see supports_typed()).
+        bool field_supports_typed(const google::protobuf::FieldDescriptor* field)
+        { return supports_typed(field); }
+
+        /// \brief The parameters resolved for this field when this codec validated it, or 0 if it has not. Valid for the lifetime of the codec.
+        const FieldCodecParams* field_resolved_params(const google::protobuf::FieldDescriptor* field) const;
+
+        /// \brief Encode a (single or repeated) field by reading its value(s) directly from the parent message, without converting through boost::any. Only valid if field_supports_typed(field) is true.
+        ///
+        /// \param writer BitWriter to write the encoded bits to
+        /// \param parent Message containing the field
+        /// \param field Protobuf descriptor to the field.
+        void field_encode_typed(BitWriter* writer,
+                                const google::protobuf::Message& parent,
+                                const google::protobuf::FieldDescriptor* field);
+
+        /// \brief Decode a (single or repeated) field and store the result(s) directly into the parent message, without converting through boost::any. Only valid if field_supports_typed(field) is true.
+        ///
+        /// \param reader BitReader to decode from. The reader is advanced past the bits that were used.
+        /// \param parent Message containing the field
+        /// \param field Protobuf descriptor to the field.
+        void field_decode_typed(BitReader* reader,
+                                google::protobuf::Message* parent,
+                                const google::protobuf::FieldDescriptor* field);
+
+        /// \brief Calculate the size of a (single or repeated) field read directly from the parent message. Only valid if field_supports_typed(field) is true.
+        ///
+        /// \param bit_size Location to <i>add</i> calculated bit size to.
+        /// \param parent Message containing the field
+        /// \param field Protobuf descriptor to the field.
+        void field_size_typed(unsigned* bit_size,
+                              const google::protobuf::Message& parent,
+                              const google::protobuf::FieldDescriptor* field);
+
         /// \brief Post-decodes a non-repeated (i.e. optional or required) field by converting the WireType (the type used in the encoded DCCL message) representation into the FieldType representation (the Google Protobuf representation). This allows for type-converting codecs.
         ///
         /// \param wire_value Should be set to the desired value to translate
@@ -323,7 +465,7 @@ namespace dccl
         /// \brief Get the DCCL field option extension value for the current field
         ///
         /// dccl::DCCLFieldOptions is defined in acomms_option_extensions.proto
-        dccl::DCCLFieldOptions dccl_field_options() const 
+        const dccl::DCCLFieldOptions& dccl_field_options() const 
         {
             if(this_field())
                 return this_field()->options().GetExtension(dccl::field);
@@ -332,6 +474,14 @@ namespace dccl
                 
         }
             
+        /// \brief Parameters for the current field, as computed by resolve_params() when the message was loaded (or computed now, if the field was never validated by this codec).
+        FieldCodecParams field_params();
+
+        /// \brief Compute the parameters for the current field. Called once per field from field_validate(), after validate() succeeds.
+        ///
+        /// Codecs whose parameters are not taken directly from the options (e.g. DefaultNumericFieldCodec, which may override min(), max() and precision()) should override this, calling the base implementation first.
+        virtual void resolve_params(FieldCodecParams* params);
+
         /// \brief Essentially an assertion to be used in the validate() virtual method
         ///
         /// \param b Boolean to assert (if true, execution continues, if false an exception is thrown)
@@ -382,6 +532,18 @@ namespace dccl
         /// \param wire_value Place to store decoded value (as FieldType)
         virtual void any_decode(Bitset* bits, boost::any* wire_value) = 0;
 
+        /// \brief Virtual method used to encode directly into a BitWriter. The default implementation calls any_encode(Bitset*, const boost::any&) and copies the result into the writer; override this to avoid the intermediate Bitset.
+        ///
+        /// \param writer BitWriter to write the encoded bits to
+        /// \param wire_value Value to encode (WireType)
+        virtual void any_encode(BitWriter* writer, const boost::any& wire_value);
+
+        /// \brief Virtual method used to decode directly from a BitReader. The default implementation presents up to max_size() bits of the reader to any_decode(Bitset*, boost::any*); override this to avoid the intermediate Bitset.
+        ///
+        /// \param reader BitReader to decode from. Implementations must consume exactly the bits that were encoded.
+        /// \param wire_value Place to store decoded value (as FieldType)
+        virtual void any_decode(BitReader* reader, boost::any* wire_value);
+
         /// \brief Virtual method used to pre-encode (convert from FieldType to WireType). The default implementation of this method is for when WireType == FieldType and simply copies the field_value to the wire_value.
         ///
         /// \param wire_value Converted value (WireType)
@@ -425,6 +587,8 @@ namespace dccl
 
         virtual void any_encode_repeated(Bitset* bits, const std::vector<boost::any>& wire_values);
         virtual void any_decode_repeated(Bitset* repeated_bits, std::vector<boost::any>* field_values);
+        virtual void any_encode_repeated(BitWriter* writer, const std::vector<boost::any>& wire_values);
+        virtual void any_decode_repeated(BitReader* reader, std::vector<boost::any>* field_values);
 
         virtual void any_pre_encode_repeated(std::vector<boost::any>* wire_values,
                                              const std::vector<boost::any>& field_values);
@@ -435,7 +599,25 @@ namespace dccl
         virtual unsigned any_size_repeated(const std::vector<boost::any>& wire_values);
         virtual unsigned max_size_repeated();
         virtual unsigned min_size_repeated();
+
+        // typed (no boost::any)
+        /// \brief Whether this codec implements typed_encode(), typed_decode() and typed_size() for the given field. The default is false; TypedFieldCodec returns true for fields whose FieldType is a Protobuf scalar type (numeric, bool, enum, string or bytes).
+        virtual bool supports_typed(const google::protobuf::FieldDescriptor* field)
+        { return false; }
+
+        /// \brief Virtual method used to encode this_field() read directly from the parent message (see supports_typed()). Must produce the same bits as the boost::any path.
+        virtual void typed_encode(BitWriter* writer, const google::protobuf::Message& parent);
+
+        /// \brief Virtual method used to decode this_field() directly into the parent message (see supports_typed()).
+        virtual void typed_decode(BitReader* reader, google::protobuf::Message* parent);
+
+        /// \brief Virtual method used to calculate the size of this_field() read directly from the parent message (see supports_typed()).
+        virtual unsigned typed_size(const google::protobuf::Message& parent);
             
+        /// \brief Number of bits used to encode the size of a repeated field (DCCL3 and beyond)
+        int repeated_vector_field_size(int max_repeat)
+        { return dccl::ceil_log2(max_repeat+1); }
+
         friend class FieldCodecManager;
       private:
         // codec information
@@ -454,57 +636,78 @@ namespace dccl
                 return max_size() != min_size();
         }            
 
-        int repeated_vector_field_size(int max_repeat)
-        { return dccl::ceil_log2(max_repeat+1); }
-
-        void disp_size(const google::protobuf::FieldDescriptor* field, const Bitset& new_bits, int depth, int vector_size = -1);
+        void disp_size(const google::protobuf::FieldDescriptor* field, unsigned bit_size, int depth, int vector_size = -1);
         
         
       private:
-        // sets global statics relating the current message begin processed
-        // and unsets them on destruction
+        // root descriptor of the traversal in progress on this thread
+        static const google::protobuf::Descriptor* root_descriptor()
+        {
+            internal::TraversalContext* context = internal::TraversalContext::current();
+            return context ? context->root_descriptor : 0;
+        }
+
+        // sets the traversal state relating to the current message being processed
+        // and restores the previous state on destruction
         struct BaseRAII
         {
             BaseRAII(MessagePart part,
                      const google::protobuf::Descriptor* root_descriptor,
                      bool strict = false)
+                : scope_(true),
+                context_(internal::TraversalContext::current()),
+                part_(context_->part),
+                strict_(context_->strict),
+                root_message_(context_->root_message),
+                root_descriptor_(context_->root_descriptor)
                 {
-                    FieldCodecBase::part_ = part;
-                    FieldCodecBase::strict_ = strict;
-                    FieldCodecBase::root_message_ = 0;
-                    FieldCodecBase::root_descriptor_ = root_descriptor;
+                    set(part, strict, 0, root_descriptor);
                 }
 
             BaseRAII(MessagePart part,            
                      const google::protobuf::Message* root_message,
                      bool strict = false)                
+                : scope_(true),
+                context_(internal::TraversalContext::current()),
+                part_(context_->part),
+                strict_(context_->strict),
+                root_message_(context_->root_message),
+                root_descriptor_(context_->root_descriptor)
                 {
-                    FieldCodecBase::part_ = part;
-                    FieldCodecBase::strict_ = strict;
-                    FieldCodecBase::root_message_ = root_message;
-                    FieldCodecBase::root_descriptor_ = root_message->GetDescriptor();                    
+                    set(part, strict, root_message, root_message->GetDescriptor());
                 }
             ~BaseRAII()
                 {
-                    FieldCodecBase::part_ = dccl::UNKNOWN;
-                    FieldCodecBase::strict_ = false;
-                    FieldCodecBase::root_message_ = 0;
-                    FieldCodecBase::root_descriptor_ = 0;
+                    set(part_, strict_, root_message_, root_descriptor_);
                 }
+
+          private:
+            void set(MessagePart part, bool strict,
+                     const google::protobuf::Message* root_message,
+                     const google::protobuf::Descriptor* root_descriptor)
+            {
+                context_->part = part;
+                context_->strict = strict;
+                context_->root_message = root_message;
+                context_->root_descriptor = root_descriptor;
+            }
+
+            internal::TraversalScope scope_;
+            internal::TraversalContext* context_;
+            MessagePart part_;
+            bool strict_;
+            const google::protobuf::Message* root_message_;
+            const google::protobuf::Descriptor* root_descriptor_;
         };
         
-        
-        static MessagePart part_;
-        static bool strict_;
-        static const google::protobuf::Message* root_message_;
-        static const google::protobuf::Descriptor* root_descriptor_;
-        
         std::string name_;
         google::protobuf::FieldDescriptor::Type field_type_;
         google::protobuf::FieldDescriptor::CppType wire_type_;
 
         bool force_required_;
 
+        // filled in by field_validate(), read-only afterwards
+        std::map<const google::protobuf::FieldDescriptor*, FieldCodecParams> params_;
     };
 
     inline std::ostream& operator<<(std::ostream& os, const FieldCodecBase& field_codec )
@@ -26,6 +26,31 @@ namespace dccl
     /// \brief Provides the default 1 byte or 2 byte DCCL ID codec
     class DefaultIdentifierCodec : public TypedFieldCodec<uint32>
     {
+      public:
+        /// \brief Read the id from the start of an encoded message without going through the codec (the lsb of the first byte selects the one byte (7 bit id) or two byte (15 bit id) form)
+        ///
+        /// \return false if [begin, end) is too short to contain the id
+        static bool peek(const char* begin, const char* end, uint32* id)
+        {
+            if(end - begin < SHORT_FORM_ID_BYTES)
+                return false;
+
+            const unsigned char first = static_cast<unsigned char>(begin[0]);
+            if(!(first & 1))
+            {
+                *id = first >> 1;
+                return true;
+            }
+
+            if(end - begin < LONG_FORM_ID_BYTES)
+                return false;
+            *id = (first | (static_cast<unsigned char>(begin[1]) << BITS_IN_BYTE)) >> 1;
+            return true;
+        }
+
+        /// \brief Largest id that this codec can encode
+        static uint32 max_id() { return TWO_BYTE_MAX_ID; }
+
       protected:
         virtual Bitset encode();
         virtual Bitset encode(const uint32& wire_value);
@@ -21,7 +21,9 @@
 // along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
 #include "field_codec_manager.h"
 
-std::map<google::protobuf::FieldDescriptor::Type, dccl::FieldCodecManager::InsideMap> dccl::FieldCodecManager::codecs_;
+dccl::FieldCodecManager::CodecMapCell dccl::FieldCodecManager::codecs_;
+dccl::FieldCodecManager::GenerationMap dccl::FieldCodecManager::generations_;
+boost::mutex dccl::FieldCodecManager::generations_mutex_;
 
 
 boost::shared_ptr<dccl::FieldCodecBase>
@@ -30,10 +32,22 @@ dccl::FieldCodecManager::__find(google::protobuf::FieldDescriptor::Type type,
                                                  const std::string& type_name /* = "" */)
 {
     typedef InsideMap::const_iterator InsideIterator;
-    typedef std::map<google::protobuf::FieldDescriptor::Type, InsideMap>::const_iterator Iterator;
-    
-    Iterator it = codecs_.find(type);
-    if(it != codecs_.end())
+    typedef CodecMap::const_iterator Iterator;
+
+    // before reading the snapshot: a codec published after this bumps the generation recorded
+    if(internal::DependencyScope::active())
+    {
+        internal::DependencyScope::record(generation(type, codec_name));
+        if(!type_name.empty())
+        {
+            internal::DependencyScope::record(generation(type, __mangle_name(codec_name, type_name)));
+            internal::DependencyScope::record(generation(type, __mangle_name("", type_name)));
+        }
+    }
+
+    CodecMapCell::Reader codecs(codecs_);
+    Iterator it = codecs->find(type);
+    if(it != codecs->end())
     {
         InsideIterator inside_it = it->second.end();
         // try specific type codec
@@ -51,3 +65,26 @@ dccl::FieldCodecManager::__find(google::protobuf::FieldDescriptor::Type type,
 }
 
 
+
+dccl::internal::Generation* dccl::FieldCodecManager::generation(google::protobuf::FieldDescriptor::Type type,
+                                                                const std::string& name)
+{
+    boost::mutex::scoped_lock lock(generations_mutex_);
+    boost::shared_ptr<internal::Generation>& generation = generations_[std::make_pair(type, name)];
+    if(!generation)
+        generation.reset(new internal::Generation);
+    return generation.get();
+}
+
+void dccl::FieldCodecManager::bump_generation(google::protobuf::FieldDescriptor::Type type,
+                                              const std::string& name)
+{
+    generation(type, name)->bump();
+}
+
+void dccl::FieldCodecManager::bump_all_generations()
+{
+    boost::mutex::scoped_lock lock(generations_mutex_);
+    for(GenerationMap::iterator it = generations_.begin(), end = generations_.end(); it != end; ++it)
+        it->second->bump();
+}
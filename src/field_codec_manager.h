@@ -27,8 +27,11 @@
 #include <boost/mpl/and.hpp>
 #include <boost/mpl/not.hpp>
 #include <boost/mpl/logical.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "internal/type_helper.h"
+#include "internal/snapshot_cell.h"
+#include "internal/generation.h"
 #include "field_codec.h"
 #include "dccl/logger.h"
 
@@ -41,6 +44,8 @@ namespace dccl
     }
 
     /// \brief A class for managing the various field codecs. Here you can add and remove field codecs. The DCCL Codec and DefaultMessageCodec use the find() methods to locate the appropriate field codec.
+    ///
+    /// The codecs are held in an immutable snapshot: find() reads the current snapshot without taking a lock, while add(), remove() and clear() (which are serialized with each other) publish a modified copy. A codec removed while another thread is using it is destroyed once the last reference to it is released.
     class FieldCodecManager
     {
       public:
@@ -82,6 +87,19 @@ namespace dccl
         template<class Codec, google::protobuf::FieldDescriptor::Type type>
             static void add(const std::string& name);
 
+        /// \brief Add a message codec used instead of the codec \a name for one message type only (for example, one compiled ahead of time by protoc-gen-dccl: see v3::CompiledMessageCodec). Unlike add() for statically generated Protobuf messages, the codec works on google::protobuf::Message, as DefaultMessageCodec does.
+        ///
+        /// \tparam Codec A child of FieldCodecBase that encodes messages
+        /// \param name Name of the codec that this one takes precedence over (e.g. "dccl.default3")
+        /// \param desc Message type to use this codec for
+        template<class Codec>
+            static void add(const std::string& name, const google::protobuf::Descriptor* desc)
+        {
+            add_single_type<Codec>(__mangle_name(name, desc->full_name()),
+                                   google::protobuf::FieldDescriptor::TYPE_MESSAGE,
+                                   google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE);
+        }
+
         /// \brief Remove a new field codec (used for codecs operating on statically generated Protobuf messages, that is, children of google::protobuf::Message but not google::protobuf::Message itself).
         ///
         /// \tparam Codec A child of FieldCodecBase
@@ -116,6 +134,15 @@ namespace dccl
         template<class Codec, google::protobuf::FieldDescriptor::Type type>
             static void remove(const std::string& name);
 
+        /// \brief Remove a message codec added for one message type with add(const std::string&, const google::protobuf::Descriptor*)
+        template<class Codec>
+            static void remove(const std::string& name, const google::protobuf::Descriptor* desc)
+        {
+            remove_single_type<Codec>(__mangle_name(name, desc->full_name()),
+                                      google::protobuf::FieldDescriptor::TYPE_MESSAGE,
+                                      google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE);
+        }
+
         
         /// \brief Find the codec for a given field. For embedded messages, prefers (dccl.field).codec (inside field) over (dccl.msg).codec (inside embedded message).
         static boost::shared_ptr<FieldCodecBase> find(
@@ -163,7 +190,10 @@ namespace dccl
         static void clear()
         {
             internal::TypeHelper::reset();
-            codecs_.clear();
+            CodecMapCell::Writer writer(codecs_);
+            writer.modify().clear();
+            writer.publish();
+            bump_all_generations();
         }
         
         
@@ -180,6 +210,14 @@ namespace dccl
             const std::string& codec_name,
             const std::string& type_name = "");
             
+        // changes whenever the codec registered as `name` for `type` is added or removed; find()
+        // records the generations of the names it looks up into the DependencyScope in progress
+        static internal::Generation* generation(google::protobuf::FieldDescriptor::Type type,
+                                                const std::string& name);
+        static void bump_generation(google::protobuf::FieldDescriptor::Type type,
+                                    const std::string& name);
+        static void bump_all_generations();
+
         static std::string __mangle_name(const std::string& codec_name,
                                          const std::string& type_name) 
         { return type_name.empty() ? codec_name : codec_name + "[" + type_name + "]"; }
@@ -223,7 +261,16 @@ namespace dccl
 
       private:
         typedef std::map<std::string, boost::shared_ptr<FieldCodecBase> > InsideMap;
-        static std::map<google::protobuf::FieldDescriptor::Type, InsideMap> codecs_;
+        typedef std::map<google::protobuf::FieldDescriptor::Type, InsideMap> CodecMap;
+        typedef internal::SnapshotCell<CodecMap> CodecMapCell;
+        // readers (__find) never block: add/remove publish a new copy of the map
+        static CodecMapCell codecs_;
+
+        typedef std::map<std::pair<google::protobuf::FieldDescriptor::Type, std::string>,
+            boost::shared_ptr<internal::Generation> > GenerationMap;
+        // entries are never erased, so that cached results can hold on to them
+        static GenerationMap generations_;
+        static boost::mutex generations_mutex_;
     };
 }
 
@@ -237,6 +284,8 @@ void>::type
     dccl::FieldCodecManager::add(const std::string& name, compiler::dummy_fcm<0> dummy_fcm)
 {
     internal::TypeHelper::add<typename Codec::wire_type>();
+    // the type helper for this message type has changed, whichever codec the field uses
+    bump_generation(google::protobuf::FieldDescriptor::TYPE_MESSAGE, __mangle_name("", Codec::wire_type::descriptor()->full_name()));
     add_single_type<Codec>(__mangle_name(name, Codec::wire_type::descriptor()->full_name()),
                            google::protobuf::FieldDescriptor::TYPE_MESSAGE,
                            google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE);
@@ -284,26 +333,26 @@ void dccl::FieldCodecManager::add_single_type(const std::string& name,
                                               google::protobuf::FieldDescriptor::CppType wire_type)
 {
     using google::protobuf::FieldDescriptor;
-    if(!codecs_[field_type].count(name))
+    boost::shared_ptr<FieldCodecBase> new_field_codec(new Codec());
+    new_field_codec->set_name(name);
+    new_field_codec->set_field_type(field_type);
+    new_field_codec->set_wire_type(wire_type);
+
+    CodecMapCell::Writer writer(codecs_);
+    const CodecMap& current = writer.current();
+    CodecMap::const_iterator it = current.find(field_type);
+    if(it == current.end() || !it->second.count(name))
     {
-        boost::shared_ptr<FieldCodecBase> new_field_codec(new Codec());
-        new_field_codec->set_name(name);
-        new_field_codec->set_field_type(field_type);
-        new_field_codec->set_wire_type(wire_type);
-        
-        codecs_[field_type][name] = new_field_codec;
+        writer.modify()[field_type][name] = new_field_codec;
+        writer.publish();
+        bump_generation(field_type, name);
         dccl::dlog.is(dccl::logger::DEBUG1) && dccl::dlog << "Adding codec " << *new_field_codec << std::endl;
     }            
     else
     {
-        boost::shared_ptr<FieldCodecBase> new_field_codec(new Codec());
-        new_field_codec->set_name(name);
-        new_field_codec->set_field_type(field_type);
-        new_field_codec->set_wire_type(wire_type);
-        
         dccl::dlog.is(dccl::logger::DEBUG1) && dccl::dlog << "Trying to add: " << *new_field_codec
                                                             << ", but already have duplicate codec (For `name`/`field type` pair) "
-                                                            << *(codecs_[field_type].find(name)->second)
+                                                            << *(it->second.find(name)->second)
                                                             << std::endl;
     }
 }
@@ -320,6 +369,7 @@ void>::type
     dccl::FieldCodecManager::remove(const std::string& name, compiler::dummy_fcm<0> dummy_fcm)
 {
     internal::TypeHelper::remove<typename Codec::wire_type>();
+    bump_generation(google::protobuf::FieldDescriptor::TYPE_MESSAGE, __mangle_name("", Codec::wire_type::descriptor()->full_name()));
     remove_single_type<Codec>(__mangle_name(name, Codec::wire_type::descriptor()->full_name()),
                               google::protobuf::FieldDescriptor::TYPE_MESSAGE,
                               google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE);
@@ -367,10 +417,15 @@ void dccl::FieldCodecManager::remove_single_type(const std::string& name,
                                               google::protobuf::FieldDescriptor::CppType wire_type)
 {
     using google::protobuf::FieldDescriptor;
-    if(codecs_[field_type].count(name))
+    CodecMapCell::Writer writer(codecs_);
+    const CodecMap& current = writer.current();
+    CodecMap::const_iterator it = current.find(field_type);
+    if(it != current.end() && it->second.count(name))
     {       
-        dccl::dlog.is(dccl::logger::DEBUG1) && dccl::dlog << "Removing codec " << *codecs_[field_type][name]  << std::endl;
-        codecs_[field_type].erase(name);
+        dccl::dlog.is(dccl::logger::DEBUG1) && dccl::dlog << "Removing codec " << *(it->second.find(name)->second) << std::endl;
+        writer.modify()[field_type].erase(name);
+        writer.publish();
+        bump_generation(field_type, name);
     }            
     else
     {
@@ -23,7 +23,10 @@
 #define DCCLFIELDCODECTYPED20120312H
 
 
+#include <typeinfo>
+
 #include <boost/type_traits.hpp>
+#include <boost/optional.hpp>
 
 #include "field_codec.h"
 
@@ -86,6 +89,7 @@ typedef WireType wire_type;
       typedef FieldType field_type;
 
       public:
+      TypedFieldCodec() : direct_io_type_(0) { }
           
       /// \brief Encode an empty field
       ///
@@ -114,8 +118,140 @@ typedef WireType wire_type;
       /// \param wire_value Value to use when calculating the size of the field. If calculating the size requires encoding the field completely, cache the encoded value for a likely future call to encode() for the same wire_value.
       /// \return the size (in bits) of the field.
       virtual unsigned size(const WireType& wire_value) = 0;
+
+      /// \brief Encode an empty field directly into a BitWriter. Override this (along with encode(BitWriter*, const WireType&) and decode(BitReader*)) to avoid creating an intermediate Bitset for every field.
+      ///
+      /// The default implementation writes the result of encode(). A codec implementing these overloads should call set_direct_io_type() from its constructor, so that a subclass changing its encoding (by overriding only encode(const WireType&), decode(Bitset*), etc.) is not bypassed.
+      /// \param writer BitWriter to write the encoded field to.
+      virtual void encode(BitWriter* writer)
+      { writer->write(encode()); }
+
+      /// \brief Encode a non-empty field directly into a BitWriter.
+      ///
+      /// The default implementation writes the result of encode(const WireType&).
+      /// \param writer BitWriter to write the encoded field to.
+      /// \param wire_value Value to encode.
+      virtual void encode(BitWriter* writer, const WireType& wire_value)
+      { writer->write(encode(wire_value)); }
+
+      /// \brief Decode a field directly from a BitReader. If the field is empty, throw NullValueException to indicate this.
+      ///
+      /// The default implementation passes min_size() bits (and up to max_size() bits through Bitset::get_more_bits()) to decode(Bitset*).
+      /// \param reader BitReader to decode from. Exactly the bits used by this field must be consumed.
+      /// \return the decoded value.
+      virtual WireType decode(BitReader* reader)
+      {
+          internal::BitReaderBitset bits(reader, this->max_size(), this->min_size());
+          return decode(bits.bits());
+      }
+
+      /// \brief Decode a field, reporting an empty field through the return value rather than NullValueException. This is what DCCL calls when decoding a message.
+      ///
+      /// The default implementation calls decode(Bitset*) and catches NullValueException, so codecs that only implement decode() keep working unchanged. Codecs that often decode empty fields should override this (and try_decode(BitReader*, WireType*)) to avoid the cost of throwing an exception for every empty field, and implement decode() in terms of it (calling set_direct_io_type(), as with encode(BitWriter*)).
+      /// \param bits Bits to use for decoding.
+      /// \param wire_value Set to the decoded value if the field is not empty.
+      /// \return true if a value was decoded, false if the field is empty.
+      virtual bool try_decode(Bitset* bits, WireType* wire_value)
+      {
+          try
+          {
+              *wire_value = decode(bits);
+              return true;
+          }
+          catch(NullValueException&)
+          { return false; }
+      }
+
+      /// \brief Decode a field directly from a BitReader, reporting an empty field through the return value rather than NullValueException.
+      ///
+      /// The default implementation calls decode(BitReader*) and catches NullValueException.
+      /// \param reader BitReader to decode from. Exactly the bits used by this field must be consumed.
+      /// \param wire_value Set to the decoded value if the field is not empty.
+      /// \return true if a value was decoded, false if the field is empty.
+      virtual bool try_decode(BitReader* reader, WireType* wire_value)
+      {
+          try
+          {
+              *wire_value = decode(reader);
+              return true;
+          }
+          catch(NullValueException&)
+          { return false; }
+      }
+
+      /// \brief Whether DCCL uses the BitWriter / BitReader overloads and try_decode() for this codec, or only encode(), encode(const WireType&) and decode(Bitset*).
+      ///
+      /// True unless this codec is a subclass of the type given to set_direct_io_type().
+      bool direct_io() const
+      { return !direct_io_type_ || typeid(*this) == *direct_io_type_; }
+
+      /// \brief Encode an empty field with encode(BitWriter*) if direct_io(), and encode() otherwise.
+      void dispatch_encode(BitWriter* writer)
+      {
+          if(direct_io())
+              encode(writer);
+          else
+              writer->write(encode());
+      }
+
+      /// \brief Encode a non-empty field with encode(BitWriter*, const WireType&) if direct_io(), and encode(const WireType&) otherwise.
+      void dispatch_encode(BitWriter* writer, const WireType& wire_value)
+      {
+          if(direct_io())
+              encode(writer, wire_value);
+          else
+              writer->write(encode(wire_value));
+      }
+
+      /// \brief Decode a field with try_decode(Bitset*, WireType*) if direct_io(), and decode(Bitset*) otherwise.
+      bool dispatch_try_decode(Bitset* bits, WireType* wire_value)
+      {
+          if(direct_io())
+              return try_decode(bits, wire_value);
+
+          try
+          {
+              *wire_value = decode(bits);
+              return true;
+          }
+          catch(NullValueException&)
+          { return false; }
+      }
+
+      /// \brief Decode a field with try_decode(BitReader*, WireType*) if direct_io(), and decode(Bitset*) otherwise.
+      bool dispatch_try_decode(BitReader* reader, WireType* wire_value)
+      {
+          if(direct_io())
+              return try_decode(reader, wire_value);
+
+          internal::BitReaderBitset bits(reader, this->max_size(), this->min_size());
+          return dispatch_try_decode(bits.bits(), wire_value);
+      }
           
+      protected:
+      /// \brief Declare that the BitWriter / BitReader overloads and try_decode() of `type` encode the same way as its encode(), encode(const WireType&) and decode(Bitset*). Call from the constructor of `type`, e.g. set_direct_io_type(typeid(MyCodec)).
+      ///
+      /// These overloads are then only used for codecs of exactly this type: a subclass that overrides only encode(const WireType&), decode(Bitset*), etc. is encoded through those (see direct_io()). A subclass that does not change the encoding, or that overrides both sets, can call this with its own type to keep the faster path.
+      void set_direct_io_type(const std::type_info& type)
+      { direct_io_type_ = &type; }
+
+      bool supports_typed(const google::protobuf::FieldDescriptor* field)
+      { return supports_typed_specific<FieldType>(field); }
+
+      // protected so that a child codec can handle some fields itself and pass the rest on
+      void typed_encode(BitWriter* writer, const google::protobuf::Message& parent)
+      { typed_encode_specific<FieldType>(writer, parent); }
+
+      void typed_decode(BitReader* reader, google::protobuf::Message* parent)
+      { typed_decode_specific<FieldType>(reader, parent); }
+
+      unsigned typed_size(const google::protobuf::Message& parent)
+      { return typed_size_specific<FieldType>(parent); }
+
       private:
+      // see set_direct_io_type()
+      const std::type_info* direct_io_type_;
+
       unsigned any_size(const boost::any& wire_value)
       {
           try
@@ -132,11 +268,29 @@ typedef WireType wire_type;
           { throw(type_error("encode", typeid(WireType), wire_value.type())); }
       }
 
+      void any_encode(BitWriter* writer, const boost::any& wire_value)
+      {
+          try
+          {
+              if(wire_value.empty())
+                  dispatch_encode(writer);
+              else
+                  dispatch_encode(writer, boost::any_cast<WireType>(wire_value));
+          }
+          catch(boost::bad_any_cast&)
+          { throw(type_error("encode", typeid(WireType), wire_value.type())); }
+      }
+
       void any_decode(Bitset* bits, boost::any* wire_value)
       {
           any_decode_specific<WireType>(bits, wire_value);
       }
 
+      void any_decode(BitReader* reader, boost::any* wire_value)
+      {
+          any_decode_specific<WireType>(reader, wire_value);
+      }
+
 
 
       void any_pre_encode(boost::any* wire_value,
@@ -190,30 +344,195 @@ typedef WireType wire_type;
       }
 
       
-      template<typename T>
+      template<typename T, typename BitSource>
       typename boost::enable_if<boost::is_base_of<google::protobuf::Message, T>, void>::type
-      any_decode_specific(Bitset* bits, boost::any* wire_value, compiler::dummy<0> dummy = 0)
+      any_decode_specific(BitSource* bits, boost::any* wire_value, compiler::dummy<0> dummy = 0)
       {
-          try
+          WireType decoded;
+          if(dispatch_try_decode(bits, &decoded))
           {
               google::protobuf::Message* msg = boost::any_cast<google::protobuf::Message* >(*wire_value);  
-              msg->CopyFrom(decode(bits));
+              msg->CopyFrom(decoded);
           }
-          catch(NullValueException&)
+          else if(FieldCodecBase::this_field())
           {
-              if(FieldCodecBase::this_field())
-                  *wire_value = boost::any();
-          }              
+              *wire_value = boost::any();
+          }
       }
           
-      template<typename T>
+      template<typename T, typename BitSource>
       typename boost::disable_if<boost::is_base_of<google::protobuf::Message, T>, void>::type
-      any_decode_specific(Bitset* bits, boost::any* wire_value, compiler::dummy<1> dummy = 0)
+      any_decode_specific(BitSource* bits, boost::any* wire_value, compiler::dummy<1> dummy = 0)
       {
+          WireType decoded;
+          if(dispatch_try_decode(bits, &decoded))
+              *wire_value = decoded;
+          else
+              *wire_value = boost::any();
+      }
+
+      // typed (no boost::any) path, only for FieldTypes that can be read directly from google::protobuf::Reflection
+      template<typename T>
+      typename boost::disable_if<internal::ReflectedValue<T>, bool>::type
+      supports_typed_specific(const google::protobuf::FieldDescriptor* field, compiler::dummy<0> dummy = 0)
+      { return false; }
+
+      template<typename T>
+      typename boost::enable_if<internal::ReflectedValue<T>, bool>::type
+      supports_typed_specific(const google::protobuf::FieldDescriptor* field, compiler::dummy<1> dummy = 0)
+      { return field->cpp_type() == internal::ToProtoCppType<T>::as_enum(); }
+
+      template<typename T>
+      typename boost::disable_if<internal::ReflectedValue<T>, void>::type
+      typed_encode_specific(BitWriter* writer, const google::protobuf::Message& parent, compiler::dummy<0> dummy = 0)
+      { FieldCodecBase::typed_encode(writer, parent); }
+
+      template<typename T>
+      typename boost::enable_if<internal::ReflectedValue<T>, void>::type
+      typed_encode_specific(BitWriter* writer, const google::protobuf::Message& parent, compiler::dummy<1> dummy = 0)
+      {
+          const google::protobuf::FieldDescriptor* field = FieldCodecBase::this_field();
+          if(field->is_repeated())
+          {
+              const unsigned values_size = parent.GetReflection()->FieldSize(parent, field);
+              const unsigned max_repeat = this->field_params().max_repeat;
+              if(values_size > max_repeat)
+                  throw(dccl::OutOfRangeException(std::string("Repeated size exceeds max_repeat for field: ") + field->DebugString(), field));
+
+              // for DCCL3 and beyond, prefix the vector size (rather than always going to max_repeat)
+              unsigned wire_vector_size = max_repeat;
+              if(FieldCodecBase::codec_version() > 2)
+              {
+                  wire_vector_size = values_size;
+                  writer->write(values_size, FieldCodecBase::repeated_vector_field_size(max_repeat));
+              }
+
+              for(unsigned i = 0; i < wire_vector_size; ++i)
+              {
+                  if(i < values_size)
+                      typed_encode_value(writer, internal::ReflectedValue<T>::get_repeated(parent, field, i));
+                  else
+                      dispatch_encode(writer);
+              }
+          }
+          else if(!parent.GetReflection()->HasField(parent, field))
+          {
+              dispatch_encode(writer);
+          }
+          else
+          {
+              typed_encode_value(writer, internal::ReflectedValue<T>::get(parent, field));
+          }
+      }
+
+      void typed_encode_value(BitWriter* writer, const FieldType& field_value)
+      {
+          boost::optional<WireType> wire_value;
+          try
+          { wire_value = this->pre_encode(field_value); }
+          catch(NullValueException&)
+          { }
+
+          if(wire_value)
+              dispatch_encode(writer, *wire_value);
+          else
+              dispatch_encode(writer);
+      }
+
+      template<typename T>
+      typename boost::disable_if<internal::ReflectedValue<T>, void>::type
+      typed_decode_specific(BitReader* reader, google::protobuf::Message* parent, compiler::dummy<0> dummy = 0)
+      { FieldCodecBase::typed_decode(reader, parent); }
+
+      template<typename T>
+      typename boost::enable_if<internal::ReflectedValue<T>, void>::type
+      typed_decode_specific(BitReader* reader, google::protobuf::Message* parent, compiler::dummy<1> dummy = 0)
+      {
+          const google::protobuf::FieldDescriptor* field = FieldCodecBase::this_field();
+          if(field->is_repeated())
+          {
+              const unsigned max_repeat = this->field_params().max_repeat;
+              unsigned wire_vector_size = max_repeat;
+              if(FieldCodecBase::codec_version() > 2)
+                  wire_vector_size = reader->read(FieldCodecBase::repeated_vector_field_size(max_repeat));
+
+              for(unsigned i = 0; i < wire_vector_size; ++i)
+              {
+                  WireType wire_value;
+                  if(dispatch_try_decode(reader, &wire_value))
+                  {
+                      // post_decode() may still signal an empty field (e.g. an unknown enumeration index)
+                      try
+                      { internal::ReflectedValue<T>::add(parent, field, this->post_decode(wire_value)); }
+                      catch(NullValueException&)
+                      { }
+                  }
+              }
+          }
+          else
+          {
+              WireType wire_value;
+              if(dispatch_try_decode(reader, &wire_value))
+              {
+                  try
+                  { internal::ReflectedValue<T>::set(parent, field, this->post_decode(wire_value)); }
+                  catch(NullValueException&)
+                  { }
+              }
+          }
+      }
+
+      template<typename T>
+      typename boost::disable_if<internal::ReflectedValue<T>, unsigned>::type
+      typed_size_specific(const google::protobuf::Message& parent, compiler::dummy<0> dummy = 0)
+      { return FieldCodecBase::typed_size(parent); }
+
+      template<typename T>
+      typename boost::enable_if<internal::ReflectedValue<T>, unsigned>::type
+      typed_size_specific(const google::protobuf::Message& parent, compiler::dummy<1> dummy = 0)
+      {
+          const google::protobuf::FieldDescriptor* field = FieldCodecBase::this_field();
+          if(field->is_repeated())
+          {
+              const unsigned values_size = parent.GetReflection()->FieldSize(parent, field);
+              const unsigned max_repeat = this->field_params().max_repeat;
+
+              unsigned out = 0;
+              unsigned wire_vector_size = max_repeat;
+              if(FieldCodecBase::codec_version() > 2)
+              {
+                  wire_vector_size = std::min(max_repeat, values_size);
+                  out += FieldCodecBase::repeated_vector_field_size(max_repeat);
+              }
+
+              for(unsigned i = 0; i < wire_vector_size; ++i)
+              {
+                  if(i < values_size)
+                      out += typed_size_value(internal::ReflectedValue<T>::get_repeated(parent, field, i));
+                  else
+                      out += size();
+              }
+              return out;
+          }
+          else if(!parent.GetReflection()->HasField(parent, field))
+          {
+              return size();
+          }
+          else
+          {
+              return typed_size_value(internal::ReflectedValue<T>::get(parent, field));
+          }
+      }
+
+      unsigned typed_size_value(const FieldType& field_value)
+      {
+          boost::optional<WireType> wire_value;
           try
-          { *wire_value = decode(bits); }
+          { wire_value = this->pre_encode(field_value); }
           catch(NullValueException&)
-          { *wire_value = boost::any(); }              
+          { }
+
+          return wire_value ? size(*wire_value) : size();
       }
     
     };
@@ -275,6 +594,23 @@ typedef WireType wire_type;
               return return_vec.at(0);
       }
 
+      /// \brief Decode a field, returning false rather than throwing if it is empty
+      virtual bool try_decode(dccl::Bitset* bits, WireType* wire_value)
+      {
+          std::vector<WireType> return_vec = decode_repeated(bits);
+          if(return_vec.empty())
+              return false;
+          *wire_value = return_vec.at(0);
+          return true;
+      }
+
+      /// \brief Decode a field from a BitReader, returning false rather than throwing if it is empty
+      virtual bool try_decode(dccl::BitReader* reader, WireType* wire_value)
+      {
+          internal::BitReaderBitset bits(reader, max_size_repeated(), min_size_repeated());
+          return try_decode(bits.bits(), wire_value);
+      }
+
       /// \brief Calculate the size (in bits) of an empty field.
       ///
       /// \return the size (in bits) of the empty field.
@@ -294,6 +630,11 @@ typedef WireType wire_type;
       virtual unsigned min_size()
       { return min_size_repeated(); }
 
+      protected:
+      // repeated fields use encode_repeated() and friends, so only single fields can take the typed path
+      bool supports_typed(const google::protobuf::FieldDescriptor* field)
+      { return !field->is_repeated() && TypedFieldCodec<WireType, FieldType>::supports_typed(field); }
+
           
       private:
       void any_encode_repeated(Bitset* bits, const std::vector<boost::any>& wire_values)
@@ -317,15 +658,35 @@ typedef WireType wire_type;
           any_decode_repeated_specific<WireType>(repeated_bits, field_values);
       }
 
+      void any_encode_repeated(BitWriter* writer, const std::vector<boost::any>& wire_values)
+      {
+          Bitset bits;
+          any_encode_repeated(&bits, wire_values);
+          writer->write(bits);
+      }
+
+      void any_decode_repeated(BitReader* reader, std::vector<boost::any>* field_values)
+      {
+          internal::BitReaderBitset bits(reader, max_size_repeated(), min_size_repeated());
+          any_decode_repeated(bits.bits(), field_values);
+      }
+
       template<typename T>
       typename boost::enable_if<boost::is_base_of<google::protobuf::Message, T>, void>::type
       any_decode_repeated_specific(Bitset* repeated_bits, std::vector<boost::any>* wire_values, compiler::dummy<0> dummy = 0)
       {
           std::vector<WireType> decoded_msgs = decode_repeated(repeated_bits);
-          wire_values->resize(decoded_msgs.size(), WireType());
+          wire_values->resize(decoded_msgs.size());
               
           for(int i = 0, n = decoded_msgs.size(); i < n; ++i)
           {
+              // values of a repeated field are added to the parent as they are decoded
+              if(wire_values->at(i).empty())
+              {
+                  google::protobuf::Message* added = internal::add_repeated_message(this->this_field());
+                  if(added)
+                      wire_values->at(i) = added;
+              }
               google::protobuf::Message* msg = boost::any_cast<google::protobuf::Message* >(wire_values->at(i));
               msg->CopyFrom(decoded_msgs[i]);
           }
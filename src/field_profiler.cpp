@@ -0,0 +1,162 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include <algorithm>
+#include <iomanip>
+
+#include "dccl/field_profiler.h"
+#include "dccl/field_codec.h"
+#include "dccl/internal/field_profile.h"
+
+namespace
+{
+    // messages handled by this thread since it last profiled one
+    DCCL_THREAD_LOCAL unsigned unsampled = 0;
+
+    dccl::uint64 total_ns(const dccl::FieldProfile& p) { return p.encode_ns + p.decode_ns; }
+
+    bool more_time(const dccl::FieldProfile& a, const dccl::FieldProfile& b)
+    { return total_ns(a) > total_ns(b); }
+
+    bool more_bits(const dccl::FieldProfile& a, const dccl::FieldProfile& b)
+    { return a.encode_bits > b.encode_bits; }
+
+    std::string field_name(const dccl::FieldProfile& p)
+    { return p.field->containing_type()->full_name() + "." + p.field->name(); }
+
+    double percent(dccl::uint64 part, dccl::uint64 whole)
+    { return whole ? 100.0 * part / whole : 0; }
+
+    double per_call(dccl::uint64 total, dccl::uint64 calls)
+    { return calls ? static_cast<double>(total) / calls : 0; }
+}
+
+dccl::FieldProfiler::FieldProfiler(unsigned sample_period /* = 1 */)
+    : sample_period_(std::max(1u, sample_period)),
+      sampled_messages_(0)
+{ }
+
+bool dccl::FieldProfiler::sample()
+{
+    if(++unsampled < sample_period_)
+        return false;
+    unsampled = 0;
+    return true;
+}
+
+void dccl::FieldProfiler::add(const internal::FieldProfileBuffer& buffer)
+{
+    boost::mutex::scoped_lock lock(mutex_);
+    ++sampled_messages_;
+    for(std::vector<internal::FieldProfileBuffer::Entry>::const_iterator it = buffer.entries.begin(), end = buffer.entries.end(); it != end; ++it)
+    {
+        FieldProfile& profile = profiles_[Key(it->field, it->codec->name())];
+        profile.field = it->field;
+        profile.codec = it->codec->name();
+        if(buffer.decode)
+        {
+            profile.decodes += it->calls;
+            profile.decode_ns += it->ns;
+            profile.decode_bits += it->bits;
+        }
+        else
+        {
+            profile.encodes += it->calls;
+            profile.encode_ns += it->ns;
+            profile.encode_bits += it->bits;
+        }
+    }
+}
+
+dccl::uint64 dccl::FieldProfiler::sampled_messages() const
+{
+    boost::mutex::scoped_lock lock(mutex_);
+    return sampled_messages_;
+}
+
+std::vector<dccl::FieldProfile> dccl::FieldProfiler::profiles() const
+{
+    std::vector<FieldProfile> profiles;
+    boost::mutex::scoped_lock lock(mutex_);
+    profiles.reserve(profiles_.size());
+    for(std::map<Key, FieldProfile>::const_iterator it = profiles_.begin(), end = profiles_.end(); it != end; ++it)
+        profiles.push_back(it->second);
+    return profiles;
+}
+
+void dccl::FieldProfiler::reset()
+{
+    boost::mutex::scoped_lock lock(mutex_);
+    profiles_.clear();
+    sampled_messages_ = 0;
+}
+
+void dccl::FieldProfiler::report(std::ostream* os) const
+{
+    std::vector<FieldProfile> profiles = this->profiles();
+
+    uint64 all_ns = 0, all_bits = 0;
+    std::string::size_type name_width = 5, codec_width = 5;
+    for(std::vector<FieldProfile>::const_iterator it = profiles.begin(), end = profiles.end(); it != end; ++it)
+    {
+        all_ns += total_ns(*it);
+        all_bits += it->encode_bits;
+        name_width = std::max(name_width, field_name(*it).size());
+        codec_width = std::max(codec_width, it->codec.size());
+    }
+
+    const std::ios::fmtflags flags = os->flags();
+    const std::streamsize precision = os->precision();
+    *os << std::fixed << std::setprecision(1);
+
+    *os << "== Fields by time (" << sampled_messages() << " messages sampled, 1 in " << sample_period_ << ") ==\n"
+        << std::left << std::setw(name_width) << "field" << "  " << std::setw(codec_width) << "codec" << std::right
+        << std::setw(10) << "encodes" << std::setw(12) << "ns/encode"
+        << std::setw(10) << "decodes" << std::setw(12) << "ns/decode"
+        << std::setw(9) << "time %" << "\n";
+
+    std::sort(profiles.begin(), profiles.end(), more_time);
+    for(std::vector<FieldProfile>::const_iterator it = profiles.begin(), end = profiles.end(); it != end; ++it)
+    {
+        *os << std::left << std::setw(name_width) << field_name(*it) << "  " << std::setw(codec_width) << it->codec << std::right
+            << std::setw(10) << it->encodes << std::setw(12) << per_call(it->encode_ns, it->encodes)
+            << std::setw(10) << it->decodes << std::setw(12) << per_call(it->decode_ns, it->decodes)
+            << std::setw(9) << percent(total_ns(*it), all_ns) << "\n";
+    }
+
+    *os << "\n== Fields by encoded size ==\n"
+        << std::left << std::setw(name_width) << "field" << "  " << std::setw(codec_width) << "codec" << std::right
+        << std::setw(10) << "encodes" << std::setw(12) << "bits/encode"
+        << std::setw(14) << "total bits" << std::setw(9) << "bits %" << "\n";
+
+    std::stable_sort(profiles.begin(), profiles.end(), more_bits);
+    for(std::vector<FieldProfile>::const_iterator it = profiles.begin(), end = profiles.end(); it != end; ++it)
+    {
+        if(!it->encodes)
+            continue;
+        *os << std::left << std::setw(name_width) << field_name(*it) << "  " << std::setw(codec_width) << it->codec << std::right
+            << std::setw(10) << it->encodes << std::setw(12) << per_call(it->encode_bits, it->encodes)
+            << std::setw(14) << it->encode_bits << std::setw(9) << percent(it->encode_bits, all_bits) << "\n";
+    }
+
+    os->flags(flags);
+    os->precision(precision);
+}
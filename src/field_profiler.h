@@ -0,0 +1,116 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLFIELDPROFILER20261018H
+#define DCCLFIELDPROFILER20261018H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <utility>
+
+#include <boost/thread/mutex.hpp>
+
+#include <google/protobuf/descriptor.h>
+
+#include "dccl/common.h"
+
+namespace dccl
+{
+    namespace internal { struct FieldProfileBuffer; }
+
+    /// \brief Cost of encoding and decoding one field with one field codec, as measured by FieldProfiler
+    struct FieldProfile
+    {
+        FieldProfile()
+            : field(0),
+            encodes(0),
+            decodes(0),
+            encode_ns(0),
+            decode_ns(0),
+            encode_bits(0),
+            decode_bits(0)
+        { }
+
+        /// \brief The field (field->containing_type() is the message it belongs to)
+        const google::protobuf::FieldDescriptor* field;
+        /// \brief Name of the field codec used for it
+        std::string codec;
+
+        /// \brief Number of times the field was encoded (decoded) in the messages sampled
+        uint64 encodes;
+        uint64 decodes;
+        /// \brief Time spent encoding (decoding) the field, in nanoseconds, not including the time spent on the fields of an embedded message (which have their own FieldProfile)
+        uint64 encode_ns;
+        uint64 decode_ns;
+        /// \brief Bits produced by encoding (consumed by decoding) the field, likewise not including those of the fields of an embedded message
+        uint64 encode_bits;
+        uint64 decode_bits;
+    };
+
+    /// \brief Sampling profiler of the time and bits spent on each field, by field codec (see Codec::set_field_profiler()).
+    ///
+    /// Fields encoded by a compiled message codec (see v3::CompiledMessageCodec) are not timed individually.
+    /// \ingroup dccl_api
+    class FieldProfiler
+    {
+      public:
+        /// \param sample_period Profile one in every \a sample_period messages encoded or decoded by each thread (1 profiles every message)
+        explicit FieldProfiler(unsigned sample_period = 1);
+
+        unsigned sample_period() const { return sample_period_; }
+
+        /// \brief Number of messages profiled so far
+        uint64 sampled_messages() const;
+
+        /// \brief The fields profiled so far (in no particular order)
+        std::vector<FieldProfile> profiles() const;
+
+        /// \brief Discard everything profiled so far
+        void reset();
+
+        /// \brief Write two tables of the fields profiled so far: ranked by the time spent on them, and by their share of the bits encoded
+        void report(std::ostream* os) const;
+
+        /// \brief Called by Codec: whether to profile the next message on this thread
+        bool sample();
+
+        /// \brief Called by Codec: adds the fields profiled in one message
+        void add(const internal::FieldProfileBuffer& buffer);
+
+      private:
+        FieldProfiler(const FieldProfiler&);
+        FieldProfiler& operator=(const FieldProfiler&);
+
+      private:
+        unsigned sample_period_;
+
+        typedef std::pair<const google::protobuf::FieldDescriptor*, std::string> Key;
+        std::map<Key, FieldProfile> profiles_;
+        uint64 sampled_messages_;
+
+        // guards profiles_ and sampled_messages_ (held once per sampled message)
+        mutable boost::mutex mutex_;
+    };
+}
+
+#endif
@@ -19,12 +19,21 @@
 //
 // You should have received a copy of the GNU Lesser General Public License
 // along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include <exception>
+
 #include "field_codec_message_stack.h"
 #include "dccl/field_codec.h"
 
-std::vector<const google::protobuf::FieldDescriptor*> dccl::internal::MessageStack::field_;
-std::vector<const google::protobuf::Descriptor*> dccl::internal::MessageStack::desc_;
-std::vector<dccl::MessagePart> dccl::internal::MessageStack::parts_;
+DCCL_THREAD_LOCAL dccl::internal::TraversalContext* dccl::internal::TraversalContext::current_ = 0;
+
+google::protobuf::Message* dccl::internal::add_repeated_message(const google::protobuf::FieldDescriptor* field)
+{
+    TraversalContext* context = TraversalContext::current();
+    if(!context || !field || context->repeated_field != field)
+        return 0;
+    google::protobuf::Message* parent = context->repeated_parent;
+    return parent->GetReflection()->AddMessage(parent, field);
+}
 
 //
 // MessageStack
@@ -33,44 +42,46 @@ std::vector<dccl::MessagePart> dccl::internal::MessageStack::parts_;
 void dccl::internal::MessageStack::push(const google::protobuf::Descriptor* desc)
  
 {
-    desc_.push_back(desc);
+    context_->desc.push_back(desc);
     ++descriptors_pushed_;
 }
 
 void dccl::internal::MessageStack::push(const google::protobuf::FieldDescriptor* field)
 {
-    field_.push_back(field);
+    context_->field.push_back(field);
     ++fields_pushed_;
 }
 
 void dccl::internal::MessageStack::push(MessagePart part)
 {
-    parts_.push_back(part);
+    context_->parts.push_back(part);
     ++parts_pushed_;
 }
 
 
 void dccl::internal::MessageStack::__pop_desc()
 {
-    if(!desc_.empty())
-        desc_.pop_back();
+    if(!context_->desc.empty())
+        context_->desc.pop_back();
 }
 
 void dccl::internal::MessageStack::__pop_field()
 {
-    if(!field_.empty())
-        field_.pop_back();
+    if(!context_->field.empty())
+        context_->field.pop_back();
 }
 
 void dccl::internal::MessageStack::__pop_parts()
 {
-    if(!parts_.empty())
-        parts_.pop_back();
+    if(!context_->parts.empty())
+        context_->parts.pop_back();
 }
 
 
 dccl::internal::MessageStack::MessageStack(const google::protobuf::FieldDescriptor* field)
-    : descriptors_pushed_(0),
+    : scope_(true),
+      context_(TraversalContext::current()),
+      descriptors_pushed_(0),
       fields_pushed_(0),
       parts_pushed_(0)
 {
@@ -98,8 +109,24 @@ dccl::internal::MessageStack::MessageStack(const google::protobuf::FieldDescript
     
 }
 
+namespace
+{
+    bool unwinding()
+    {
+#if __cplusplus >= 201703L
+        return std::uncaught_exceptions() > 0;
+#else
+        return std::uncaught_exception();
+#endif
+    }
+}
+
 dccl::internal::MessageStack::~MessageStack()
 {
+    // record the fields being traversed when the exception was thrown (once, at the innermost field)
+    if(context_->error_field && fields_pushed_ && unwinding())
+        context_->record_error_field();
+
     for(int i = 0; i < fields_pushed_; ++i)
         __pop_field();
 
@@ -22,16 +22,155 @@
 #ifndef DCCLFIELDCODECHELPERS20110825H
 #define DCCLFIELDCODECHELPERS20110825H
 
+#include <vector>
+
 #include "dccl/common.h"
 
 namespace dccl
 {
     class FieldCodecBase;
+    class CodecContext;
     enum MessagePart { HEAD, BODY, UNKNOWN };
 
     /// Namespace for objects used internally by DCCL
     namespace internal
     {
+        struct FieldProfileBuffer;
+        struct PlannedField;
+
+        // State of a single traversal (encode, decode, size, etc.) of a DCCL message.
+        // Each thread has its own current traversal, so that Codec instances
+        // can be used concurrently from different threads.
+        struct TraversalContext
+        {
+            TraversalContext()
+            : part(UNKNOWN),
+                strict(false),
+                root_message(0),
+                root_descriptor(0),
+                error_field(0),
+                profile(0),
+                codec_context(0),
+                planned(0),
+                repeated_parent(0),
+                repeated_field(0)
+                { }
+
+            MessagePart part;
+            bool strict;
+            const google::protobuf::Message* root_message;
+            const google::protobuf::Descriptor* root_descriptor;
+
+            std::vector<const google::protobuf::Descriptor*> desc;
+            std::vector<const google::protobuf::FieldDescriptor*> field;
+            std::vector<MessagePart> parts;
+
+            // if set, receives a copy of `field` as an exception leaves the innermost field
+            // (see ~MessageStack), so that Codec::try_encode() / try_decode() can report where they failed
+            std::vector<const google::protobuf::FieldDescriptor*>* error_field;
+
+            // if set, the fields of this traversal are timed into it (see FieldProfiler)
+            FieldProfileBuffer* profile;
+
+            // state kept by field codec libraries for the Codec doing this traversal (see Codec::set_codec_context)
+            CodecContext* codec_context;
+
+            // the field of a MessagePlan that its codec is handed next, with the parameters,
+            // sizes and plan resolved when the plan was compiled (see set_planned_field)
+            const PlannedField* planned;
+
+            // if set, the message to which the values of the repeated message field `repeated_field`
+            // are added as they are decoded (see RepeatedMessageScope and add_repeated_message)
+            google::protobuf::Message* repeated_parent;
+            const google::protobuf::FieldDescriptor* repeated_field;
+
+            // copies `field` (followed by `innermost`, if given) to error_field, if requested and not yet recorded
+            void record_error_field(const google::protobuf::FieldDescriptor* innermost = 0)
+            {
+                if(!error_field || !error_field->empty())
+                    return;
+                *error_field = field;
+                if(innermost)
+                    error_field->push_back(innermost);
+            }
+
+            // traversal in progress on this thread, or 0 if none
+            static TraversalContext* current() { return current_; }
+
+          private:
+            friend class TraversalScope;
+            static DCCL_THREAD_LOCAL TraversalContext* current_;
+        };
+
+        // RAII handler that makes a new (empty) TraversalContext current for this thread,
+        // and restores the previous one on destruction. If reuse_current is true and a traversal
+        // is already in progress on this thread, that traversal is left current instead.
+        class TraversalScope
+        {
+          public:
+            explicit TraversalScope(bool reuse_current = false)
+                : previous_(TraversalContext::current_),
+                installed_(!(reuse_current && previous_))
+            {
+                if(installed_)
+                    TraversalContext::current_ = &context_;
+            }
+
+            ~TraversalScope()
+            {
+                if(installed_)
+                    TraversalContext::current_ = previous_;
+            }
+
+          private:
+            TraversalScope(const TraversalScope&);
+            TraversalScope& operator=(const TraversalScope&);
+
+            TraversalContext context_;
+            TraversalContext* previous_;
+            bool installed_;
+        };
+
+        // RAII handler that makes the values of the repeated message field `field` of `parent`
+        // decoded in this traversal be added to `parent` one at a time, and restores the previous
+        // field on destruction
+        class RepeatedMessageScope
+        {
+          public:
+            RepeatedMessageScope(google::protobuf::Message* parent, const google::protobuf::FieldDescriptor* field)
+                : context_(TraversalContext::current()),
+                parent_(context_ ? context_->repeated_parent : 0),
+                field_(context_ ? context_->repeated_field : 0)
+            {
+                if(context_)
+                {
+                    context_->repeated_parent = parent;
+                    context_->repeated_field = field;
+                }
+            }
+
+            ~RepeatedMessageScope()
+            {
+                if(context_)
+                {
+                    context_->repeated_parent = parent_;
+                    context_->repeated_field = field_;
+                }
+            }
+
+          private:
+            RepeatedMessageScope(const RepeatedMessageScope&);
+            RepeatedMessageScope& operator=(const RepeatedMessageScope&);
+
+            TraversalContext* context_;
+            google::protobuf::Message* parent_;
+            const google::protobuf::FieldDescriptor* field_;
+        };
+
+        // adds a new value to the repeated message field `field` given to the current RepeatedMessageScope
+        // and returns it, or returns 0 if `field` is not that field
+        google::protobuf::Message* add_repeated_message(const google::protobuf::FieldDescriptor* field);
+
         //RAII handler for the current Message recursion stack
         class MessageStack
         {
@@ -41,25 +180,32 @@ namespace dccl
             ~MessageStack();
             
             bool first() 
-            { return desc_.empty(); }
+            { return context_->desc.empty(); }
             int count() 
-            { return desc_.size(); }
+            { return context_->desc.size(); }
+            int field_count()
+            { return context_->field.size(); }
 
             void push(const google::protobuf::Descriptor* desc);
             void push(const google::protobuf::FieldDescriptor* field);
             void push(MessagePart part);
 
-            static MessagePart current_part() { return parts_.empty() ? UNKNOWN : parts_.back(); }
+            static MessagePart current_part()
+            {
+                TraversalContext* context = TraversalContext::current();
+                return (!context || context->parts.empty()) ? UNKNOWN : context->parts.back();
+            }
         
-            friend class ::dccl::FieldCodecBase;
           private:
+            MessageStack(const MessageStack&);
+            MessageStack& operator=(const MessageStack&);
+
             void __pop_desc();
             void __pop_field();
             void __pop_parts();
-                
-            static std::vector<const google::protobuf::Descriptor*> desc_;
-            static std::vector<const google::protobuf::FieldDescriptor*> field_;
-            static std::vector<MessagePart> parts_;
+
+            TraversalScope scope_;
+            TraversalContext* context_;
             int descriptors_pushed_;
             int fields_pushed_;
             int parts_pushed_;
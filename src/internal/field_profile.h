@@ -0,0 +1,183 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLFIELDPROFILE20261018H
+#define DCCLFIELDPROFILE20261018H
+
+#include <vector>
+
+#include "dccl/bitstream.h"
+#include "dccl/field_profiler.h"
+#include "dccl/internal/field_codec_message_stack.h"
+#include "dccl/internal/stats_recorder.h"
+
+namespace dccl
+{
+    class FieldCodecBase;
+
+    namespace internal
+    {
+        // Fields profiled during one sampled encode or decode, added to the FieldProfiler when it finishes
+        struct FieldProfileBuffer
+        {
+            explicit FieldProfileBuffer(bool is_decode)
+                : decode(is_decode),
+                child_ns(0),
+                child_bits(0)
+            { }
+
+            struct Entry
+            {
+                const google::protobuf::FieldDescriptor* field;
+                const FieldCodecBase* codec;
+                uint64 calls;
+                uint64 ns;
+                uint64 bits;
+            };
+
+            void add(const google::protobuf::FieldDescriptor* field, const FieldCodecBase* codec, uint64 ns, uint64 bits)
+            {
+                // a message rarely has more than a few dozen fields, and repeats are usually consecutive
+                for(std::vector<Entry>::reverse_iterator it = entries.rbegin(), end = entries.rend(); it != end; ++it)
+                {
+                    if(it->field == field && it->codec == codec)
+                    {
+                        ++it->calls;
+                        it->ns += ns;
+                        it->bits += bits;
+                        return;
+                    }
+                }
+                Entry entry = { field, codec, 1, ns, bits };
+                entries.push_back(entry);
+            }
+
+            bool decode;
+            // time and bits of the fields nested in the field being profiled, so that they can be excluded from it
+            uint64 child_ns;
+            uint64 child_bits;
+            std::vector<Entry> entries;
+        };
+
+        // RAII timer for one field, placed in FieldCodecBase::field_encode() / field_decode().
+        // Does nothing (beyond checking the current TraversalContext) unless the message is being profiled.
+        class FieldProfileScope
+        {
+          public:
+            FieldProfileScope(const FieldCodecBase* codec, const google::protobuf::FieldDescriptor* field, const BitWriter* writer)
+                : buffer_(buffer(field)),
+                writer_(writer),
+                reader_(0)
+            {
+                if(buffer_)
+                    begin(codec, field);
+            }
+
+            FieldProfileScope(const FieldCodecBase* codec, const google::protobuf::FieldDescriptor* field, const BitReader* reader)
+                : buffer_(buffer(field)),
+                writer_(0),
+                reader_(reader)
+            {
+                if(buffer_)
+                    begin(codec, field);
+            }
+
+            ~FieldProfileScope()
+            {
+                if(!buffer_)
+                    return;
+
+                const uint64 ns = monotonic_ns() - start_ns_;
+                const uint64 bits = position() - start_bits_;
+                buffer_->add(field_, codec_, ns - buffer_->child_ns, bits - buffer_->child_bits);
+                buffer_->child_ns = parent_child_ns_ + ns;
+                buffer_->child_bits = parent_child_bits_ + bits;
+            }
+
+          private:
+            FieldProfileScope(const FieldProfileScope&);
+            FieldProfileScope& operator=(const FieldProfileScope&);
+
+            // the root message (field == 0) is not a field
+            static FieldProfileBuffer* buffer(const google::protobuf::FieldDescriptor* field)
+            {
+                TraversalContext* context = TraversalContext::current();
+                return (field && context) ? context->profile : 0;
+            }
+
+            std::size_t position() const
+            { return writer_ ? writer_->size() : reader_->position(); }
+
+            void begin(const FieldCodecBase* codec, const google::protobuf::FieldDescriptor* field)
+            {
+                codec_ = codec;
+                field_ = field;
+                parent_child_ns_ = buffer_->child_ns;
+                parent_child_bits_ = buffer_->child_bits;
+                buffer_->child_ns = 0;
+                buffer_->child_bits = 0;
+                start_bits_ = position();
+                start_ns_ = monotonic_ns();
+            }
+
+          private:
+            FieldProfileBuffer* buffer_;
+            const BitWriter* writer_;
+            const BitReader* reader_;
+            const FieldCodecBase* codec_;
+            const google::protobuf::FieldDescriptor* field_;
+            uint64 parent_child_ns_;
+            uint64 parent_child_bits_;
+            std::size_t start_bits_;
+            uint64 start_ns_;
+        };
+
+        // Profiles the encode or decode in the current traversal, if the profiler samples it
+        class FieldProfileSampler
+        {
+          public:
+            FieldProfileSampler(FieldProfiler* profiler, bool decode)
+                : profiler_((profiler && profiler->sample()) ? profiler : 0),
+                buffer_(decode)
+            {
+                if(profiler_)
+                    TraversalContext::current()->profile = &buffer_;
+            }
+
+            ~FieldProfileSampler()
+            {
+                if(!profiler_)
+                    return;
+                TraversalContext::current()->profile = 0;
+                profiler_->add(buffer_);
+            }
+
+          private:
+            FieldProfileSampler(const FieldProfileSampler&);
+            FieldProfileSampler& operator=(const FieldProfileSampler&);
+
+            FieldProfiler* profiler_;
+            FieldProfileBuffer buffer_;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,117 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include <algorithm>
+
+#include "generation.h"
+
+boost::atomic<unsigned> dccl::internal::Generation::any_(0);
+
+DCCL_THREAD_LOCAL dccl::internal::DependencyScope* dccl::internal::DependencyScope::current_ = 0;
+
+//
+// Dependencies
+//
+
+dccl::internal::Dependencies::Dependencies(const Dependencies& other)
+    : generations_(other.generations_),
+      recorded_(other.recorded_),
+      checked_(other.checked_.load())
+{ }
+
+dccl::internal::Dependencies& dccl::internal::Dependencies::operator=(const Dependencies& other)
+{
+    generations_ = other.generations_;
+    recorded_ = other.recorded_;
+    checked_ = other.checked_.load();
+    return *this;
+}
+
+bool dccl::internal::Dependencies::current() const
+{
+    if(!recorded_)
+        return false;
+
+    // read before the generations: if one is bumped after this, so is any()
+    const unsigned any = Generation::any();
+    if(checked_ == any)
+        return true;
+
+    for(std::vector<std::pair<const Generation*, unsigned> >::const_iterator it = generations_.begin(), end = generations_.end(); it != end; ++it)
+    {
+        if(it->first->value() != it->second)
+            return false;
+    }
+    checked_ = any;
+    return true;
+}
+
+void dccl::internal::Dependencies::add(const Generation* generation, unsigned value)
+{
+    for(std::vector<std::pair<const Generation*, unsigned> >::iterator it = generations_.begin(), end = generations_.end(); it != end; ++it)
+    {
+        if(it->first == generation)
+        {
+            // the result may have been computed from the older value
+            it->second = std::min(it->second, value);
+            return;
+        }
+    }
+    generations_.push_back(std::make_pair(generation, value));
+}
+
+void dccl::internal::Dependencies::add(const Dependencies& other)
+{
+    for(std::vector<std::pair<const Generation*, unsigned> >::const_iterator it = other.generations_.begin(), end = other.generations_.end(); it != end; ++it)
+        add(it->first, it->second);
+}
+
+//
+// DependencyScope
+//
+
+dccl::internal::DependencyScope::DependencyScope(Dependencies* dependencies)
+    : dependencies_(dependencies),
+      previous_(current_)
+{
+    dependencies_->generations_.clear();
+    dependencies_->recorded_ = true;
+    dependencies_->checked_ = Generation::any();
+    current_ = this;
+}
+
+dccl::internal::DependencyScope::~DependencyScope()
+{
+    current_ = previous_;
+}
+
+void dccl::internal::DependencyScope::record(const Generation* generation)
+{
+    const unsigned value = generation->value();
+    for(DependencyScope* scope = current_; scope; scope = scope->previous_)
+        scope->dependencies_->add(generation, value);
+}
+
+void dccl::internal::DependencyScope::record(const Dependencies& dependencies)
+{
+    for(DependencyScope* scope = current_; scope; scope = scope->previous_)
+        scope->dependencies_->add(dependencies);
+}
@@ -0,0 +1,117 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLGENERATION20261018H
+#define DCCLGENERATION20261018H
+
+#include <vector>
+#include <utility>
+
+#include <boost/atomic.hpp>
+
+#include "dccl/common.h"
+
+namespace dccl
+{
+    namespace internal
+    {
+        // Counter for some state that results are cached from (e.g. the codec registered
+        // for a field type and name), bumped whenever that state changes. Generations are
+        // never destroyed while the library is in use, so they may be referred to by pointer.
+        class Generation
+        {
+          public:
+            Generation() : value_(0) { }
+
+            unsigned value() const { return value_; }
+
+            // call after the state has changed
+            void bump()
+            {
+                ++value_;
+                ++any_;
+            }
+
+            // changes whenever any Generation is bumped
+            static unsigned any() { return any_; }
+
+          private:
+            Generation(const Generation&);
+            Generation& operator=(const Generation&);
+
+            boost::atomic<unsigned> value_;
+            static boost::atomic<unsigned> any_;
+        };
+
+        // The Generations (and their values) that a cached result was computed from: the
+        // result is current until one of them is bumped. Filled in by a DependencyScope.
+        class Dependencies
+        {
+          public:
+            Dependencies() : recorded_(false), checked_(0) { }
+            Dependencies(const Dependencies& other);
+            Dependencies& operator=(const Dependencies& other);
+
+            // false if never recorded, or if one of the Generations has changed since
+            bool current() const;
+
+            void add(const Generation* generation, unsigned value);
+            // adds the Generations of a result that this one was computed from (e.g. the
+            // plan of an embedded message); only valid while other is current()
+            void add(const Dependencies& other);
+
+          private:
+            friend class DependencyScope;
+
+            std::vector<std::pair<const Generation*, unsigned> > generations_;
+            bool recorded_;
+            // Generation::any() when generations_ were last found unchanged, so that
+            // current() only has to look at them after some Generation is bumped
+            mutable boost::atomic<unsigned> checked_;
+        };
+
+        // RAII handler that records into `dependencies` (replacing its contents) every Generation
+        // passed to record() on this thread until it is destroyed. Scopes nest: a Generation is
+        // recorded into all the scopes in progress.
+        class DependencyScope
+        {
+          public:
+            explicit DependencyScope(Dependencies* dependencies);
+            ~DependencyScope();
+
+            // a scope is in progress on this thread
+            static bool active() { return current_ != 0; }
+
+            static void record(const Generation* generation);
+            static void record(const Dependencies& dependencies);
+
+          private:
+            DependencyScope(const DependencyScope&);
+            DependencyScope& operator=(const DependencyScope&);
+
+            Dependencies* dependencies_;
+            DependencyScope* previous_;
+            static DCCL_THREAD_LOCAL DependencyScope* current_;
+        };
+    }
+}
+
+#endif
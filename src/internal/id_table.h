@@ -0,0 +1,86 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLIDTABLE20261018H
+#define DCCLIDTABLE20261018H
+
+#include <map>
+#include <vector>
+
+#include "dccl/common.h"
+
+namespace dccl
+{
+    namespace internal
+    {
+        // Maps DCCL ids onto values in O(1): ids up to MAX_DENSE_ID (which covers every
+        // id of the default identifier codec) index a vector sized to the largest id set;
+        // larger ids (only possible with a custom identifier codec) fall back to a map.
+        // Unset ids map to Value().
+        template<typename Value>
+            class IdTable
+        {
+          public:
+            enum { MAX_DENSE_ID = (1 << 16) - 1 };
+
+            IdTable() : empty_() { }
+
+            const Value& get(uint32 id) const
+            {
+                if(id < dense_.size())
+                    return dense_[id];
+                if(id <= MAX_DENSE_ID)
+                    return empty_;
+                typename std::map<uint32, Value>::const_iterator it = sparse_.find(id);
+                return it == sparse_.end() ? empty_ : it->second;
+            }
+
+            void set(uint32 id, const Value& value)
+            {
+                if(id <= MAX_DENSE_ID)
+                {
+                    if(id >= dense_.size())
+                        dense_.resize(id + 1);
+                    dense_[id] = value;
+                }
+                else
+                {
+                    sparse_[id] = value;
+                }
+            }
+
+            void erase(uint32 id)
+            {
+                if(id < dense_.size())
+                    dense_[id] = Value();
+                else
+                    sparse_.erase(id);
+            }
+
+          private:
+            std::vector<Value> dense_;
+            std::map<uint32, Value> sparse_;
+            Value empty_;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,59 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include "message_plan.h"
+
+//
+// MessagePlanCache
+//
+
+bool dccl::internal::MessagePlanCache::Key::operator<(const Key& k) const
+{
+    if(root != k.root) return root < k.root;
+    if(desc != k.desc) return desc < k.desc;
+    if(part != k.part) return part < k.part;
+    return parent_part < k.parent_part;
+}
+
+dccl::internal::MessagePlanCache::Key dccl::internal::MessagePlanCache::key(const google::protobuf::Descriptor* desc)
+{
+    Key k;
+    TraversalContext* context = TraversalContext::current();
+    k.root = context ? context->root_descriptor : 0;
+    k.desc = desc;
+    k.part = context ? context->part : UNKNOWN;
+    k.parent_part = MessageStack::current_part();
+    return k;
+}
+
+const dccl::internal::MessagePlan* dccl::internal::MessagePlanCache::find(const google::protobuf::Descriptor* desc) const
+{
+    std::map<Key, MessagePlan>::const_iterator it = plans_.find(key(desc));
+    if(it == plans_.end() || !it->second.dependencies.current())
+        return 0;
+    else
+        return &it->second;
+}
+
+void dccl::internal::MessagePlanCache::insert(const google::protobuf::Descriptor* desc, const MessagePlan& plan)
+{
+    plans_[key(desc)] = plan;
+}
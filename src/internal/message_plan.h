@@ -0,0 +1,146 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLMESSAGEPLAN20261018H
+#define DCCLMESSAGEPLAN20261018H
+
+#include <map>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "dccl/internal/field_codec_message_stack.h"
+#include "dccl/internal/protobuf_cpp_type_helpers.h"
+#include "dccl/internal/generation.h"
+
+namespace dccl
+{
+    class FieldCodecBase;
+    struct FieldCodecParams;
+
+    namespace internal
+    {
+        struct MessagePlan;
+
+        // A field of a MessagePlan, with its codec and type helper already resolved
+        struct PlannedField
+        {
+            const google::protobuf::FieldDescriptor* field;
+            boost::shared_ptr<FieldCodecBase> codec;
+            boost::shared_ptr<FromProtoCppTypeBase> helper;
+            // codec supports the typed (no boost::any) path for this field
+            bool typed;
+            // field is handled by the message codec's compiled hooks (see v3::CompiledMessageCodec)
+            bool compiled;
+            // the codec's parameters for this field (owned by the codec), or 0 if it has not validated the field
+            const FieldCodecParams* params;
+            // codec's field_min_size() and field_max_size() for this field, if sized
+            bool sized;
+            unsigned min_bits;
+            unsigned max_bits;
+            // for an embedded message, the plan that its (default message) codec compiled for it
+            // in the same traversal, or 0 if none
+            const MessagePlan* nested;
+        };
+
+        // makes planned the field that its codec is handed next in the traversal in progress on this thread,
+        // saving the codec the lookups of its parameters, sizes and plan (see planned_field())
+        inline void set_planned_field(const PlannedField& planned)
+        {
+            TraversalContext* context = TraversalContext::current();
+            if(context)
+                context->planned = &planned;
+        }
+
+        // the PlannedField given to set_planned_field(), if it is for `field` and `codec`, otherwise 0
+        inline const PlannedField* planned_field(const FieldCodecBase* codec, const google::protobuf::FieldDescriptor* field)
+        {
+            TraversalContext* context = TraversalContext::current();
+            if(!context || !context->planned || !field)
+                return 0;
+            const PlannedField* planned = context->planned;
+            return (planned->codec.get() == codec && planned->field == field) ? planned : 0;
+        }
+
+        // RAII handler that restores the planned field of the traversal on destruction, so that a
+        // message codec handing its own fields to their codecs leaves the field it was handed in
+        // place (e.g. for the next value of a repeated field)
+        class PlannedFieldScope
+        {
+          public:
+            PlannedFieldScope()
+                : context_(TraversalContext::current()),
+                planned_(context_ ? context_->planned : 0)
+            { }
+
+            ~PlannedFieldScope()
+            {
+                if(context_)
+                    context_->planned = planned_;
+            }
+
+          private:
+            PlannedFieldScope(const PlannedFieldScope&);
+            PlannedFieldScope& operator=(const PlannedFieldScope&);
+
+            TraversalContext* context_;
+            const PlannedField* planned_;
+        };
+
+        // The fields of a message (in order) that are encoded in the current part of a traversal
+        struct MessagePlan
+        {
+            std::vector<PlannedField> fields;
+            // the codec (and type helper) lookups the plan was compiled from
+            Dependencies dependencies;
+        };
+
+        // Plans compiled when messages are loaded, keyed by the traversal state
+        // that determines which fields are included and which codecs they use.
+        class MessagePlanCache
+        {
+          public:
+            // plan for desc in the traversal in progress on this thread, or 0 if none
+            // was compiled or a codec it uses has been added or removed since
+            const MessagePlan* find(const google::protobuf::Descriptor* desc) const;
+
+            // stores the plan for desc in the traversal in progress on this thread
+            void insert(const google::protobuf::Descriptor* desc, const MessagePlan& plan);
+
+          private:
+            struct Key
+            {
+                const google::protobuf::Descriptor* root;
+                const google::protobuf::Descriptor* desc;
+                MessagePart part;
+                MessagePart parent_part;
+
+                bool operator<(const Key& k) const;
+            };
+
+            static Key key(const google::protobuf::Descriptor* desc);
+
+            std::map<Key, MessagePlan> plans_;
+        };
+    }
+}
+
+#endif
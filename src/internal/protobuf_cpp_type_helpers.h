@@ -23,6 +23,7 @@
 #define DCCLPROTOBUFCPPTYPEHELPERS20110323H
 
 #include <boost/any.hpp>
+#include <boost/type_traits/integral_constant.hpp>
 #include <google/protobuf/descriptor.h>
 #include <google/protobuf/descriptor.pb.h>
 #include <google/protobuf/message.h>
@@ -583,6 +584,46 @@ namespace dccl
             static google::protobuf::FieldDescriptor::CppType as_enum()
             { return google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE; }
         };
+
+        /// \brief Typed access to field values through google::protobuf::Reflection (without boost::any). Specialized (true_type) for the C++ type of each non-message google::protobuf::FieldDescriptor::CppType.
+        template<typename T>
+            class ReflectedValue : public boost::false_type
+        { };
+
+#define DCCL_REFLECTED_VALUE(T, Name)                                   \
+        template<>                                                      \
+            class ReflectedValue<T> : public boost::true_type           \
+        {                                                               \
+          public:                                                       \
+            typedef T type;                                             \
+            static type get(const google::protobuf::Message& msg,          \
+                         const google::protobuf::FieldDescriptor* field) \
+            { return msg.GetReflection()->Get##Name(msg, field); }      \
+            static type get_repeated(const google::protobuf::Message& msg, \
+                                  const google::protobuf::FieldDescriptor* field, \
+                                  int index)                            \
+            { return msg.GetReflection()->GetRepeated##Name(msg, field, index); } \
+            static void set(google::protobuf::Message* msg,             \
+                            const google::protobuf::FieldDescriptor* field, \
+                            const type& value)                          \
+            { msg->GetReflection()->Set##Name(msg, field, value); }     \
+            static void add(google::protobuf::Message* msg,             \
+                            const google::protobuf::FieldDescriptor* field, \
+                            const type& value)                          \
+            { msg->GetReflection()->Add##Name(msg, field, value); }     \
+        }
+
+        DCCL_REFLECTED_VALUE(double, Double);
+        DCCL_REFLECTED_VALUE(float, Float);
+        DCCL_REFLECTED_VALUE(google::protobuf::int32, Int32);
+        DCCL_REFLECTED_VALUE(google::protobuf::uint32, UInt32);
+        DCCL_REFLECTED_VALUE(google::protobuf::int64, Int64);
+        DCCL_REFLECTED_VALUE(google::protobuf::uint64, UInt64);
+        DCCL_REFLECTED_VALUE(bool, Bool);
+        DCCL_REFLECTED_VALUE(std::string, String);
+        DCCL_REFLECTED_VALUE(const google::protobuf::EnumValueDescriptor*, Enum);
+
+#undef DCCL_REFLECTED_VALUE
     }
 }
 
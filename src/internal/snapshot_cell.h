@@ -0,0 +1,157 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLSNAPSHOTCELL20261018H
+#define DCCLSNAPSHOTCELL20261018H
+
+#include <vector>
+
+#include <boost/atomic.hpp>
+
+namespace dccl
+{
+    namespace internal
+    {
+        // Holds a value of type T that is read concurrently without locks and replaced
+        // (rarely) by publishing a modified copy, read-copy-update style.
+        //
+        // Readers (Reader) see an immutable snapshot for as long as they hold it.
+        // Writers (Writer) are serialized by a spinlock, copy the current snapshot on the
+        // first change and publish the copy. A replaced snapshot is retired and deleted
+        // by the first later publish() (or the destructor) that finds no Reader in progress.
+        template<typename T>
+            class SnapshotCell
+        {
+          public:
+            SnapshotCell()
+                : current_(new T),
+                readers_(0),
+                writing_(false)
+            { }
+
+            ~SnapshotCell()
+            {
+                delete current_.load();
+                delete_retired();
+            }
+
+            // the current snapshot, which is not deleted until this is destroyed
+            class Reader
+            {
+              public:
+                explicit Reader(const SnapshotCell& cell)
+                    : cell_(cell)
+                {
+                    // the count must be visible before the snapshot is loaded (see publish())
+                    ++cell_.readers_;
+                    value_ = cell_.current_.load();
+                }
+
+                ~Reader() { --cell_.readers_; }
+
+                const T& operator*() const { return *value_; }
+                const T* operator->() const { return value_; }
+
+              private:
+                Reader(const Reader&);
+                Reader& operator=(const Reader&);
+
+                const SnapshotCell& cell_;
+                const T* value_;
+            };
+
+            // exclusive access for changing the value: nothing is visible to Readers until publish()
+            class Writer
+            {
+              public:
+                explicit Writer(SnapshotCell& cell)
+                    : cell_(cell),
+                    copy_(0)
+                {
+                    while(cell_.writing_.exchange(true, boost::memory_order_acquire))
+                    { }
+                }
+
+                ~Writer()
+                {
+                    delete copy_;
+                    cell_.writing_.store(false, boost::memory_order_release);
+                }
+
+                // the value as changed so far
+                const T& current() const { return copy_ ? *copy_ : *cell_.current_.load(); }
+
+                // the value to change, copied from the current snapshot on first use
+                T& modify()
+                {
+                    if(!copy_)
+                        copy_ = new T(*cell_.current_.load());
+                    return *copy_;
+                }
+
+                // makes the changes visible to new Readers
+                void publish()
+                {
+                    if(!copy_)
+                        return;
+                    cell_.publish(copy_);
+                    copy_ = 0;
+                }
+
+              private:
+                Writer(const Writer&);
+                Writer& operator=(const Writer&);
+
+                SnapshotCell& cell_;
+                T* copy_;
+            };
+
+          private:
+            SnapshotCell(const SnapshotCell&);
+            SnapshotCell& operator=(const SnapshotCell&);
+
+            void publish(T* next)
+            {
+                retired_.push_back(current_.exchange(next));
+
+                // a Reader that starts after this point sees next, so with no Reader
+                // in progress, no one can still hold a retired snapshot
+                if(readers_.load() == 0)
+                    delete_retired();
+            }
+
+            void delete_retired()
+            {
+                for(typename std::vector<T*>::iterator it = retired_.begin(), end = retired_.end(); it != end; ++it)
+                    delete *it;
+                retired_.clear();
+            }
+
+            boost::atomic<T*> current_;
+            mutable boost::atomic<unsigned> readers_;
+            boost::atomic<bool> writing_;
+            // only accessed by the Writer holding writing_
+            std::vector<T*> retired_;
+        };
+    }
+}
+
+#endif
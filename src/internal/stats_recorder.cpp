@@ -0,0 +1,217 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include <ctime>
+#include <stdexcept>
+#include <algorithm>
+
+#include "dccl/common.h"
+#include "dccl/exception.h"
+#include "stats_recorder.h"
+
+namespace
+{
+    // 1 + the shard used by this thread (0 until its first call)
+    DCCL_THREAD_LOCAL unsigned thread_shard = 0;
+    boost::atomic<unsigned> next_shard(0);
+
+    unsigned current_shard()
+    {
+        if(!thread_shard)
+            thread_shard = 1 + next_shard.fetch_add(1, boost::memory_order_relaxed) % dccl::internal::StatsRecorder::NUM_SHARDS;
+        return thread_shard - 1;
+    }
+
+    unsigned latency_bucket(dccl::uint64 ns)
+    {
+        unsigned bucket = 0;
+        for(dccl::uint64 v = ns >> 6; v && bucket < dccl::LatencyHistogram::NUM_BUCKETS - 1; v >>= 1)
+            ++bucket;
+        return bucket;
+    }
+
+    void increment(boost::atomic<dccl::uint64>& counter, dccl::uint64 value)
+    {
+        counter.fetch_add(value, boost::memory_order_relaxed);
+    }
+
+    dccl::uint64 load(const boost::atomic<dccl::uint64>& counter)
+    {
+        return counter.load(boost::memory_order_relaxed);
+    }
+
+    bool by_id(const dccl::MessageStats& a, const dccl::MessageStats& b)
+    {
+        return a.dccl_id < b.dccl_id;
+    }
+}
+
+dccl::uint64 dccl::internal::monotonic_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+dccl::internal::StatsRecorder::Entry::Entry(int id, const std::string& message_name)
+    : dccl_id(id),
+      name(message_name)
+{
+    clear(this);
+}
+
+dccl::internal::StatsRecorder::StatsRecorder()
+    : unknown_(new Entry(-1, ""))
+{ }
+
+void dccl::internal::StatsRecorder::add(uint32 dccl_id, const google::protobuf::Descriptor* desc)
+{
+    if(Entry* entry = entries_.get(dccl_id))
+    {
+        entry->name = desc->full_name();
+        return;
+    }
+
+    owned_.push_back(boost::shared_ptr<Entry>(new Entry(dccl_id, desc->full_name())));
+    entries_.set(dccl_id, owned_.back().get());
+}
+
+void dccl::internal::StatsRecorder::record(const StatsSample& sample, StatusCode result)
+{
+    const uint64 latency_ns = monotonic_ns() - sample.start_ns;
+
+    Entry* entry = sample.has_id ? entries_.get(sample.dccl_id) : 0;
+    if(!entry)
+        entry = unknown_.get();
+    Counters& counters = entry->shards[current_shard()][sample.operation];
+
+    if(result == STATUS_OK)
+    {
+        increment(counters.count, 1);
+        increment(counters.bytes, sample.bytes);
+        increment(counters.padding_bits, sample.padding_bits);
+    }
+    else
+    {
+        increment(counters.failures[result], 1);
+    }
+
+    increment(counters.latency.sum_ns, latency_ns);
+    increment(counters.latency.buckets[latency_bucket(latency_ns)], 1);
+    if(sample.crypto)
+    {
+        increment(counters.crypto_latency.sum_ns, sample.crypto_ns);
+        increment(counters.crypto_latency.buckets[latency_bucket(sample.crypto_ns)], 1);
+    }
+}
+
+void dccl::internal::StatsRecorder::add_sum(MessageStats* stats, const Entry& entry)
+{
+    OperationStats* ops[2] = { &stats->encode, &stats->decode };
+    for(int s = 0; s < NUM_SHARDS; ++s)
+    {
+        for(int o = 0; o < 2; ++o)
+        {
+            const Counters& counters = entry.shards[s][o];
+            OperationStats* op = ops[o];
+            op->count += load(counters.count);
+            for(int i = 0; i < NUM_STATUS_CODES; ++i)
+                op->failures[i] += load(counters.failures[i]);
+            op->bytes += load(counters.bytes);
+            op->padding_bits += load(counters.padding_bits);
+
+            op->latency.sum_ns += load(counters.latency.sum_ns);
+            op->crypto_latency.sum_ns += load(counters.crypto_latency.sum_ns);
+            for(int i = 0; i < LatencyHistogram::NUM_BUCKETS; ++i)
+            {
+                const uint64 n = load(counters.latency.buckets[i]);
+                op->latency.buckets[i] += n;
+                op->latency.count += n;
+
+                const uint64 crypto_n = load(counters.crypto_latency.buckets[i]);
+                op->crypto_latency.buckets[i] += crypto_n;
+                op->crypto_latency.count += crypto_n;
+            }
+        }
+    }
+}
+
+void dccl::internal::StatsRecorder::snapshot(CodecStats* stats) const
+{
+    stats->messages.clear();
+
+    MessageStats unknown;
+    add_sum(&unknown, *unknown_);
+    if(unknown.encode.latency.count || unknown.decode.latency.count)
+        stats->messages.push_back(unknown);
+
+    for(std::vector<boost::shared_ptr<Entry> >::const_iterator it = owned_.begin(), end = owned_.end(); it != end; ++it)
+    {
+        stats->messages.push_back(MessageStats());
+        MessageStats& message = stats->messages.back();
+        message.dccl_id = (*it)->dccl_id;
+        message.name = (*it)->name;
+        add_sum(&message, **it);
+    }
+    std::sort(stats->messages.begin(), stats->messages.end(), by_id);
+}
+
+void dccl::internal::StatsRecorder::clear(Entry* entry)
+{
+    for(int s = 0; s < NUM_SHARDS; ++s)
+    {
+        for(int o = 0; o < 2; ++o)
+        {
+            Counters& counters = entry->shards[s][o];
+            counters.count = 0;
+            for(int i = 0; i < NUM_STATUS_CODES; ++i)
+                counters.failures[i] = 0;
+            counters.bytes = 0;
+            counters.padding_bits = 0;
+            counters.latency.sum_ns = 0;
+            counters.crypto_latency.sum_ns = 0;
+            for(int i = 0; i < LatencyHistogram::NUM_BUCKETS; ++i)
+            {
+                counters.latency.buckets[i] = 0;
+                counters.crypto_latency.buckets[i] = 0;
+            }
+        }
+    }
+}
+
+void dccl::internal::StatsRecorder::reset()
+{
+    clear(unknown_.get());
+    for(std::vector<boost::shared_ptr<Entry> >::const_iterator it = owned_.begin(), end = owned_.end(); it != end; ++it)
+        clear(it->get());
+}
+
+dccl::StatusCode dccl::internal::StatsRecorder::failure_code(const std::exception& e)
+{
+    if(dynamic_cast<const OutOfRangeException*>(&e))
+        return STATUS_OUT_OF_RANGE;
+    else if(dynamic_cast<const TruncatedException*>(&e))
+        return STATUS_TRUNCATED;
+    else if(dynamic_cast<const std::length_error*>(&e))
+        return STATUS_BUFFER_TOO_SMALL;
+    else
+        return STATUS_CODEC_ERROR;
+}
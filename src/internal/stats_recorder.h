@@ -0,0 +1,142 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLSTATSRECORDER20261018H
+#define DCCLSTATSRECORDER20261018H
+
+#include <exception>
+
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <google/protobuf/descriptor.h>
+
+#include "dccl/stats.h"
+#include "dccl/internal/id_table.h"
+
+namespace dccl
+{
+    namespace internal
+    {
+        // monotonic clock, in nanoseconds
+        uint64 monotonic_ns();
+
+        // what one encode or decode call did, filled in as it goes and then passed to StatsRecorder::record()
+        struct StatsSample
+        {
+            enum Operation { ENCODE, DECODE };
+
+            explicit StatsSample(Operation op)
+                : operation(op),
+                has_id(false),
+                dccl_id(0),
+                failure(STATUS_OK),
+                bytes(0),
+                padding_bits(0),
+                crypto(false),
+                crypto_ns(0),
+                start_ns(monotonic_ns())
+            { }
+
+            void set_id(uint32 id) { has_id = true; dccl_id = id; }
+
+            void start_crypto() { crypto = true; crypto_ns = monotonic_ns(); }
+            void stop_crypto() { crypto_ns = monotonic_ns() - crypto_ns; }
+
+            Operation operation;
+            bool has_id;
+            uint32 dccl_id;
+            // set where the cause of a failure is known better than from the exception thrown
+            StatusCode failure;
+            uint64 bytes;
+            uint64 padding_bits;
+            bool crypto;
+            uint64 crypto_ns;
+            uint64 start_ns;
+        };
+
+        // Counters behind Codec::stats(). Each DCCL id has NUM_SHARDS copies of its counters,
+        // and each thread only adds to one (by relaxed atomic increments), so that threads
+        // encoding the same message type do not contend. stats() sums the shards.
+        //
+        // add() must not be called concurrently with record().
+        class StatsRecorder
+        {
+          public:
+            enum { NUM_SHARDS = 16 };
+
+            StatsRecorder();
+
+            // keep separate counters for this id (called when it is loaded)
+            void add(uint32 dccl_id, const google::protobuf::Descriptor* desc);
+
+            // adds a finished call with the given result
+            void record(const StatsSample& sample, StatusCode result);
+
+            void snapshot(CodecStats* stats) const;
+            void reset();
+
+            // the StatusCode for a call that threw e
+            static StatusCode failure_code(const std::exception& e);
+
+          private:
+            struct Histogram
+            {
+                boost::atomic<uint64> sum_ns;
+                boost::atomic<uint64> buckets[LatencyHistogram::NUM_BUCKETS];
+            };
+
+            struct Counters
+            {
+                boost::atomic<uint64> count;
+                boost::atomic<uint64> failures[NUM_STATUS_CODES];
+                boost::atomic<uint64> bytes;
+                boost::atomic<uint64> padding_bits;
+                Histogram latency;
+                Histogram crypto_latency;
+            };
+
+            struct Entry
+            {
+                Entry(int id, const std::string& message_name);
+
+                int dccl_id;
+                std::string name;
+                // [shard][StatsSample::Operation]
+                Counters shards[NUM_SHARDS][2];
+            };
+
+            static void add_sum(MessageStats* stats, const Entry& entry);
+            static void clear(Entry* entry);
+
+          private:
+            StatsRecorder(const StatsRecorder&);
+            StatsRecorder& operator=(const StatsRecorder&);
+
+            // unknown_ is used for calls without a DCCL id or with one that was not added
+            boost::shared_ptr<Entry> unknown_;
+            IdTable<Entry*> entries_;
+            std::vector<boost::shared_ptr<Entry> > owned_;
+        };
+    }
+}
+
+#endif
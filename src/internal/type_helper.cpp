@@ -23,7 +23,7 @@
 
 dccl::internal::TypeHelper::TypeMap dccl::internal::TypeHelper::type_map_;
 dccl::internal::TypeHelper::CppTypeMap dccl::internal::TypeHelper::cpptype_map_;
-dccl::internal::TypeHelper::CustomMessageMap dccl::internal::TypeHelper::custom_message_map_;
+dccl::internal::TypeHelper::CustomMessageMapCell dccl::internal::TypeHelper::custom_message_map_;
 
 // used to construct, initialize, and delete a copy of this object
 boost::shared_ptr<dccl::internal::TypeHelper> dccl::internal::TypeHelper::inst_(new dccl::internal::TypeHelper);
@@ -88,8 +88,9 @@ boost::shared_ptr<dccl::internal::FromProtoCppTypeBase> dccl::internal::TypeHelp
 {
     if(!type_name.empty())
     {
-        CustomMessageMap::iterator it = custom_message_map_.find(type_name);
-        if(it != custom_message_map_.end())
+        CustomMessageMapCell::Reader custom_message_map(custom_message_map_);
+        CustomMessageMap::const_iterator it = custom_message_map->find(type_name);
+        if(it != custom_message_map->end())
             return it->second;
     }
     
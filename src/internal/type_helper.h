@@ -27,6 +27,7 @@
 #include <boost/shared_ptr.hpp>
 
 #include "protobuf_cpp_type_helpers.h"
+#include "snapshot_cell.h"
 
 namespace dccl
 {
@@ -61,13 +62,21 @@ namespace dccl
             template<typename ProtobufMessage>
                 static void add()
             {
-                custom_message_map_.insert(std::make_pair(ProtobufMessage::descriptor()->full_name(),
-                                                          boost::shared_ptr<FromProtoCppTypeBase>(new FromProtoCustomMessage<ProtobufMessage>)));
+                CustomMessageMapCell::Writer writer(custom_message_map_);
+                if(writer.current().count(ProtobufMessage::descriptor()->full_name()))
+                    return;
+                writer.modify().insert(std::make_pair(ProtobufMessage::descriptor()->full_name(),
+                                                      boost::shared_ptr<FromProtoCppTypeBase>(new FromProtoCustomMessage<ProtobufMessage>)));
+                writer.publish();
             }
             template<typename ProtobufMessage>
                 static void remove()
             {
-                custom_message_map_.erase(ProtobufMessage::descriptor()->full_name());
+                CustomMessageMapCell::Writer writer(custom_message_map_);
+                if(!writer.current().count(ProtobufMessage::descriptor()->full_name()))
+                    return;
+                writer.modify().erase(ProtobufMessage::descriptor()->full_name());
+                writer.publish();
             }
             static void reset()
             {
@@ -80,7 +89,9 @@ namespace dccl
             {
                 type_map_.clear();
                 cpptype_map_.clear();
-                custom_message_map_.clear();
+                CustomMessageMapCell::Writer writer(custom_message_map_);
+                writer.modify().clear();
+                writer.publish();
             }
             TypeHelper(const TypeHelper&);
             TypeHelper& operator= (const TypeHelper&);
@@ -102,7 +113,9 @@ namespace dccl
 
             typedef std::map<std::string,
                 boost::shared_ptr<FromProtoCppTypeBase> > CustomMessageMap;
-            static CustomMessageMap custom_message_map_;
+            typedef SnapshotCell<CustomMessageMap> CustomMessageMapCell;
+            // changed by FieldCodecManager::add/remove while codecs may be looking up types
+            static CustomMessageMapCell custom_message_map_;
         };
     }
 }
@@ -0,0 +1,69 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include "dccl/message_pool.h"
+#include "dccl/dynamic_protobuf_manager.h"
+
+google::protobuf::Message* dccl::MessagePool::acquire(const google::protobuf::Descriptor* desc)
+{
+    std::map<const google::protobuf::Descriptor*, std::vector<google::protobuf::Message*> >::iterator it = free_.find(desc);
+    if(it == free_.end() || it->second.empty())
+        return DynamicProtobufManager::msg_factory().GetPrototype(desc)->New();
+
+    google::protobuf::Message* msg = it->second.back();
+    it->second.pop_back();
+    --size_;
+    return msg;
+}
+
+void dccl::MessagePool::release(google::protobuf::Message* msg)
+{
+    if(!msg)
+        return;
+
+#if DCCL_HAS_PROTOBUF_ARENA
+    // owned by the arena
+    if(msg->GetArena())
+        return;
+#endif
+
+    std::vector<google::protobuf::Message*>& free = free_[msg->GetDescriptor()];
+    if(free.size() >= max_per_type_)
+    {
+        delete msg;
+        return;
+    }
+
+    msg->Clear();
+    free.push_back(msg);
+    ++size_;
+}
+
+void dccl::MessagePool::clear()
+{
+    for(std::map<const google::protobuf::Descriptor*, std::vector<google::protobuf::Message*> >::iterator it = free_.begin(), end = free_.end(); it != end; ++it)
+    {
+        for(std::vector<google::protobuf::Message*>::iterator msg_it = it->second.begin(), msg_end = it->second.end(); msg_it != msg_end; ++msg_it)
+            delete *msg_it;
+    }
+    free_.clear();
+    size_ = 0;
+}
@@ -0,0 +1,72 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLMESSAGEPOOL20261018H
+#define DCCLMESSAGEPOOL20261018H
+
+#include <map>
+#include <vector>
+#include <cstddef>
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/message.h>
+
+namespace dccl
+{
+    /// \brief Recycles Google Protobuf messages of any type, so that decoding a stream of messages does not allocate a new message (and its submessages, strings and repeated fields) for each one.
+    ///
+    /// Released messages are cleared and kept by Descriptor, and acquire() hands one of these back before creating a new one. A cleared message keeps the memory used by its submessages, strings and repeated fields, so decoding into a recycled message usually allocates nothing. A MessagePool must not be used from more than one thread at a time.
+    /// \ingroup dccl_api
+    class MessagePool
+    {
+      public:
+        /// \param max_per_type Maximum number of released messages kept for each type (any more are deleted)
+        explicit MessagePool(std::size_t max_per_type = 64)
+            : max_per_type_(max_per_type),
+            size_(0)
+        { }
+
+        /// \brief Deletes all the messages held by the pool (not those acquired and not yet released)
+        ~MessagePool() { clear(); }
+
+        /// \brief An empty message of type \a desc: a released one if available, otherwise a new one. Return it with release() when finished.
+        google::protobuf::Message* acquire(const google::protobuf::Descriptor* desc);
+
+        /// \brief Return a message to the pool (it is cleared). Any heap allocated message may be released, not only those from acquire(); the pool takes ownership.
+        void release(google::protobuf::Message* msg);
+
+        /// \brief Number of released messages held by the pool
+        std::size_t size() const { return size_; }
+
+        /// \brief Delete all the messages held by the pool
+        void clear();
+
+      private:
+        MessagePool(const MessagePool&);
+        MessagePool& operator=(const MessagePool&);
+
+        std::map<const google::protobuf::Descriptor*, std::vector<google::protobuf::Message*> > free_;
+        std::size_t max_per_type_;
+        std::size_t size_;
+    };
+}
+
+#endif
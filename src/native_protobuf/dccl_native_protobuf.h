@@ -22,15 +22,10 @@
 #ifndef DCCL_NATIVE_PROTOBUF_20190218H
 #define DCCL_NATIVE_PROTOBUF_20190218H
 
-#include <google/protobuf/unknown_field_set.h>
-#include <google/protobuf/io/coded_stream.h>
-#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
-#include <google/protobuf/wire_format_lite.h>
+#include <cstring>
+#include <limits>
 
-#include <google/protobuf/stubs/common.h>
-#if GOOGLE_PROTOBUF_VERSION < 3008000
-#include <google/protobuf/wire_format_lite_inl.h> // this .h has been removed in protobuf 3.8
-#endif
+#include <google/protobuf/wire_format_lite.h>
 
 #include "dccl/field_codec_fixed.h"
 #include "dccl/field_codec_typed.h"
@@ -41,172 +36,249 @@ namespace dccl
 namespace native_protobuf
 {
 
-template<typename WireType, google::protobuf::internal::WireFormatLite::FieldType DeclaredType>
-struct PrimitiveTypeHelperBase
+/// \brief Number of bytes used by the base 128 varint encoding of \a value
+inline unsigned varint_size(dccl::uint64 value)
 {
-    WireType decode(google::protobuf::io::CodedInputStream* input_stream)
+    unsigned bytes = 1;
+    while(value >= 0x80)
     {
-       WireType value;
-       google::protobuf::internal::WireFormatLite::ReadPrimitive<WireType, DeclaredType>(input_stream, &value);
-       return value;
+        value >>= 7;
+        ++bytes;
     }
-};
-    
+    return bytes;
+}
+
+/// \brief Longest varint that Google Protocol Buffers will read
+const unsigned MAX_VARINT_BYTES = 10;
+
+/// \brief Write \a value as a base 128 varint (least significant group first, the most significant bit of each byte set if more bytes follow)
+inline void write_varint(BitWriter* writer, dccl::uint64 value)
+{
+    while(value >= 0x80)
+    {
+        writer->write((value & 0x7F) | 0x80, BITS_IN_BYTE);
+        value >>= 7;
+    }
+    writer->write(value, BITS_IN_BYTE);
+}
+
+/// \brief Read a varint written by write_varint() from \a source, which must provide dccl::uint64 read(unsigned num_bits)
+template<typename BitSource>
+dccl::uint64 read_varint(BitSource* source)
+{
+    dccl::uint64 value = 0;
+    for(unsigned i = 0; i < MAX_VARINT_BYTES; ++i)
+    {
+        const dccl::uint64 byte = source->read(BITS_IN_BYTE);
+        value |= (byte & 0x7F) << (7*i);
+        if(!(byte & 0x80))
+            return value;
+    }
+    throw(Exception("Malformed varint: more than 10 bytes"));
+}
 
+// Each helper converts a WireType to and from the unsigned integer that Google Protocol Buffers writes for the declared type: the value of a varint, or the little-endian contents of a fixed width field.
 template<typename WireType, google::protobuf::FieldDescriptor::Type DeclaredType>
 struct PrimitiveTypeHelper
 {   
 };
 
 template<typename WireType>
-struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_INT64> : public PrimitiveTypeHelperBase<WireType, google::protobuf::internal::WireFormatLite::TYPE_INT64>
+struct VarintTypeHelper
 {
-    unsigned byte_size(const WireType& wire_value)
-    { return google::protobuf::internal::WireFormatLite::Int64Size(wire_value); }
-    void encode(WireType wire_value, std::vector<google::protobuf::uint8>* bytes)
-    { google::protobuf::internal::WireFormatLite::WriteInt64NoTagToArray(wire_value, &(*bytes)[0]); }
-    bool is_varint() { return true; }
+    static bool is_varint() { return true; }
 };
 
-template<typename WireType>
-struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_INT32> : public PrimitiveTypeHelperBase<WireType, google::protobuf::internal::WireFormatLite::TYPE_INT32>
+template<typename WireType, unsigned Bytes>
+struct FixedTypeHelper
 {
-    unsigned byte_size(const WireType& wire_value)
-    { return google::protobuf::internal::WireFormatLite::Int32Size(wire_value); }
-    void encode(WireType wire_value, std::vector<google::protobuf::uint8>* bytes)
-    { google::protobuf::internal::WireFormatLite::WriteInt32NoTagToArray(wire_value, &(*bytes)[0]); }
-    bool is_varint() { return true; }
+    static bool is_varint() { return false; }
+    static unsigned byte_size(const WireType& wire_value) { return Bytes; }
 };
 
-
 template<typename WireType>
-struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_UINT64> : public PrimitiveTypeHelperBase<WireType, google::protobuf::internal::WireFormatLite::TYPE_UINT64>
+struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_INT64> : public VarintTypeHelper<WireType>
 {
-    unsigned byte_size(const WireType& wire_value)
-    { return google::protobuf::internal::WireFormatLite::UInt64Size(wire_value); }
-    void encode(WireType wire_value, std::vector<google::protobuf::uint8>* bytes)
-    { google::protobuf::internal::WireFormatLite::WriteUInt64NoTagToArray(wire_value, &(*bytes)[0]); }
-    bool is_varint() { return true; }
+    static dccl::uint64 to_wire(const WireType& wire_value) { return static_cast<dccl::uint64>(wire_value); }
+    static WireType from_wire(dccl::uint64 value) { return static_cast<WireType>(value); }
+    static unsigned byte_size(const WireType& wire_value) { return varint_size(to_wire(wire_value)); }
 };
 
+// negative values are sign extended to 64 bits (and so always use 10 bytes)
 template<typename WireType>
-struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_UINT32> : public PrimitiveTypeHelperBase<WireType, google::protobuf::internal::WireFormatLite::TYPE_UINT32>
+struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_INT32> : public VarintTypeHelper<WireType>
 {
-    unsigned byte_size(const WireType& wire_value)
-    { return google::protobuf::internal::WireFormatLite::UInt32Size(wire_value); }
-    void encode(WireType wire_value, std::vector<google::protobuf::uint8>* bytes)
-    { google::protobuf::internal::WireFormatLite::WriteUInt32NoTagToArray(wire_value, &(*bytes)[0]); }
-    bool is_varint() { return true; }
+    static dccl::uint64 to_wire(const WireType& wire_value) { return static_cast<dccl::uint64>(static_cast<dccl::int64>(wire_value)); }
+    static WireType from_wire(dccl::uint64 value) { return static_cast<WireType>(value); }
+    static unsigned byte_size(const WireType& wire_value) { return varint_size(to_wire(wire_value)); }
 };
 
 template<typename WireType>
-struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_SINT64> : public PrimitiveTypeHelperBase<WireType, google::protobuf::internal::WireFormatLite::TYPE_SINT64>
+struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_UINT64> : public VarintTypeHelper<WireType>
 {
-    unsigned byte_size(const WireType& wire_value)
-    { return google::protobuf::internal::WireFormatLite::SInt64Size(wire_value); }
-    void encode(WireType wire_value, std::vector<google::protobuf::uint8>* bytes)
-    { google::protobuf::internal::WireFormatLite::WriteSInt64NoTagToArray(wire_value, &(*bytes)[0]); }
-    bool is_varint() { return true; }
+    static dccl::uint64 to_wire(const WireType& wire_value) { return wire_value; }
+    static WireType from_wire(dccl::uint64 value) { return value; }
+    static unsigned byte_size(const WireType& wire_value) { return varint_size(to_wire(wire_value)); }
 };
 
 template<typename WireType>
-struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_SINT32> : public PrimitiveTypeHelperBase<WireType, google::protobuf::internal::WireFormatLite::TYPE_SINT32>
+struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_UINT32> : public VarintTypeHelper<WireType>
 {
-    unsigned byte_size(const WireType& wire_value)
-    { return google::protobuf::internal::WireFormatLite::SInt32Size(wire_value); }
-    void encode(WireType wire_value, std::vector<google::protobuf::uint8>* bytes)
-    { google::protobuf::internal::WireFormatLite::WriteSInt32NoTagToArray(wire_value, &(*bytes)[0]); }
-    bool is_varint() { return true; }
+    static dccl::uint64 to_wire(const WireType& wire_value) { return wire_value; }
+    static WireType from_wire(dccl::uint64 value) { return static_cast<WireType>(value); }
+    static unsigned byte_size(const WireType& wire_value) { return varint_size(to_wire(wire_value)); }
 };
 
-
-
 template<typename WireType>
-struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_ENUM> : public PrimitiveTypeHelperBase<WireType, google::protobuf::internal::WireFormatLite::TYPE_ENUM>
+struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_SINT64> : public VarintTypeHelper<WireType>
 {
-    unsigned byte_size(const WireType& wire_value)
-    { return google::protobuf::internal::WireFormatLite::EnumSize(wire_value); }
-    void encode(WireType wire_value, std::vector<google::protobuf::uint8>* bytes)
-    { google::protobuf::internal::WireFormatLite::WriteEnumNoTagToArray(wire_value, &(*bytes)[0]); }
-    bool is_varint() { return true; }
+    static dccl::uint64 to_wire(const WireType& wire_value)
+    { return google::protobuf::internal::WireFormatLite::ZigZagEncode64(wire_value); }
+    static WireType from_wire(dccl::uint64 value)
+    { return google::protobuf::internal::WireFormatLite::ZigZagDecode64(value); }
+    static unsigned byte_size(const WireType& wire_value) { return varint_size(to_wire(wire_value)); }
 };
 
+template<typename WireType>
+struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_SINT32> : public VarintTypeHelper<WireType>
+{
+    static dccl::uint64 to_wire(const WireType& wire_value)
+    { return google::protobuf::internal::WireFormatLite::ZigZagEncode32(wire_value); }
+    static WireType from_wire(dccl::uint64 value)
+    { return google::protobuf::internal::WireFormatLite::ZigZagDecode32(static_cast<dccl::uint32>(value)); }
+    static unsigned byte_size(const WireType& wire_value) { return varint_size(to_wire(wire_value)); }
+};
 
 template<typename WireType>
-struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_DOUBLE> : public PrimitiveTypeHelperBase<WireType, google::protobuf::internal::WireFormatLite::TYPE_DOUBLE>
+struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_ENUM> : public PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_INT32>
 {
-    unsigned byte_size(const WireType& wire_value)
-    { return google::protobuf::internal::WireFormatLite::kDoubleSize; }
-    void encode(WireType wire_value, std::vector<google::protobuf::uint8>* bytes)
-    { google::protobuf::internal::WireFormatLite::WriteDoubleNoTagToArray(wire_value, &(*bytes)[0]); }
-    bool is_varint() { return false; }
 };
 
 template<typename WireType>
-struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_FLOAT> : public PrimitiveTypeHelperBase<WireType, google::protobuf::internal::WireFormatLite::TYPE_FLOAT>
+struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_DOUBLE> : public FixedTypeHelper<WireType, 8>
 {
-    unsigned byte_size(const WireType& wire_value)
-    { return google::protobuf::internal::WireFormatLite::kFloatSize; }
-    void encode(WireType wire_value, std::vector<google::protobuf::uint8>* bytes)
-    { google::protobuf::internal::WireFormatLite::WriteFloatNoTagToArray(wire_value, &(*bytes)[0]); }
-    bool is_varint() { return false; }
+    static dccl::uint64 to_wire(const WireType& wire_value)
+    {
+        double d = wire_value;
+        dccl::uint64 value;
+        std::memcpy(&value, &d, sizeof(value));
+        return value;
+    }
+    static WireType from_wire(dccl::uint64 value)
+    {
+        double d;
+        std::memcpy(&d, &value, sizeof(d));
+        return d;
+    }
 };
 
 template<typename WireType>
-struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_BOOL> : public PrimitiveTypeHelperBase<WireType, google::protobuf::internal::WireFormatLite::TYPE_BOOL>
+struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_FLOAT> : public FixedTypeHelper<WireType, 4>
 {
-    unsigned byte_size(const WireType& wire_value)
-    { return google::protobuf::internal::WireFormatLite::kBoolSize; }
-    void encode(WireType wire_value, std::vector<google::protobuf::uint8>* bytes)
-    { google::protobuf::internal::WireFormatLite::WriteBoolNoTagToArray(wire_value, &(*bytes)[0]); }
-    bool is_varint() { return false; }
+    static dccl::uint64 to_wire(const WireType& wire_value)
+    {
+        float f = wire_value;
+        dccl::uint32 value;
+        std::memcpy(&value, &f, sizeof(value));
+        return value;
+    }
+    static WireType from_wire(dccl::uint64 value)
+    {
+        const dccl::uint32 value32 = static_cast<dccl::uint32>(value);
+        float f;
+        std::memcpy(&f, &value32, sizeof(f));
+        return f;
+    }
 };
 
+// a varint, but always a single byte
+template<typename WireType>
+struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_BOOL> : public FixedTypeHelper<WireType, 1>
+{
+    static dccl::uint64 to_wire(const WireType& wire_value) { return wire_value ? 1 : 0; }
+    static WireType from_wire(dccl::uint64 value) { return value != 0; }
+};
 
 template<typename WireType>
-struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_FIXED64> : public PrimitiveTypeHelperBase<WireType, google::protobuf::internal::WireFormatLite::TYPE_FIXED64>
+struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_FIXED64> : public FixedTypeHelper<WireType, 8>
 {
-    unsigned byte_size(const WireType& wire_value)
-    { return google::protobuf::internal::WireFormatLite::kFixed64Size; }
-    void encode(WireType wire_value, std::vector<google::protobuf::uint8>* bytes)
-    { google::protobuf::internal::WireFormatLite::WriteFixed64NoTagToArray(wire_value, &(*bytes)[0]); }
-    bool is_varint() { return false; }
+    static dccl::uint64 to_wire(const WireType& wire_value) { return wire_value; }
+    static WireType from_wire(dccl::uint64 value) { return value; }
 };
 
 template<typename WireType>
-struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_FIXED32> : public PrimitiveTypeHelperBase<WireType, google::protobuf::internal::WireFormatLite::TYPE_FIXED32>
+struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_FIXED32> : public FixedTypeHelper<WireType, 4>
 {
-    unsigned byte_size(const WireType& wire_value)
-    { return google::protobuf::internal::WireFormatLite::kFixed32Size; }
-    void encode(WireType wire_value, std::vector<google::protobuf::uint8>* bytes)
-    { google::protobuf::internal::WireFormatLite::WriteFixed32NoTagToArray(wire_value, &(*bytes)[0]); }
-    bool is_varint() { return false; }
+    static dccl::uint64 to_wire(const WireType& wire_value) { return wire_value; }
+    static WireType from_wire(dccl::uint64 value) { return static_cast<WireType>(value); }
 };
 
 template<typename WireType>
-struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_SFIXED64> : public PrimitiveTypeHelperBase<WireType, google::protobuf::internal::WireFormatLite::TYPE_SFIXED64>
+struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_SFIXED64> : public FixedTypeHelper<WireType, 8>
 {
-    unsigned byte_size(const WireType& wire_value)
-    { return google::protobuf::internal::WireFormatLite::kSFixed64Size; }
-    void encode(WireType wire_value, std::vector<google::protobuf::uint8>* bytes)
-    { google::protobuf::internal::WireFormatLite::WriteSFixed64NoTagToArray(wire_value, &(*bytes)[0]); }
-    bool is_varint() { return false; }
+    static dccl::uint64 to_wire(const WireType& wire_value) { return static_cast<dccl::uint64>(wire_value); }
+    static WireType from_wire(dccl::uint64 value) { return static_cast<WireType>(value); }
 };
 
 template<typename WireType>
-struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_SFIXED32> : public PrimitiveTypeHelperBase<WireType, google::protobuf::internal::WireFormatLite::TYPE_SFIXED32>
+struct PrimitiveTypeHelper<WireType, google::protobuf::FieldDescriptor::TYPE_SFIXED32> : public FixedTypeHelper<WireType, 4>
 {
-    unsigned byte_size(const WireType& wire_value)
-    { return google::protobuf::internal::WireFormatLite::kSFixed32Size; }
-    void encode(WireType wire_value, std::vector<google::protobuf::uint8>* bytes)
-    { google::protobuf::internal::WireFormatLite::WriteSFixed32NoTagToArray(wire_value, &(*bytes)[0]); }
-    bool is_varint() { return false; }
+    static dccl::uint64 to_wire(const WireType& wire_value) { return static_cast<dccl::uint32>(wire_value); }
+    static WireType from_wire(dccl::uint64 value) { return static_cast<WireType>(static_cast<dccl::uint32>(value)); }
 };
 
+/// \brief Encodes a numeric field the way Google Protocol Buffers does (varint, zigzag varint or little-endian fixed width), preceded by a presence bit unless the field is required.
+///
+/// Values are written to and read from the BitWriter / BitReader directly. A repeated field with `(dccl.field).packed = true` is encoded as the body of a Protocol Buffers packed field: a varint byte length followed by the values (with no DCCL size prefix or presence bits). Requires codec_version 3 or newer. Protobuf's own `[packed = true]` does not change the DCCL encoding.
 template<typename WireType, google::protobuf::FieldDescriptor::Type DeclaredType, typename FieldType = WireType>
 class PrimitiveTypeFieldCodec : public TypedFieldCodec<WireType, FieldType>
 {
+public:
+    PrimitiveTypeFieldCodec()
+        { this->set_direct_io_type(typeid(PrimitiveTypeFieldCodec)); }
+
+protected:
+    void typed_encode(BitWriter* writer, const google::protobuf::Message& parent)
+        {
+            if(is_packed(this->this_field()))
+                typed_encode_packed<FieldType>(writer, parent);
+            else
+                TypedFieldCodec<WireType, FieldType>::typed_encode(writer, parent);
+        }
+
+    void typed_decode(BitReader* reader, google::protobuf::Message* parent)
+        {
+            if(is_packed(this->this_field()))
+                typed_decode_packed<FieldType>(reader, parent);
+            else
+                TypedFieldCodec<WireType, FieldType>::typed_decode(reader, parent);
+        }
+
+    unsigned typed_size(const google::protobuf::Message& parent)
+        {
+            if(is_packed(this->this_field()))
+                return typed_size_packed<FieldType>(parent);
+            else
+                return TypedFieldCodec<WireType, FieldType>::typed_size(parent);
+        }
+
 private:
+    typedef PrimitiveTypeHelper<WireType, DeclaredType> Helper;
+
+    static bool is_packed(const google::protobuf::FieldDescriptor* field)
+        {
+            return field && field->is_repeated() && field->options().GetExtension(dccl::field).packed();
+        }
+
+    void validate()
+        {
+            if(this->dccl_field_options().packed())
+            {
+                FieldCodecBase::require(this->this_field()->is_repeated(), "(dccl.field).packed can only be set on a repeated field");
+                FieldCodecBase::require(this->codec_version() > 2, "(dccl.field).packed requires codec_version 3 or newer");
+            }
+        }
+
     unsigned presence_bit_size()
         {
             return this->use_required() ? 0 : 1;
@@ -217,10 +289,10 @@ private:
             // if required, minimum size is 1-byte (for varint) or full size (for non-varint)
             if(this->use_required())
             {
-                if(helper_.is_varint())
+                if(Helper::is_varint())
                     return BITS_IN_BYTE;
                 else
-                    return BITS_IN_BYTE*helper_.byte_size(WireType());
+                    return BITS_IN_BYTE*Helper::byte_size(WireType());
             }
             // if not required, presence bit
             else
@@ -232,9 +304,14 @@ private:
 
     unsigned max_size()
         {
-            // Int32 and Int64 use more space for large negative numbers
-            return std::max<unsigned>(size(std::numeric_limits<WireType>::min()),
-                                      size(std::numeric_limits<WireType>::max()));
+            return presence_bit_size() + BITS_IN_BYTE*max_value_bytes();
+        }
+
+    // Int32 and Int64 use more space for large negative numbers
+    unsigned max_value_bytes()
+        {
+            return std::max(Helper::byte_size(std::numeric_limits<WireType>::min()),
+                            Helper::byte_size(std::numeric_limits<WireType>::max()));
         }
     
     unsigned size() 
@@ -244,9 +321,7 @@ private:
     
     unsigned size(const WireType& wire_value)
         {
-            unsigned data_bytes = helper_.byte_size(wire_value);
-            unsigned size = presence_bit_size() + BITS_IN_BYTE*data_bytes;
-            return size;
+            return presence_bit_size() + BITS_IN_BYTE*Helper::byte_size(wire_value);
         }
 
     Bitset encode()
@@ -257,57 +332,324 @@ private:
     
     Bitset encode(const WireType& wire_value)
         {
-            std::vector<google::protobuf::uint8> bytes(size(wire_value) / BITS_IN_BYTE, 0);
-            
-            helper_.encode(wire_value, &bytes);
+            char buffer[MAX_VARINT_BYTES + 1];
+            BitWriter writer(buffer, buffer + sizeof(buffer));
+            encode(&writer, wire_value);
+            return to_bitset(buffer, writer);
+        }
 
-            Bitset data_bits;
-            data_bits.from_byte_stream(bytes.begin(), bytes.end());
-            if(!this->use_required())
-            {
-                data_bits.resize(data_bits.size() + presence_bit_size());
-                data_bits <<= 1;
-                data_bits.set(0, true); // presence bit
-            }            
-            return data_bits;
+    void encode(BitWriter* writer)
+        {
+            writer->write(0, min_size());
         }
 
+    void encode(BitWriter* writer, const WireType& wire_value)
+        {
+            if(!this->use_required())
+                writer->write_bit(true); // presence bit
+            write_value(writer, wire_value);
+        }
     
     WireType decode(Bitset* bits)
         {
-            if(!this->use_required())
+            WireType wire_value;
+            if(!try_decode(bits, &wire_value))
+                throw NullValueException();
+            return wire_value;
+        }
+
+    WireType decode(BitReader* reader)
+        {
+            WireType wire_value;
+            if(!try_decode(reader, &wire_value))
+                throw NullValueException();
+            return wire_value;
+        }
+
+    bool try_decode(Bitset* bits, WireType* wire_value)
+        {
+            internal::BitsetSource source(bits);
+            return read_field(&source, wire_value);
+        }    
+
+    bool try_decode(BitReader* reader, WireType* wire_value)
+        {
+            return read_field(reader, wire_value);
+        }
+
+    void any_encode_repeated(Bitset* bits, const std::vector<boost::any>& wire_values)
+        {
+            if(!is_packed(this->this_field()))
+                return FieldCodecBase::any_encode_repeated(bits, wire_values);
+
+            std::vector<char> buffer((max_size_repeated() + BITS_IN_BYTE - 1) / BITS_IN_BYTE);
+            BitWriter writer(&buffer[0], &buffer[0] + buffer.size());
+            encode_packed(&writer, wire_values);
+            *bits = to_bitset(&buffer[0], writer);
+        }
+
+    void any_decode_repeated(Bitset* repeated_bits, std::vector<boost::any>* wire_values)
+        {
+            if(!is_packed(this->this_field()))
+                return FieldCodecBase::any_decode_repeated(repeated_bits, wire_values);
+
+            wire_values->clear();
+            internal::BitsetSource source(repeated_bits);
+            decode_packed(&source, wire_values);
+        }
+
+    void any_encode_repeated(BitWriter* writer, const std::vector<boost::any>& wire_values)
+        {
+            if(!is_packed(this->this_field()))
+                return FieldCodecBase::any_encode_repeated(writer, wire_values);
+
+            encode_packed(writer, wire_values);
+        }
+
+    void any_decode_repeated(BitReader* reader, std::vector<boost::any>* wire_values)
+        {
+            if(!is_packed(this->this_field()))
+                return FieldCodecBase::any_decode_repeated(reader, wire_values);
+
+            wire_values->clear();
+            decode_packed(reader, wire_values);
+        }
+
+    unsigned any_size_repeated(const std::vector<boost::any>& wire_values)
+        {
+            if(!is_packed(this->this_field()))
+                return FieldCodecBase::any_size_repeated(wire_values);
+
+            const unsigned payload_bytes = packed_payload_bytes(wire_values);
+            return BITS_IN_BYTE*(varint_size(payload_bytes) + payload_bytes);
+        }
+
+    unsigned max_size_repeated()
+        {
+            if(!is_packed(this->this_field()))
+                return FieldCodecBase::max_size_repeated();
+
+            const unsigned payload_bytes = max_packed_payload_bytes();
+            return BITS_IN_BYTE*(varint_size(payload_bytes) + payload_bytes);
+        }
+
+    unsigned min_size_repeated()
+        {
+            if(!is_packed(this->this_field()))
+                return FieldCodecBase::min_size_repeated();
+
+            // zero length
+            return BITS_IN_BYTE;
+        }
+
+    template<typename BitSource>
+        bool read_field(BitSource* source, WireType* wire_value)
+        {
+            if(!this->use_required() && !source->read(1))
+                return false;
+            *wire_value = read_value(source);
+            return true;
+        }
+
+    void write_value(BitWriter* writer, const WireType& wire_value)
+        {
+            if(Helper::is_varint())
+                write_varint(writer, Helper::to_wire(wire_value));
+            else
+                writer->write(Helper::to_wire(wire_value), BITS_IN_BYTE*Helper::byte_size(wire_value));
+        }
+
+    template<typename BitSource>
+        WireType read_value(BitSource* source)
+        {
+            if(Helper::is_varint())
+                return Helper::from_wire(read_varint(source));
+            else
+                return Helper::from_wire(source->read(BITS_IN_BYTE*Helper::byte_size(WireType())));
+        }
+
+    // values are written back to back after their total length in bytes; empty values are omitted
+    void encode_packed(BitWriter* writer, const std::vector<boost::any>& wire_values)
+        {
+            const unsigned payload_bytes = packed_payload_bytes(wire_values);
+            write_varint(writer, payload_bytes);
+            for(std::vector<boost::any>::const_iterator it = wire_values.begin(), end = wire_values.end(); it != end; ++it)
             {
-                dccl::uint64 uint_value = (bits->template to<dccl::uint64>)();
-                if(!uint_value) throw NullValueException();
-                bits->resize(0);
-                
-                if(helper_.is_varint())
-                    bits->get_more_bits(BITS_IN_BYTE);
-                else
-                    bits->get_more_bits(BITS_IN_BYTE*helper_.byte_size(WireType()));
+                if(!it->empty())
+                    write_value(writer, boost::any_cast<WireType>(*it));
             }
+        }
+
+    // Values must provide push_back(const WireType&) and size()
+    template<typename BitSource, typename Values>
+        void decode_packed(BitSource* source, Values* wire_values)
+        {
+            const dccl::uint64 payload_bytes = read_varint(source);
+            if(payload_bytes > max_packed_payload_bytes())
+                throw(Exception("Packed field length exceeds the maximum for field: " + this->this_field()->DebugString()));
 
-            if(helper_.is_varint())
+            const std::size_t end = source->position() + BITS_IN_BYTE*payload_bytes;
+            const unsigned max_repeat = this->field_params().max_repeat;
+            while(source->position() < end && !source->overrun())
             {
-                // most significant bit indicates if more bytes are needed
-                while(bits->test(bits->size()-1))
-                    bits->get_more_bits(BITS_IN_BYTE);
+                if(wire_values->size() == max_repeat)
+                    throw(Exception("Packed field holds more than max_repeat values: " + this->this_field()->DebugString()));
+                wire_values->push_back(read_value(source));
             }
-                            
-            std::string bytes = bits->to_byte_string();
-            google::protobuf::io::CodedInputStream input_stream(reinterpret_cast<const google::protobuf::uint8*>(bytes.data()), bytes.size());
 
-            return helper_.decode(&input_stream);
-        }    
+            if(source->position() != end && !source->overrun())
+                throw(Exception("Packed field length does not end on a value boundary: " + this->this_field()->DebugString()));
+        }
 
-private:
-    PrimitiveTypeHelper<WireType, DeclaredType> helper_;
+    unsigned packed_payload_bytes(const std::vector<boost::any>& wire_values)
+        {
+            check_max_repeat(wire_values.size());
 
+            unsigned payload_bytes = 0;
+            try
+            {
+                for(std::vector<boost::any>::const_iterator it = wire_values.begin(), end = wire_values.end(); it != end; ++it)
+                {
+                    if(!it->empty())
+                        payload_bytes += Helper::byte_size(boost::any_cast<WireType>(*it));
+                }
+            }
+            catch(boost::bad_any_cast&)
+            { throw(type_error("encode_repeated", typeid(WireType), wire_values.at(0).type())); }
+            return payload_bytes;
+        }
+
+    // the typed path reads the values directly from (and adds them directly to) the parent message
+    template<typename T>
+        typename boost::enable_if<internal::ReflectedValue<T>, void>::type
+        typed_encode_packed(BitWriter* writer, const google::protobuf::Message& parent, compiler::dummy<1> dummy = 0)
+        {
+            const google::protobuf::FieldDescriptor* field = this->this_field();
+            const int values_size = parent.GetReflection()->FieldSize(parent, field);
+
+            write_varint(writer, typed_payload_bytes<T>(parent));
+            WireType wire_value;
+            for(int i = 0; i < values_size; ++i)
+            {
+                if(typed_pre_encode(internal::ReflectedValue<T>::get_repeated(parent, field, i), &wire_value))
+                    write_value(writer, wire_value);
+            }
+        }
+
+    template<typename T>
+        typename boost::enable_if<internal::ReflectedValue<T>, void>::type
+        typed_decode_packed(BitReader* reader, google::protobuf::Message* parent, compiler::dummy<1> dummy = 0)
+        {
+            ReflectedValues<T> values(this, parent);
+            decode_packed(reader, &values);
+        }
+
+    template<typename T>
+        typename boost::enable_if<internal::ReflectedValue<T>, unsigned>::type
+        typed_size_packed(const google::protobuf::Message& parent, compiler::dummy<1> dummy = 0)
+        {
+            const unsigned payload_bytes = typed_payload_bytes<T>(parent);
+            return BITS_IN_BYTE*(varint_size(payload_bytes) + payload_bytes);
+        }
+
+    template<typename T>
+        typename boost::disable_if<internal::ReflectedValue<T>, void>::type
+        typed_encode_packed(BitWriter* writer, const google::protobuf::Message& parent, compiler::dummy<0> dummy = 0)
+        { FieldCodecBase::typed_encode(writer, parent); }
+
+    template<typename T>
+        typename boost::disable_if<internal::ReflectedValue<T>, void>::type
+        typed_decode_packed(BitReader* reader, google::protobuf::Message* parent, compiler::dummy<0> dummy = 0)
+        { FieldCodecBase::typed_decode(reader, parent); }
+
+    template<typename T>
+        typename boost::disable_if<internal::ReflectedValue<T>, unsigned>::type
+        typed_size_packed(const google::protobuf::Message& parent, compiler::dummy<0> dummy = 0)
+        { return FieldCodecBase::typed_size(parent); }
+
+    template<typename T>
+        unsigned typed_payload_bytes(const google::protobuf::Message& parent)
+        {
+            const google::protobuf::FieldDescriptor* field = this->this_field();
+            const int values_size = parent.GetReflection()->FieldSize(parent, field);
+            check_max_repeat(values_size);
+
+            unsigned payload_bytes = 0;
+            WireType wire_value;
+            for(int i = 0; i < values_size; ++i)
+            {
+                if(typed_pre_encode(internal::ReflectedValue<T>::get_repeated(parent, field, i), &wire_value))
+                    payload_bytes += Helper::byte_size(wire_value);
+            }
+            return payload_bytes;
+        }
+
+    // false if the value is empty (pre_encode() threw NullValueException)
+    bool typed_pre_encode(const FieldType& field_value, WireType* wire_value)
+        {
+            try
+            {
+                *wire_value = this->pre_encode(field_value);
+                return true;
+            }
+            catch(NullValueException&)
+            { return false; }
+        }
+
+    void check_max_repeat(std::size_t values_size)
+        {
+            if(values_size > this->field_params().max_repeat)
+                throw(dccl::OutOfRangeException(std::string("Repeated size exceeds max_repeat for field: ") + this->this_field()->DebugString(), this->this_field()));
+        }
+
+    unsigned max_packed_payload_bytes()
+        {
+            return this->field_params().max_repeat * max_value_bytes();
+        }
+
+    static Bitset to_bitset(const char* buffer, const BitWriter& writer)
+        {
+            Bitset bits;
+            bits.from_byte_stream(buffer, buffer + writer.byte_size());
+            bits.resize(writer.size());
+            return bits;
+        }
+
+    // adds decoded values to a repeated field of the parent message
+    template<typename T>
+        class ReflectedValues
+    {
+    public:
+        ReflectedValues(PrimitiveTypeFieldCodec* codec, google::protobuf::Message* parent)
+            : codec_(codec), parent_(parent), field_(codec->this_field()), size_(0)
+            { }
+
+        void push_back(const WireType& wire_value)
+            {
+                ++size_;
+                // post_decode() may still signal an empty value (e.g. an unknown enumeration index)
+                try
+                { internal::ReflectedValue<T>::add(parent_, field_, codec_->post_decode(wire_value)); }
+                catch(NullValueException&)
+                { }
+            }
+
+        std::size_t size() const { return size_; }
+
+    private:
+        PrimitiveTypeFieldCodec* codec_;
+        google::protobuf::Message* parent_;
+        const google::protobuf::FieldDescriptor* field_;
+        std::size_t size_;
+    };
 };
 
 class EnumFieldCodec : public PrimitiveTypeFieldCodec<int, google::protobuf::FieldDescriptor::TYPE_ENUM, const google::protobuf::EnumValueDescriptor*>
 {
 public:
+    EnumFieldCodec()
+        { set_direct_io_type(typeid(EnumFieldCodec)); }
+
     int pre_encode(const google::protobuf::EnumValueDescriptor* const& field_value);
     const google::protobuf::EnumValueDescriptor* post_decode(const int& wire_value);    
 };
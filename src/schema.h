@@ -0,0 +1,101 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLSCHEMA20261018H
+#define DCCLSCHEMA20261018H
+
+#include <map>
+#include <string>
+
+#include <google/protobuf/descriptor.h>
+
+#include "common.h"
+#include "internal/id_table.h"
+#include "internal/generation.h"
+
+namespace dccl
+{
+    class Codec;
+
+    /// \brief The message types loaded into a Codec, along with the sizes and identifiers computed when they were validated by Codec::load().
+    ///
+    /// A Schema is loaded and validated once and can then be shared by any number of Codec instances (see Codec::schema() and Codec(boost::shared_ptr<const Schema>)), for example one per link or crypto passphrase. Settings specific to a link (crypto passphrase, strict mode, frame handlers) stay with each Codec. A shared Schema is never modified: loading or unloading messages in a Codec that shares its Schema first gives that Codec its own copy.
+    /// \ingroup dccl_api
+    class Schema
+    {
+      public:
+        /// \brief Name of the identifier codec (see Codec::Codec()) used to encode and decode the DCCL ids
+        const std::string& id_codec_name() const { return id_codec_; }
+
+        /// \brief Map of all loaded DCCL ids to the equivalent Protobuf descriptor
+        const std::map<int32, const google::protobuf::Descriptor*>& loaded() const { return id2desc_; }
+
+        /// \brief Descriptor of the message loaded with a given DCCL id (in constant time), or 0 if none is loaded
+        const google::protobuf::Descriptor* loaded_descriptor(unsigned dccl_id) const
+        { return id2desc_table_.get(dccl_id); }
+
+      private:
+        friend class Codec;
+
+        Schema(const std::string& id_codec, bool default_id_codec)
+            : id_codec_(id_codec),
+            default_id_codec_(default_id_codec),
+            id_min_bits_(0),
+            id_max_bits_(0)
+        { }
+
+        // maximum and minimum encoded sizes of a message type, not including the DCCL id
+        struct MessageBitSizes
+        {
+            unsigned head_max;
+            unsigned body_max;
+            unsigned head_min;
+            unsigned body_min;
+        };
+
+        // sizes of a loaded message, valid while the codecs (and other state) they were computed from are unchanged
+        struct LoadedSizes
+        {
+            MessageBitSizes bits;
+            internal::Dependencies dependencies;
+        };
+
+        std::string id_codec_;
+
+        // maps `dccl.id`s onto Message Descriptors
+        std::map<int32, const google::protobuf::Descriptor*> id2desc_;
+        // same contents as id2desc_, for constant time lookup when decoding
+        internal::IdTable<const google::protobuf::Descriptor*> id2desc_table_;
+
+        // sizes computed by load()
+        std::map<const google::protobuf::Descriptor*, LoadedSizes> desc2size_;
+        std::map<int32, unsigned> id2bits_;
+        // id_codec_ is the DefaultIdentifierCodec, so ids can be read directly from the bytes.
+        // Custom id codecs may size the id using external state, so id sizes are only cached for the default one
+        bool default_id_codec_;
+        unsigned id_min_bits_;
+        unsigned id_max_bits_;
+        // the id codec that id2bits_, id_min_bits_ and id_max_bits_ were computed with
+        internal::Dependencies id_dependencies_;
+    };
+}
+
+#endif
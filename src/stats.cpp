@@ -0,0 +1,234 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "dccl/stats.h"
+#include "dccl/exception.h"
+
+namespace
+{
+    // e.g. "too short" -> "too_short"
+    std::string reason_name(int code)
+    {
+        std::string name = dccl::Status::code_name(static_cast<dccl::StatusCode>(code));
+        std::replace(name.begin(), name.end(), ' ', '_');
+        return name;
+    }
+
+    // escapes backslash and quote (the only characters of a protobuf full name or a reason that could need it)
+    std::string quoted(const std::string& s)
+    {
+        std::string out = "\"";
+        for(std::string::const_iterator it = s.begin(), end = s.end(); it != end; ++it)
+        {
+            if(*it == '\\' || *it == '"')
+                out += '\\';
+            out += *it;
+        }
+        return out + "\"";
+    }
+
+    // nanoseconds as seconds, without rounding away the nanoseconds
+    std::string seconds(dccl::uint64 ns)
+    {
+        std::stringstream ss;
+        ss.precision(15);
+        ss << ns * 1e-9;
+        return ss.str();
+    }
+
+    std::string labels(const dccl::MessageStats& message)
+    {
+        std::stringstream ss;
+        ss << "id=\"" << message.dccl_id << "\",message=" << quoted(message.name);
+        return ss.str();
+    }
+
+    void write_counter(std::ostream* os, const std::string& metric, const std::string& help,
+                       const std::vector<dccl::MessageStats>& messages,
+                       dccl::uint64 dccl::OperationStats::* value, dccl::OperationStats dccl::MessageStats::* op)
+    {
+        *os << "# HELP " << metric << " " << help << "\n"
+            << "# TYPE " << metric << " counter\n";
+        for(std::vector<dccl::MessageStats>::const_iterator it = messages.begin(), end = messages.end(); it != end; ++it)
+            *os << metric << "{" << labels(*it) << "} " << (*it).*op.*value << "\n";
+    }
+
+    void write_failures(std::ostream* os, const std::string& metric, const std::string& help,
+                        const std::vector<dccl::MessageStats>& messages,
+                        dccl::OperationStats dccl::MessageStats::* op)
+    {
+        *os << "# HELP " << metric << " " << help << "\n"
+            << "# TYPE " << metric << " counter\n";
+        for(std::vector<dccl::MessageStats>::const_iterator it = messages.begin(), end = messages.end(); it != end; ++it)
+        {
+            for(int code = dccl::STATUS_OK + 1; code < dccl::NUM_STATUS_CODES; ++code)
+            {
+                if(((*it).*op).failures[code])
+                    *os << metric << "{" << labels(*it) << ",reason=\"" << reason_name(code) << "\"} " << ((*it).*op).failures[code] << "\n";
+            }
+        }
+    }
+
+    void write_histogram(std::ostream* os, const std::string& metric, const std::string& help,
+                         const std::vector<dccl::MessageStats>& messages,
+                         dccl::LatencyHistogram dccl::OperationStats::* histogram, dccl::OperationStats dccl::MessageStats::* op)
+    {
+        *os << "# HELP " << metric << " " << help << "\n"
+            << "# TYPE " << metric << " histogram\n";
+        for(std::vector<dccl::MessageStats>::const_iterator it = messages.begin(), end = messages.end(); it != end; ++it)
+        {
+            const dccl::LatencyHistogram& h = (*it).*op.*histogram;
+            const std::string l = labels(*it);
+            dccl::uint64 cumulative = 0;
+            for(int i = 0; i < dccl::LatencyHistogram::NUM_BUCKETS - 1; ++i)
+            {
+                cumulative += h.buckets[i];
+                *os << metric << "_bucket{" << l << ",le=\"" << seconds(dccl::LatencyHistogram::upper_bound_ns(i)) << "\"} " << cumulative << "\n";
+            }
+            *os << metric << "_bucket{" << l << ",le=\"+Inf\"} " << h.count << "\n"
+                << metric << "_sum{" << l << "} " << seconds(h.sum_ns) << "\n"
+                << metric << "_count{" << l << "} " << h.count << "\n";
+        }
+    }
+
+    void write_json(std::ostream* os, const dccl::LatencyHistogram& h)
+    {
+        *os << "{\"count\": " << h.count << ", \"sum_ns\": " << h.sum_ns << ", \"buckets\": [";
+        for(int i = 0; i < dccl::LatencyHistogram::NUM_BUCKETS; ++i)
+        {
+            if(i)
+                *os << ", ";
+            *os << "{\"le_ns\": ";
+            if(dccl::LatencyHistogram::upper_bound_ns(i))
+                *os << dccl::LatencyHistogram::upper_bound_ns(i);
+            else
+                *os << "null";
+            *os << ", \"count\": " << h.buckets[i] << "}";
+        }
+        *os << "]}";
+    }
+
+    void write_json(std::ostream* os, const dccl::OperationStats& op)
+    {
+        *os << "{\"count\": " << op.count << ", \"failures\": {";
+        bool first = true;
+        for(int code = dccl::STATUS_OK + 1; code < dccl::NUM_STATUS_CODES; ++code)
+        {
+            if(!op.failures[code])
+                continue;
+            if(!first)
+                *os << ", ";
+            first = false;
+            *os << quoted(reason_name(code)) << ": " << op.failures[code];
+        }
+        *os << "}, \"bytes\": " << op.bytes << ", \"padding_bits\": " << op.padding_bits << ", \"latency\": ";
+        write_json(os, op.latency);
+        *os << ", \"crypto_latency\": ";
+        write_json(os, op.crypto_latency);
+        *os << "}";
+    }
+}
+
+dccl::LatencyHistogram::LatencyHistogram()
+    : count(0),
+      sum_ns(0)
+{
+    std::fill(buckets, buckets + NUM_BUCKETS, 0);
+}
+
+dccl::OperationStats::OperationStats()
+    : count(0),
+      bytes(0),
+      padding_bits(0)
+{
+    std::fill(failures, failures + NUM_STATUS_CODES, 0);
+}
+
+dccl::uint64 dccl::OperationStats::failed() const
+{
+    uint64 n = 0;
+    for(int i = 0; i < NUM_STATUS_CODES; ++i)
+        n += failures[i];
+    return n;
+}
+
+void dccl::CodecStats::write_prometheus(std::ostream* os) const
+{
+    write_counter(os, "dccl_encodes_total", "Messages encoded", messages, &OperationStats::count, &MessageStats::encode);
+    write_failures(os, "dccl_encode_failures_total", "Messages that failed to encode", messages, &MessageStats::encode);
+    write_counter(os, "dccl_encoded_bytes_total", "Bytes of encoded messages", messages, &OperationStats::bytes, &MessageStats::encode);
+    write_counter(os, "dccl_padding_bits_total", "Bits added to encoded messages to fill whole bytes", messages, &OperationStats::padding_bits, &MessageStats::encode);
+    write_histogram(os, "dccl_encode_seconds", "Time to encode a message", messages, &OperationStats::latency, &MessageStats::encode);
+    write_histogram(os, "dccl_encrypt_seconds", "Time to encrypt a message body", messages, &OperationStats::crypto_latency, &MessageStats::encode);
+
+    write_counter(os, "dccl_decodes_total", "Messages decoded", messages, &OperationStats::count, &MessageStats::decode);
+    write_failures(os, "dccl_decode_failures_total", "Messages that failed to decode", messages, &MessageStats::decode);
+    write_counter(os, "dccl_decoded_bytes_total", "Bytes of decoded messages", messages, &OperationStats::bytes, &MessageStats::decode);
+    write_histogram(os, "dccl_decode_seconds", "Time to decode a message", messages, &OperationStats::latency, &MessageStats::decode);
+    write_histogram(os, "dccl_decrypt_seconds", "Time to decrypt a message body", messages, &OperationStats::crypto_latency, &MessageStats::decode);
+}
+
+void dccl::CodecStats::write_json(std::ostream* os) const
+{
+    *os << "{\"messages\": [";
+    for(std::vector<MessageStats>::const_iterator it = messages.begin(), end = messages.end(); it != end; ++it)
+    {
+        if(it != messages.begin())
+            *os << ", ";
+        *os << "{\"id\": " << it->dccl_id << ", \"name\": " << quoted(it->name) << ", \"encode\": ";
+        ::write_json(os, it->encode);
+        *os << ", \"decode\": ";
+        ::write_json(os, it->decode);
+        *os << "}";
+    }
+    *os << "]}\n";
+}
+
+void dccl::CodecStats::save(const std::string& path, StatsFormat format /* = STATS_PROMETHEUS */) const
+{
+    // write alongside and rename over the old file, so that it is replaced in one step
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream fout(tmp_path.c_str());
+        if(!fout.is_open())
+            throw(Exception("Failed to open " + tmp_path + " for writing statistics"));
+
+        if(format == STATS_JSON)
+            write_json(&fout);
+        else
+            write_prometheus(&fout);
+
+        fout.close();
+        if(fout.fail())
+            throw(Exception("Failed to write statistics to " + tmp_path));
+    }
+
+    if(std::rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tmp_path.c_str());
+        throw(Exception("Failed to replace " + path + " with the new statistics"));
+    }
+}
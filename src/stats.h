@@ -0,0 +1,118 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLSTATS20261018H
+#define DCCLSTATS20261018H
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "dccl/common.h"
+#include "dccl/status.h"
+
+namespace dccl
+{
+    /// \brief Number of StatusCode values (failures are counted per StatusCode)
+    const int NUM_STATUS_CODES = STATUS_CODEC_ERROR + 1;
+
+    /// \brief Distribution of the time taken by calls, in power of two buckets of nanoseconds
+    struct LatencyHistogram
+    {
+        enum { NUM_BUCKETS = 24 };
+
+        LatencyHistogram();
+
+        /// \brief Exclusive upper bound (in nanoseconds) of bucket \a i: 64 ns for bucket 0, doubling up to about 0.27 s. The last bucket has no upper bound (returns 0).
+        static uint64 upper_bound_ns(int i)
+        { return i < NUM_BUCKETS - 1 ? (uint64(64) << i) : 0; }
+
+        /// \brief Number of calls timed
+        uint64 count;
+        /// \brief Total time of all the calls timed, in nanoseconds
+        uint64 sum_ns;
+        /// \brief Number of calls in each bucket (not cumulative)
+        uint64 buckets[NUM_BUCKETS];
+    };
+
+    /// \brief Counters for encoding (or decoding) one message type
+    struct OperationStats
+    {
+        OperationStats();
+
+        /// \brief Successful calls
+        uint64 count;
+        /// \brief Failed calls, indexed by StatusCode. Calls that throw are counted under the closest StatusCode to the exception (STATUS_CODEC_ERROR if there is none).
+        uint64 failures[NUM_STATUS_CODES];
+        /// \brief Total number of failed calls
+        uint64 failed() const;
+        /// \brief Bytes encoded (or consumed by decoding) by successful calls
+        uint64 bytes;
+        /// \brief Encoding only: bits added to round the head and body up to whole bytes
+        uint64 padding_bits;
+        /// \brief Time taken by every call (successful or not)
+        LatencyHistogram latency;
+        /// \brief Time spent encrypting (or decrypting) the body, for calls that did so
+        LatencyHistogram crypto_latency;
+    };
+
+    /// \brief Counters for one DCCL id
+    struct MessageStats
+    {
+        MessageStats() : dccl_id(-1) { }
+
+        /// \brief DCCL id, or -1 for calls whose id was unknown (too few bytes, or not loaded when statistics were enabled)
+        int dccl_id;
+        /// \brief Full name of the message type loaded for this id (empty for dccl_id -1)
+        std::string name;
+        OperationStats encode;
+        OperationStats decode;
+    };
+
+    /// \brief Output formats of CodecStats::save()
+    enum StatsFormat
+    {
+        /// Prometheus text exposition format (see write_prometheus())
+        STATS_PROMETHEUS,
+        /// JSON (see write_json())
+        STATS_JSON
+    };
+
+    /// \brief Snapshot of the runtime statistics kept by a Codec (see Codec::set_stats_enabled())
+    /// \ingroup dccl_api
+    struct CodecStats
+    {
+        /// \brief One entry per DCCL id used since statistics were enabled (or last reset), in order of id
+        std::vector<MessageStats> messages;
+
+        /// \brief Write as Prometheus text: counters dccl_encodes_total, dccl_encode_failures_total (by `reason`), dccl_encoded_bytes_total, dccl_padding_bits_total and histograms dccl_encode_seconds and dccl_encrypt_seconds (and the same for decoding), all labeled by DCCL `id` and `message`
+        void write_prometheus(std::ostream* os) const;
+
+        /// \brief Write as a JSON object {"messages": [...]} with the fields of MessageStats
+        void write_json(std::ostream* os) const;
+
+        /// \brief Write to the file \a path, replacing it atomically (so that a reader, such as the Prometheus node exporter, never sees a partial file)
+        /// \throw Exception if the file cannot be written
+        void save(const std::string& path, StatsFormat format = STATS_PROMETHEUS) const;
+    };
+}
+
+#endif
@@ -0,0 +1,67 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#include <sstream>
+
+#include "dccl/status.h"
+
+const char* dccl::Status::code_name(StatusCode code)
+{
+    switch(code)
+    {
+        case STATUS_OK: return "ok";
+        case STATUS_TOO_SHORT: return "too short";
+        case STATUS_UNKNOWN_ID: return "unknown id";
+        case STATUS_NO_CODEC: return "no codec";
+        case STATUS_NOT_INITIALIZED: return "not initialized";
+        case STATUS_OUT_OF_RANGE: return "out of range";
+        case STATUS_BUFFER_TOO_SMALL: return "buffer too small";
+        case STATUS_TRUNCATED: return "truncated";
+        case STATUS_CODEC_ERROR: return "codec error";
+    }
+    return "unknown status";
+}
+
+std::string dccl::Status::str() const
+{
+    std::stringstream ss;
+    ss << code_name(code_);
+    if(ok())
+        return ss.str();
+
+    if(dccl_id_ >= 0)
+        ss << " (DCCL id " << dccl_id_ << ")";
+
+    ss << " at bit " << bit_offset_;
+
+    if(!field_path_.empty())
+    {
+        // e.g. dccl.test.Foo.inner.lat
+        ss << " in field " << field_path_.front()->containing_type()->full_name();
+        for(std::vector<const google::protobuf::FieldDescriptor*>::const_iterator it = field_path_.begin(), end = field_path_.end(); it != end; ++it)
+            ss << "." << (*it)->name();
+    }
+
+    if(!detail_.empty())
+        ss << ": " << detail_;
+
+    return ss.str();
+}
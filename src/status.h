@@ -0,0 +1,127 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef DCCLSTATUS20261018H
+#define DCCLSTATUS20261018H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include <google/protobuf/descriptor.h>
+
+namespace dccl
+{
+    class Codec;
+
+    /// \brief Reason that Codec::try_encode() or Codec::try_decode() failed
+    enum StatusCode
+    {
+        /// Success
+        STATUS_OK = 0,
+        /// Decode: fewer bytes than the DCCL id, header or minimum body size
+        STATUS_TOO_SHORT,
+        /// The DCCL id has not been loaded
+        STATUS_UNKNOWN_ID,
+        /// The (dccl.msg).codec for this message type is not loaded
+        STATUS_NO_CODEC,
+        /// Encode: not all `required` fields are set
+        STATUS_NOT_INITIALIZED,
+        /// Encode: a field value is out of bounds (strict mode only)
+        STATUS_OUT_OF_RANGE,
+        /// Encode: the output buffer is too small
+        STATUS_BUFFER_TOO_SMALL,
+        /// Decode: a field needed more bits than remain in the message
+        STATUS_TRUNCATED,
+        /// A field codec failed for another reason (see Status::detail())
+        STATUS_CODEC_ERROR
+    };
+
+    /// \brief Outcome of Codec::try_encode() or Codec::try_decode(): a StatusCode and where in the message the failure happened.
+    ///
+    /// Nothing is formatted when a call fails; use str() to produce a human readable description. A Status can be reused between calls, so that its storage is only allocated once.
+    /// \ingroup dccl_api
+    class Status
+    {
+      public:
+        Status()
+            : code_(STATUS_OK),
+            dccl_id_(-1),
+            bit_offset_(0)
+        { }
+
+        /// \brief True if the call succeeded
+        bool ok() const { return code_ == STATUS_OK; }
+
+        StatusCode code() const { return code_; }
+
+        /// \brief DCCL id of the message, or -1 if not known (e.g. too few bytes to decode the id)
+        int dccl_id() const { return dccl_id_; }
+
+        /// \brief Fields (outermost first) being encoded or decoded when a field codec failed, or empty if the failure was not within a field
+        const std::vector<const google::protobuf::FieldDescriptor*>& field_path() const
+        { return field_path_; }
+
+        /// \brief Innermost field being encoded or decoded when a field codec failed, or 0
+        const google::protobuf::FieldDescriptor* field() const
+        { return field_path_.empty() ? 0 : field_path_.back(); }
+
+        /// \brief Offset (in bits from the start of the encoded message, including the DCCL id) at which the failure happened
+        std::size_t bit_offset() const { return bit_offset_; }
+
+        /// \brief Description given by the field codec for STATUS_CODEC_ERROR, otherwise empty
+        const std::string& detail() const { return detail_; }
+
+        /// \brief Human readable description of this status (e.g. "truncated at bit 42 in field dccl.test.Foo.bar")
+        std::string str() const;
+
+        /// \brief Short name of a status code (e.g. "truncated")
+        static const char* code_name(StatusCode code);
+
+      private:
+        friend class Codec;
+
+        void reset()
+        {
+            code_ = STATUS_OK;
+            dccl_id_ = -1;
+            bit_offset_ = 0;
+            field_path_.clear();
+            detail_.clear();
+        }
+
+        bool fail(StatusCode code, std::size_t bit_offset)
+        {
+            code_ = code;
+            bit_offset_ = bit_offset;
+            return false;
+        }
+
+      private:
+        StatusCode code_;
+        int dccl_id_;
+        std::size_t bit_offset_;
+        std::vector<const google::protobuf::FieldDescriptor*> field_path_;
+        std::string detail_;
+    };
+}
+
+#endif
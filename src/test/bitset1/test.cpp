@@ -158,6 +158,68 @@ int main()
         assert(grandparent.to_ulong() == 0xD);
     }
 
+    // multi-word operations
+    {
+        std::cout << std::endl;
+        std::string bytes = dccl::hex_decode("0123456789abcdeffedcba987654321011");
+        Bitset big;
+        big.from_byte_string(bytes);
+        assert(big.size() == bytes.size()*8);
+        assert(big.to_byte_string() == bytes);
+
+        // append and prepend at non-word-aligned offsets
+        Bitset a(3, 0x5), b;
+        b.from_byte_string(bytes);
+        a.append(b);
+        assert(a.size() == 3 + bytes.size()*8);
+        Bitset c(a);
+        c >>= 3;
+        c.resize(bytes.size()*8);
+        assert(c.to_byte_string() == bytes);
+
+        Bitset d(b);
+        d.prepend(Bitset(5, 0x1F));
+        assert(d.size() == 5 + bytes.size()*8);
+        assert(Bitset(d >> 5).to_string().substr(5) == b.to_string());
+        assert(d.to_string().substr(d.size()-5) == "11111");
+
+        // shifts larger than a word preserve size and contents
+        Bitset e(b);
+        e <<= 70;
+        assert(e.size() == b.size());
+        for(Bitset::size_type i = 0; i < e.size(); ++i)
+            assert(e[i] == (i < 70 ? false : b[i-70]));
+        e >>= 70;
+        for(Bitset::size_type i = 0; i < e.size(); ++i)
+            assert(e[i] == (i < e.size() - 70 ? b[i] : false));
+
+        // deque-like operations at both ends
+        Bitset f;
+        for(int i = 0; i < 200; ++i)
+        {
+            f.push_front(i % 3 == 0);
+            f.push_back(i % 5 == 0);
+        }
+        assert(f.size() == 400);
+        for(int i = 0; i < 200; ++i)
+        {
+            assert(f.front() == ((199 - i) % 3 == 0));
+            f.pop_front();
+        }
+        for(int i = 199; i >= 0; --i)
+        {
+            assert(f.back() == (i % 5 == 0));
+            f.pop_back();
+        }
+        assert(f.empty());
+
+        // 64-bit integer round trip
+        dccl::uint64 v64 = 0xFEDCBA9876543210ull;
+        Bitset g;
+        g.from<dccl::uint64>(v64);
+        assert(g.size() == 64);
+        assert(g.to<dccl::uint64>() == v64);
+    }
     
     std::cout << "all tests passed" << std::endl;
     
@@ -0,0 +1,166 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests BitWriter / BitReader against the Bitset byte layout
+
+#include <iostream>
+#include <cassert>
+#include <stdexcept>
+
+#include "dccl/bitstream.h"
+#include "dccl/binary.h"
+
+using dccl::Bitset;
+using dccl::BitWriter;
+using dccl::BitReader;
+
+int main()
+{
+    // unaligned writes produce the same bytes as the equivalent Bitset
+    {
+        char buffer[16];
+        std::memset(buffer, 0xFF, sizeof(buffer)); // writer must not depend on a zeroed buffer
+        BitWriter writer(buffer, buffer + sizeof(buffer));
+        writer.write(5, 3);
+        writer.write_bit(true);
+        writer.write(0x1234567, 27);
+        writer.write_bytes("ab", 2);
+        writer.write(Bitset(11, 1025));
+        assert(writer.size() == 3 + 1 + 27 + 16 + 11);
+
+        Bitset bits(3, 5);
+        bits.append(Bitset(1, 1));
+        bits.append(Bitset(27, 0x1234567));
+        bits.append(Bitset(8, 'a'));
+        bits.append(Bitset(8, 'b'));
+        bits.append(Bitset(11, 1025));
+
+        std::string expected = bits.to_byte_string();
+        assert(writer.byte_size() == expected.size());
+        std::cout << dccl::hex_encode(buffer, buffer + writer.byte_size()) << std::endl;
+        assert(std::string(buffer, writer.byte_size()) == expected);
+
+        // read it all back
+        BitReader reader(buffer, buffer + writer.byte_size());
+        assert(reader.peek(3) == 5);
+        assert(reader.read(3) == 5);
+        assert(reader.read_bit());
+        assert(reader.read(27) == 0x1234567);
+        assert(reader.read_bytes(2) == "ab");
+        Bitset tail;
+        reader.read(&tail, 11);
+        assert(tail.to_ulong() == 1025);
+        assert(reader.position() == writer.size());
+        assert(reader.remaining() == writer.byte_size() * 8 - writer.size());
+    }
+
+    // aligned byte copies, wide values and padding
+    {
+        char buffer[12];
+        BitWriter writer(buffer, buffer + sizeof(buffer));
+        writer.write_bytes("xyz", 3);
+        writer.write(0xFEDCBA9876543210ull, 64);
+        writer.write_bit(true);
+        writer.pad_to_byte();
+        assert(writer.size() == 12 * 8);
+
+        BitReader reader(buffer, buffer + sizeof(buffer));
+        assert(reader.read_bytes(3) == "xyz");
+        assert(reader.read(64) == 0xFEDCBA9876543210ull);
+        assert(reader.read(8) == 1);
+        assert(reader.remaining() == 0);
+
+        // buffer is full
+        bool caught = false;
+        try { writer.write_bit(false); }
+        catch(std::length_error&) { caught = true; }
+        assert(caught);
+
+        caught = false;
+        try { reader.read_bit(); }
+        catch(dccl::Exception&) { caught = true; }
+        assert(caught);
+    }
+
+    // Bitsets wider than a word, at an unaligned cursor
+    {
+        Bitset wide;
+        for(unsigned i = 0; i < 150; ++i)
+            wide.push_back((i * 7) % 3 == 0);
+
+        char buffer[20];
+        BitWriter writer(buffer, buffer + sizeof(buffer));
+        writer.write(3, 5);
+        writer.write(wide);
+        assert(writer.size() == 5 + 150);
+
+        Bitset bits(5, 3);
+        bits.append(wide);
+        assert(std::string(buffer, writer.byte_size()) == bits.to_byte_string());
+
+        BitReader reader(buffer, buffer + writer.byte_size());
+        reader.skip(5);
+        Bitset read_back;
+        reader.read(&read_back, 150);
+        assert(read_back == wide);
+    }
+
+    // Bitset adapter only consumes the bits that were used
+    {
+        char buffer[4];
+        BitWriter writer(buffer, buffer + sizeof(buffer));
+        writer.write(0xABCDEF, 24);
+        writer.write(0x5, 8);
+
+        BitReader reader(buffer, buffer + sizeof(buffer));
+        {
+            dccl::internal::BitReaderBitset adapter(&reader, 24, 8);
+            Bitset* bits = adapter.bits();
+            assert(bits->size() == 8);
+            assert(bits->to_ulong() == 0xEF);
+            bits->get_more_bits(8);
+            assert(bits->to_ulong() == 0xCDEF);
+        }
+        assert(reader.position() == 16);
+        assert(reader.read(16) == 0x05AB);
+    }
+
+    // Bitset source pulls bits from the parent a read at a time
+    {
+        Bitset parent(200);
+        parent.set(3);
+        parent.set(67);
+        parent.set(69);
+        parent.set(130);
+        parent.set(199);
+
+        Bitset bits(&parent);
+        dccl::internal::BitsetSource source(&bits);
+        assert(source.read(4) == 8);
+        assert(source.read(66) == (1ull << 63)); // bit 67; bit 69 is past the first 64 and discarded
+        assert(source.read(61) == (1ull << 60));
+        assert(source.read(69) == 0); // bit 199 is discarded as well
+        assert(source.position() == 200);
+        assert(parent.empty());
+    }
+
+    std::cout << "all tests passed" << std::endl;
+}
@@ -0,0 +1,125 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests decoding onto a google::protobuf::Arena and into messages recycled by a dccl::MessagePool
+
+#include "dccl/codec.h"
+#include "test.pb.h"
+
+using namespace dccl::test;
+
+void fill(ArenaMsg* msg, int i)
+{
+    msg->mutable_inner()->set_value(i);
+    msg->mutable_inner()->set_label("inner");
+    for(int j = 0; j < i % 5; ++j)
+    {
+        ArenaInner* item = msg->add_items();
+        item->set_value(i + j);
+        item->set_label("item");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::Codec codec;
+    codec.load<ArenaMsg>();
+
+    std::vector<std::string> frames;
+    std::vector<ArenaMsg> msgs_in(20);
+    for(int i = 0, n = msgs_in.size(); i < n; ++i)
+    {
+        fill(&msgs_in[i], i);
+        frames.push_back(std::string());
+        codec.encode(&frames.back(), msgs_in[i]);
+    }
+
+#if DCCL_HAS_PROTOBUF_ARENA
+    {
+        google::protobuf::Arena arena;
+        google::protobuf::Message* msg = codec.decode(frames[3], &arena);
+        assert(msg->GetDescriptor() == ArenaMsg::descriptor());
+        assert(msg->GetArena() == &arena);
+        assert(msg->SerializeAsString() == msgs_in[3].SerializeAsString());
+
+        // submessages are on the same arena
+        const google::protobuf::Reflection* refl = msg->GetReflection();
+        const google::protobuf::FieldDescriptor* items = ArenaMsg::descriptor()->FindFieldByName("items");
+        assert(refl->FieldSize(*msg, items) == 3);
+        assert(refl->GetRepeatedMessage(*msg, items, 0).GetArena() == &arena);
+
+        std::vector<google::protobuf::Message*> msgs_out;
+        codec.decode_batch(frames, &msgs_out, &arena);
+        assert(msgs_out.size() == frames.size());
+        for(int i = 0, n = msgs_out.size(); i < n; ++i)
+        {
+            assert(msgs_out[i]->GetArena() == &arena);
+            assert(msgs_out[i]->SerializeAsString() == msgs_in[i].SerializeAsString());
+        }
+
+        // frees every message at once
+        arena.Reset();
+    }
+#endif
+
+    {
+        dccl::MessagePool pool;
+        google::protobuf::Message* first = codec.decode(frames[4], &pool);
+        assert(first->SerializeAsString() == msgs_in[4].SerializeAsString());
+        pool.release(first);
+        assert(pool.size() == 1);
+
+        // the released message is reused (and cleared before reuse)
+        google::protobuf::Message* second = codec.decode(frames[1], &pool);
+        assert(second == first);
+        assert(pool.size() == 0);
+        assert(second->SerializeAsString() == msgs_in[1].SerializeAsString());
+
+        // returned to the pool if decoding fails
+        std::string truncated = frames[4].substr(0, 1);
+        try
+        {
+            codec.decode(truncated, &pool);
+            assert(false);
+        }
+        catch(dccl::Exception& e)
+        {
+        }
+        pool.release(second);
+        assert(pool.size() == 2);
+
+        google::protobuf::Message* third = pool.acquire(ArenaMsg::descriptor());
+        assert(third == first && third->ByteSizeLong() == 0);
+        pool.release(third);
+    }
+
+    {
+        // no more than max_per_type are kept
+        dccl::MessagePool pool(2);
+        for(int i = 0; i < 3; ++i)
+            pool.release(new ArenaMsg);
+        assert(pool.size() == 2);
+        pool.clear();
+        assert(pool.size() == 0);
+    }
+
+    std::cout << "all tests passed" << std::endl;
+}
@@ -21,6 +21,8 @@
 // along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
 // tests arithmetic encoder
 
+#include <pthread.h>
+
 #include <google/protobuf/descriptor.pb.h>
 
 #include "dccl/codec.h"
@@ -83,6 +85,34 @@ void run_test(dccl::arith::protobuf::ArithmeticModel& model,
 }
 
 
+// encodes and decodes the same messages on one link (a Codec with its own ModelContext),
+// keeping the encoded bytes
+struct Link
+{
+    std::vector<ArithmeticDouble3TestMsg> msgs;
+    std::vector<std::string> bytes;
+};
+
+void* run_link(void* arg)
+{
+    Link* link = static_cast<Link*>(arg);
+    
+    dccl::Codec codec;
+    dccl::arith::ModelManager::context(codec);
+    codec.load<ArithmeticDouble3TestMsg>();
+    
+    for(std::vector<ArithmeticDouble3TestMsg>::const_iterator it = link->msgs.begin(), end = link->msgs.end(); it != end; ++it)
+    {
+        std::string bytes;
+        codec.encode(&bytes, *it);
+        ArithmeticDouble3TestMsg msg_out;
+        codec.decode(bytes, &msg_out);
+        assert(it->SerializeAsString() == msg_out.SerializeAsString());
+        link->bytes.push_back(bytes);
+    }
+    return 0;
+}
+
 // usage: dccl_test10 [boolean: verbose]
 int main(int argc, char* argv[])
 {
@@ -119,6 +149,37 @@ int main(int argc, char* argv[])
         run_test(model, msg_in);
     }
 
+    // values equal to the bounds -x and x are each encoded as their own bound
+    {
+        dccl::arith::protobuf::ArithmeticModel model;
+
+        model.add_value_bound(-3);
+        model.add_frequency(10);
+
+        model.add_value_bound(-1);
+        model.add_frequency(20);
+
+        model.add_value_bound(1);
+        model.add_frequency(20);
+
+        model.add_value_bound(3);
+        model.add_frequency(10);
+
+        model.add_value_bound(5);
+
+        model.set_eof_frequency(10);
+        model.set_out_of_range_frequency(1);
+
+        ArithmeticDoubleTestMsg msg_in;
+
+        msg_in.add_value(-1);
+        msg_in.add_value(1);
+        msg_in.add_value(-3);
+        msg_in.add_value(3);
+
+        run_test(model, msg_in);
+    }
+
     // misc test case
     {            
         dccl::arith::protobuf::ArithmeticModel model;
@@ -365,8 +426,114 @@ int main(int argc, char* argv[])
         std::cout << "end random test #" << i << std::endl;
         
     }
+
+    // adaptive model with a large alphabet: the symbol frequencies change with every value encoded
+    {
+        dccl::arith::protobuf::ArithmeticModel model;
+
+        const int symbols = 500;
+        model.set_eof_frequency(1);
+        model.set_out_of_range_frequency(1);
+        for(int j = 0; j < symbols; ++j)
+        {
+            model.add_value_bound(j);
+            model.add_frequency(1);
+        }
+        model.add_value_bound(symbols);
+        model.set_is_adaptive(true);
+
+        for(int k = 0; k < 20; ++k)
+        {
+            ArithmeticDouble2TestMsg msg_in;
+            for(unsigned j = 0, n = rand() % 101; j < n; ++j)
+            {
+                // skewed towards the low symbols
+                int value = (rand() % 10) ? rand() % 50 : rand() % symbols;
+                msg_in.add_value(value);
+            }
+            run_test(model, msg_in, k == 0);
+        }
+    }
     
 
+    // adaptive models scoped to a Codec: links adapt independently of each other and of the shared model
+    {
+        dccl::arith::protobuf::ArithmeticModel model;
+        model.set_name("model");
+        model.set_eof_frequency(1);
+        model.add_value_bound(0);
+        model.add_frequency(1); 
+        model.add_value_bound(1);
+        model.add_frequency(1); 
+        model.add_value_bound(2);
+        model.set_out_of_range_frequency(1);
+        model.set_is_adaptive(true);
+        dccl::arith::ModelManager::set_model(model);
+
+        Link reference;
+        for(int i = 0; i < 200; ++i)
+        {
+            ArithmeticDouble3TestMsg msg;
+            for(int j = 0, n = rand() % 5; j < n; ++j)
+                msg.add_value((rand() % 4) ? 0 : 1);
+            reference.msgs.push_back(msg);
+        }
+        run_link(&reference);
+
+        // the shared model has not adapted
+        const dccl::arith::Model& shared = dccl::arith::ModelManager::find("model");
+        assert(shared.total_freq(dccl::arith::Model::ENCODER) == 4);
+        assert(shared.total_freq(dccl::arith::Model::DECODER) == 4);
+
+        // so each link starts from the same model, and produces the same bytes as the reference (without any of them seeing the others' updates)
+        dccl::dlog.disconnect(dccl::logger::ALL);
+        const int num_links = 4;
+        std::vector<Link> links(num_links);
+        std::vector<pthread_t> threads(num_links);
+        for(int i = 0; i < num_links; ++i)
+        {
+            links[i].msgs = reference.msgs;
+            if(pthread_create(&threads[i], 0, run_link, &links[i]) != 0)
+            {
+                std::cerr << "failed to create thread " << i << std::endl;
+                return 1;
+            }
+        }
+        for(int i = 0; i < num_links; ++i)
+        {
+            pthread_join(threads[i], 0);
+            assert(links[i].bytes == reference.bytes);
+        }
+
+        // a model set for one Codec is not seen by others
+        dccl::Codec link_codec;
+        dccl::arith::protobuf::ArithmeticModel link_model = model;
+        link_model.set_frequency(0, 100);
+        link_model.set_is_adaptive(false);
+        dccl::arith::ModelManager::set_model(link_codec, link_model);
+        link_codec.load<ArithmeticDouble3TestMsg>();
+        assert(dccl::arith::ModelManager::context(link_codec).find("model").total_freq(dccl::arith::Model::ENCODER) == 103);
+        assert(dccl::arith::ModelManager::find("model").total_freq(dccl::arith::Model::ENCODER) == 4);
+
+        std::string link_bytes;
+        link_codec.encode(&link_bytes, reference.msgs[0]);
+        ArithmeticDouble3TestMsg link_msg_out;
+        link_codec.decode(link_bytes, &link_msg_out);
+        assert(link_msg_out.SerializeAsString() == reference.msgs[0].SerializeAsString());
+
+        // reset() starts the adaptive models over
+        dccl::Codec reset_codec;
+        dccl::arith::ModelContext& context = dccl::arith::ModelManager::context(reset_codec);
+        reset_codec.load<ArithmeticDouble3TestMsg>();
+        std::string bytes;
+        reset_codec.encode(&bytes, reference.msgs[0]);
+        assert(bytes == reference.bytes[0]);
+        bytes.clear();
+        context.reset();
+        reset_codec.encode(&bytes, reference.msgs[0]);
+        assert(bytes == reference.bytes[0]);
+    }
+
     std::cout << "all tests passed" << std::endl;
 }
 
@@ -0,0 +1,126 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests Codec::encode_batch and Codec::decode_batch
+
+#include <boost/shared_ptr.hpp>
+
+#include "dccl/codec.h"
+#include "test.pb.h"
+
+using namespace dccl::test;
+
+const int num_msgs = 100;
+
+void fill(BatchMsgA* msg, int seed)
+{
+    msg->set_source(seed % 32);
+    if(seed % 3)
+        msg->set_value(seed % 201 - 100);
+}
+
+void fill(BatchMsgB* msg, int seed)
+{
+    msg->set_source(seed % 32);
+    msg->set_name(std::string("abcdefgh").substr(0, 1 + seed % 8));
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::Codec codec;
+    codec.load<BatchMsgA>();
+    codec.load<BatchMsgB>();
+
+    // alternate the two types, so the batch must switch ids
+    std::vector<boost::shared_ptr<google::protobuf::Message> > msgs_in;
+    std::vector<const google::protobuf::Message*> msg_ptrs;
+    for(int i = 0; i < num_msgs; ++i)
+    {
+        if(i % 2)
+        {
+            boost::shared_ptr<BatchMsgA> msg(new BatchMsgA);
+            fill(msg.get(), i);
+            msgs_in.push_back(msg);
+        }
+        else
+        {
+            boost::shared_ptr<BatchMsgB> msg(new BatchMsgB);
+            fill(msg.get(), i);
+            msgs_in.push_back(msg);
+        }
+        msg_ptrs.push_back(msgs_in.back().get());
+    }
+
+    std::vector<std::string> frames;
+    codec.encode_batch(&frames, msg_ptrs);
+    assert(frames.size() == msgs_in.size());
+
+    // identical to encoding one at a time
+    for(int i = 0; i < num_msgs; ++i)
+    {
+        std::string bytes;
+        codec.encode(&bytes, *msgs_in[i]);
+        assert(bytes == frames[i]);
+    }
+
+    // known types
+    {
+        std::vector<boost::shared_ptr<google::protobuf::Message> > msgs_out;
+        std::vector<google::protobuf::Message*> out_ptrs;
+        for(int i = 0; i < num_msgs; ++i)
+        {
+            msgs_out.push_back(boost::shared_ptr<google::protobuf::Message>(msgs_in[i]->New()));
+            out_ptrs.push_back(msgs_out.back().get());
+        }
+        codec.decode_batch(frames, out_ptrs);
+        for(int i = 0; i < num_msgs; ++i)
+            assert(msgs_in[i]->SerializeAsString() == msgs_out[i]->SerializeAsString());
+
+        // size mismatch is an error
+        out_ptrs.pop_back();
+        try
+        {
+            codec.decode_batch(frames, out_ptrs);
+            assert(false);
+        }
+        catch(dccl::Exception& e)
+        { }
+    }
+
+    // dynamic types
+    {
+        std::vector<boost::shared_ptr<google::protobuf::Message> > msgs_out;
+        codec.decode_batch(frames, &msgs_out);
+        assert(msgs_out.size() == msgs_in.size());
+        for(int i = 0; i < num_msgs; ++i)
+        {
+            assert(msgs_out[i]->GetDescriptor() == msgs_in[i]->GetDescriptor());
+            assert(msgs_in[i]->SerializeAsString() == msgs_out[i]->SerializeAsString());
+        }
+    }
+
+    // encoding the batch again appends
+    codec.encode_batch(&frames, msg_ptrs);
+    assert(frames.size() == 2 * msgs_in.size());
+    assert(frames[0] == frames[num_msgs]);
+
+    std::cout << "all tests passed" << std::endl;
+}
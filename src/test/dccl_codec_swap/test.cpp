@@ -0,0 +1,223 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests that codecs can be added to and removed from the FieldCodecManager while other threads encode and decode
+
+#include <pthread.h>
+
+#include <boost/atomic.hpp>
+
+#include "dccl/codec.h"
+#include "dccl/field_codec_manager.h"
+#include "dccl/codecs3/field_codec_default.h"
+#include "dccl/codecs3/field_codec_default_message.h"
+#include "test.pb.h"
+
+using namespace dccl::test;
+
+const int num_threads = 4;
+const int num_iterations = 2000;
+const int num_swaps = 500;
+
+boost::atomic<bool> done(false);
+
+bool round_trip(dccl::Codec* codec, int seed)
+{
+    SwapMsg msg_in;
+    msg_in.set_a(seed % 201 - 100);
+    if(seed % 2)
+        msg_in.set_b((seed % 10000) / 100.0);
+    if(seed % 3)
+        msg_in.set_c(std::string("abcdefgh").substr(0, seed % 9));
+
+    std::string bytes;
+    codec->encode(&bytes, msg_in);
+
+    SwapMsg msg_out;
+    codec->decode(bytes, &msg_out);
+    return msg_in.SerializeAsString() == msg_out.SerializeAsString();
+}
+
+// counts how often the plans and sizes of the messages using it are compiled
+class CountingCodec : public dccl::v3::DefaultNumericFieldCodec<dccl::int32>
+{
+  public:
+    // doesn't change the encoding, so keep the BitWriter / BitReader path (max_size() is otherwise called to decode)
+    CountingCodec()
+    { set_direct_io_type(typeid(CountingCodec)); }
+
+    static int plans;
+    static int sizes;
+
+  private:
+    bool supports_typed(const google::protobuf::FieldDescriptor* field)
+    {
+        ++plans;
+        return dccl::v3::DefaultNumericFieldCodec<dccl::int32>::supports_typed(field);
+    }
+
+    unsigned max_size()
+    {
+        ++sizes;
+        return dccl::v3::DefaultNumericFieldCodec<dccl::int32>::max_size();
+    }
+};
+
+int CountingCodec::plans = 0;
+int CountingCodec::sizes = 0;
+
+bool count_round_trip(dccl::Codec* codec)
+{
+    CountCodecMsg msg_in, msg_out;
+    msg_in.set_a(-12);
+    msg_in.set_b("abc");
+    std::string bytes;
+    codec->encode(&bytes, msg_in);
+    codec->decode(bytes, &msg_out);
+    return msg_in.SerializeAsString() == msg_out.SerializeAsString();
+}
+
+struct Worker
+{
+    dccl::Codec* codec;
+    int index;
+    bool ok;
+};
+
+void* encode(void* arg)
+{
+    Worker* worker = static_cast<Worker*>(arg);
+    // keep going until the swapping is finished, so that the two overlap
+    for(int i = 0; worker->ok && (i < num_iterations || !done); ++i)
+        worker->ok = round_trip(worker->codec, worker->index * num_iterations + i);
+    return 0;
+}
+
+void* swap(void*)
+{
+    using google::protobuf::FieldDescriptor;
+    for(int i = 0; i < num_swaps; ++i)
+    {
+        // a codec that no one is using
+        dccl::FieldCodecManager::add<dccl::v3::DefaultNumericFieldCodec<dccl::int32> >("test.swap");
+        // a codec that takes over SwapMsg from the default message codec (with the same encoding)
+        dccl::FieldCodecManager::add<dccl::v3::DefaultMessageCodec>(dccl::Codec::default_codec_name(3), SwapMsg::descriptor());
+
+        dccl::FieldCodecManager::remove<dccl::v3::DefaultNumericFieldCodec<dccl::int32> >("test.swap");
+        dccl::FieldCodecManager::remove<dccl::v3::DefaultMessageCodec>(dccl::Codec::default_codec_name(3), SwapMsg::descriptor());
+    }
+    done = true;
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<Worker> workers(num_threads);
+    for(int i = 0; i < num_threads; ++i)
+    {
+        workers[i].codec = new dccl::Codec;
+        workers[i].codec->load<SwapMsg>();
+        workers[i].index = i;
+        workers[i].ok = true;
+    }
+
+    std::vector<pthread_t> threads(num_threads);
+    for(int i = 0; i < num_threads; ++i)
+    {
+        if(pthread_create(&threads[i], 0, &encode, &workers[i]) != 0)
+        {
+            std::cerr << "failed to create thread " << i << std::endl;
+            return 1;
+        }
+    }
+
+    pthread_t swapper;
+    if(pthread_create(&swapper, 0, &swap, 0) != 0)
+    {
+        std::cerr << "failed to create swapper thread" << std::endl;
+        return 1;
+    }
+    pthread_join(swapper, 0);
+
+    for(int i = 0; i < num_threads; ++i)
+    {
+        pthread_join(threads[i], 0);
+        assert(workers[i].ok);
+        delete workers[i].codec;
+    }
+
+    // the registry is consistent afterwards: removed codecs are gone and added ones are usable
+    dccl::Codec codec;
+    try
+    {
+        codec.load<SwapCodecMsg>();
+        assert(false);
+    }
+    catch(dccl::Exception& e)
+    {
+    }
+
+    dccl::FieldCodecManager::add<dccl::v3::DefaultNumericFieldCodec<dccl::int32> >("test.swap");
+    codec.load<SwapCodecMsg>();
+    SwapCodecMsg msg_in, msg_out;
+    msg_in.set_a(42);
+    std::string bytes;
+    codec.encode(&bytes, msg_in);
+    codec.decode(bytes, &msg_out);
+    assert(msg_out.a() == 42);
+    codec.load<SwapMsg>();
+    assert(round_trip(&codec, 7));
+
+    // adding and removing codecs that a message does not use leaves its cached plans and sizes in use
+    {
+        dccl::FieldCodecManager::add<CountingCodec>("test.count");
+        dccl::Codec count_codec;
+        count_codec.load<CountCodecMsg>();
+        assert(count_round_trip(&count_codec));
+        const int plans = CountingCodec::plans, sizes = CountingCodec::sizes;
+        assert(plans > 0 && sizes > 0);
+
+        swap(0);
+        dccl::FieldCodecManager::add<dccl::v3::DefaultNumericFieldCodec<dccl::int64> >("test.swap");
+        dccl::FieldCodecManager::remove<dccl::v3::DefaultNumericFieldCodec<dccl::int64> >("test.swap");
+
+        assert(count_round_trip(&count_codec));
+        count_codec.load<CountCodecMsg>();
+        assert(count_round_trip(&count_codec));
+        assert(CountingCodec::plans == plans);
+        assert(CountingCodec::sizes == sizes);
+
+        // replacing the codec that it does use is picked up straight away, and cached again by load()
+        dccl::FieldCodecManager::remove<CountingCodec>("test.count");
+        dccl::FieldCodecManager::add<CountingCodec>("test.count");
+        assert(count_round_trip(&count_codec));
+        assert(CountingCodec::plans > plans);
+        assert(CountingCodec::sizes > sizes);
+
+        count_codec.load<CountCodecMsg>();
+        const int reloaded_plans = CountingCodec::plans, reloaded_sizes = CountingCodec::sizes;
+        assert(count_round_trip(&count_codec));
+        assert(CountingCodec::plans == reloaded_plans);
+        assert(CountingCodec::sizes == reloaded_sizes);
+    }
+
+    std::cout << "all tests passed" << std::endl;
+}
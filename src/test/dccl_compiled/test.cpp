@@ -0,0 +1,164 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests that message codecs compiled by protoc-gen-dccl (--dccl_out=compiled:...) produce the same bits as DefaultMessageCodec
+
+#include <cstdlib>
+
+#include <google/protobuf/dynamic_message.h>
+
+#include "dccl/codec.h"
+#include "dccl/codecs3/field_codec_compiled_message.h"
+#include "dccl/codecs3/field_codec_default_message.h"
+// generated with protoc-gen-dccl --dccl_out=compiled:..., which adds the compiled codecs to test.pb.cc
+#include "test.pb.h"
+
+using namespace dccl::test;
+
+const int num_msgs = 500;
+
+void fill(CompiledMsg* msg, int seed)
+{
+    msg->set_source(seed % 32);
+    if(seed % 3)
+        msg->set_lat(-90 + (seed * 0.0123457) - 180 * int(seed * 0.0123457 / 180));
+    if(seed % 4)
+        msg->set_temp(-5 + (seed % 4000) * 0.01f);
+    if(seed % 5)
+        msg->set_count(seed * 2003 % 1000001);
+    if(seed % 6)
+        msg->set_delta(seed % 20001 - 10000);
+    if(seed % 7)
+        msg->set_flag(seed % 2);
+    msg->set_ack(seed % 3 == 1);
+    if(seed % 2)
+        msg->set_mode(static_cast<CompiledMsg::Mode>(CompiledMsg::Mode_descriptor()->value(seed % 3)->number()));
+    if(seed % 5 != 1)
+        msg->set_raw_mode(static_cast<CompiledMsg::Mode>(CompiledMsg::Mode_descriptor()->value(seed % 3)->number()));
+    if(seed % 4 == 1)
+        msg->set_name(std::string("abcdefghij").substr(0, seed % 11));
+    for(int i = 0, n = seed % 5; i < n; ++i)
+        msg->add_values((seed + i) % 101);
+    if(seed % 3 != 2)
+    {
+        if(seed % 2)
+            msg->mutable_inner()->set_depth((seed % 1001) * 0.1);
+        msg->mutable_inner()->set_valid(seed % 2);
+    }
+    if(seed % 5 == 2)
+        msg->set_presence(seed % 11);
+    // out of bounds, encoded as "not present" when not strict
+    if(seed % 50 == 3)
+        msg->set_lat(91);
+    if(seed % 50 == 4)
+        msg->set_count(2000000);
+}
+
+void encode_all(dccl::Codec* codec, std::vector<std::string>* bytes, std::vector<unsigned>* sizes, std::vector<std::string>* decoded)
+{
+    for(int i = 0; i < num_msgs; ++i)
+    {
+        CompiledMsg msg;
+        fill(&msg, i);
+        std::string encoded;
+        codec->encode(&encoded, msg);
+        bytes->push_back(encoded);
+        sizes->push_back(codec->size(msg));
+
+        CompiledMsg msg_out;
+        codec->decode(encoded, &msg_out);
+        decoded->push_back(msg_out.SerializeAsString());
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::Codec codec;
+    codec.load<CompiledMsg>();
+
+    // the compiled codecs were added when the default codecs were loaded, and take precedence for their message types
+    assert(boost::dynamic_pointer_cast<dccl::v3::CompiledMessageCodec<CompiledMsg> >(dccl::FieldCodecManager::find(CompiledMsg::descriptor())));
+    assert(boost::dynamic_pointer_cast<dccl::v3::CompiledMessageCodec<CompiledInner> >(dccl::FieldCodecManager::find(CompiledInner::descriptor(), "dccl.default3")));
+    codec.info<CompiledMsg>(&std::cout);
+
+    std::vector<std::string> compiled_bytes, compiled_decoded;
+    std::vector<unsigned> compiled_sizes;
+    encode_all(&codec, &compiled_bytes, &compiled_sizes, &compiled_decoded);
+
+    // a DynamicMessage of the same type uses the fields' codecs
+    {
+        google::protobuf::DynamicMessageFactory factory;
+        for(int i = 0; i < num_msgs; i += 7)
+        {
+            CompiledMsg msg;
+            fill(&msg, i);
+            boost::shared_ptr<google::protobuf::Message> dynamic_msg(factory.GetPrototype(CompiledMsg::descriptor())->New());
+            dynamic_msg->ParseFromString(msg.SerializeAsString());
+
+            std::string encoded;
+            codec.encode(&encoded, *dynamic_msg);
+            assert(encoded == compiled_bytes[i]);
+            assert(codec.size(*dynamic_msg) == compiled_sizes[i]);
+
+            dynamic_msg->Clear();
+            codec.decode(encoded, dynamic_msg.get());
+            assert(dynamic_msg->SerializeAsString() == compiled_decoded[i]);
+        }
+    }
+
+    // strict mode throws for out of bounds values, as the field codec does
+    {
+        CompiledMsg msg;
+        fill(&msg, 1);
+        msg.set_lat(-91);
+        codec.set_strict(true);
+        try
+        {
+            std::string encoded;
+            codec.encode(&encoded, msg);
+            assert(false);
+        }
+        catch(dccl::OutOfRangeException& e)
+        {
+            assert(e.field() == CompiledMsg::descriptor()->FindFieldByName("lat"));
+        }
+        codec.set_strict(false);
+    }
+
+    // now without the compiled codecs
+    dccl::FieldCodecManager::remove<dccl::v3::DefaultMessageCodec>("dccl.default3", CompiledMsg::descriptor());
+    dccl::FieldCodecManager::remove<dccl::v3::DefaultMessageCodec>("dccl.default3", CompiledInner::descriptor());
+    assert(!boost::dynamic_pointer_cast<dccl::v3::CompiledMessageCodec<CompiledMsg> >(dccl::FieldCodecManager::find(CompiledMsg::descriptor())));
+    codec.load<CompiledMsg>();
+
+    std::vector<std::string> dynamic_bytes, dynamic_decoded;
+    std::vector<unsigned> dynamic_sizes;
+    encode_all(&codec, &dynamic_bytes, &dynamic_sizes, &dynamic_decoded);
+
+    for(int i = 0; i < num_msgs; ++i)
+    {
+        assert(compiled_bytes[i] == dynamic_bytes[i]);
+        assert(compiled_sizes[i] == dynamic_sizes[i]);
+        assert(compiled_decoded[i] == dynamic_decoded[i]);
+    }
+
+    std::cout << "all tests passed" << std::endl;
+}
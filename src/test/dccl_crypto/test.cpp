@@ -0,0 +1,82 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests that encrypted messages are unchanged on the wire: known answers for AES-CTR with the
+// key and IV derived from SHA256 as CryptoPP::CTR_Mode<AES> was keyed before the cipher was cached
+
+#include "dccl/codec.h"
+#include "dccl/binary.h"
+#include "test.pb.h"
+
+using namespace dccl::test;
+
+int main(int argc, char* argv[])
+{
+    dccl::dlog.connect(dccl::logger::ALL, &std::cerr);
+
+    CryptoMsg msg_in;
+    // the head hashes to an IV ending in 0xff, so the counter carries into the next byte after the first block
+    msg_in.set_sequence(176);
+    // a body of three blocks, the last one partial
+    msg_in.set_text("The quick brown fox jumps over the lazy dog");
+    msg_in.set_value(-273);
+
+    const std::string plain_hex = "18b0002b155a19485c5ddad81a8898dcdb9d1b88d91b1e885a5d1bdc1cc89b5d991c081d5a19085b985e1e08d9dbd9b500";
+    // head (the nonce) followed by the body encrypted with
+    // key = SHA256("my_passphrase!"), IV = first 16 bytes of SHA256(head), big-endian counter increment
+    // (computed independently, with `openssl enc -aes-256-ctr`)
+    const std::string cipher_hex = "18b00096ceb21c6d878e867f8edad8628632406fe76ff0fc0234a6a988a69daa471e8854c774cb1704b8c6451d1a483082";
+
+    dccl::Codec codec;
+    codec.load<CryptoMsg>();
+    std::string bytes;
+    codec.encode(&bytes, msg_in);
+    assert(dccl::hex_encode(bytes) == plain_hex);
+
+    dccl::Codec crypto_codec;
+    crypto_codec.set_crypto_passphrase("my_passphrase!");
+    crypto_codec.load<CryptoMsg>();
+
+    std::string crypto_bytes;
+    crypto_codec.encode(&crypto_bytes, msg_in);
+#if DCCL_HAS_CRYPTOPP
+    assert(dccl::hex_encode(crypto_bytes) == cipher_hex);
+#else
+    std::cout << "compiled without Crypto++: only checking the unencrypted encoding" << std::endl;
+    assert(dccl::hex_encode(crypto_bytes) == plain_hex);
+#endif
+
+    // and in place, through the char* overload
+    std::vector<char> buffer(crypto_codec.max_size<CryptoMsg>());
+    std::size_t len = crypto_codec.encode(&buffer[0], buffer.size(), msg_in);
+    assert(std::string(&buffer[0], len) == crypto_bytes);
+
+    CryptoMsg msg_out;
+#if DCCL_HAS_CRYPTOPP
+    crypto_codec.decode(dccl::hex_decode(cipher_hex), &msg_out);
+    assert(msg_out.SerializeAsString() == msg_in.SerializeAsString());
+    msg_out.Clear();
+#endif
+    crypto_codec.decode(crypto_bytes, &msg_out);
+    assert(msg_out.SerializeAsString() == msg_in.SerializeAsString());
+
+    std::cout << "all tests passed" << std::endl;
+}
@@ -23,6 +23,7 @@
 // tests cryptography
 
 #include "dccl/codec.h"
+#include "dccl/codecs3/field_codec_default.h"
 #include "test.pb.h"
 
 
@@ -169,6 +170,16 @@ namespace dccl
     
         };
 
+        // changes the encoding of DefaultNumericFieldCodec by overriding only the Bitset hooks,
+        // which must not be bypassed by the base class's BitWriter / BitReader overloads
+        class HalvingCodec : public dccl::v3::DefaultNumericFieldCodec<dccl::int32>
+        {
+            dccl::Bitset encode(const dccl::int32& wire_value)
+            { return dccl::v3::DefaultNumericFieldCodec<dccl::int32>::encode(wire_value / 2); }
+
+            dccl::int32 decode(dccl::Bitset* bits)
+            { return 2 * dccl::v3::DefaultNumericFieldCodec<dccl::int32>::decode(bits); }
+        };
     }
 }
 
@@ -219,6 +230,42 @@ int main(int argc, char* argv[])
     codec.decode(bytes2, &msg_out2);
     std::cout << "... got Message out:\n" << msg_out2.DebugString() << std::endl;
     assert(msg_in2.SerializeAsString() == msg_out2.SerializeAsString());
+
+    // a subclass overriding only encode(const WireType&) and decode(Bitset*) is encoded through them
+    {
+        dccl::FieldCodecManager::add<dccl::test::HalvingCodec>("halving_codec");
+        assert(!dccl::test::HalvingCodec().direct_io());
+        assert(dccl::v3::DefaultNumericFieldCodec<dccl::int32>().direct_io());
+
+        dccl::Codec plain_codec;
+        plain_codec.load<HalvedMsg>();
+        plain_codec.load<HalvedReferenceMsg>();
+
+        HalvedMsg halved_in, halved_out;
+        halved_in.set_a(40);
+        halved_in.set_b(10);
+        halved_in.add_d(2);
+        halved_in.add_d(4);
+        halved_in.add_d(6);
+
+        HalvedReferenceMsg reference;
+        reference.set_a(20);
+        reference.set_b(5);
+        reference.add_d(1);
+        reference.add_d(2);
+        reference.add_d(3);
+
+        std::string halved_bytes, reference_bytes;
+        plain_codec.encode(&halved_bytes, halved_in);
+        plain_codec.encode(&reference_bytes, reference);
+        // same body (the one byte ids differ)
+        assert(halved_bytes.substr(1) == reference_bytes.substr(1));
+        assert(plain_codec.size(halved_in) == plain_codec.size(reference));
+
+        plain_codec.decode(halved_bytes, &halved_out);
+        std::cout << "Halved message out:\n" << halved_out.DebugString() << std::endl;
+        assert(halved_in.SerializeAsString() == halved_out.SerializeAsString());
+    }
     
     std::cout << "all tests passed" << std::endl;
 }
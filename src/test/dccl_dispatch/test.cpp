@@ -0,0 +1,110 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests reading the DCCL id in place and dispatching frames by id
+
+#include <boost/bind/bind.hpp>
+
+#include "dccl/codec.h"
+#include "test.pb.h"
+
+using namespace dccl::test;
+
+struct Counter
+{
+    Counter() : calls(0), last_id(0), last_size(0) { }
+
+    void handle(unsigned dccl_id, const char* begin, const char* end)
+    {
+        ++calls;
+        last_id = dccl_id;
+        last_size = end - begin;
+    }
+
+    int calls;
+    unsigned last_id;
+    std::size_t last_size;
+};
+
+int main(int argc, char* argv[])
+{
+    dccl::Codec codec;
+    codec.load<ShortIdMsg>();
+    codec.load<LongIdMsg>();
+
+    assert(codec.id<ShortIdMsg>() == 2);
+    assert(codec.id<LongIdMsg>() == 1000);
+    assert(codec.loaded_descriptor(2) == ShortIdMsg::descriptor());
+    assert(codec.loaded_descriptor(1000) == LongIdMsg::descriptor());
+    assert(codec.loaded_descriptor(3) == 0);
+    assert(codec.loaded_descriptor(1 << 20) == 0);
+
+    ShortIdMsg short_msg;
+    short_msg.set_value(10);
+    LongIdMsg long_msg;
+    long_msg.set_value(20);
+
+    std::string short_bytes, long_bytes;
+    codec.encode(&short_bytes, short_msg);
+    codec.encode(&long_bytes, long_msg);
+
+    // one and two byte forms of the id, read in place and through the iterator interface
+    assert(codec.id(short_bytes) == 2);
+    assert(codec.id(long_bytes) == 1000);
+    assert(codec.id(long_bytes.begin(), long_bytes.end()) == 1000);
+
+    // too short to hold the id
+    try
+    {
+        codec.id(long_bytes.data(), long_bytes.data() + 1);
+        assert(false);
+    }
+    catch(dccl::Exception& e)
+    { }
+
+    using namespace boost::placeholders;
+    Counter short_counter, long_counter;
+    codec.add_frame_handler(2, boost::bind(&Counter::handle, &short_counter, _1, _2, _3));
+    codec.add_frame_handler(1000, boost::bind(&Counter::handle, &long_counter, _1, _2, _3));
+
+    assert(codec.dispatch(short_bytes));
+    assert(codec.dispatch(long_bytes));
+    assert(codec.dispatch(long_bytes));
+    assert(short_counter.calls == 1 && short_counter.last_id == 2 && short_counter.last_size == short_bytes.size());
+    assert(long_counter.calls == 2 && long_counter.last_id == 1000 && long_counter.last_size == long_bytes.size());
+
+    // the handler need not be for a loaded type
+    codec.unload<LongIdMsg>();
+    assert(codec.loaded_descriptor(1000) == 0);
+    assert(codec.dispatch(long_bytes));
+    assert(long_counter.calls == 3);
+
+    codec.remove_frame_handler(1000);
+    assert(!codec.dispatch(long_bytes));
+    assert(long_counter.calls == 3);
+
+    // decoding still works after the table changes
+    ShortIdMsg short_out;
+    codec.decode(short_bytes, &short_out);
+    assert(short_out.value() == 10);
+
+    std::cout << "all tests passed" << std::endl;
+}
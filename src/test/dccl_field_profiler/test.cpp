@@ -0,0 +1,151 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests the per-field profiler (FieldProfiler, Codec::set_field_profiler)
+
+#include <sstream>
+
+#include "dccl/codec.h"
+#include "test.pb.h"
+
+using namespace dccl::test;
+
+const dccl::FieldProfile* find(const std::vector<dccl::FieldProfile>& profiles, const std::string& name)
+{
+    for(std::vector<dccl::FieldProfile>::const_iterator it = profiles.begin(), end = profiles.end(); it != end; ++it)
+    {
+        if(it->field->full_name() == name)
+            return &*it;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::dlog.connect(dccl::logger::ALL, &std::cerr);
+
+    dccl::Codec codec;
+    codec.load<ProfiledMsg>();
+
+    ProfiledMsg msg;
+    msg.set_x(500);
+    msg.mutable_embedded()->set_a(42);
+    msg.mutable_embedded()->add_b(true);
+    msg.mutable_embedded()->add_b(false);
+    msg.set_label("hello");
+
+    const int n = 100;
+    
+    // no profiler: nothing is recorded
+    {
+        dccl::FieldProfiler profiler;
+        std::string bytes;
+        codec.encode(&bytes, msg);
+        assert(profiler.sampled_messages() == 0);
+        assert(profiler.profiles().empty());
+        assert(codec.field_profiler() == 0);
+    }
+    
+    // profile every message
+    {
+        dccl::FieldProfiler profiler;
+        codec.set_field_profiler(&profiler);
+        assert(codec.field_profiler() == &profiler);
+
+        std::string bytes;
+        for(int i = 0; i < n; ++i)
+        {
+            bytes.clear();
+            codec.encode(&bytes, msg);
+            ProfiledMsg decoded;
+            codec.decode(bytes, &decoded);
+            assert(decoded.SerializeAsString() == msg.SerializeAsString());
+        }
+        codec.set_field_profiler(0);
+
+        assert(profiler.sampled_messages() == 2*n);
+
+        std::vector<dccl::FieldProfile> profiles = profiler.profiles();
+        const dccl::FieldProfile* x = find(profiles, "dccl.test.ProfiledMsg.x");
+        const dccl::FieldProfile* embedded = find(profiles, "dccl.test.ProfiledMsg.embedded");
+        const dccl::FieldProfile* a = find(profiles, "dccl.test.ProfiledEmbedded.a");
+        const dccl::FieldProfile* b = find(profiles, "dccl.test.ProfiledEmbedded.b");
+        const dccl::FieldProfile* label = find(profiles, "dccl.test.ProfiledMsg.label");
+        assert(x && embedded && a && b && label);
+
+        for(std::vector<dccl::FieldProfile>::const_iterator it = profiles.begin(), end = profiles.end(); it != end; ++it)
+        {
+            assert(!it->codec.empty());
+            assert(it->encodes == static_cast<dccl::uint64>(n));
+            assert(it->decodes == static_cast<dccl::uint64>(n));
+            // decoding reads exactly what encoding wrote
+            assert(it->encode_bits == it->decode_bits);
+        }
+
+        // 0-1023 required: 10 bits; 0-255 required: 8 bits
+        assert(x->encode_bits == 10u*n);
+        assert(a->encode_bits == 8u*n);
+
+        // the bits of the embedded message's fields are not counted against the embedded field itself
+        assert(embedded->encode_bits < a->encode_bits);
+        assert(embedded->encode_bits + a->encode_bits + b->encode_bits < 8u*32*n);
+
+        // the fields account for every bit of the body (the rest is the DCCL id and the padding to a whole byte)
+        dccl::uint64 field_bits = 0;
+        for(std::vector<dccl::FieldProfile>::const_iterator it = profiles.begin(), end = profiles.end(); it != end; ++it)
+            field_bits += it->encode_bits;
+        assert(field_bits <= 8u*bytes.size()*n);
+        assert(field_bits > 8u*(bytes.size() - 2)*n);
+
+        std::stringstream report;
+        profiler.report(&report);
+        std::cout << report.str();
+        assert(report.str().find("== Fields by time") != std::string::npos);
+        assert(report.str().find("== Fields by encoded size") != std::string::npos);
+        assert(report.str().find("dccl.test.ProfiledEmbedded.a") != std::string::npos);
+
+        profiler.reset();
+        assert(profiler.sampled_messages() == 0);
+        assert(profiler.profiles().empty());
+    }
+
+    // sample one in every ten messages
+    {
+        dccl::FieldProfiler profiler(10);
+        assert(profiler.sample_period() == 10);
+        codec.set_field_profiler(&profiler);
+
+        std::string bytes;
+        for(int i = 0; i < n; ++i)
+        {
+            bytes.clear();
+            codec.encode(&bytes, msg);
+        }
+        codec.set_field_profiler(0);
+
+        assert(profiler.sampled_messages() == n/10);
+        std::vector<dccl::FieldProfile> profiles = profiler.profiles();
+        const dccl::FieldProfile* x = find(profiles, "dccl.test.ProfiledMsg.x");
+        assert(x && x->encodes == static_cast<dccl::uint64>(n/10) && x->decodes == 0);
+    }
+
+    std::cout << "all tests passed" << std::endl;
+}
@@ -0,0 +1,163 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests building arithmetic models from a corpus of messages
+
+#include "dccl/codec.h"
+#include "dccl/arithmetic/field_codec_arithmetic.h"
+#include "dccl/arithmetic/model_trainer.h"
+
+#include "test.pb.h"
+
+using namespace dccl::test;
+
+// skewed values, as a real corpus would have
+void fill(TrainMsg* msg, int i)
+{
+    msg->set_state((i % 10) ? STATE_SURVEY : ((i % 20) ? STATE_IDLE : STATE_ABORT));
+    if(i % 3)
+        msg->set_count((i % 7) ? 0 : (i % 21) - 10);
+    for(int j = 0, n = (i % 5) ? 8 : i % 8; j < n; ++j)
+        msg->add_reading(((i + j) % 4) ? -1 : (((i * j) % 3) ? 1 : -50 + (i * 7 + j) % 101));
+    if(i % 2)
+        msg->set_flag(i % 9 == 1);
+    msg->set_name("abc");
+    if(i % 4)
+        msg->mutable_sample()->set_depth(100 * (i % 3));
+    msg->set_skipped(i);
+}
+
+const google::protobuf::FieldDescriptor* field(const std::string& name)
+{ return TrainMsg::descriptor()->FindFieldByName(name); }
+
+int main(int argc, char* argv[])
+{
+    dccl::dlog.connect(dccl::logger::WARN_PLUS, &std::cerr);
+
+    const int num_msgs = 2000;
+    std::vector<TrainMsg> corpus(num_msgs);
+    for(int i = 0; i < num_msgs; ++i)
+        fill(&corpus[i], i);
+
+    // training in parts and merging is the same as training on the whole corpus
+    dccl::arith::ModelTrainer trainer;
+    std::vector<dccl::arith::ModelTrainer> parts(4);
+    for(int i = 0; i < num_msgs; ++i)
+    {
+        trainer.add(corpus[i]);
+        parts[i % parts.size()].add(corpus[i]);
+    }
+    dccl::arith::ModelTrainer merged;
+    for(std::size_t i = 0; i < parts.size(); ++i)
+        merged.merge(parts[i]);
+    assert(merged.messages() == num_msgs);
+    assert(trainer.messages() == num_msgs);
+
+    // string, message and omitted fields are not counted
+    std::vector<const google::protobuf::FieldDescriptor*> fields = trainer.fields();
+    assert(fields == merged.fields());
+    assert(fields.size() == 6);
+    assert(fields[0] == field("count"));
+    assert(fields[1] == field("flag"));
+    assert(fields[2] == field("never"));
+    assert(fields[3] == field("reading"));
+    assert(fields[4] == field("state"));
+    assert(fields[5] == TrainSample::descriptor()->FindFieldByName("depth"));
+
+    // a field that is never set has no model
+    dccl::arith::protobuf::ArithmeticModel model;
+    assert(!trainer.model(field("never"), &model));
+
+    for(std::size_t i = 0; i < fields.size(); ++i)
+    {
+        dccl::arith::protobuf::ArithmeticModel merged_model;
+        if(!trainer.model(fields[i], &model))
+            continue;
+        assert(merged.model(fields[i], &merged_model));
+        assert(model.SerializeAsString() == merged_model.SerializeAsString());
+        std::cout << model.DebugString() << std::endl;
+
+        // every value seen maps back to its own symbol
+        dccl::arith::Model symbols(model);
+        for(int j = 0, n = model.frequency_size(); j < n; ++j)
+            assert(symbols.value_to_symbol(model.value_bound(j)) == j);
+    }
+
+    // the required field never ends early
+    assert(trainer.model(field("state"), &model));
+    assert(model.eof_frequency() == 0);
+    assert(model.frequency_size() == 3);
+    assert(model.frequency(0) == 100 && model.frequency(1) == 1800 && model.frequency(2) == 100);
+
+    // the repeated field has one EOF for each message with fewer than max_repeat readings (plus one)
+    assert(trainer.model(field("reading"), &model));
+    assert(model.eof_frequency() == 1 + num_msgs / 5);
+    assert(model.value_bound(0) == -50);
+    assert(trainer.distinct_values(field("reading")) == static_cast<unsigned>(model.frequency_size()));
+
+    // too many distinct values
+    dccl::arith::ModelTrainer small_trainer(3);
+    small_trainer.merge(trainer);
+    assert(!small_trainer.model(field("reading"), &model));
+    assert(small_trainer.model(field("state"), &model));
+
+    // use the models: the trained message is smaller, and close to the expected size
+    dccl::Codec codec;
+    codec.load_library(DCCL_ARITHMETIC_NAME);
+    codec.load<TrainMsg>();
+
+    double expected_bits = 0;
+    for(std::size_t i = 0; i < fields.size(); ++i)
+    {
+        if(trainer.model(fields[i], &model))
+        {
+            dccl::arith::ModelManager::set_model(model);
+            expected_bits += trainer.expected_bits(fields[i], model);
+        }
+    }
+    codec.load<TrainedMsg>();
+    codec.info<TrainedMsg>(&std::cout);
+
+    dccl::uint64 default_bytes = 0, trained_bytes = 0;
+    for(int i = 0; i < num_msgs; ++i)
+    {
+        std::string bytes;
+        codec.encode(&bytes, corpus[i]);
+        default_bytes += bytes.size();
+
+        TrainedMsg trained;
+        trained.ParseFromString(corpus[i].SerializeAsString());
+        trained.clear_skipped();
+        bytes.clear();
+        codec.encode(&bytes, trained);
+        trained_bytes += bytes.size();
+
+        TrainedMsg trained_out;
+        codec.decode(bytes, &trained_out);
+        assert(trained.SerializeAsString() == trained_out.SerializeAsString());
+    }
+
+    std::cout << "default: " << default_bytes << " bytes, trained: " << trained_bytes << " bytes, expected bits per message for the trained fields: " << expected_bits << std::endl;
+    assert(trained_bytes < default_bytes * 0.7);
+    assert(expected_bits > 0);
+
+    std::cout << "all tests passed" << std::endl;
+}
@@ -230,6 +230,18 @@ void run_test(dccl::Codec& codec, NativeProtobufTest& msg_in)
 }
 
 
+void run_packed_test(dccl::Codec& codec, const NativeProtobufPackedTest& msg_in)
+{
+    std::string bytes;
+    codec.encode(&bytes, msg_in);
+    std::cout << "Packed message:\n" << msg_in.DebugString() << "... got bytes (hex): " << dccl::hex_encode(bytes) << std::endl;
+    assert(bytes.size() == codec.size(msg_in));
+
+    NativeProtobufPackedTest msg_out;
+    codec.decode(bytes, &msg_out);
+    assert(msg_in.SerializeAsString() == msg_out.SerializeAsString());
+}
+
 int main(int argc, char* argv[])
 {
     dccl::dlog.connect(dccl::logger::ALL, &std::cerr);    
@@ -265,6 +277,111 @@ int main(int argc, char* argv[])
     
     
     
+    codec.load<NativeProtobufPackedTest>();
+    codec.info<NativeProtobufPackedTest>(&dccl::dlog);
+
+    {
+        NativeProtobufPackedTest msg_in;
+        msg_in.add_int32_packed(0);
+        msg_in.add_int32_packed(150);
+        msg_in.add_int32_packed(-1);
+        msg_in.add_int32_packed(std::numeric_limits<dccl::int32>::max());
+        msg_in.add_sint64_packed(-3);
+        msg_in.add_sint64_packed(std::numeric_limits<dccl::int64>::min());
+        msg_in.add_double_packed(1.5);
+        msg_in.add_double_packed(-std::numeric_limits<double>::max());
+        msg_in.add_enum_packed(ENUM_B);
+        msg_in.add_enum_packed(ENUM_C);
+        msg_in.add_bool_packed(true);
+        msg_in.add_bool_packed(false);
+        run_packed_test(codec, msg_in);
+
+        // all empty: one zero length byte per field
+        run_packed_test(codec, NativeProtobufPackedTest());
+        assert(codec.size(NativeProtobufPackedTest()) == 1 + 5);
+    }
+
+    {
+        // a packed field is byte aligned after the (1 byte) id, so the body is the Protobuf encoding without the field tag
+        NativeProtobufPackedTest msg_in;
+        msg_in.add_int32_packed(3);
+        msg_in.add_int32_packed(270);
+        msg_in.add_int32_packed(-86942);
+        std::string bytes;
+        codec.encode(&bytes, msg_in);
+        std::string pb_bytes = msg_in.SerializeAsString();
+        assert(bytes.substr(1, pb_bytes.size() - 1) == pb_bytes.substr(1));
+        run_packed_test(codec, msg_in);
+    }
+
+    {
+        // more values than max_repeat
+        NativeProtobufPackedTest msg_in;
+        for(int i = 0; i < 3; ++i)
+            msg_in.add_bool_packed(true);
+        std::string bytes;
+        assert(codec.try_encode(&bytes, msg_in) == dccl::STATUS_OUT_OF_RANGE);
+    }
+
+    {
+        // a length that does not end on a value boundary
+        NativeProtobufPackedTest msg_in;
+        msg_in.add_int32_packed(300);
+        std::string bytes;
+        codec.encode(&bytes, msg_in);
+        assert(static_cast<unsigned char>(bytes[1]) == 2);
+        bytes[1] = 1;
+
+        NativeProtobufPackedTest msg_out;
+        assert(codec.try_decode(bytes, &msg_out) == dccl::STATUS_CODEC_ERROR);
+    }
+
+    {
+        // protobuf's [packed = true] alone is encoded value by value, as it was before (dccl.field).packed
+        NativeProtobufPbPackedTest pb_packed_in;
+        NativeProtobufRepeatedTest repeated_in;
+        const int values[] = { 0, 150, -1, 300 };
+        for(int i = 0; i < 4; ++i)
+        {
+            pb_packed_in.add_int32_repeated(values[i]);
+            repeated_in.add_int32_repeated(values[i]);
+        }
+        pb_packed_in.add_enum_repeated(ENUM_B);
+        repeated_in.add_enum_repeated(ENUM_B);
+
+        codec.load<NativeProtobufPbPackedTest>();
+        codec.load<NativeProtobufRepeatedTest>();
+        std::string pb_packed_bytes, repeated_bytes;
+        codec.encode(&pb_packed_bytes, pb_packed_in);
+        codec.encode(&repeated_bytes, repeated_in);
+        // same body after the (1 byte) id
+        assert(pb_packed_bytes.substr(1) == repeated_bytes.substr(1));
+
+        NativeProtobufPbPackedTest pb_packed_out;
+        codec.decode(pb_packed_bytes, &pb_packed_out);
+        assert(pb_packed_in.SerializeAsString() == pb_packed_out.SerializeAsString());
+
+        // and loads with codec_version 2
+        NativeProtobufPbPackedV2Test v2_in, v2_out;
+        for(int i = 0; i < 4; ++i)
+            v2_in.add_int32_repeated(values[i]);
+        codec.load<NativeProtobufPbPackedV2Test>();
+        std::string v2_bytes;
+        codec.encode(&v2_bytes, v2_in);
+        codec.decode(v2_bytes, &v2_out);
+        assert(v2_in.SerializeAsString() == v2_out.SerializeAsString());
+
+        // whereas (dccl.field).packed needs codec_version 3
+        try
+        {
+            codec.load<NativeProtobufPackedV2Test>();
+            assert(false);
+        }
+        catch(dccl::Exception& e)
+        {
+        }
+    }
+
     std::cout << "all tests passed" << std::endl;
 }
 
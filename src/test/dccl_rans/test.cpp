@@ -0,0 +1,237 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests the rANS codec ("dccl.rans")
+
+#include <cmath>
+
+#include "dccl/codec.h"
+#include "dccl/field_codec_manager.h"
+#include "dccl/arithmetic/field_codec_rans.h"
+
+#include "test.pb.h"
+
+using namespace dccl::test;
+
+// uses only the Bitset interface of the rANS codec, as does a codec that wraps it
+class BitsetRansCodec : public dccl::arith::RansFieldCodec<double>
+{
+    void any_encode_repeated(dccl::BitWriter* writer, const std::vector<boost::any>& wire_values)
+    {
+        std::vector<double> in;
+        for(std::vector<boost::any>::const_iterator it = wire_values.begin(), end = wire_values.end(); it != end; ++it)
+            in.push_back(boost::any_cast<double>(*it));
+        writer->write(encode_repeated(in));
+    }
+
+    void any_decode_repeated(dccl::BitReader* reader, std::vector<boost::any>* wire_values)
+    {
+        dccl::internal::BitReaderBitset bits(reader, max_size_repeated(), min_size_repeated());
+        std::vector<double> out = decode_repeated(bits.bits());
+        wire_values->assign(out.begin(), out.end());
+    }
+};
+
+dccl::Codec codec;
+
+template<typename ProtobufMessage>
+std::string round_trip(const ProtobufMessage& msg_in, ProtobufMessage* msg_out)
+{
+    std::string bytes;
+    codec.encode(&bytes, msg_in);
+    assert(codec.size(msg_in) == bytes.size());
+    codec.decode(bytes, msg_out);
+    return bytes;
+}
+
+template<typename ProtobufMessage>
+std::string check_round_trip(const ProtobufMessage& msg_in)
+{
+    ProtobufMessage msg_out;
+    std::string bytes = round_trip(msg_in, &msg_out);
+    assert(msg_in.SerializeAsString() == msg_out.SerializeAsString());
+    return bytes;
+}
+
+void set_model(const std::string& name, dccl::uint32 eof_freq, dccl::uint32 out_of_range_freq,
+               const std::vector<double>& bounds, const std::vector<dccl::uint32>& freqs,
+               bool is_adaptive = false)
+{
+    dccl::arith::protobuf::ArithmeticModel model;
+    model.set_name(name);
+    model.set_eof_frequency(eof_freq);
+    model.set_out_of_range_frequency(out_of_range_freq);
+    for(std::size_t i = 0; i < bounds.size(); ++i)
+        model.add_value_bound(bounds[i]);
+    for(std::size_t i = 0; i < freqs.size(); ++i)
+        model.add_frequency(freqs[i]);
+    model.set_is_adaptive(is_adaptive);
+    dccl::arith::ModelManager::set_model(model);
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::dlog.connect(dccl::logger::WARN_PLUS, &std::cerr);
+
+    void* dl_handle = dlopen(DCCL_ARITHMETIC_NAME, RTLD_LAZY);
+    if(!dl_handle)
+    {
+        std::cerr << "Failed to open " << DCCL_ARITHMETIC_NAME << std::endl;
+        exit(1);
+    }
+    codec.load_library(dl_handle);
+    dccl::FieldCodecManager::add<BitsetRansCodec>("test.rans_bitset");
+
+    // singular and short repeated fields, and the rules for values without a frequency
+    {
+        std::vector<double> bounds;
+        std::vector<dccl::uint32> freqs;
+
+        bounds.push_back(1); bounds.push_back(2); bounds.push_back(3); bounds.push_back(4);
+        freqs.push_back(5); freqs.push_back(3); freqs.push_back(2);
+        set_model("enum_model", 2, 0, bounds, freqs);
+
+        bounds.clear(); freqs.clear();
+        bounds.push_back(0); bounds.push_back(1); bounds.push_back(2);
+        freqs.push_back(1); freqs.push_back(6);
+        // no EOF: short fields are filled with the most probable value
+        set_model("no_eof_model", 0, 0, bounds, freqs);
+
+        freqs.clear();
+        freqs.push_back(4); freqs.push_back(4);
+        set_model("out_of_range_model", 1, 1, bounds, freqs);
+
+        codec.load<RansEnumTestMsg>();
+        codec.info<RansEnumTestMsg>(&std::cout);
+
+        RansEnumTestMsg msg_in;
+        msg_in.set_single(ENUM_B);
+        msg_in.add_filled(0);
+        msg_in.add_filled(1);
+        msg_in.add_filled(1);
+        msg_in.add_filled(0);
+        check_round_trip(msg_in);
+
+        for(int i = 0; i < 4; ++i)
+        {
+            msg_in.add_value(static_cast<Enum1>(i % 3 + 1));
+            msg_in.set_optional_single(static_cast<Enum1>((i + 1) % 3 + 1));
+            check_round_trip(msg_in);
+        }
+
+        msg_in.add_out_of_range(0);
+        msg_in.add_out_of_range(1);
+        check_round_trip(msg_in);
+
+        // an out of range value without a frequency ends the field, and (as there is no EOF) the
+        // rest is filled with the most probable value; with a frequency it decodes as NaN
+        msg_in.clear_filled();
+        msg_in.add_filled(0);
+        msg_in.add_filled(7);
+        msg_in.add_out_of_range(5);
+        RansEnumTestMsg msg_out;
+        round_trip(msg_in, &msg_out);
+        assert(msg_out.filled_size() == 4);
+        assert(msg_out.filled(0) == 0);
+        for(int i = 1; i < 4; ++i)
+            assert(msg_out.filled(i) == 1);
+        assert(msg_out.out_of_range_size() == 3);
+        assert(msg_out.out_of_range(1) == 1);
+        assert(std::isnan(msg_out.out_of_range(2)));
+    }
+
+    // adaptive models are not supported
+    {
+        std::vector<double> bounds;
+        std::vector<dccl::uint32> freqs;
+        bounds.push_back(0); bounds.push_back(1); bounds.push_back(2);
+        freqs.push_back(1); freqs.push_back(1);
+        set_model("adaptive_model", 1, 1, bounds, freqs, true);
+
+        bool threw = false;
+        try
+        {
+            codec.load<RansAdaptiveTestMsg>();
+        }
+        catch(dccl::Exception& e)
+        {
+            std::cout << "Caught (as expected): " << e.what() << std::endl;
+            threw = true;
+        }
+        assert(threw);
+    }
+
+    // random models (mostly with totals larger than the rANS coder state, so that the frequencies
+    // are scaled down) and messages of every length, drawn from the model
+    srand(1);
+    unsigned rans_bytes = 0, arithmetic_bytes = 0;
+    for(unsigned i = 0; i <= RansDoubleTestMsg::descriptor()->FindFieldByName("value")->options().GetExtension(dccl::field).max_repeat(); ++i)
+    {
+        const int symbols = rand() % 1000 + 2;
+        const dccl::arith::Model::freq_type each_max_freq = (i % 4) ? dccl::arith::Model::MAX_FREQUENCY / (symbols + 2) : 4;
+
+        std::vector<double> bounds;
+        std::vector<dccl::uint32> freqs;
+        std::vector<dccl::uint64> cumulative;
+        dccl::uint64 total = 0;
+        for(int j = 0; j <= symbols; ++j)
+        {
+            bounds.push_back(j * 10);
+            if(j < symbols)
+            {
+                // skewed, so that the message is compressible
+                freqs.push_back((rand() % 8) ? rand() % 4 + 1 : rand() % each_max_freq + 1);
+                total += freqs.back();
+                cumulative.push_back(total);
+            }
+        }
+        set_model("model", rand() % each_max_freq + 1, (i % 2) ? 0 : rand() % each_max_freq + 1, bounds, freqs);
+        codec.load<RansDoubleTestMsg>();
+        codec.load<ArithmeticDoubleTestMsg>();
+        codec.load<RansBitsetTestMsg>();
+
+        RansDoubleTestMsg msg_in;
+        for(unsigned j = 0; j < i; ++j)
+        {
+            dccl::uint64 c_freq = (static_cast<dccl::uint64>(rand()) * RAND_MAX + rand()) % total;
+            msg_in.add_value(bounds[std::upper_bound(cumulative.begin(), cumulative.end(), c_freq) - cumulative.begin()]);
+        }
+
+        std::string bytes = check_round_trip(msg_in);
+        rans_bytes += bytes.size();
+
+        // the Bitset interface gives the same bits
+        RansBitsetTestMsg bitset_msg_in;
+        bitset_msg_in.mutable_value()->CopyFrom(msg_in.value());
+        std::string bitset_bytes = check_round_trip(bitset_msg_in);
+        assert(bitset_bytes.substr(1) == bytes.substr(1));
+
+        ArithmeticDoubleTestMsg arithmetic_msg_in;
+        arithmetic_msg_in.mutable_value()->CopyFrom(msg_in.value());
+        arithmetic_bytes += check_round_trip(arithmetic_msg_in).size();
+    }
+
+    std::cout << "rANS: " << rans_bytes << " bytes, arithmetic: " << arithmetic_bytes << " bytes" << std::endl;
+    // comparable compression: at most a couple of bytes of coder state per message more
+    assert(rans_bytes < arithmetic_bytes * 1.02 + 2 * 101);
+
+    std::cout << "all tests passed" << std::endl;
+}
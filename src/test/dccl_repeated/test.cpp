@@ -22,6 +22,9 @@
 // tests functionality of std::list<const google::protobuf::Message*> calls
 
 
+#include <deque>
+#include <vector>
+
 #include "dccl/codec.h"
 #include "dccl/binary.h"
 
@@ -119,6 +122,101 @@ int main(int argc, char* argv[])
     }
 
 
+    // non-destructive, from a raw buffer
+    {
+        std::list< boost::shared_ptr<google::protobuf::Message> > msgs_out;
+        try
+        {
+            const char* data = bytes1.data();
+            std::size_t len = bytes1.size();
+            while(len)
+            {
+                std::map<dccl::int32, const google::protobuf::Descriptor*>::const_iterator it = codec.loaded().find(codec.id(data, data + len));
+                if(it == codec.loaded().end())
+                    break;
+
+                boost::shared_ptr<google::protobuf::Message> msg =
+                    dccl::DynamicProtobufManager::new_protobuf_message(it->second);
+                std::size_t consumed = 0;
+                codec.decode(data, len, msg.get(), &consumed);
+                assert(consumed == codec.size(*msg));
+                data += consumed;
+                len -= consumed;
+                msgs_out.push_back(msg);
+            }
+        }
+        catch(dccl::Exception &e)
+        {
+            std::cout << e.what() << std::endl;
+        }
+
+        assert(msgs.size() == msgs_out.size());
+
+        std::list<const google::protobuf::Message*>::const_iterator in_it = msgs.begin();
+        for(std::list< boost::shared_ptr<google::protobuf::Message> >::const_iterator it = msgs_out.begin(),
+                end = msgs_out.end(); it != end; ++it)
+        {
+            assert((*in_it)->SerializeAsString() == (*it)->SerializeAsString());
+            ++in_it;
+        }
+    }
+
+    // non-destructive, from contiguous (vector) and non-contiguous (deque) iterators
+    {
+        std::vector<char> vbytes(bytes1.begin(), bytes1.end());
+        std::deque<char> dbytes(bytes1.begin(), bytes1.end());
+
+        std::vector<char>::const_iterator vbegin = vbytes.begin(), vend = vbytes.end();
+        std::deque<char>::const_iterator dbegin = dbytes.begin(), dend = dbytes.end();
+        std::list<const google::protobuf::Message*>::const_iterator in_it = msgs.begin();
+        for(; in_it != msgs.end(); ++in_it)
+        {
+            boost::shared_ptr<google::protobuf::Message> vmsg =
+                dccl::DynamicProtobufManager::new_protobuf_message((*in_it)->GetDescriptor());
+            boost::shared_ptr<google::protobuf::Message> dmsg =
+                dccl::DynamicProtobufManager::new_protobuf_message((*in_it)->GetDescriptor());
+
+            vbegin = codec.decode(vbegin, vend, vmsg.get());
+            dbegin = codec.decode(dbegin, dend, dmsg.get());
+
+            assert((*in_it)->SerializeAsString() == vmsg->SerializeAsString());
+            assert((*in_it)->SerializeAsString() == dmsg->SerializeAsString());
+            assert(vbegin - vbytes.begin() == dbegin - dbytes.begin());
+        }
+        // only the trailing padding is left
+        assert(vend - vbegin == 4);
+    }
+
+    // non-destructive, from a raw buffer of encrypted frames: each body is decrypted on its own
+    {
+        dccl::Codec crypto_codec;
+        crypto_codec.set_crypto_passphrase("my_passphrase!");
+        for(std::list<const google::protobuf::Descriptor*>::const_iterator it = descs.begin(),
+                end = descs.end(); it != end; ++it)
+            crypto_codec.load(*it);
+
+        std::string crypto_bytes;
+        for(std::list<const google::protobuf::Message*>::const_iterator it = msgs.begin(),
+                end = msgs.end(); it != end; ++it)
+            crypto_codec.encode(&crypto_bytes, *(*it));
+
+        const char* data = crypto_bytes.data();
+        std::size_t len = crypto_bytes.size();
+        for(std::list<const google::protobuf::Message*>::const_iterator in_it = msgs.begin(),
+                end = msgs.end(); in_it != end; ++in_it)
+        {
+            boost::shared_ptr<google::protobuf::Message> msg =
+                dccl::DynamicProtobufManager::new_protobuf_message((*in_it)->GetDescriptor());
+            std::size_t consumed = 0;
+            crypto_codec.decode(data, len, msg.get(), &consumed);
+            assert(consumed == crypto_codec.size(*msg));
+            assert((*in_it)->SerializeAsString() == msg->SerializeAsString());
+            data += consumed;
+            len -= consumed;
+        }
+        assert(len == 0);
+    }
+
     // destructive
     {
         std::list< boost::shared_ptr<google::protobuf::Message> > msgs_out;
@@ -0,0 +1,95 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests sharing a loaded dccl::Schema between Codec instances
+
+#include "dccl/codec.h"
+#include "test.pb.h"
+
+using namespace dccl::test;
+
+int main(int argc, char* argv[])
+{
+    dccl::Codec codec;
+    codec.load<SchemaMsg>();
+
+    SchemaMsg msg_in;
+    msg_in.set_value(42);
+    msg_in.set_label("shared");
+
+    std::string bytes;
+    codec.encode(&bytes, msg_in);
+
+    // another link shares the loaded messages without loading them again
+    dccl::Codec link(codec.schema());
+    assert(link.schema() == codec.schema());
+    assert(link.loaded_descriptor(15) == SchemaMsg::descriptor());
+    {
+        SchemaMsg msg_out;
+        link.decode(bytes, &msg_out);
+        assert(msg_out.SerializeAsString() == msg_in.SerializeAsString());
+    }
+
+    // loading a type that is already loaded does not copy the schema
+    link.load<SchemaMsg>();
+    assert(link.schema() == codec.schema());
+
+    // link-specific settings are not shared
+    link.set_crypto_passphrase("link");
+    {
+        std::string link_bytes;
+        link.encode(&link_bytes, msg_in);
+#if DCCL_HAS_CRYPTOPP
+        assert(link_bytes != bytes);
+#endif
+
+        std::string codec_bytes;
+        codec.encode(&codec_bytes, msg_in);
+        assert(codec_bytes == bytes);
+
+        SchemaMsg msg_out;
+        link.decode(link_bytes, &msg_out);
+        assert(msg_out.SerializeAsString() == msg_in.SerializeAsString());
+    }
+
+    // loading a new type gives the link its own copy; the original is unchanged
+    boost::shared_ptr<const dccl::Schema> original = codec.schema();
+    link.load<OtherMsg>();
+    assert(link.schema() != original);
+    assert(codec.schema() == original);
+    assert(link.loaded().size() == 2);
+    assert(codec.loaded().size() == 1);
+    assert(codec.loaded_descriptor(16) == 0);
+    assert(link.loaded_descriptor(16) == OtherMsg::descriptor());
+
+    // as does unloading
+    dccl::Codec link2(codec.schema());
+    link2.unload<SchemaMsg>();
+    assert(link2.loaded().empty());
+    assert(codec.loaded_descriptor(15) == SchemaMsg::descriptor());
+    {
+        SchemaMsg msg_out;
+        codec.decode(bytes, &msg_out);
+        assert(msg_out.SerializeAsString() == msg_in.SerializeAsString());
+    }
+
+    std::cout << "all tests passed" << std::endl;
+}
@@ -0,0 +1,246 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests the runtime statistics kept by Codec (set_stats_enabled, stats, CodecStats)
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+
+#include <pthread.h>
+
+#include "dccl/codec.h"
+#include "test.pb.h"
+
+using namespace dccl::test;
+
+const int num_threads = 4;
+const int num_iterations = 1000;
+
+const dccl::MessageStats* find(const dccl::CodecStats& stats, int dccl_id)
+{
+    for(std::vector<dccl::MessageStats>::const_iterator it = stats.messages.begin(), end = stats.messages.end(); it != end; ++it)
+    {
+        if(it->dccl_id == dccl_id)
+            return &*it;
+    }
+    return 0;
+}
+
+void check_histogram(const dccl::LatencyHistogram& h, dccl::uint64 count)
+{
+    assert(h.count == count);
+    dccl::uint64 sum = 0;
+    for(int i = 0; i < dccl::LatencyHistogram::NUM_BUCKETS; ++i)
+        sum += h.buckets[i];
+    assert(sum == count);
+    assert(count == 0 || h.sum_ns > 0);
+}
+
+struct Worker
+{
+    dccl::Codec* codec;
+    std::string bytes;
+};
+
+void* run(void* arg)
+{
+    Worker* worker = static_cast<Worker*>(arg);
+    for(int i = 0; i < num_iterations; ++i)
+    {
+        StatsMsg msg;
+        worker->codec->decode(worker->bytes, &msg);
+    }
+    return 0;
+}
+
+bool contains(const std::string& s, const std::string& part)
+{
+    return s.find(part) != std::string::npos;
+}
+
+int main(int argc, char* argv[])
+{
+    dccl::Codec codec;
+    codec.load<StatsMsg>();
+
+    StatsMsg msg_in;
+    msg_in.set_source(3);
+    msg_in.set_value(-7);
+    msg_in.set_label("hello");
+
+    // off by default
+    assert(!codec.stats_enabled());
+    {
+        std::string bytes;
+        codec.encode(&bytes, msg_in);
+        assert(codec.stats().messages.empty());
+    }
+
+    // types loaded before and after enabling are both counted
+    codec.set_stats_enabled(true);
+    codec.load<OtherStatsMsg>();
+    {
+        dccl::CodecStats stats = codec.stats();
+        assert(stats.messages.size() == 2);
+        assert(stats.messages[0].dccl_id == 20 && stats.messages[0].name == "dccl.test.StatsMsg");
+        assert(stats.messages[1].dccl_id == 21 && stats.messages[1].name == "dccl.test.OtherStatsMsg");
+        assert(stats.messages[0].encode.count == 0);
+    }
+
+    std::string bytes;
+    for(int i = 0; i < 10; ++i)
+    {
+        bytes.clear();
+        codec.encode(&bytes, msg_in);
+    }
+    for(int i = 0; i < 5; ++i)
+    {
+        StatsMsg msg_out;
+        codec.decode(bytes, &msg_out);
+        assert(msg_out.SerializeAsString() == msg_in.SerializeAsString());
+    }
+
+    // failures: by exception and by status
+    {
+        StatsMsg msg_out;
+        dccl::Status status;
+        assert(codec.try_decode(bytes.substr(0, bytes.size() - 2), &msg_out, &status) == dccl::STATUS_TRUNCATED);
+        try
+        {
+            codec.decode(bytes.substr(0, bytes.size() - 2), &msg_out);
+            assert(false);
+        }
+        catch(dccl::Exception& e)
+        { }
+
+        StatsMsg uninitialized;
+        std::string out;
+        assert(codec.try_encode(&out, uninitialized, &status) == dccl::STATUS_NOT_INITIALIZED);
+        try
+        {
+            codec.encode(&out, uninitialized);
+            assert(false);
+        }
+        catch(dccl::Exception& e)
+        { }
+
+        // no id at all
+        assert(codec.try_decode(std::string(), &msg_out, &status) == dccl::STATUS_TOO_SHORT);
+    }
+
+    {
+        dccl::CodecStats stats = codec.stats();
+        const dccl::MessageStats* s = find(stats, 20);
+        assert(s);
+        assert(s->encode.count == 10);
+        assert(s->encode.bytes == 10 * bytes.size());
+        // the head and body are each padded by less than a byte
+        assert(s->encode.padding_bits % 10 == 0 && s->encode.padding_bits / 10 < 2 * 8);
+        assert(s->encode.failures[dccl::STATUS_NOT_INITIALIZED] == 2);
+        assert(s->encode.failed() == 2);
+        check_histogram(s->encode.latency, 12);
+        check_histogram(s->encode.crypto_latency, 0);
+
+        assert(s->decode.count == 5);
+        assert(s->decode.bytes == 5 * bytes.size());
+        assert(s->decode.failures[dccl::STATUS_TRUNCATED] == 2);
+        assert(s->decode.failed() == 2);
+        check_histogram(s->decode.latency, 7);
+
+        const dccl::MessageStats* unknown = find(stats, -1);
+        assert(unknown && unknown->name.empty());
+        assert(unknown->decode.failures[dccl::STATUS_TOO_SHORT] == 1);
+
+        assert(find(stats, 21)->encode.count == 0);
+
+        std::stringstream prometheus;
+        stats.write_prometheus(&prometheus);
+        std::cout << prometheus.str() << std::endl;
+        assert(contains(prometheus.str(), "# TYPE dccl_encodes_total counter\n"));
+        assert(contains(prometheus.str(), "dccl_encodes_total{id=\"20\",message=\"dccl.test.StatsMsg\"} 10\n"));
+        assert(contains(prometheus.str(), "dccl_decode_failures_total{id=\"20\",message=\"dccl.test.StatsMsg\",reason=\"truncated\"} 2\n"));
+        assert(contains(prometheus.str(), "dccl_encode_seconds_count{id=\"20\",message=\"dccl.test.StatsMsg\"} 12\n"));
+        assert(contains(prometheus.str(), "dccl_encode_seconds_bucket{id=\"20\",message=\"dccl.test.StatsMsg\",le=\"+Inf\"} 12\n"));
+
+        std::stringstream json;
+        stats.write_json(&json);
+        std::cout << json.str() << std::endl;
+        assert(contains(json.str(), "{\"id\": 20, \"name\": \"dccl.test.StatsMsg\", \"encode\": {\"count\": 10, \"failures\": {\"not_initialized\": 2}"));
+
+        const std::string path = "dccl_test_stats.json";
+        stats.save(path, dccl::STATS_JSON);
+        std::ifstream fin(path.c_str());
+        std::stringstream saved;
+        saved << fin.rdbuf();
+        assert(saved.str() == json.str());
+        std::remove(path.c_str());
+
+        try
+        {
+            stats.save("/nonexistent/directory/stats.prom");
+            assert(false);
+        }
+        catch(dccl::Exception& e)
+        { }
+    }
+
+    // counts from several threads add up
+    codec.reset_stats();
+    assert(find(codec.stats(), 20)->decode.count == 0);
+    {
+        std::vector<Worker> workers(num_threads);
+        std::vector<pthread_t> threads(num_threads);
+        for(int i = 0; i < num_threads; ++i)
+        {
+            workers[i].codec = &codec;
+            workers[i].bytes = bytes;
+            if(pthread_create(&threads[i], 0, &run, &workers[i]) != 0)
+            {
+                std::cerr << "failed to create thread " << i << std::endl;
+                return 1;
+            }
+        }
+        for(int i = 0; i < num_threads; ++i)
+            pthread_join(threads[i], 0);
+
+        const dccl::MessageStats* s = find(codec.stats(), 20);
+        assert(s->decode.count == num_threads * num_iterations);
+        check_histogram(s->decode.latency, num_threads * num_iterations);
+    }
+
+#if DCCL_HAS_CRYPTOPP
+    codec.set_crypto_passphrase("secret");
+    bytes.clear();
+    codec.encode(&bytes, msg_in);
+    {
+        StatsMsg msg_out;
+        codec.decode(bytes, &msg_out);
+    }
+    check_histogram(find(codec.stats(), 20)->encode.crypto_latency, 1);
+    check_histogram(find(codec.stats(), 20)->decode.crypto_latency, 1);
+#endif
+
+    codec.set_stats_enabled(false);
+    assert(codec.stats().messages.empty());
+
+    std::cout << "all tests passed" << std::endl;
+}
@@ -0,0 +1,138 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests that separate Codec instances can encode and decode concurrently
+
+#include <pthread.h>
+
+#include "dccl/codec.h"
+#include "test.pb.h"
+
+#include "dccl/binary.h"
+using namespace dccl::test;
+
+const int num_threads = 8;
+const int num_iterations = 500;
+
+template<typename Msg>
+void fill(Msg* msg, int seed)
+{
+    msg->mutable_header()->set_source(seed % 32);
+    if(seed % 3)
+        msg->mutable_header()->set_dest((seed * 7) % 32);
+    msg->set_name(std::string("abcdefgh").substr(0, 1 + seed % 8));
+    // version 2 always encodes max_repeat elements
+    int n = Msg::descriptor()->options().GetExtension(dccl::msg).codec_version() == 2 ? 4 : seed % 5;
+    for(int i = 0; i < n; ++i)
+    {
+        Sample* sample = msg->add_sample();
+        sample->set_depth((seed * 13 + i) % 10000 / 10.0);
+        if(i % 2)
+            sample->set_valid(seed % 2);
+    }
+    if(seed % 4)
+        msg->set_count(seed % 201 - 100);
+}
+
+void fill_data(ThreadMsgV3* msg, int seed)
+{
+    if(seed % 2)
+        msg->set_data(std::string("\x01\x02\x03\x04\x05\x06", seed % 7));
+}
+
+void fill_data(ThreadMsgV2*, int) { }
+
+template<typename Msg>
+bool round_trip(dccl::Codec* codec, int seed)
+{
+    Msg msg_in;
+    fill(&msg_in, seed);
+    fill_data(&msg_in, seed);
+
+    std::string bytes;
+    codec->encode(&bytes, msg_in);
+    if(bytes.size() != codec->size(msg_in))
+        return false;
+
+    Msg msg_out;
+    codec->decode(bytes, &msg_out);
+    return msg_in.SerializeAsString() == msg_out.SerializeAsString();
+}
+
+struct Worker
+{
+    dccl::Codec* codec;
+    int index;
+    bool ok;
+};
+
+void* run(void* arg)
+{
+    Worker* worker = static_cast<Worker*>(arg);
+    for(int i = 0; i < num_iterations; ++i)
+    {
+        int seed = worker->index * num_iterations + i;
+        worker->ok = worker->ok && round_trip<ThreadMsgV2>(worker->codec, seed) && round_trip<ThreadMsgV3>(worker->codec, seed);
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    // one Codec per thread, all constructed and loaded before any work starts
+    std::vector<dccl::Codec*> codecs;
+    std::vector<Worker> workers(num_threads);
+    for(int i = 0; i < num_threads; ++i)
+    {
+        codecs.push_back(new dccl::Codec);
+        codecs.back()->load<ThreadMsgV2>();
+        codecs.back()->load<ThreadMsgV3>();
+        workers[i].codec = codecs.back();
+        workers[i].index = i;
+        workers[i].ok = true;
+    }
+
+    // sanity check single threaded
+    for(int i = 0; i < 50; ++i)
+    {
+        assert(round_trip<ThreadMsgV2>(codecs[0], i));
+        assert(round_trip<ThreadMsgV3>(codecs[0], i));
+    }
+
+    std::vector<pthread_t> threads(num_threads);
+    for(int i = 0; i < num_threads; ++i)
+    {
+        if(pthread_create(&threads[i], 0, &run, &workers[i]) != 0)
+        {
+            std::cerr << "failed to create thread " << i << std::endl;
+            return 1;
+        }
+    }
+
+    for(int i = 0; i < num_threads; ++i)
+    {
+        pthread_join(threads[i], 0);
+        assert(workers[i].ok);
+        delete codecs[i];
+    }
+
+    std::cout << "all tests passed" << std::endl;
+}
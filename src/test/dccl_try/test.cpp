@@ -0,0 +1,199 @@
+// Copyright 2009-2017 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (for 2013-)
+//                     Massachusetts Institute of Technology (for 2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Dynamic Compact Control Language Library
+// ("DCCL").
+//
+// DCCL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// DCCL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with DCCL.  If not, see <http://www.gnu.org/licenses/>.
+// tests Codec::try_encode and Codec::try_decode
+
+#include "dccl/codec.h"
+#include "test.pb.h"
+
+using namespace dccl::test;
+
+// user codec that refuses to decode values above 100
+class CheckedCodec : public dccl::TypedFixedFieldCodec<dccl::int32>
+{
+  private:
+    dccl::Bitset encode(const dccl::int32& wire_value)
+    { return dccl::Bitset(size(), static_cast<unsigned long>(wire_value)); }
+
+    dccl::Bitset encode()
+    { return encode(0); }
+
+    dccl::int32 decode(dccl::Bitset* bits)
+    {
+        dccl::int32 value = bits->to_ulong();
+        if(value > 100)
+            throw(dccl::Exception("value out of range for try_checked_codec"));
+        return value;
+    }
+
+    unsigned size()
+    { return 8; }
+
+    void validate()
+    { }
+};
+
+int main(int argc, char* argv[])
+{
+    dccl::Codec codec;
+    codec.load<TryMsg>();
+
+    TryMsg msg_in;
+    msg_in.set_source(7);
+    msg_in.set_value(-42);
+    msg_in.mutable_inner()->set_depth(123.4);
+    msg_in.mutable_inner()->set_label("a fairly long label for a field");
+
+    dccl::Status status;
+
+    // success: same bytes and message as encode() / decode()
+    std::string bytes;
+    assert(codec.try_encode(&bytes, msg_in, &status) == dccl::STATUS_OK);
+    assert(status.ok() && status.dccl_id() == 13);
+    {
+        std::string expected;
+        codec.encode(&expected, msg_in);
+        assert(bytes == expected);
+    }
+    {
+        TryMsg msg_out;
+        std::size_t consumed = 0;
+        assert(codec.try_decode(bytes.data(), bytes.size(), &msg_out, &consumed, &status) == dccl::STATUS_OK);
+        assert(status.ok() && consumed == bytes.size());
+        assert(msg_out.SerializeAsString() == msg_in.SerializeAsString());
+        std::cout << "ok: " << status.str() << std::endl;
+    }
+
+    // no bytes at all
+    {
+        TryMsg msg_out;
+        assert(codec.try_decode(std::string(), &msg_out, &status) == dccl::STATUS_TOO_SHORT);
+        assert(status.dccl_id() == -1 && status.field() == 0);
+        std::cout << status.str() << std::endl;
+    }
+
+    // too short for the header
+    {
+        TryMsg msg_out;
+        assert(codec.try_decode(bytes.substr(0, 1), &msg_out, &status) == dccl::STATUS_TOO_SHORT);
+        assert(status.dccl_id() == 13);
+        std::cout << status.str() << std::endl;
+    }
+
+    // cut off in the middle of inner.label
+    {
+        TryMsg msg_out;
+        const std::size_t cut = bytes.size() - 10;
+        assert(codec.try_decode(bytes.substr(0, cut), &msg_out, &status) == dccl::STATUS_TRUNCATED);
+        assert(status.field_path().size() == 2);
+        assert(status.field_path()[0] == TryMsg::descriptor()->FindFieldByName("inner"));
+        assert(status.field() == TryInner::descriptor()->FindFieldByName("label"));
+        assert(status.bit_offset() > 0 && status.bit_offset() <= cut * 8);
+        std::cout << status.str() << std::endl;
+
+        // the throwing interface still throws
+        try
+        {
+            codec.decode(bytes.substr(0, cut), &msg_out);
+            assert(false);
+        }
+        catch(dccl::Exception& e)
+        { }
+    }
+
+    // id that this codec has not loaded
+    {
+        dccl::Codec other_codec;
+        TryMsg msg_out;
+        assert(other_codec.try_decode(bytes, &msg_out, &status) == dccl::STATUS_UNKNOWN_ID);
+        assert(status.dccl_id() == 13);
+        // status is optional
+        assert(other_codec.try_decode(bytes, &msg_out) == dccl::STATUS_UNKNOWN_ID);
+        std::cout << status.str() << std::endl;
+    }
+
+    // missing required field
+    {
+        TryMsg msg;
+        msg.set_source(1);
+        std::string out = "prefix";
+        assert(codec.try_encode(&out, msg, &status) == dccl::STATUS_NOT_INITIALIZED);
+        assert(out == "prefix");
+        std::cout << status.str() << std::endl;
+    }
+
+    // out of range in strict mode
+    {
+        codec.set_strict(true);
+        TryMsg msg = msg_in;
+        msg.mutable_inner()->set_depth(5000);
+        std::string out;
+        assert(codec.try_encode(&out, msg, &status) == dccl::STATUS_OUT_OF_RANGE);
+        assert(out.empty());
+        assert(status.field() == TryInner::descriptor()->FindFieldByName("depth"));
+        assert(status.field_path().size() == 2);
+        std::cout << status.str() << std::endl;
+        codec.set_strict(false);
+    }
+
+    // output buffer too small
+    {
+        char buffer[4];
+        std::size_t len = 0;
+        assert(codec.try_encode(buffer, sizeof(buffer), msg_in, &len, &status) == dccl::STATUS_BUFFER_TOO_SMALL);
+        assert(len == 0);
+        std::cout << status.str() << std::endl;
+    }
+
+    // exception thrown by a user codec
+    {
+        dccl::FieldCodecManager::add<CheckedCodec>("try_checked_codec");
+        codec.load<TryCodecMsg>();
+
+        TryCodecMsg msg;
+        msg.set_checked(42);
+        std::string good;
+        codec.encode(&good, msg);
+        TryCodecMsg msg_out;
+        assert(codec.try_decode(good, &msg_out, &status) == dccl::STATUS_OK);
+        assert(msg_out.checked() == 42);
+
+        msg.set_checked(200);
+        std::string bad;
+        codec.encode(&bad, msg);
+        assert(codec.try_decode(bad, &msg_out, &status) == dccl::STATUS_CODEC_ERROR);
+        assert(status.dccl_id() == 14);
+        assert(status.field() == TryCodecMsg::descriptor()->FindFieldByName("checked"));
+        assert(status.detail().find("try_checked_codec") != std::string::npos);
+        std::cout << status.str() << std::endl;
+
+        // the throwing interface still throws
+        try
+        {
+            codec.decode(bad, &msg_out);
+            assert(false);
+        }
+        catch(dccl::Exception& e)
+        { }
+    }
+
+    std::cout << "all tests passed" << std::endl;
+}